@@ -1,17 +1,35 @@
 // Data Node Server Entry Point with gRPC
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <csignal>
+#include <cstdint>
 #include <cstdlib>
+#include <filesystem>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
 
+#include <google/protobuf/arena.h>
 #include <grpcpp/grpcpp.h>
 #include <grpcpp/health_check_service_interface.h>
 #include <grpcpp/ext/proto_server_reflection_plugin.h>
+#include <grpcpp/support/message_allocator.h>
 
 #include "data_node.grpc.pb.h"
+#include "data_node/concurrency_limiter.h"
 #include "data_node/data_node.h"
+#include "data_node/logging.h"
+#include "data_node/metrics.h"
+#include "data_node/thread_pool.h"
 
 // Global pointer for signal handling
 std::unique_ptr<grpc::Server> g_server;
@@ -28,66 +46,443 @@ void signalHandler(int signal) {
   }
 }
 
-// gRPC service implementation
-class DataNodeServiceImpl final : public datanode::DataNodeService::Service {
+// Allocates the request and response of each call on a per-call protobuf
+// arena, so building a large SearchResponse costs a few block allocations
+// instead of one heap allocation per record and string field. The arena and
+// everything on it is freed when gRPC releases the call.
+template <typename RequestT, typename ResponseT>
+class ArenaMessageAllocator
+    : public grpc::MessageAllocator<RequestT, ResponseT> {
  public:
-  explicit DataNodeServiceImpl(std::shared_ptr<DataNode> node)
-      : node_(node) {}
+  grpc::MessageHolder<RequestT, ResponseT>* AllocateMessages() override {
+    return new ArenaMessageHolder();
+  }
 
-  grpc::Status Search(grpc::ServerContext* context,
-                     const datanode::SearchRequest* request,
-                     datanode::SearchResponse* response) override {
-    try {
-      // Extract query terms from request
-      std::vector<std::string> query_terms;
-      for (const auto& term : request->query_terms()) {
-        query_terms.push_back(term);
-      }
-
-      // Log the search request
-      std::cout << "[INFO] Search request received with " << query_terms.size()
-                << " term(s): ";
-      for (size_t i = 0; i < query_terms.size(); ++i) {
-        std::cout << "\"" << query_terms[i] << "\"";
-        if (i < query_terms.size() - 1) {
-          std::cout << ", ";
+ private:
+  class ArenaMessageHolder : public grpc::MessageHolder<RequestT, ResponseT> {
+   public:
+    ArenaMessageHolder() {
+      this->set_request(
+          google::protobuf::Arena::CreateMessage<RequestT>(&arena_));
+      this->set_response(
+          google::protobuf::Arena::CreateMessage<ResponseT>(&arena_));
+    }
+
+    void Release() override { delete this; }
+
+    // Arena-owned messages cannot be freed individually; the request is
+    // reclaimed with the arena in Release()
+    void FreeRequest() override {}
+
+   private:
+    google::protobuf::Arena arena_;
+  };
+};
+
+// Copy a stored record into a response message
+void fillRecord(const AddressRecordView& record,
+                datanode::AddressRecord* pb_record) {
+  pb_record->set_hash(record.hash);
+  pb_record->set_longitude(record.longitude);
+  pb_record->set_latitude(record.latitude);
+  pb_record->set_number(record.number.data(), record.number.size());
+  pb_record->set_street(record.street.data(), record.street.size());
+  pb_record->set_unit(record.unit.data(), record.unit.size());
+  pb_record->set_city(record.city.data(), record.city.size());
+  pb_record->set_postcode(record.postcode.data(), record.postcode.size());
+}
+
+// Copy a stored record into a response message, adding the time it took
+// to build_time
+void fillRecordTimed(const AddressRecordView& record,
+                     datanode::AddressRecord* pb_record,
+                     DataNode::Clock::duration& build_time) {
+  DataNode::Clock::time_point start = DataNode::Clock::now();
+  fillRecord(record, pb_record);
+  build_time += DataNode::Clock::now() - start;
+}
+
+// Streams the ranked matches of one SearchStream call, one chunk per write.
+// Records are copied out of the ForwardIndex only as their chunk is sent,
+// so a broad query never holds its whole response in memory. The cursor
+// keeps the index generation it ranked on alive, even across a reload.
+class SearchStreamReactor
+    : public grpc::ServerWriteReactor<datanode::SearchChunk> {
+ public:
+  // Records per SearchChunk
+  static constexpr size_t kChunkRecords = 32;
+
+  SearchStreamReactor(LatencyHistogram& build_latency, bool log_query)
+      : build_latency_(build_latency), log_query_(log_query) {}
+
+  // Start streaming the ranked matches; called once, from any thread. A
+  // call that is not started is finished with its error instead
+  void start(DataNode::RankedCursor cursor) {
+    cursor_ = std::move(cursor);
+    writeNextChunk();
+  }
+
+  void OnWriteDone(bool ok) override {
+    if (!ok || cancelled_) {
+      // The client cancelled or went away
+      LogLine(LogLevel::kInfo, nullptr, log_query_)
+          << "SearchStream ended by the client after " << streamed_
+          << " result(s)";
+      Finish(grpc::Status::CANCELLED);
+      return;
+    }
+    writeNextChunk();
+  }
+
+  // May run concurrently with OnWriteDone()
+  void OnCancel() override { cancelled_ = true; }
+
+  void OnDone() override { delete this; }
+
+ private:
+  DataNode::RankedCursor cursor_;
+  LatencyHistogram& build_latency_;
+  // Writes run on gRPC threads, so the query's sampling decision is kept
+  bool log_query_;
+  datanode::SearchChunk chunk_;
+  size_t streamed_ = 0;
+  std::atomic<bool> cancelled_{false};
+
+  void writeNextChunk() {
+    chunk_.Clear();
+    DataNode::Clock::duration build_time{};
+    size_t count = cursor_.next(
+        kChunkRecords,
+        [this, &build_time](const AddressRecordView& record, double score) {
+          fillRecordTimed(record, chunk_.add_results(), build_time);
+          chunk_.add_scores(score);
+        });
+    if (count == 0) {
+      LogLine(LogLevel::kInfo, nullptr, log_query_)
+          << "SearchStream completed, streamed " << streamed_ << " result(s)";
+      Finish(grpc::Status::OK);
+      return;
+    }
+    build_latency_.record(build_time);
+    streamed_ += count;
+    StartWrite(&chunk_);
+  }
+};
+
+// gRPC service implementation (callback API, which supports arena-allocated
+// messages through ArenaMessageAllocator). Searches are handed to a worker
+// pool sized to the machine instead of running on gRPC's callback threads,
+// which must not block; the reactor is finished from the worker. A
+// ConcurrencyLimiter caps the searches queued or running, so a burst is
+// answered with RESOURCE_EXHAUSTED (which the gateway fails over to
+// another replica) instead of an ever longer pool queue.
+class DataNodeServiceImpl final
+    : public datanode::DataNodeService::CallbackService {
+ public:
+  DataNodeServiceImpl(std::shared_ptr<DataNode> node,
+                      std::shared_ptr<ThreadPool> pool,
+                      std::shared_ptr<ConcurrencyLimiter> limiter)
+      : node_(node), pool_(pool), limiter_(limiter) {}
+
+  grpc::ServerUnaryReactor* Search(
+      grpc::CallbackServerContext* context,
+      const datanode::SearchRequest* request,
+      datanode::SearchResponse* response) override {
+    grpc::ServerUnaryReactor* reactor = context->DefaultReactor();
+    // The request and response stay valid until the reactor is finished
+    submitAdmitted(context, reactor, [this, reactor, request, response]() {
+      beginQueryLog();
+      try {
+        // Extract query terms from request
+        std::vector<std::string> query_terms(request->query_terms().begin(),
+                                             request->query_terms().end());
+
+        // Log the search request
+        {
+          LogLine line(LogLevel::kInfo, nullptr, isQueryLogged());
+          line << "Search request received with " << query_terms.size()
+               << " term(s): ";
+          for (size_t i = 0; i < query_terms.size(); ++i) {
+            line << "\"" << query_terms[i] << "\"";
+            if (i < query_terms.size() - 1) {
+              line << ", ";
+            }
+          }
         }
+
+        // Rank matches on this shard and serialize only the best ones,
+        // straight from the ForwardIndex into the response
+        size_t max_results = request->max_results() > 0
+                                 ? static_cast<size_t>(request->max_results())
+                                 : DataNode::kNoLimit;
+        DataNode::Clock::duration build_time{};
+        size_t result_count = node_->searchTopK(
+            query_terms, max_results, request->min_score(),
+            [response, &build_time](const AddressRecordView& record,
+                                    double score) {
+              fillRecordTimed(record, response->add_results(), build_time);
+              response->add_scores(score);
+            },
+            request->fuzziness());
+        node_->getMetrics().protobuf_build.record(build_time);
+
+        response->set_result_count(result_count);
+
+        LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+            << "Search completed, returning " << result_count << " result(s)";
+
+        reactor->Finish(grpc::Status::OK);
+
+      } catch (const std::exception& e) {
+        LogLine(LogLevel::kError, nullptr)
+            << "Exception during search: " << e.what();
+        reactor->Finish(grpc::Status(grpc::StatusCode::INTERNAL,
+                                     "Internal error during search"));
       }
-      std::cout << std::endl;
+    });
+    return reactor;
+  }
 
-      // Execute search
-      std::vector<AddressRecord> results = node_->search(query_terms);
+  grpc::ServerWriteReactor<datanode::SearchChunk>* SearchStream(
+      grpc::CallbackServerContext* context,
+      const datanode::SearchRequest* request) override {
+    bool log_query = beginQueryLog();
+    auto* reactor = new SearchStreamReactor(node_->getMetrics().protobuf_build,
+                                            log_query);
+    // Ranking takes the call's slot and runs on the pool; the writes that
+    // follow are paced by the client
+    submitAdmitted(context, reactor, [this, reactor, request, log_query]() {
+      try {
+        std::vector<std::string> query_terms(request->query_terms().begin(),
+                                             request->query_terms().end());
+        LogLine(LogLevel::kInfo, nullptr, log_query)
+            << "SearchStream request received with " << query_terms.size()
+            << " term(s)";
 
-      // Convert results to protobuf format
-      for (const auto& record : results) {
-        datanode::AddressRecord* pb_record = response->add_results();
-        pb_record->set_hash(record.hash);
-        pb_record->set_longitude(record.longitude);
-        pb_record->set_latitude(record.latitude);
-        pb_record->set_number(record.number);
-        pb_record->set_street(record.street);
-        pb_record->set_unit(record.unit);
-        pb_record->set_city(record.city);
-        pb_record->set_postcode(record.postcode);
+        size_t max_results = request->max_results() > 0
+                                 ? static_cast<size_t>(request->max_results())
+                                 : DataNode::kNoLimit;
+        reactor->start(node_->searchRanked(query_terms, max_results,
+                                           request->min_score(),
+                                           request->fuzziness()));
+      } catch (const std::exception& e) {
+        LogLine(LogLevel::kError, nullptr)
+            << "Exception during search stream: " << e.what();
+        reactor->Finish(grpc::Status(grpc::StatusCode::INTERNAL,
+                                     "Internal error during search"));
       }
+    });
+    return reactor;
+  }
+
+  grpc::ServerUnaryReactor* BatchSearch(
+      grpc::CallbackServerContext* context,
+      const datanode::BatchSearchRequest* request,
+      datanode::BatchSearchResponse* response) override {
+    grpc::ServerUnaryReactor* reactor = context->DefaultReactor();
+    submitAdmitted(context, reactor, [this, reactor, request, response]() {
+      beginQueryLog();
+      try {
+        std::vector<DataNode::BatchQuery> queries(request->queries_size());
+        for (int i = 0; i < request->queries_size(); ++i) {
+          const datanode::SearchRequest& query = request->queries(i);
+          queries[i].query_terms.assign(query.query_terms().begin(),
+                                        query.query_terms().end());
+          queries[i].max_results =
+              query.max_results() > 0
+                  ? static_cast<size_t>(query.max_results())
+                  : DataNode::kNoLimit;
+          queries[i].min_score = query.min_score();
+          queries[i].fuzziness = query.fuzziness();
+          response->add_responses();
+        }
+
+        LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+            << "BatchSearch request received with " << queries.size()
+            << " queries";
 
-      response->set_result_count(results.size());
+        // Every query fills its own response and build time, so the batch
+        // workers never share a message
+        std::vector<DataNode::Clock::duration> build_times(queries.size());
+        size_t result_count = node_->searchTopKBatch(
+            queries, [response, &build_times](size_t query,
+                                              const AddressRecordView& record,
+                                              double score) {
+              datanode::SearchResponse* query_response =
+                  response->mutable_responses(query);
+              fillRecordTimed(record, query_response->add_results(),
+                              build_times[query]);
+              query_response->add_scores(score);
+            });
+        for (auto& query_response : *response->mutable_responses()) {
+          query_response.set_result_count(query_response.results_size());
+        }
+        for (DataNode::Clock::duration build_time : build_times) {
+          node_->getMetrics().protobuf_build.record(build_time);
+        }
 
-      std::cout << "[INFO] Search completed, returning " << results.size()
-                << " result(s)" << std::endl;
+        LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+            << "BatchSearch completed, returning " << result_count
+            << " result(s)";
 
-      return grpc::Status::OK;
+        reactor->Finish(grpc::Status::OK);
 
-    } catch (const std::exception& e) {
-      std::cerr << "[ERROR] Exception during search: " << e.what() << std::endl;
-      return grpc::Status(grpc::StatusCode::INTERNAL,
-                         "Internal error during search");
+      } catch (const std::exception& e) {
+        LogLine(LogLevel::kError, nullptr)
+            << "Exception during batch search: " << e.what();
+        reactor->Finish(grpc::Status(grpc::StatusCode::INTERNAL,
+                                     "Internal error during batch search"));
+      }
+    });
+    return reactor;
+  }
+
+  grpc::ServerUnaryReactor* ReverseGeocode(
+      grpc::CallbackServerContext* context,
+      const datanode::ReverseGeocodeRequest* request,
+      datanode::ReverseGeocodeResponse* response) override {
+    grpc::ServerUnaryReactor* reactor = context->DefaultReactor();
+    GeoPoint point{request->longitude(), request->latitude()};
+    if (!point.isValid() || request->max_distance_meters() < 0) {
+      reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                                   "Invalid point or distance"));
+      return reactor;
     }
+
+    submitAdmitted(context, reactor, [this, reactor, request, response, point]() {
+      beginQueryLog();
+      try {
+        std::vector<std::string> query_terms(request->query_terms().begin(),
+                                             request->query_terms().end());
+        size_t max_results = request->max_results() > 0
+                                 ? static_cast<size_t>(request->max_results())
+                                 : DataNode::kNoLimit;
+        DataNode::Clock::duration build_time{};
+        size_t result_count = node_->searchNearest(
+            point, max_results, request->max_distance_meters(), query_terms,
+            [response, &build_time](const AddressRecordView& record,
+                                    double distance) {
+              datanode::NearbyAddress* nearby = response->add_results();
+              fillRecordTimed(record, nearby->mutable_record(), build_time);
+              nearby->set_distance_meters(distance);
+            });
+        node_->getMetrics().protobuf_build.record(build_time);
+
+        response->set_result_count(result_count);
+
+        LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+            << "ReverseGeocode completed, returning " << result_count
+            << " result(s)";
+
+        reactor->Finish(grpc::Status::OK);
+
+      } catch (const std::exception& e) {
+        LogLine(LogLevel::kError, nullptr)
+            << "Exception during reverse geocoding: " << e.what();
+        reactor->Finish(grpc::Status(
+            grpc::StatusCode::INTERNAL,
+            "Internal error during reverse geocoding"));
+      }
+    });
+    return reactor;
+  }
+
+  grpc::ServerUnaryReactor* Lookup(
+      grpc::CallbackServerContext* context,
+      const datanode::LookupRequest* request,
+      datanode::SearchResponse* response) override {
+    grpc::ServerUnaryReactor* reactor = context->DefaultReactor();
+    submitAdmitted(context, reactor, [this, reactor, request, response]() {
+      beginQueryLog();
+      try {
+        std::vector<std::string> keys(request->keys().begin(),
+                                      request->keys().end());
+        std::vector<std::string> query_terms(request->query_terms().begin(),
+                                             request->query_terms().end());
+        LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+            << "Lookup request received with " << keys.size() << " key(s)";
+
+        size_t max_results = request->max_results() > 0
+                                 ? static_cast<size_t>(request->max_results())
+                                 : DataNode::kNoLimit;
+        DataNode::Clock::duration build_time{};
+        size_t result_count = node_->lookup(
+            keys, query_terms, max_results,
+            [response, &build_time](const AddressRecordView& record,
+                                    double /*score*/) {
+              fillRecordTimed(record, response->add_results(), build_time);
+            });
+        node_->getMetrics().protobuf_build.record(build_time);
+
+        response->set_result_count(result_count);
+
+        LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+            << "Lookup completed, returning " << result_count << " result(s)";
+
+        reactor->Finish(grpc::Status::OK);
+
+      } catch (const std::exception& e) {
+        LogLine(LogLevel::kError, nullptr)
+            << "Exception during lookup: " << e.what();
+        reactor->Finish(grpc::Status(grpc::StatusCode::INTERNAL,
+                                     "Internal error during lookup"));
+      }
+    });
+    return reactor;
+  }
+
+  grpc::ServerUnaryReactor* SearchBox(
+      grpc::CallbackServerContext* context,
+      const datanode::SearchBoxRequest* request,
+      datanode::SearchResponse* response) override {
+    grpc::ServerUnaryReactor* reactor = context->DefaultReactor();
+    GeoBox box{request->min_longitude(), request->min_latitude(),
+               request->max_longitude(), request->max_latitude()};
+    if (!box.isValid()) {
+      reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                                   "Invalid bounding box"));
+      return reactor;
+    }
+
+    submitAdmitted(context, reactor, [this, reactor, request, response, box]() {
+      beginQueryLog();
+      try {
+        std::vector<std::string> query_terms(request->query_terms().begin(),
+                                             request->query_terms().end());
+        size_t max_results = request->max_results() > 0
+                                 ? static_cast<size_t>(request->max_results())
+                                 : DataNode::kNoLimit;
+        DataNode::Clock::duration build_time{};
+        size_t result_count = node_->searchBox(
+            box, max_results, query_terms,
+            [response, &build_time](const AddressRecordView& record) {
+              fillRecordTimed(record, response->add_results(), build_time);
+            });
+        node_->getMetrics().protobuf_build.record(build_time);
+
+        response->set_result_count(result_count);
+
+        LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+            << "SearchBox completed, returning " << result_count
+            << " result(s)";
+
+        reactor->Finish(grpc::Status::OK);
+
+      } catch (const std::exception& e) {
+        LogLine(LogLevel::kError, nullptr)
+            << "Exception during box search: " << e.what();
+        reactor->Finish(grpc::Status(grpc::StatusCode::INTERNAL,
+                                     "Internal error during box search"));
+      }
+    });
+    return reactor;
   }
 
-  grpc::Status GetStatistics(grpc::ServerContext* context,
-                            const datanode::StatisticsRequest* request,
-                            datanode::StatisticsResponse* response) override {
+  grpc::ServerUnaryReactor* GetStatistics(
+      grpc::CallbackServerContext* context,
+      const datanode::StatisticsRequest* request,
+      datanode::StatisticsResponse* response) override {
+    grpc::ServerUnaryReactor* reactor = context->DefaultReactor();
     try {
       DataNode::Statistics stats = node_->getStatistics();
 
@@ -95,21 +490,224 @@ class DataNodeServiceImpl final : public datanode::DataNodeService::Service {
       response->set_radix_tree_memory(stats.radix_tree_memory);
       response->set_forward_index_size(stats.forward_index_size);
       response->set_load_time_ms(stats.load_time.count());
+      response->set_postings_cache_hits(stats.postings_cache.hits);
+      response->set_postings_cache_misses(stats.postings_cache.misses);
+      response->set_postings_cache_entries(stats.postings_cache.entries);
+      response->set_postings_cache_bytes(stats.postings_cache.bytes);
+      response->set_postings_cache_max_bytes(stats.postings_cache.max_bytes);
+      response->set_spatial_index_memory(stats.spatial_index_memory);
+      response->set_key_index_memory(stats.key_index_memory);
+      response->set_generation(stats.generation);
+      response->set_loaded_at_unix_ms(
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              stats.loaded_at.time_since_epoch())
+              .count());
+
+      DataNode::Metrics& metrics = node_->getMetrics();
+      const std::pair<const char*, const LatencyHistogram*> stages[] = {
+          {"normalize", &metrics.normalize},
+          {"trie_lookup", &metrics.trie_lookup},
+          {"key_lookup", &metrics.key_lookup},
+          {"intersection", &metrics.intersection},
+          {"record_fetch", &metrics.record_fetch},
+          {"protobuf_build", &metrics.protobuf_build}};
+      for (const auto& [name, histogram] : stages) {
+        LatencyHistogram::Snapshot snapshot = histogram->snapshot();
+        datanode::StageLatency* stage = response->add_stage_latencies();
+        stage->set_stage(name);
+        stage->set_count(snapshot.count);
+        stage->set_sum_us(static_cast<double>(snapshot.sum) / 1e3);
+        stage->set_p50_us(static_cast<double>(snapshot.percentile(0.5)) / 1e3);
+        stage->set_p90_us(static_cast<double>(snapshot.percentile(0.9)) / 1e3);
+        stage->set_p99_us(static_cast<double>(snapshot.percentile(0.99)) /
+                          1e3);
+        stage->set_p999_us(static_cast<double>(snapshot.percentile(0.999)) /
+                           1e3);
+        stage->set_max_us(static_cast<double>(snapshot.max) / 1e3);
+      }
+      response->set_queries_served(metrics.queries.value());
+
+      ConcurrencyLimiter::Stats admission = limiter_->getStats();
+      response->set_admission_limit(admission.limit);
+      response->set_requests_in_flight(admission.in_flight);
+      response->set_requests_queued(pool_->getQueuedTaskCount());
+      response->set_requests_shed(admission.shed);
+      response->set_requests_expired(admission.dropped);
 
-      std::cout << "[INFO] Statistics request served" << std::endl;
+      LogLine(LogLevel::kInfo, nullptr) << "Statistics request served";
 
-      return grpc::Status::OK;
+      reactor->Finish(grpc::Status::OK);
 
     } catch (const std::exception& e) {
-      std::cerr << "[ERROR] Exception getting statistics: " << e.what()
-                << std::endl;
-      return grpc::Status(grpc::StatusCode::INTERNAL,
-                         "Internal error getting statistics");
+      LogLine(LogLevel::kError, nullptr)
+          << "Exception getting statistics: " << e.what();
+      reactor->Finish(grpc::Status(grpc::StatusCode::INTERNAL,
+                                   "Internal error getting statistics"));
+    }
+    return reactor;
+  }
+
+  grpc::ServerUnaryReactor* Reload(
+      grpc::CallbackServerContext* context,
+      const datanode::ReloadRequest* /*request*/,
+      datanode::ReloadResponse* response) override {
+    grpc::ServerUnaryReactor* reactor = context->DefaultReactor();
+    LogLine(LogLevel::kInfo, nullptr) << "Reload request received";
+
+    // Building a generation takes as long as a startup load, so it runs on
+    // the reload worker instead of blocking a gRPC callback thread.
+    // Searches keep being served from the current generation meanwhile.
+    reload_worker_.submit([node = node_, reactor, response]() {
+      try {
+        std::optional<DataNode::Statistics> stats = node->reload();
+        if (!stats) {
+          reactor->Finish(grpc::Status(grpc::StatusCode::INTERNAL,
+                                       "Reload failed, indexes unchanged"));
+          return;
+        }
+        response->set_generation(stats->generation);
+        response->set_total_records(stats->total_records);
+        response->set_load_time_ms(stats->load_time.count());
+
+        LogLine(LogLevel::kInfo, nullptr)
+            << "Reload completed, serving generation " << stats->generation;
+        reactor->Finish(grpc::Status::OK);
+      } catch (const std::exception& e) {
+        LogLine(LogLevel::kError, nullptr)
+            << "Exception during reload: " << e.what();
+        reactor->Finish(grpc::Status(grpc::StatusCode::INTERNAL,
+                                     "Internal error during reload"));
+      }
+    });
+    return reactor;
+  }
+
+ private:
+  std::shared_ptr<DataNode> node_;
+  std::shared_ptr<ThreadPool> pool_;
+  std::shared_ptr<ConcurrencyLimiter> limiter_;
+
+  // Runs Reload calls one at a time. Its destructor finishes the reloads
+  // still queued and joins the thread, so none outlives the service.
+  ThreadPool reload_worker_{1};
+
+  // Run a call's work on the pool if the limiter admits it, or finish the
+  // call with RESOURCE_EXHAUSTED at once. Work still queued when the
+  // caller's deadline passes is skipped, as the caller no longer waits for
+  // it. The call's slot is held until its work has run
+  template <typename Reactor>
+  void submitAdmitted(grpc::CallbackServerContext* context,
+                      Reactor* reactor,
+                      std::function<void()> work) {
+    auto permit =
+        std::make_shared<ConcurrencyLimiter::Permit>(limiter_->tryAcquire());
+    if (!*permit) {
+      reactor->Finish(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                                   "Data node overloaded"));
+      return;
+    }
+    pool_->submit([context, reactor, permit, work = std::move(work)]() {
+      if (context->deadline() <= std::chrono::system_clock::now()) {
+        permit->setDropped();
+        reactor->Finish(grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED,
+                                     "Deadline passed while queued"));
+        return;
+      }
+      work();
+    });
+  }
+};
+
+// Reloads a data node when its data file changes. The file's size and
+// modification time are polled every interval; a change is acted on once
+// they have stayed the same for a whole interval, so a file still being
+// written is not loaded half way.
+class DataFileWatcher {
+ public:
+  DataFileWatcher(std::shared_ptr<DataNode> node,
+                  std::string path,
+                  std::chrono::seconds interval)
+      : node_(std::move(node)),
+        path_(std::move(path)),
+        interval_(interval),
+        loaded_state_(readState()),
+        thread_([this]() { run(); }) {}
+
+  ~DataFileWatcher() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
     }
+    stop_cv_.notify_all();
+    thread_.join();
   }
 
+  DataFileWatcher(const DataFileWatcher&) = delete;
+  DataFileWatcher& operator=(const DataFileWatcher&) = delete;
+
  private:
+  struct FileState {
+    bool exists = false;
+    std::uintmax_t size = 0;
+    std::filesystem::file_time_type modified;
+
+    bool operator==(const FileState& other) const {
+      return exists == other.exists && size == other.size &&
+             modified == other.modified;
+    }
+    bool operator!=(const FileState& other) const { return !(*this == other); }
+  };
+
+  FileState readState() const {
+    FileState state;
+    std::error_code error;
+    state.size = std::filesystem::file_size(path_, error);
+    if (error) {
+      return state;
+    }
+    state.modified = std::filesystem::last_write_time(path_, error);
+    state.exists = !error;
+    return state;
+  }
+
+  void run() {
+    FileState pending_state = loaded_state_;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_cv_.wait_for(lock, interval_, [this]() { return stopping_; })) {
+      FileState state = readState();
+      if (!state.exists || state == loaded_state_) {
+        pending_state = state;
+        continue;
+      }
+      if (state != pending_state) {
+        pending_state = state;  // Still changing; check again next interval
+        continue;
+      }
+
+      LogLine(LogLevel::kInfo, nullptr)
+          << "Data file " << path_ << " changed, reloading";
+      lock.unlock();
+      std::optional<DataNode::Statistics> stats = node_->reload();
+      lock.lock();
+      // A failed load is not retried until the file changes again
+      loaded_state_ = state;
+      if (stats) {
+        LogLine(LogLevel::kInfo, nullptr)
+            << "Reload completed, serving generation " << stats->generation;
+      }
+    }
+  }
+
   std::shared_ptr<DataNode> node_;
+  std::string path_;
+  std::chrono::seconds interval_;
+  FileState loaded_state_;
+
+  std::mutex mutex_;
+  std::condition_variable stop_cv_;
+  bool stopping_ = false;
+
+  std::thread thread_;  // Last, so it starts after the members it uses
 };
 
 // Get configuration from environment variables with defaults
@@ -158,10 +756,229 @@ int getPort(int shard_id) {
   return 50051 + shard_id;
 }
 
-void runServer(std::shared_ptr<DataNode> node, int port) {
+// Get how often to check the data file for changes, in seconds
+// (0 = do not watch it)
+int getReloadWatchSeconds() {
+  const char* env_watch = std::getenv("RELOAD_WATCH_SECONDS");
+  if (env_watch) {
+    try {
+      int seconds = std::stoi(env_watch);
+      if (seconds >= 0) {
+        return seconds;
+      }
+      std::cerr << "[WARNING] RELOAD_WATCH_SECONDS must be non-negative, "
+                << "not watching the data file" << std::endl;
+    } catch (const std::exception& e) {
+      std::cerr << "[WARNING] Invalid RELOAD_WATCH_SECONDS: " << env_watch
+                << ", not watching the data file" << std::endl;
+    }
+  }
+
+  // Default: reload only on request
+  return 0;
+}
+
+// Get the number of worker threads serving searches
+// (0 = one per hardware thread)
+size_t getServerThreads() {
+  const char* env_threads = std::getenv("SERVER_THREADS");
+  if (env_threads) {
+    try {
+      int threads = std::stoi(env_threads);
+      if (threads >= 0) {
+        return static_cast<size_t>(threads);
+      }
+      std::cerr << "[WARNING] SERVER_THREADS must be non-negative, "
+                << "using default" << std::endl;
+    } catch (const std::exception& e) {
+      std::cerr << "[WARNING] Invalid SERVER_THREADS: " << env_threads
+                << ", using default" << std::endl;
+    }
+  }
+
+  // Default: one per hardware thread
+  return 0;
+}
+
+// Get the most searches queued or running at once
+// (0 = adapt the limit to latency)
+size_t getMaxConcurrentRequests() {
+  const char* env_limit = std::getenv("MAX_CONCURRENT_REQUESTS");
+  if (env_limit) {
+    try {
+      int limit = std::stoi(env_limit);
+      if (limit >= 0) {
+        return static_cast<size_t>(limit);
+      }
+      std::cerr << "[WARNING] MAX_CONCURRENT_REQUESTS must be non-negative, "
+                << "using default" << std::endl;
+    } catch (const std::exception& e) {
+      std::cerr << "[WARNING] Invalid MAX_CONCURRENT_REQUESTS: " << env_limit
+                << ", using default" << std::endl;
+    }
+  }
+
+  // Default: adaptive
+  return 0;
+}
+
+// Get the least severe level of log lines to write
+LogLevel getLogLevel() {
+  const char* env_level = std::getenv("LOG_LEVEL");
+  if (env_level) {
+    std::optional<LogLevel> level = parseLogLevel(env_level);
+    if (level) {
+      return *level;
+    }
+    std::cerr << "[WARNING] Invalid LOG_LEVEL: " << env_level
+              << ", using default (INFO)" << std::endl;
+  }
+
+  // Default: INFO
+  return LogLevel::kInfo;
+}
+
+// Get how many queries share one set of per-query log lines
+uint32_t getQueryLogSampling() {
+  const char* env_sample = std::getenv("QUERY_LOG_SAMPLE");
+  if (env_sample) {
+    try {
+      int every = std::stoi(env_sample);
+      if (every > 0) {
+        return static_cast<uint32_t>(every);
+      }
+      std::cerr << "[WARNING] QUERY_LOG_SAMPLE must be positive, "
+                << "using default" << std::endl;
+    } catch (const std::exception& e) {
+      std::cerr << "[WARNING] Invalid QUERY_LOG_SAMPLE: " << env_sample
+                << ", using default" << std::endl;
+    }
+  }
+
+  // Default: log one query in 100
+  return 100;
+}
+
+// Default memory budget of the hot prefix postings cache
+constexpr size_t kDefaultPostingsCacheBytes = 16 * 1024 * 1024;
+
+// Get data node options from environment variables with defaults
+DataNodeOptions getDataNodeOptions(const std::string& data_file_path) {
+  DataNodeOptions options;
+  options.postings_cache_bytes = kDefaultPostingsCacheBytes;
+
+  // SNAPSHOT_PATH sets the index snapshot file; by default it sits next to
+  // the data file. Set it to an empty string to disable snapshots
+  const char* env_snapshot_path = std::getenv("SNAPSHOT_PATH");
+  options.snapshot_path = env_snapshot_path
+                              ? std::string(env_snapshot_path)
+                              : data_file_path + ".snapshot";
+
+  // RADIX_LAYOUT selects the RadixTreeIndex layout: "flat" (default) freezes
+  // the index into contiguous arrays, "pointer" keeps the build tree
+  const char* env_layout = std::getenv("RADIX_LAYOUT");
+  if (env_layout) {
+    std::string layout(env_layout);
+    if (layout == "flat") {
+      options.flat_radix_layout = true;
+    } else if (layout == "pointer") {
+      options.flat_radix_layout = false;
+    } else {
+      std::cerr << "[WARNING] Invalid RADIX_LAYOUT: " << layout
+                << ", using default (flat)" << std::endl;
+    }
+  }
+
+  // LOAD_THREADS sets the worker threads used to parse and index the data
+  // file at startup (0 or unset = one per hardware thread)
+  const char* env_load_threads = std::getenv("LOAD_THREADS");
+  if (env_load_threads) {
+    try {
+      int load_threads = std::stoi(env_load_threads);
+      if (load_threads < 0) {
+        std::cerr << "[WARNING] LOAD_THREADS must be non-negative, "
+                  << "using default" << std::endl;
+      } else {
+        options.load_threads = static_cast<size_t>(load_threads);
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "[WARNING] Invalid LOAD_THREADS: " << env_load_threads
+                << ", using default" << std::endl;
+    }
+  }
+
+  // BATCH_THREADS sets the most worker threads answering one BatchSearch
+  // (0 or unset = one per hardware thread)
+  const char* env_batch_threads = std::getenv("BATCH_THREADS");
+  if (env_batch_threads) {
+    try {
+      int batch_threads = std::stoi(env_batch_threads);
+      if (batch_threads < 0) {
+        std::cerr << "[WARNING] BATCH_THREADS must be non-negative, "
+                  << "using default" << std::endl;
+      } else {
+        options.batch_threads = static_cast<size_t>(batch_threads);
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "[WARNING] Invalid BATCH_THREADS: " << env_batch_threads
+                << ", using default" << std::endl;
+    }
+  }
+
+  // POSTINGS_CACHE_BYTES sets the memory budget of the hot prefix postings
+  // cache (0 disables it)
+  const char* env_cache_bytes = std::getenv("POSTINGS_CACHE_BYTES");
+  if (env_cache_bytes) {
+    try {
+      long long cache_bytes = std::stoll(env_cache_bytes);
+      if (cache_bytes < 0) {
+        std::cerr << "[WARNING] POSTINGS_CACHE_BYTES must be non-negative, "
+                  << "using default" << std::endl;
+      } else {
+        options.postings_cache_bytes = static_cast<size_t>(cache_bytes);
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "[WARNING] Invalid POSTINGS_CACHE_BYTES: "
+                << env_cache_bytes << ", using default" << std::endl;
+    }
+  }
+
+  return options;
+}
+
+void runServer(std::shared_ptr<DataNode> node, int port,
+               std::shared_ptr<ThreadPool> pool,
+               size_t max_concurrent_requests) {
   std::string server_address = "0.0.0.0:" + std::to_string(port);
 
-  DataNodeServiceImpl service(node);
+  // An adaptive limit never drops below one search per worker
+  ConcurrencyLimiterConfig limiter_config;
+  limiter_config.max_concurrency = max_concurrent_requests;
+  limiter_config.min_limit = pool->getThreadCount();
+  limiter_config.initial_limit = 2 * pool->getThreadCount();
+  limiter_config.max_limit =
+      std::max(limiter_config.max_limit, limiter_config.initial_limit);
+  auto limiter = std::make_shared<ConcurrencyLimiter>(limiter_config);
+  DataNodeServiceImpl service(node, pool, limiter);
+
+  // Requests and responses live on a per-call arena
+  ArenaMessageAllocator<datanode::SearchRequest, datanode::SearchResponse>
+      search_allocator;
+  service.SetMessageAllocatorFor_Search(&search_allocator);
+  ArenaMessageAllocator<datanode::BatchSearchRequest,
+                        datanode::BatchSearchResponse>
+      batch_search_allocator;
+  service.SetMessageAllocatorFor_BatchSearch(&batch_search_allocator);
+  ArenaMessageAllocator<datanode::ReverseGeocodeRequest,
+                        datanode::ReverseGeocodeResponse>
+      reverse_geocode_allocator;
+  service.SetMessageAllocatorFor_ReverseGeocode(&reverse_geocode_allocator);
+  ArenaMessageAllocator<datanode::SearchBoxRequest, datanode::SearchResponse>
+      search_box_allocator;
+  service.SetMessageAllocatorFor_SearchBox(&search_box_allocator);
+  ArenaMessageAllocator<datanode::LookupRequest, datanode::SearchResponse>
+      lookup_allocator;
+  service.SetMessageAllocatorFor_Lookup(&lookup_allocator);
 
   grpc::EnableDefaultHealthCheckService(true);
   grpc::reflection::InitProtoReflectionServerBuilderPlugin();
@@ -183,6 +1000,15 @@ void runServer(std::shared_ptr<DataNode> node, int port) {
   }
 
   std::cout << "[INFO] gRPC server listening on " << server_address << std::endl;
+  std::cout << "[INFO] Serving searches on " << pool->getThreadCount()
+            << " worker thread(s)" << std::endl;
+  if (limiter->isAdaptive()) {
+    std::cout << "[INFO] Admitting an adaptive limit of searches, starting "
+              << "at " << limiter->getStats().limit << std::endl;
+  } else {
+    std::cout << "[INFO] Admitting up to " << limiter->getStats().limit
+              << " searches at once" << std::endl;
+  }
   std::cout << "[INFO] Server ready to accept requests" << std::endl;
   std::cout << "[INFO] Press Ctrl+C to shutdown\n" << std::endl;
 
@@ -205,19 +1031,65 @@ int main(int argc, char* argv[]) {
 
   std::string data_file_path = getDataFilePath(shard_id);
   int port = getPort(shard_id);
+  DataNodeOptions options = getDataNodeOptions(data_file_path);
+  int reload_watch_seconds = getReloadWatchSeconds();
+  size_t server_threads = getServerThreads();
+  size_t max_concurrent_requests = getMaxConcurrentRequests();
+  LogLevel log_level = getLogLevel();
+  setLogLevel(log_level);
+  uint32_t query_log_sampling = getQueryLogSampling();
+  setQueryLogSampling(query_log_sampling);
 
   std::cout << "[INFO] Starting Data Node with configuration:" << std::endl;
   std::cout << "  Shard ID: " << shard_id << std::endl;
   std::cout << "  Data file: " << data_file_path << std::endl;
-  std::cout << "  gRPC port: " << port << "\n" << std::endl;
+  std::cout << "  gRPC port: " << port << std::endl;
+  std::cout << "  Radix layout: "
+            << (options.flat_radix_layout ? "flat" : "pointer") << std::endl;
+  std::cout << "  Snapshot: "
+            << (options.snapshot_path.empty() ? std::string("disabled")
+                                              : options.snapshot_path)
+            << std::endl;
+  std::cout << "  Postings cache: " << options.postings_cache_bytes
+            << " bytes" << std::endl;
+  std::cout << "  Load threads: "
+            << (options.load_threads > 0 ? std::to_string(options.load_threads)
+                                         : std::string("auto"))
+            << std::endl;
+  std::cout << "  Batch threads: "
+            << (options.batch_threads > 0
+                    ? std::to_string(options.batch_threads)
+                    : std::string("auto"))
+            << std::endl;
+  std::cout << "  Reload watch: "
+            << (reload_watch_seconds > 0
+                    ? std::to_string(reload_watch_seconds) + " s"
+                    : std::string("disabled"))
+            << std::endl;
+  std::cout << "  Server threads: "
+            << (server_threads > 0 ? std::to_string(server_threads)
+                                   : std::string("auto"))
+            << std::endl;
+  std::cout << "  Max concurrent requests: "
+            << (max_concurrent_requests > 0
+                    ? std::to_string(max_concurrent_requests)
+                    : std::string("adaptive"))
+            << std::endl;
+  std::cout << "  Log level: " << logLevelName(log_level) << std::endl;
+  std::cout << "  Query log sampling: 1 in " << query_log_sampling << "\n"
+            << std::endl;
 
   // Set up signal handlers for graceful shutdown
   std::signal(SIGINT, signalHandler);   // Ctrl+C
   std::signal(SIGTERM, signalHandler);  // Termination signal
 
-  // Create and initialize DataNode
+  // Create and initialize DataNode. Batch searches run their extra workers
+  // on the server's pool rather than on threads of their own.
   try {
-    auto data_node = std::make_shared<DataNode>(shard_id, data_file_path);
+    auto pool = std::make_shared<ThreadPool>(server_threads);
+    options.batch_pool = pool;
+    auto data_node = std::make_shared<DataNode>(shard_id, data_file_path,
+                                                options);
 
     std::cout << "[INFO] Initializing data node..." << std::endl;
     if (!data_node->initialize()) {
@@ -235,12 +1107,46 @@ int main(int argc, char* argv[]) {
               << " bytes" << std::endl;
     std::cout << "ForwardIndex storage: " << stats.forward_index_size
               << " bytes" << std::endl;
+    std::cout << "SpatialIndex memory usage: " << stats.spatial_index_memory
+              << " bytes" << std::endl;
+    std::cout << "CompositeKeyIndex memory usage: " << stats.key_index_memory
+              << " bytes" << std::endl;
     std::cout << "Initialization time: " << stats.load_time.count() << " ms"
               << std::endl;
+    std::cout << "  Snapshot load: " << stats.load_stages.snapshot_load.count()
+              << " ms" << std::endl;
+    std::cout << "  Parse: " << stats.load_stages.parse.count() << " ms"
+              << std::endl;
+    std::cout << "  Forward index: " << stats.load_stages.forward_index.count()
+              << " ms" << std::endl;
+    std::cout << "  Key generation: "
+              << stats.load_stages.key_generation.count() << " ms"
+              << std::endl;
+    std::cout << "  Radix build: " << stats.load_stages.radix_build.count()
+              << " ms" << std::endl;
+    std::cout << "  Freeze: " << stats.load_stages.freeze.count() << " ms"
+              << std::endl;
+    std::cout << "  Spatial build: "
+              << stats.load_stages.spatial_build.count() << " ms"
+              << std::endl;
+    std::cout << "  Key index: " << stats.load_stages.key_index.count()
+              << " ms" << std::endl;
+    std::cout << "  Snapshot write: "
+              << stats.load_stages.snapshot_write.count() << " ms"
+              << std::endl;
     std::cout << "==========================\n" << std::endl;
 
+    // Pick up changes to the data file while serving
+    std::unique_ptr<DataFileWatcher> watcher;
+    if (reload_watch_seconds > 0) {
+      watcher = std::make_unique<DataFileWatcher>(
+          data_node, data_file_path,
+          std::chrono::seconds(reload_watch_seconds));
+    }
+
     // Start gRPC server
-    runServer(data_node, port);
+    runServer(data_node, port, pool, max_concurrent_requests);
+    watcher.reset();
 
     std::cout << "\n[INFO] Data node shutting down gracefully..." << std::endl;
 
@@ -1,12 +1,17 @@
 // Gateway Server Entry Point with HTTP API
 
+#include <algorithm>
+#include <chrono>
 #include <csignal>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "data_node/logging.h"
 #include "gateway/gateway_server.h"
 
 // Global pointer for signal handling
@@ -46,7 +51,8 @@ int getHttpPort() {
   return 18080;
 }
 
-// Get data node address from environment variable
+// Get the addresses of a shard's data node replicas from an environment
+// variable: one address, or several separated by commas
 std::string getDataNodeAddress(int node_index) {
   std::string env_var = "DATA_NODE_" + std::to_string(node_index);
   const char* env_address = std::getenv(env_var.c_str());
@@ -64,6 +70,26 @@ std::string getDataNodeAddress(int node_index) {
   return "";
 }
 
+// Split a comma-separated list of data node addresses, dropping empty ones
+std::vector<std::string> splitAddresses(const std::string& addresses) {
+  std::vector<std::string> result;
+  size_t start = 0;
+  while (start <= addresses.size()) {
+    size_t end = addresses.find(',', start);
+    if (end == std::string::npos) {
+      end = addresses.size();
+    }
+    std::string address = addresses.substr(start, end - start);
+    address.erase(0, address.find_first_not_of(" \t"));
+    address.erase(address.find_last_not_of(" \t") + 1);
+    if (!address.empty()) {
+      result.push_back(address);
+    }
+    start = end + 1;
+  }
+  return result;
+}
+
 // Get gRPC timeout from environment variable with default
 int getGrpcTimeout() {
   const char* env_timeout = std::getenv("GRPC_TIMEOUT_MS");
@@ -86,6 +112,144 @@ int getGrpcTimeout() {
   return 5000;
 }
 
+// Get number of gRPC completion queue threads from environment variable
+int getCompletionQueueThreads() {
+  const char* env_threads = std::getenv("GRPC_CQ_THREADS");
+  if (env_threads) {
+    try {
+      int threads = std::stoi(env_threads);
+      if (threads <= 0) {
+        std::cerr << "[WARNING] GRPC_CQ_THREADS must be positive, using default"
+                  << std::endl;
+        return 2;
+      }
+      return threads;
+    } catch (const std::exception& e) {
+      std::cerr << "[WARNING] Invalid GRPC_CQ_THREADS: " << env_threads
+                << ", using default" << std::endl;
+    }
+  }
+
+  // Default: 2 threads
+  return 2;
+}
+
+// Get a non-negative size from an environment variable with default
+size_t getNonNegativeEnv(const char* name, size_t default_value) {
+  const char* env_value = std::getenv(name);
+  if (env_value) {
+    try {
+      long long value = std::stoll(env_value);
+      if (value < 0) {
+        std::cerr << "[WARNING] " << name
+                  << " must not be negative, using default" << std::endl;
+        return default_value;
+      }
+      return static_cast<size_t>(value);
+    } catch (const std::exception& e) {
+      std::cerr << "[WARNING] Invalid " << name << ": " << env_value
+                << ", using default" << std::endl;
+    }
+  }
+  return default_value;
+}
+
+// Get query cache configuration from environment variables with defaults
+QueryCacheConfig getQueryCacheConfig() {
+  QueryCacheConfig config;
+  config.max_bytes =
+      getNonNegativeEnv("QUERY_CACHE_MAX_BYTES", config.max_bytes);
+  config.ttl = std::chrono::milliseconds(getNonNegativeEnv(
+      "QUERY_CACHE_TTL_MS", static_cast<size_t>(config.ttl.count())));
+  return config;
+}
+
+// Get admission control configuration from environment variables with
+// defaults
+ConcurrencyLimiterConfig getAdmissionConfig() {
+  ConcurrencyLimiterConfig config;
+  config.max_concurrency =
+      getNonNegativeEnv("MAX_CONCURRENT_REQUESTS", config.max_concurrency);
+  config.max_queued =
+      getNonNegativeEnv("MAX_QUEUED_REQUESTS", config.max_queued);
+  config.max_queue_wait = std::chrono::milliseconds(getNonNegativeEnv(
+      "MAX_QUEUE_WAIT_MS", static_cast<size_t>(config.max_queue_wait.count())));
+  return config;
+}
+
+// Get the replica selection policy from environment variable
+ReplicaSelection getReplicaSelection() {
+  const char* env_selection = std::getenv("REPLICA_SELECTION");
+  if (env_selection) {
+    std::string selection = env_selection;
+    if (selection == "least_outstanding") {
+      return ReplicaSelection::kLeastOutstanding;
+    }
+    if (selection == "ewma") {
+      return ReplicaSelection::kEwmaLatency;
+    }
+    std::cerr << "[WARNING] Invalid REPLICA_SELECTION: " << env_selection
+              << ", using default (least_outstanding)" << std::endl;
+  }
+
+  // Default: fewest calls in flight
+  return ReplicaSelection::kLeastOutstanding;
+}
+
+// Get the latency percentile after which shard calls are hedged
+double getHedgePercentile() {
+  const char* env_percentile = std::getenv("HEDGE_PERCENTILE");
+  if (env_percentile) {
+    try {
+      double percentile = std::stod(env_percentile);
+      if (percentile < 0 || percentile >= 100) {
+        std::cerr << "[WARNING] HEDGE_PERCENTILE must be in [0, 100), "
+                  << "using default" << std::endl;
+        return 95.0;
+      }
+      return percentile;
+    } catch (const std::exception& e) {
+      std::cerr << "[WARNING] Invalid HEDGE_PERCENTILE: " << env_percentile
+                << ", using default" << std::endl;
+    }
+  }
+
+  // Default: hedge the slowest 5% of calls
+  return 95.0;
+}
+
+// Get the routing key the shards were split by (see shard_builder)
+std::optional<ShardPartition::Key> getPartitionKey() {
+  const char* env_key = std::getenv("PARTITION_KEY");
+  if (env_key && *env_key) {
+    std::optional<ShardPartition::Key> key = ShardPartition::parseKey(env_key);
+    if (key) {
+      return key;
+    }
+    std::cerr << "[WARNING] Invalid PARTITION_KEY: " << env_key
+              << ", using default (unknown)" << std::endl;
+  }
+
+  // Default: records may be on any shard
+  return std::nullopt;
+}
+
+// Get the least severe level of log lines to write
+LogLevel getLogLevel() {
+  const char* env_level = std::getenv("LOG_LEVEL");
+  if (env_level) {
+    std::optional<LogLevel> level = parseLogLevel(env_level);
+    if (level) {
+      return *level;
+    }
+    std::cerr << "[WARNING] Invalid LOG_LEVEL: " << env_level
+              << ", using default (INFO)" << std::endl;
+  }
+
+  // Default: INFO
+  return LogLevel::kInfo;
+}
+
 int main(int argc, char* argv[]) {
   std::cout << "========================================" << std::endl;
   std::cout << "Gateway Server" << std::endl;
@@ -97,15 +261,85 @@ int main(int argc, char* argv[]) {
     return EXIT_FAILURE;
   }
 
-  std::string data_node_0 = getDataNodeAddress(0);
-  std::string data_node_1 = getDataNodeAddress(1);
+  // DATA_NODE_i holds the replicas of shard i; shards past 1 are read
+  // until the first unset variable
+  std::vector<std::string> data_nodes;
+  for (int i = 0;; ++i) {
+    std::string addresses = getDataNodeAddress(i);
+    if (addresses.empty() && i >= 2) {
+      break;
+    }
+    data_nodes.push_back(addresses);
+  }
   int grpc_timeout_ms = getGrpcTimeout();
+  int completion_queue_threads = getCompletionQueueThreads();
+  QueryCacheConfig query_cache = getQueryCacheConfig();
+  bool stream_search = getNonNegativeEnv("SEARCH_STREAMING", 0) != 0;
+  int channels_per_replica = static_cast<int>(
+      std::max<size_t>(1, getNonNegativeEnv("CHANNELS_PER_REPLICA", 1)));
+  ReplicaSelection replica_selection = getReplicaSelection();
+  double hedge_percentile = getHedgePercentile();
+  int health_check_interval_ms = static_cast<int>(
+      getNonNegativeEnv("HEALTH_CHECK_INTERVAL_MS", 1000));
+  std::optional<ShardPartition::Key> partition_key = getPartitionKey();
+  ConcurrencyLimiterConfig admission = getAdmissionConfig();
+  int request_timeout_ms =
+      static_cast<int>(getNonNegativeEnv("REQUEST_TIMEOUT_MS", 0));
+  int http_threads = static_cast<int>(getNonNegativeEnv("HTTP_THREADS", 0));
+  LogLevel log_level = getLogLevel();
+  setLogLevel(log_level);
+  // Requests share one set of per-query log lines per QUERY_LOG_SAMPLE
+  uint32_t query_log_sampling = static_cast<uint32_t>(
+      std::max<size_t>(1, getNonNegativeEnv("QUERY_LOG_SAMPLE", 100)));
+  setQueryLogSampling(query_log_sampling);
 
   std::cout << "[INFO] Starting Gateway Server with configuration:" << std::endl;
   std::cout << "  HTTP port: " << http_port << std::endl;
-  std::cout << "  Data Node 0: " << data_node_0 << std::endl;
-  std::cout << "  Data Node 1: " << data_node_1 << std::endl;
-  std::cout << "  gRPC timeout: " << grpc_timeout_ms << " ms\n" << std::endl;
+  for (size_t i = 0; i < data_nodes.size(); ++i) {
+    std::cout << "  Data Node " << i << ": " << data_nodes[i] << std::endl;
+  }
+  std::cout << "  gRPC timeout: " << grpc_timeout_ms << " ms" << std::endl;
+  std::cout << "  gRPC completion queue threads: " << completion_queue_threads
+            << std::endl;
+  std::cout << "  Query cache: " << query_cache.max_bytes << " bytes, TTL "
+            << query_cache.ttl.count() << " ms" << std::endl;
+  std::cout << "  Search streaming: " << (stream_search ? "on" : "off")
+            << std::endl;
+  std::cout << "  Channels per replica: " << channels_per_replica << std::endl;
+  std::cout << "  Replica selection: "
+            << (replica_selection == ReplicaSelection::kEwmaLatency
+                    ? "ewma"
+                    : "least_outstanding")
+            << std::endl;
+  std::cout << "  Hedge percentile: " << hedge_percentile
+            << (hedge_percentile > 0 ? "" : " (off)") << std::endl;
+  std::cout << "  Health check interval: " << health_check_interval_ms
+            << " ms" << (health_check_interval_ms > 0 ? "" : " (off)")
+            << std::endl;
+  std::cout << "  Partition key: "
+            << (partition_key ? ShardPartition::keyName(*partition_key)
+                              : "unknown")
+            << std::endl;
+  std::cout << "  Max concurrent requests: "
+            << (admission.max_concurrency > 0
+                    ? std::to_string(admission.max_concurrency)
+                    : std::string("adaptive"))
+            << std::endl;
+  std::cout << "  Admission queue: " << admission.max_queued
+            << " requests, up to " << admission.max_queue_wait.count()
+            << " ms" << std::endl;
+  std::cout << "  Request timeout: "
+            << (request_timeout_ms > 0
+                    ? std::to_string(request_timeout_ms) + " ms"
+                    : std::string("gRPC timeout"))
+            << std::endl;
+  std::cout << "  HTTP threads: "
+            << (http_threads > 0 ? std::to_string(http_threads)
+                                 : std::string("default"))
+            << std::endl;
+  std::cout << "  Log level: " << logLevelName(log_level) << std::endl;
+  std::cout << "  Query log sampling: 1 in " << query_log_sampling << "\n"
+            << std::endl;
 
   // Set up signal handlers for graceful shutdown
   std::signal(SIGINT, signalHandler);   // Ctrl+C
@@ -115,20 +349,26 @@ int main(int argc, char* argv[]) {
   GatewayConfig config;
   config.http_port = http_port;
   config.grpc_timeout_ms = grpc_timeout_ms;
+  config.completion_queue_threads = completion_queue_threads;
+  config.query_cache = query_cache;
+  config.stream_search = stream_search;
+  config.channels_per_replica = channels_per_replica;
+  config.replica_selection = replica_selection;
+  config.hedge_percentile = hedge_percentile;
+  config.health_check_interval_ms = health_check_interval_ms;
+  config.partition_key = partition_key;
+  config.admission = admission;
+  config.request_timeout_ms = request_timeout_ms;
+  config.http_threads = http_threads;
 
-  // Add data node configurations
-  if (!data_node_0.empty()) {
-    DataNodeConfig node0;
-    node0.address = data_node_0;
-    node0.shard_id = 0;
-    config.data_nodes.push_back(node0);
-  }
-
-  if (!data_node_1.empty()) {
-    DataNodeConfig node1;
-    node1.address = data_node_1;
-    node1.shard_id = 1;
-    config.data_nodes.push_back(node1);
+  // Add data node configurations, one per replica of each shard
+  for (size_t shard_id = 0; shard_id < data_nodes.size(); ++shard_id) {
+    for (const std::string& address : splitAddresses(data_nodes[shard_id])) {
+      DataNodeConfig node;
+      node.address = address;
+      node.shard_id = static_cast<int>(shard_id);
+      config.data_nodes.push_back(node);
+    }
   }
 
   if (config.data_nodes.empty()) {
@@ -151,6 +391,8 @@ int main(int argc, char* argv[]) {
     std::cout << "[INFO] HTTP API available at http://0.0.0.0:" << http_port
               << std::endl;
     std::cout << "[INFO] Endpoint: POST /api/findAddress" << std::endl;
+    std::cout << "[INFO] Endpoint: GET /api/cacheStats" << std::endl;
+    std::cout << "[INFO] Endpoint: GET /metrics" << std::endl;
     std::cout << "[INFO] Press Ctrl+C to shutdown\n" << std::endl;
 
     // Start the HTTP server (blocking call)
@@ -49,6 +49,69 @@ class DataNodeClient {
     }
   }
 
+  void ReverseGeocode(double longitude, double latitude, int max_results) {
+    datanode::ReverseGeocodeRequest request;
+    request.set_longitude(longitude);
+    request.set_latitude(latitude);
+    request.set_max_results(max_results);
+
+    datanode::ReverseGeocodeResponse response;
+    ClientContext context;
+
+    Status status = stub_->ReverseGeocode(&context, request, &response);
+
+    if (status.ok()) {
+      std::cout << "ReverseGeocode successful! Found "
+                << response.result_count() << " results:" << std::endl;
+
+      for (int i = 0; i < response.results_size(); ++i) {
+        const auto& nearby = response.results(i);
+        const auto& record = nearby.record();
+        std::cout << "  " << (i + 1) << ". " << record.number() << " "
+                  << record.street() << ", " << record.city() << " ("
+                  << nearby.distance_meters() << " m)" << std::endl;
+      }
+    } else {
+      std::cout << "RPC failed: " << status.error_message() << std::endl;
+    }
+  }
+
+  void BatchSearch(const std::vector<std::vector<std::string>>& queries,
+                   int max_results) {
+    datanode::BatchSearchRequest request;
+    for (const auto& query_terms : queries) {
+      datanode::SearchRequest* query = request.add_queries();
+      for (const auto& term : query_terms) {
+        query->add_query_terms(term);
+      }
+      query->set_max_results(max_results);
+    }
+
+    datanode::BatchSearchResponse response;
+    ClientContext context;
+
+    Status status = stub_->BatchSearch(&context, request, &response);
+
+    if (status.ok()) {
+      std::cout << "BatchSearch successful! Answered "
+                << response.responses_size() << " queries:" << std::endl;
+
+      for (int i = 0; i < response.responses_size(); ++i) {
+        const auto& query_response = response.responses(i);
+        std::cout << "  Query " << (i + 1) << ": "
+                  << query_response.result_count() << " results";
+        if (query_response.results_size() > 0) {
+          const auto& record = query_response.results(0);
+          std::cout << ", best: " << record.number() << " " << record.street()
+                    << ", " << record.city();
+        }
+        std::cout << std::endl;
+      }
+    } else {
+      std::cout << "RPC failed: " << status.error_message() << std::endl;
+    }
+  }
+
   void GetStatistics() {
     datanode::StatisticsRequest request;
     datanode::StatisticsResponse response;
@@ -64,6 +127,31 @@ class DataNodeClient {
       std::cout << "ForwardIndex size: " << response.forward_index_size()
                 << " bytes" << std::endl;
       std::cout << "Load time: " << response.load_time_ms() << " ms" << std::endl;
+      std::cout << "Postings cache: " << response.postings_cache_entries()
+                << " entries, " << response.postings_cache_bytes() << "/"
+                << response.postings_cache_max_bytes() << " bytes, "
+                << response.postings_cache_hits() << " hits, "
+                << response.postings_cache_misses() << " misses" << std::endl;
+      std::cout << "SpatialIndex memory: " << response.spatial_index_memory()
+                << " bytes" << std::endl;
+      std::cout << "CompositeKeyIndex memory: " << response.key_index_memory()
+                << " bytes" << std::endl;
+      std::cout << "Index generation: " << response.generation()
+                << " (loaded at " << response.loaded_at_unix_ms()
+                << " ms since epoch)" << std::endl;
+      std::cout << "Queries served: " << response.queries_served()
+                << std::endl;
+      std::cout << "Admission: limit " << response.admission_limit() << ", "
+                << response.requests_in_flight() << " in flight, "
+                << response.requests_queued() << " queued, "
+                << response.requests_shed() << " shed, "
+                << response.requests_expired() << " expired" << std::endl;
+      for (const auto& stage : response.stage_latencies()) {
+        std::cout << "  " << stage.stage() << ": " << stage.count()
+                  << " samples, p50 " << stage.p50_us() << " us, p99 "
+                  << stage.p99_us() << " us, max " << stage.max_us() << " us"
+                  << std::endl;
+      }
       std::cout << "======================\n" << std::endl;
     } else {
       std::cout << "RPC failed: " << status.error_message() << std::endl;
@@ -94,5 +182,14 @@ int main(int argc, char** argv) {
   std::cout << "\n=== Test 2: Search for '3RD STREET' ===" << std::endl;
   client.Search({"3RD", "STREET"});
 
+  // Test 3: Reverse geocode a point
+  std::cout << "\n=== Test 3: Addresses nearest to (36.7082, -121.6461) ==="
+            << std::endl;
+  client.ReverseGeocode(-121.6461331, 36.7082169, 5);
+
+  // Test 4: Several searches in one call
+  std::cout << "\n=== Test 4: Batch search ===" << std::endl;
+  client.BatchSearch({{"3RD", "STREET"}, {"SALINAS"}, {"MAIN"}}, 5);
+
   return 0;
 }
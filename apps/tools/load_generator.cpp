@@ -0,0 +1,481 @@
+// Load generator for a data node (gRPC Search) or the gateway
+// (POST /api/findAddress)
+//
+// Replays a query log, one address per line, in a loop:
+//
+//   load_generator --target=gateway --address=localhost:18080 \
+//       --queries=queries.txt --mode=open --qps=500 --duration=30
+//
+// Closed loop (default): --concurrency workers each send their next query
+// as soon as the previous one is answered, measuring the server's
+// throughput. Open loop: queries are scheduled at a fixed --qps rate
+// regardless of how fast they are answered, and latency is measured from
+// the scheduled send time, so a server falling behind shows up as queueing
+// delay instead of a silently lower request rate. --concurrency then bounds
+// the requests in flight.
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <grpcpp/grpcpp.h>
+#include "data_node.grpc.pb.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+  std::string target = "datanode";  // "datanode" or "gateway"
+  std::string address;              // Default depends on the target
+  std::string queries_path;
+  std::string mode = "closed";      // "closed" or "open"
+  int concurrency = 8;
+  double qps = 100.0;               // Open loop only
+  double duration_seconds = 10.0;
+  long long max_requests = 0;       // 0 = until the duration has passed
+  int max_results = 5;              // Data node target only
+};
+
+void printUsage() {
+  std::cerr
+      << "Usage: load_generator --queries=FILE [options]\n"
+      << "  --target=datanode|gateway  Server to load (default: datanode)\n"
+      << "  --address=HOST:PORT        Server address (default: "
+      << "localhost:50051 or localhost:18080)\n"
+      << "  --mode=closed|open         Load model (default: closed)\n"
+      << "  --concurrency=N            Workers / most requests in flight "
+      << "(default: 8)\n"
+      << "  --qps=R                    Open loop request rate (default: 100)\n"
+      << "  --duration=S               Seconds to run (default: 10)\n"
+      << "  --requests=N               Stop after N requests (default: no "
+      << "limit)\n"
+      << "  --max-results=N            Results per data node query "
+      << "(default: 5)\n";
+}
+
+// Parse --name=value arguments; returns false on anything unrecognized
+bool parseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    size_t equals = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || equals == std::string::npos) {
+      std::cerr << "Invalid argument: " << arg << std::endl;
+      return false;
+    }
+    std::string name = arg.substr(2, equals - 2);
+    std::string value = arg.substr(equals + 1);
+    try {
+      if (name == "target") {
+        options.target = value;
+      } else if (name == "address") {
+        options.address = value;
+      } else if (name == "queries") {
+        options.queries_path = value;
+      } else if (name == "mode") {
+        options.mode = value;
+      } else if (name == "concurrency") {
+        options.concurrency = std::stoi(value);
+      } else if (name == "qps") {
+        options.qps = std::stod(value);
+      } else if (name == "duration") {
+        options.duration_seconds = std::stod(value);
+      } else if (name == "requests") {
+        options.max_requests = std::stoll(value);
+      } else if (name == "max-results") {
+        options.max_results = std::stoi(value);
+      } else {
+        std::cerr << "Unknown option: --" << name << std::endl;
+        return false;
+      }
+    } catch (const std::exception&) {
+      std::cerr << "Invalid value for --" << name << ": " << value
+                << std::endl;
+      return false;
+    }
+  }
+
+  if (options.target != "datanode" && options.target != "gateway") {
+    std::cerr << "--target must be datanode or gateway" << std::endl;
+    return false;
+  }
+  if (options.mode != "closed" && options.mode != "open") {
+    std::cerr << "--mode must be closed or open" << std::endl;
+    return false;
+  }
+  if (options.queries_path.empty() || options.concurrency < 1 ||
+      options.qps <= 0 || options.duration_seconds <= 0) {
+    return false;
+  }
+  if (options.address.empty()) {
+    options.address = options.target == "gateway" ? "localhost:18080"
+                                                  : "localhost:50051";
+  }
+  return true;
+}
+
+// Read the query log: one address per line, skipping blank lines and lines
+// starting with #
+std::vector<std::string> loadQueries(const std::string& path) {
+  std::vector<std::string> queries;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (!line.empty() && line[0] != '#') {
+      queries.push_back(line);
+    }
+  }
+  return queries;
+}
+
+// Sends one query and waits for its answer. One client per worker
+class LoadClient {
+ public:
+  virtual ~LoadClient() = default;
+
+  // Returns false if the request failed
+  virtual bool send(const std::string& query) = 0;
+};
+
+// Calls Search on a data node. Terms are split like the gateway does: a
+// structured address (with commas) is one term, anything else is split on
+// whitespace
+class DataNodeLoadClient : public LoadClient {
+ public:
+  DataNodeLoadClient(std::shared_ptr<grpc::Channel> channel, int max_results)
+      : stub_(datanode::DataNodeService::NewStub(channel)),
+        max_results_(max_results) {}
+
+  bool send(const std::string& query) override {
+    datanode::SearchRequest request;
+    if (query.find(',') != std::string::npos) {
+      request.add_query_terms(query);
+    } else {
+      std::istringstream words(query);
+      std::string word;
+      while (words >> word) {
+        request.add_query_terms(word);
+      }
+    }
+    request.set_max_results(max_results_);
+
+    datanode::SearchResponse response;
+    grpc::ClientContext context;
+    return stub_->Search(&context, request, &response).ok();
+  }
+
+ private:
+  std::unique_ptr<datanode::DataNodeService::Stub> stub_;
+  int max_results_;
+};
+
+// Posts to the gateway's /api/findAddress over a kept-alive HTTP/1.1
+// connection, reconnecting after errors
+class GatewayLoadClient : public LoadClient {
+ public:
+  GatewayLoadClient(std::string host, std::string port)
+      : host_(std::move(host)), port_(std::move(port)) {}
+
+  ~GatewayLoadClient() override { disconnect(); }
+
+  bool send(const std::string& query) override {
+    std::string body = "{\"address\":\"" + jsonEscape(query) + "\"}";
+    std::string request = "POST /api/findAddress HTTP/1.1\r\nHost: " + host_ +
+                          "\r\nContent-Type: application/json\r\n"
+                          "Content-Length: " +
+                          std::to_string(body.size()) + "\r\n\r\n" + body;
+    if ((socket_ < 0 && !connectToServer()) || !sendAll(request)) {
+      disconnect();
+      return false;
+    }
+    int status = readResponse();
+    if (status < 0) {
+      disconnect();
+      return false;
+    }
+    return status == 200;
+  }
+
+ private:
+  std::string host_;
+  std::string port_;
+  int socket_ = -1;
+  std::string buffer_;  // Bytes read past the end of the last response
+
+  static std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        escaped += '\\';
+      }
+      if (static_cast<unsigned char>(c) >= 0x20) {
+        escaped += c;
+      }
+    }
+    return escaped;
+  }
+
+  bool connectToServer() {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host_.c_str(), port_.c_str(), &hints, &addresses) != 0) {
+      return false;
+    }
+    for (addrinfo* address = addresses; address != nullptr;
+         address = address->ai_next) {
+      int fd = socket(address->ai_family, address->ai_socktype,
+                      address->ai_protocol);
+      if (fd < 0) {
+        continue;
+      }
+      if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        socket_ = fd;
+        break;
+      }
+      close(fd);
+    }
+    freeaddrinfo(addresses);
+    return socket_ >= 0;
+  }
+
+  void disconnect() {
+    if (socket_ >= 0) {
+      close(socket_);
+      socket_ = -1;
+    }
+    buffer_.clear();
+  }
+
+  bool sendAll(const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+      ssize_t count = ::send(socket_, data.data() + sent, data.size() - sent,
+                             MSG_NOSIGNAL);
+      if (count <= 0) {
+        return false;
+      }
+      sent += static_cast<size_t>(count);
+    }
+    return true;
+  }
+
+  // Read more bytes into buffer_; returns false at EOF or on error
+  bool readMore() {
+    char chunk[16384];
+    ssize_t count = recv(socket_, chunk, sizeof(chunk), 0);
+    if (count <= 0) {
+      return false;
+    }
+    buffer_.append(chunk, static_cast<size_t>(count));
+    return true;
+  }
+
+  // Read one response with a Content-Length body and return its status
+  // code, or -1 if the connection failed
+  int readResponse() {
+    size_t header_end;
+    while ((header_end = buffer_.find("\r\n\r\n")) == std::string::npos) {
+      if (!readMore()) {
+        return -1;
+      }
+    }
+    std::string headers = buffer_.substr(0, header_end);
+    int status = -1;
+    size_t space = headers.find(' ');
+    if (space != std::string::npos) {
+      status = std::atoi(headers.c_str() + space + 1);
+    }
+
+    size_t content_length = 0;
+    std::string lower(headers);
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    size_t length_header = lower.find("content-length:");
+    if (length_header != std::string::npos) {
+      content_length = std::strtoull(
+          headers.c_str() + length_header + std::strlen("content-length:"),
+          nullptr, 10);
+    }
+
+    size_t response_end = header_end + 4 + content_length;
+    while (buffer_.size() < response_end) {
+      if (!readMore()) {
+        return -1;
+      }
+    }
+    buffer_.erase(0, response_end);
+    return status;
+  }
+};
+
+// Latencies in microseconds and the error count of one worker
+struct WorkerStats {
+  std::vector<int64_t> latencies_us;
+  long long errors = 0;
+};
+
+// Latency at quantile q of sorted latencies, in milliseconds
+double percentileMs(const std::vector<int64_t>& sorted, double q) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  size_t index = static_cast<size_t>(q * static_cast<double>(sorted.size()));
+  return static_cast<double>(sorted[std::min(index, sorted.size() - 1)]) /
+         1000.0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> queries = loadQueries(options.queries_path);
+  if (queries.empty()) {
+    std::cerr << "No queries in " << options.queries_path << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Replaying " << queries.size() << " queries against "
+            << options.target << " at " << options.address << " ("
+            << options.mode << " loop, " << options.concurrency
+            << " workers";
+  if (options.mode == "open") {
+    std::cout << ", " << options.qps << " QPS";
+  }
+  std::cout << ", " << options.duration_seconds << " s)" << std::endl;
+
+  // Workers share one gRPC channel, which multiplexes their calls
+  std::shared_ptr<grpc::Channel> channel;
+  std::string host = options.address;
+  std::string port = "80";
+  if (options.target == "datanode") {
+    channel = grpc::CreateChannel(options.address,
+                                  grpc::InsecureChannelCredentials());
+  } else {
+    size_t colon = options.address.rfind(':');
+    if (colon != std::string::npos) {
+      host = options.address.substr(0, colon);
+      port = options.address.substr(colon + 1);
+    }
+  }
+
+  const bool open_loop = options.mode == "open";
+  const auto interval = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / options.qps));
+  const auto duration = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(options.duration_seconds));
+
+  // Each ticket is one request: the query it replays and, in the open
+  // loop, its scheduled send time
+  std::atomic<long long> next_ticket{0};
+  std::vector<WorkerStats> stats(options.concurrency);
+  std::vector<std::thread> workers;
+  const Clock::time_point start = Clock::now();
+  const Clock::time_point deadline = start + duration;
+
+  for (int w = 0; w < options.concurrency; ++w) {
+    workers.emplace_back([&, w]() {
+      std::unique_ptr<LoadClient> client;
+      if (channel) {
+        client = std::make_unique<DataNodeLoadClient>(channel,
+                                                      options.max_results);
+      } else {
+        client = std::make_unique<GatewayLoadClient>(host, port);
+      }
+      WorkerStats& worker_stats = stats[w];
+
+      while (true) {
+        long long ticket = next_ticket.fetch_add(1);
+        if (options.max_requests > 0 && ticket >= options.max_requests) {
+          break;
+        }
+        Clock::time_point send_time;
+        if (open_loop) {
+          send_time = start + interval * ticket;
+          if (send_time >= deadline) {
+            break;
+          }
+          std::this_thread::sleep_until(send_time);
+        } else {
+          send_time = Clock::now();
+          if (send_time >= deadline) {
+            break;
+          }
+        }
+
+        bool ok = client->send(queries[ticket % queries.size()]);
+        auto latency = Clock::now() - send_time;
+        worker_stats.latencies_us.push_back(
+            std::chrono::duration_cast<std::chrono::microseconds>(latency)
+                .count());
+        if (!ok) {
+          worker_stats.errors++;
+        }
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  double elapsed_seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::vector<int64_t> latencies;
+  long long errors = 0;
+  for (const WorkerStats& worker_stats : stats) {
+    latencies.insert(latencies.end(), worker_stats.latencies_us.begin(),
+                     worker_stats.latencies_us.end());
+    errors += worker_stats.errors;
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "\n=== Results ===" << std::endl;
+  std::cout << "Requests: " << latencies.size() << " (" << errors
+            << " failed)" << std::endl;
+  std::cout << "Elapsed: " << elapsed_seconds << " s" << std::endl;
+  std::cout << "Throughput: "
+            << static_cast<double>(latencies.size()) / elapsed_seconds
+            << " req/s" << std::endl;
+  std::cout << "Latency (ms): p50 " << percentileMs(latencies, 0.50)
+            << ", p90 " << percentileMs(latencies, 0.90) << ", p99 "
+            << percentileMs(latencies, 0.99) << ", p999 "
+            << percentileMs(latencies, 0.999) << ", max "
+            << (latencies.empty() ? 0.0 : latencies.back() / 1000.0)
+            << std::endl;
+  if (open_loop && elapsed_seconds > options.duration_seconds * 1.1) {
+    std::cout << "Warning: the server fell behind the target rate; "
+              << "latencies include queueing behind --concurrency"
+              << std::endl;
+  }
+
+  return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,317 @@
+// Shard builder: splits address CSV files into N shards
+//
+//   shard_builder --input=data/raw --output=data/shards --shards=4
+//                 --key=postcode --snapshots=1
+//
+// Every input (a CSV file, or a directory searched recursively for *.csv)
+// is parsed with CSVParser on --threads threads. Each valid record's line is
+// copied unchanged to shard_<i>_data.csv, where i is chosen by
+// ShardPartition: a jump consistent hash of the record's HASH field or
+// normalized postcode (--key). Parse threads buffer lines per shard and
+// append whole buffers, so all shard files are written concurrently. Lines
+// CSVParser rejects are dropped, as the data nodes would skip them anyway.
+//
+// With --snapshots=1 each shard's indexes are then built and saved to
+// shard_<i>_data.csv.snapshot, where a data node serving that file finds
+// them by default (see SNAPSHOT_PATH).
+//
+// The gateway routes by the same partition when started with
+// PARTITION_KEY set to the --key used here and DATA_NODE_0 ..
+// DATA_NODE_<N-1> pointing at the nodes serving shards 0 .. N-1.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "data_node/address_normalizer.h"
+#include "data_node/csv_parser.h"
+#include "data_node/data_node.h"
+#include "data_node/shard_partition.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Header written to every shard file
+constexpr char kCsvHeader[] =
+    "LON,LAT,NUMBER,STREET,UNIT,CITY,DISTRICT,REGION,POSTCODE,ID,HASH\n";
+
+// Bytes a parse thread buffers for one shard before appending them
+constexpr size_t kFlushBytes = 1 << 20;
+
+struct Options {
+  std::vector<std::string> inputs;
+  std::string output_dir = "shards";
+  size_t shards = 0;
+  ShardPartition::Key key = ShardPartition::Key::kHash;
+  size_t threads = 0;      // 0 = one per hardware thread
+  bool snapshots = false;  // Also build each shard's index snapshot
+};
+
+void printUsage() {
+  std::cerr
+      << "Usage: shard_builder --input=PATH --shards=N [options]\n"
+      << "  --input=PATH          CSV file or directory of CSV files "
+      << "(repeatable)\n"
+      << "  --shards=N            Number of shards\n"
+      << "  --output=DIR          Output directory (default: shards)\n"
+      << "  --key=hash|postcode   Routing key (default: hash)\n"
+      << "  --threads=N           Parse threads (default: one per core)\n"
+      << "  --snapshots=0|1       Build each shard's index snapshot "
+      << "(default: 0)\n";
+}
+
+// Parse --name=value arguments; returns false on anything unrecognized
+bool parseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    size_t equals = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || equals == std::string::npos) {
+      std::cerr << "Invalid argument: " << arg << std::endl;
+      return false;
+    }
+    std::string name = arg.substr(2, equals - 2);
+    std::string value = arg.substr(equals + 1);
+    try {
+      if (name == "input") {
+        options.inputs.push_back(value);
+      } else if (name == "output") {
+        options.output_dir = value;
+      } else if (name == "shards") {
+        options.shards = std::stoul(value);
+      } else if (name == "key") {
+        std::optional<ShardPartition::Key> key =
+            ShardPartition::parseKey(value);
+        if (!key) {
+          std::cerr << "--key must be hash or postcode" << std::endl;
+          return false;
+        }
+        options.key = *key;
+      } else if (name == "threads") {
+        options.threads = std::stoul(value);
+      } else if (name == "snapshots") {
+        options.snapshots = std::stoi(value) != 0;
+      } else {
+        std::cerr << "Unknown option: --" << name << std::endl;
+        return false;
+      }
+    } catch (const std::exception&) {
+      std::cerr << "Invalid value for --" << name << ": " << value
+                << std::endl;
+      return false;
+    }
+  }
+
+  if (options.inputs.empty() || options.shards == 0) {
+    return false;
+  }
+  if (options.threads == 0) {
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return true;
+}
+
+// Expand the inputs into CSV files: files as given, directories searched
+// recursively, each directory's files in name order
+std::vector<std::string> findInputFiles(const std::vector<std::string>& inputs) {
+  std::vector<std::string> files;
+  for (const std::string& input : inputs) {
+    if (!fs::is_directory(input)) {
+      files.push_back(input);
+      continue;
+    }
+    std::vector<std::string> found;
+    for (const auto& entry : fs::recursive_directory_iterator(input)) {
+      if (entry.is_regular_file() && entry.path().extension() == ".csv") {
+        found.push_back(entry.path().string());
+      }
+    }
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+  }
+  return files;
+}
+
+std::string shardPath(const std::string& output_dir, size_t shard) {
+  return (fs::path(output_dir) / ("shard_" + std::to_string(shard) +
+                                  "_data.csv"))
+      .string();
+}
+
+// One output file, appended to by every parse thread
+struct ShardFile {
+  std::mutex mutex;
+  std::ofstream file;
+  size_t records = 0;
+};
+
+// Split every input file into the shard files. Returns false if an output
+// file cannot be written.
+bool writeShards(const Options& options,
+                 const std::vector<std::string>& input_files,
+                 std::vector<std::unique_ptr<ShardFile>>& shard_files) {
+  ShardPartition partition(options.shards, options.key);
+  AddressNormalizer normalizer;
+
+  // Lines and record counts waiting in each parse thread, per shard
+  struct Pending {
+    std::string lines;
+    size_t records = 0;
+  };
+  std::vector<std::vector<Pending>> pending(
+      options.threads, std::vector<Pending>(options.shards));
+  auto flush = [&shard_files](size_t shard, Pending& buffer) {
+    ShardFile& shard_file = *shard_files[shard];
+    std::lock_guard<std::mutex> lock(shard_file.mutex);
+    shard_file.file.write(buffer.lines.data(),
+                          static_cast<std::streamsize>(buffer.lines.size()));
+    shard_file.records += buffer.records;
+    buffer.lines.clear();
+    buffer.records = 0;
+  };
+
+  size_t total_records = 0;
+  size_t total_errors = 0;
+  for (size_t i = 0; i < input_files.size(); ++i) {
+    const std::string& path = input_files[i];
+    std::cout << "[" << (i + 1) << "/" << input_files.size()
+              << "] Processing file: " << path << std::endl;
+
+    CSVParser parser;
+    bool scanned = parser.scan(
+        path, options.threads,
+        [&](size_t chunk, std::string_view line, AddressRecord& record) {
+          std::string postcode;
+          if (options.key == ShardPartition::Key::kPostcode) {
+            postcode = normalizer.normalize(record.postcode);
+          }
+          size_t shard = partition.shardFor(record.hash, postcode);
+          Pending& buffer = pending[chunk][shard];
+          buffer.lines.append(line);
+          buffer.lines.push_back('\n');
+          buffer.records++;
+          if (buffer.lines.size() >= kFlushBytes) {
+            flush(shard, buffer);
+          }
+        });
+    if (!scanned) {
+      std::cerr << "Warning: Skipping unreadable file " << path << std::endl;
+      continue;
+    }
+    total_records += parser.getSuccessCount();
+    total_errors += parser.getErrorCount();
+  }
+
+  for (auto& thread_pending : pending) {
+    for (size_t shard = 0; shard < options.shards; ++shard) {
+      flush(shard, thread_pending[shard]);
+    }
+  }
+
+  bool ok = true;
+  for (size_t shard = 0; shard < options.shards; ++shard) {
+    ShardFile& shard_file = *shard_files[shard];
+    shard_file.file.close();
+    if (shard_file.file.fail()) {
+      std::cerr << "Error: Could not write "
+                << shardPath(options.output_dir, shard) << std::endl;
+      ok = false;
+    }
+  }
+
+  std::cout << "Records written: " << total_records << " (" << total_errors
+            << " malformed skipped)" << std::endl;
+  return ok;
+}
+
+// Build each shard's indexes from its file and save them as its snapshot.
+// Shards are built one at a time, each with every thread, so only one
+// shard's indexes are in memory at once.
+bool buildSnapshots(const Options& options) {
+  for (size_t shard = 0; shard < options.shards; ++shard) {
+    std::string path = shardPath(options.output_dir, shard);
+    DataNodeOptions node_options;
+    node_options.load_threads = options.threads;
+    node_options.snapshot_path = path + ".snapshot";
+    DataNode node(static_cast<int>(shard), path, node_options);
+    if (!node.initialize()) {
+      std::cerr << "Error: Could not build the indexes of " << path
+                << std::endl;
+      return false;
+    }
+    std::cout << "Snapshot written: " << node_options.snapshot_path
+              << std::endl;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+
+  std::vector<std::string> input_files = findInputFiles(options.inputs);
+  if (input_files.empty()) {
+    std::cerr << "No CSV files found" << std::endl;
+    return 1;
+  }
+
+  std::error_code error;
+  fs::create_directories(options.output_dir, error);
+  if (error) {
+    std::cerr << "Error: Could not create " << options.output_dir << ": "
+              << error.message() << std::endl;
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<ShardFile>> shard_files;
+  for (size_t shard = 0; shard < options.shards; ++shard) {
+    auto shard_file = std::make_unique<ShardFile>();
+    std::string path = shardPath(options.output_dir, shard);
+    shard_file->file.open(path, std::ios::binary | std::ios::trunc);
+    if (!shard_file->file.is_open()) {
+      std::cerr << "Error: Could not open " << path << std::endl;
+      return 1;
+    }
+    shard_file->file << kCsvHeader;
+    shard_files.push_back(std::move(shard_file));
+  }
+
+  std::cout << "Splitting " << input_files.size() << " file(s) into "
+            << options.shards << " shard(s) by "
+            << ShardPartition::keyName(options.key) << " with "
+            << options.threads << " thread(s)" << std::endl;
+  auto start_time = std::chrono::steady_clock::now();
+
+  if (!writeShards(options, input_files, shard_files)) {
+    return 1;
+  }
+  for (size_t shard = 0; shard < options.shards; ++shard) {
+    std::cout << "  " << shardPath(options.output_dir, shard) << ": "
+              << shard_files[shard]->records << " records" << std::endl;
+  }
+
+  if (options.snapshots && !buildSnapshots(options)) {
+    return 1;
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start_time);
+  std::cout << "Done in " << elapsed.count() << " ms. Start the gateway with "
+            << "PARTITION_KEY=" << ShardPartition::keyName(options.key)
+            << " to route by this partition" << std::endl;
+  return 0;
+}
@@ -0,0 +1,155 @@
+#include "benchmark_data.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include "data_node/address_normalizer.h"
+#include "data_node/csv_parser.h"
+
+#ifndef BENCHMARK_DATA_DIR
+#define BENCHMARK_DATA_DIR "data"
+#endif
+
+namespace {
+
+std::mutex g_datasets_mutex;
+
+// Demo records of all shards, normalized like the data node indexes them
+const std::vector<AddressRecord>& demoRecords() {
+  static const std::vector<AddressRecord> records = []() {
+    std::vector<AddressRecord> all;
+    AddressNormalizer normalizer;
+    for (const char* file :
+         {"shard_0_data_demo.csv", "shard_1_data_demo.csv"}) {
+      CSVParser parser;
+      std::string path = std::string(BENCHMARK_DATA_DIR) + "/" + file;
+      for (AddressRecord& record : parser.parse(path)) {
+        record.number = normalizer.normalize(record.number);
+        record.street = normalizer.normalize(record.street);
+        record.unit = normalizer.normalize(record.unit);
+        record.city = normalizer.normalize(record.city);
+        record.postcode = normalizer.normalize(record.postcode);
+        all.push_back(std::move(record));
+      }
+    }
+    if (all.empty()) {
+      throw std::runtime_error("No demo data found in " +
+                               std::string(BENCHMARK_DATA_DIR));
+    }
+    return all;
+  }();
+  return records;
+}
+
+// Write a field, quoting it if it holds a separator or a quote
+void writeField(std::ofstream& out, const std::string& field) {
+  if (field.find_first_of(",\"") == std::string::npos) {
+    out << field;
+    return;
+  }
+  out << '"';
+  for (char c : field) {
+    if (c == '"') {
+      out << '"';
+    }
+    out << c;
+  }
+  out << '"';
+}
+
+}  // namespace
+
+const std::vector<AddressRecord>& scaledRecords(size_t count) {
+  static std::map<size_t, std::unique_ptr<std::vector<AddressRecord>>>
+      datasets;
+  std::lock_guard<std::mutex> lock(g_datasets_mutex);
+  auto& dataset = datasets[count];
+  if (!dataset) {
+    const std::vector<AddressRecord>& demo = demoRecords();
+    dataset = std::make_unique<std::vector<AddressRecord>>();
+    dataset->reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      AddressRecord record = demo[i % demo.size()];
+      size_t copy = i / demo.size();
+      if (copy > 0) {
+        // A distinct address a few meters from the original
+        record.number = std::to_string(copy) + "-" + record.number;
+        record.longitude += 1e-5 * static_cast<double>(copy % 100);
+        record.latitude += 1e-5 * static_cast<double>(copy / 100 % 100);
+        record.hash = record.hash * 31 + copy;
+      }
+      dataset->push_back(std::move(record));
+    }
+  }
+  return *dataset;
+}
+
+const std::string& scaledCsvPath(size_t count) {
+  static std::map<size_t, std::string> paths;
+  const std::vector<AddressRecord>& records = scaledRecords(count);
+
+  std::lock_guard<std::mutex> lock(g_datasets_mutex);
+  std::string& path = paths[count];
+  if (path.empty()) {
+    path = (std::filesystem::temp_directory_path() /
+            ("geocoding_benchmark_" + std::to_string(count) + ".csv"))
+               .string();
+    std::ofstream out(path, std::ios::trunc);
+    out << "LON,LAT,NUMBER,STREET,UNIT,CITY,DISTRICT,REGION,POSTCODE,ID,HASH\n";
+    char coordinates[64];
+    char hash[17];
+    for (const AddressRecord& record : records) {
+      std::snprintf(coordinates, sizeof(coordinates), "%.7f,%.7f,",
+                    record.longitude, record.latitude);
+      std::snprintf(hash, sizeof(hash), "%016zx", record.hash);
+      out << coordinates;
+      writeField(out, record.number);
+      out << ',';
+      writeField(out, record.original_street);
+      out << ',';
+      writeField(out, record.original_unit);
+      out << ',';
+      writeField(out, record.original_city);
+      out << ",,,";
+      writeField(out, record.postcode);
+      out << ",," << hash << '\n';
+    }
+  }
+  return path;
+}
+
+std::vector<std::string> recordTerms(const AddressRecord& record) {
+  // Composite keys join fields with DataNode::KEY_SEPARATOR
+  const std::string separator(1, '\x01');
+  std::vector<std::string> terms;
+  if (!record.number.empty() && !record.street.empty()) {
+    std::string number_street = record.number + separator + record.street;
+    if (!record.city.empty()) {
+      std::string with_city = number_street + separator + record.city;
+      terms.push_back(with_city);
+      if (!record.postcode.empty()) {
+        terms.push_back(with_city + separator + record.postcode);
+      }
+    }
+    terms.push_back(std::move(number_street));
+  }
+  for (const std::string* field :
+       {&record.street, &record.city, &record.postcode, &record.number}) {
+    if (!field->empty()) {
+      terms.push_back(*field);
+    }
+  }
+  return terms;
+}
+
+const std::vector<std::string>& queryPrefixes() {
+  static const std::vector<std::string> prefixes = {
+      "S", "MA", "SALINAS", "MCKINNON STREET", "939", "93906",
+      "1531\x01MCKINNON STREET", "ARNHEM ROAD", "SEASIDE", "3RD"};
+  return prefixes;
+}
@@ -0,0 +1,36 @@
+#ifndef BENCHMARK_BENCHMARK_DATA_H_
+#define BENCHMARK_BENCHMARK_DATA_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "data_node/address_record.h"
+
+// Datasets shared by the benchmarks. The base dataset is the demo data
+// (data/shard_*_data_demo.csv, about 20,000 records); larger sizes are
+// synthetic scale-ups that repeat it with distinct house numbers and
+// slightly shifted coordinates, so term distributions stay realistic.
+
+// Dataset sizes every size-parameterized benchmark runs with
+inline const std::vector<long>& datasetSizes() {
+  static const std::vector<long> sizes = {10000, 100000, 1000000};
+  return sizes;
+}
+
+// Get count records of the scaled demo data. Built once per size
+const std::vector<AddressRecord>& scaledRecords(size_t count);
+
+// Get the path of a CSV file holding scaledRecords(count), written to the
+// temporary directory on first use
+const std::string& scaledCsvPath(size_t count);
+
+// Index terms of a record, as the data node derives them: the composite
+// number/street/city/postcode keys and each field on its own
+std::vector<std::string> recordTerms(const AddressRecord& record);
+
+// Query prefixes drawn from the demo data, from one-letter prefixes
+// matching many records to full terms matching few
+const std::vector<std::string>& queryPrefixes();
+
+#endif  // BENCHMARK_BENCHMARK_DATA_H_
@@ -0,0 +1,243 @@
+// Data Node Microbenchmarks
+//
+// Each size-parameterized benchmark runs on the datasets of
+// benchmark_data.h; the argument is the number of records.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark_data.h"
+#include "data_node/address_normalizer.h"
+#include "data_node/csv_parser.h"
+#include "data_node/data_node.h"
+#include "data_node/forward_index.h"
+#include "data_node/logging.h"
+#include "data_node/radix_tree_index.h"
+
+namespace {
+
+// Register a benchmark once per dataset size
+void datasetArgs(benchmark::internal::Benchmark* bench) {
+  for (long size : datasetSizes()) {
+    bench->Arg(size);
+  }
+}
+
+// (term, ID) postings of the first count records, sorted for buildFrom()
+std::vector<RadixTreeIndex::TermPosting> sortedPostings(size_t count) {
+  const std::vector<AddressRecord>& records = scaledRecords(count);
+  std::vector<RadixTreeIndex::TermPosting> postings;
+  for (size_t id = 0; id < records.size(); ++id) {
+    for (std::string& term : recordTerms(records[id])) {
+      postings.push_back({std::move(term), static_cast<DocId>(id)});
+    }
+  }
+  std::sort(postings.begin(), postings.end(), RadixTreeIndex::postingLess);
+  return postings;
+}
+
+// A frozen index of the first count records, built once per size
+const RadixTreeIndex& frozenIndex(size_t count) {
+  static std::vector<std::pair<size_t, std::unique_ptr<RadixTreeIndex>>>
+      indexes;
+  for (const auto& [size, index] : indexes) {
+    if (size == count) {
+      return *index;
+    }
+  }
+  auto index = std::make_unique<RadixTreeIndex>();
+  index->buildFrom(sortedPostings(count));
+  index->freeze();
+  indexes.emplace_back(count, std::move(index));
+  return *indexes.back().second;
+}
+
+// A forward index of the first count records, built once per size
+const ForwardIndex& forwardIndex(size_t count) {
+  static std::vector<std::pair<size_t, std::unique_ptr<ForwardIndex>>>
+      indexes;
+  for (const auto& [size, index] : indexes) {
+    if (size == count) {
+      return *index;
+    }
+  }
+  auto index = std::make_unique<ForwardIndex>();
+  for (const AddressRecord& record : scaledRecords(count)) {
+    index->insert(record);
+  }
+  indexes.emplace_back(count, std::move(index));
+  return *indexes.back().second;
+}
+
+}  // namespace
+
+// Insert every term of every record one at a time
+static void BM_RadixInsert(benchmark::State& state) {
+  const std::vector<AddressRecord>& records = scaledRecords(state.range(0));
+  size_t postings = 0;
+  for (auto _ : state) {
+    RadixTreeIndex index;
+    postings = 0;
+    for (size_t id = 0; id < records.size(); ++id) {
+      for (const std::string& term : recordTerms(records[id])) {
+        index.insert(term, static_cast<DocId>(id));
+        postings++;
+      }
+    }
+    benchmark::DoNotOptimize(index.getTermCount());
+  }
+  state.SetItemsProcessed(state.iterations() * postings);
+}
+BENCHMARK(BM_RadixInsert)->Apply(datasetArgs)->Unit(benchmark::kMillisecond);
+
+// Build the tree from sorted postings in one pass, as the data node does
+static void BM_RadixBuildFrom(benchmark::State& state) {
+  std::vector<RadixTreeIndex::TermPosting> postings =
+      sortedPostings(state.range(0));
+  for (auto _ : state) {
+    RadixTreeIndex index;
+    index.buildFrom(postings);
+    index.freeze();
+    benchmark::DoNotOptimize(index.getTermCount());
+  }
+  state.SetItemsProcessed(state.iterations() * postings.size());
+}
+BENCHMARK(BM_RadixBuildFrom)
+    ->Apply(datasetArgs)
+    ->Unit(benchmark::kMillisecond);
+
+// Prefix search returning at most 100 IDs, over all query prefixes
+static void BM_RadixSearch(benchmark::State& state) {
+  const RadixTreeIndex& index = frozenIndex(state.range(0));
+  const std::vector<std::string>& prefixes = queryPrefixes();
+  for (auto _ : state) {
+    for (const std::string& prefix : prefixes) {
+      benchmark::DoNotOptimize(index.search(prefix, 100));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * prefixes.size());
+}
+BENCHMARK(BM_RadixSearch)->Apply(datasetArgs);
+
+// Collect every ID under each query prefix, sorted
+static void BM_RadixCollect(benchmark::State& state) {
+  const RadixTreeIndex& index = frozenIndex(state.range(0));
+  const std::vector<std::string>& prefixes = queryPrefixes();
+  size_t ids = 0;
+  for (auto _ : state) {
+    ids = 0;
+    for (const std::string& prefix : prefixes) {
+      std::vector<DocId> collected = index.searchSorted(prefix);
+      ids += collected.size();
+      benchmark::DoNotOptimize(collected.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * ids);
+}
+BENCHMARK(BM_RadixCollect)->Apply(datasetArgs);
+
+// Copy records out of the forward index, in a scattered order
+static void BM_ForwardIndexGet(benchmark::State& state) {
+  const ForwardIndex& index = forwardIndex(state.range(0));
+  const DocId count = static_cast<DocId>(index.getRecordCount());
+  DocId id = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(index.get(id));
+    id = (id + 7919) % count;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ForwardIndexGet)->Apply(datasetArgs);
+
+// View records in the forward index without copying, in a scattered order
+static void BM_ForwardIndexGetView(benchmark::State& state) {
+  const ForwardIndex& index = forwardIndex(state.range(0));
+  const DocId count = static_cast<DocId>(index.getRecordCount());
+  DocId id = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(index.getView(id));
+    id = (id + 7919) % count;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ForwardIndexGetView)->Apply(datasetArgs);
+
+// Parse a whole CSV file; reported in bytes per second. The second
+// argument is the number of parser threads
+static void BM_CsvParse(benchmark::State& state) {
+  const std::string& path = scaledCsvPath(state.range(0));
+  size_t threads = static_cast<size_t>(state.range(1));
+  for (auto _ : state) {
+    CSVParser parser;
+    benchmark::DoNotOptimize(parser.parse(path, threads));
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          std::filesystem::file_size(path));
+}
+BENCHMARK(BM_CsvParse)
+    ->Apply([](benchmark::internal::Benchmark* bench) {
+      for (long size : datasetSizes()) {
+        bench->Args({size, 1});
+        bench->Args({size, 4});
+      }
+    })
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Normalize the raw street and city of every record into a reused buffer
+static void BM_Normalize(benchmark::State& state) {
+  const std::vector<AddressRecord>& records = scaledRecords(state.range(0));
+  AddressNormalizer normalizer;
+  std::string out;
+  for (auto _ : state) {
+    for (const AddressRecord& record : records) {
+      normalizer.normalizeInto(record.original_street, out);
+      benchmark::DoNotOptimize(out.data());
+      normalizer.normalizeInto(record.original_city, out);
+      benchmark::DoNotOptimize(out.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * records.size() * 2);
+}
+BENCHMARK(BM_Normalize)->Apply(datasetArgs)->Unit(benchmark::kMillisecond);
+
+// Expand street suffix abbreviations of every record
+static void BM_NormalizeStreetSuffix(benchmark::State& state) {
+  const std::vector<AddressRecord>& records = scaledRecords(state.range(0));
+  AddressNormalizer normalizer;
+  for (auto _ : state) {
+    for (const AddressRecord& record : records) {
+      benchmark::DoNotOptimize(normalizer.normalizeStreetSuffix(record.street));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * records.size());
+}
+BENCHMARK(BM_NormalizeStreetSuffix)
+    ->Apply(datasetArgs)
+    ->Unit(benchmark::kMillisecond);
+
+// Answer top-10 queries on one shared data node from several threads at
+// once. Every query first takes a reference to the generation being
+// served, so this shows whether that scales with the thread count.
+static void BM_DataNodeSearchThreads(benchmark::State& state) {
+  static DataNode* node = []() {
+    setLogLevel(LogLevel::kWarning);
+    auto* built = new DataNode(0, scaledCsvPath(datasetSizes()[0]));
+    built->initialize();
+    return built;
+  }();
+  const std::vector<std::string>& prefixes = queryPrefixes();
+  size_t next = 0;
+  for (auto _ : state) {
+    const std::string& prefix = prefixes[next++ % prefixes.size()];
+    benchmark::DoNotOptimize(node->searchTopK(
+        {prefix}, 10, 0.0, [](const AddressRecordView&, double) {}));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DataNodeSearchThreads)->ThreadRange(1, 16)->UseRealTime();
@@ -0,0 +1,79 @@
+// Gateway Microbenchmarks
+
+#include <benchmark/benchmark.h>
+
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "benchmark_data.h"
+#include "data_node.grpc.pb.h"
+#include "gateway/gateway_server.h"
+
+namespace {
+
+// Discards everything written to it, so that log lines are formatted as
+// in production but not printed
+class NullBuffer : public std::streambuf {
+ protected:
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char*, std::streamsize count) override {
+    return count;
+  }
+};
+
+// Results of shards data nodes answering one query with records_per_shard
+// records each. One record in four is also returned by the next shard, as
+// happens with overlapping shard data
+std::vector<DataNodeResult> syntheticResults(size_t shards,
+                                             size_t records_per_shard) {
+  const std::vector<AddressRecord>& records =
+      scaledRecords(datasetSizes().front());
+  std::vector<DataNodeResult> results(shards);
+  size_t next = 0;
+  for (size_t shard = 0; shard < shards; ++shard) {
+    results[shard].shard_id = static_cast<int>(shard);
+    results[shard].success = true;
+    for (size_t i = 0; i < records_per_shard; ++i) {
+      size_t index = i % 4 == 0 && next >= records_per_shard
+                         ? next - records_per_shard
+                         : next;
+      next++;
+      const AddressRecord& record = records[index % records.size()];
+      datanode::AddressRecord pb_record;
+      pb_record.set_hash(record.hash);
+      pb_record.set_longitude(record.longitude);
+      pb_record.set_latitude(record.latitude);
+      pb_record.set_number(record.number);
+      pb_record.set_street(record.street);
+      pb_record.set_unit(record.unit);
+      pb_record.set_city(record.city);
+      pb_record.set_postcode(record.postcode);
+      results[shard].records.push_back(std::move(pb_record));
+    }
+  }
+  return results;
+}
+
+}  // namespace
+
+// Merge, deduplicate and rank the results of all shards. Arguments: the
+// number of shards and the records each one returns
+static void BM_AggregateAndRankResults(benchmark::State& state) {
+  std::vector<DataNodeResult> results = syntheticResults(
+      static_cast<size_t>(state.range(0)), static_cast<size_t>(state.range(1)));
+  const std::vector<std::string> query_terms = {"MAIN", "SALINAS"};
+
+  NullBuffer null_buffer;
+  std::streambuf* old_cout = std::cout.rdbuf(&null_buffer);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(GatewayServer::aggregateAndRankResults(
+        results, query_terms, GatewayServer::kMaxResults));
+  }
+  std::cout.rdbuf(old_cout);
+  state.SetItemsProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+}
+BENCHMARK(BM_AggregateAndRankResults)
+    ->ArgsProduct({{2, 8}, {5, 100, 1000}});
@@ -0,0 +1,98 @@
+#ifndef DATA_NODE_ADDRESS_KEYS_H_
+#define DATA_NODE_ADDRESS_KEYS_H_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "data_node/address_normalizer.h"
+#include "data_node/array_view.h"
+
+// Composite keys joining normalized address fields, shared by the data node
+// (which indexes them) and the gateway (which builds them from structured
+// queries to route them and look them up exactly)
+
+// Separator between the fields of a composite key
+constexpr char kKeySeparator = '\x01';
+
+// Address components of a structured query "number street, city,
+// postcode", as views into the query, still to be normalized
+struct ParsedAddress {
+  std::string_view number;
+  std::string_view street;  // The rest of the first part, as written
+  std::string_view city;
+  std::string_view postcode;
+};
+
+// Whether query terms are one structured (comma separated) address
+bool isStructuredQuery(const std::vector<std::string>& query_terms);
+
+// Split a structured query into address components in one pass: the first
+// token of the first part is the number, the rest of it the street, then
+// the city and postcode parts. Missing parts are left empty.
+ParsedAddress parseStructuredQuery(std::string_view query);
+
+// Append the composite keys indexed for a record's normalized fields
+void appendIndexKeys(const std::string& number,
+                     const std::string& street,
+                     const std::string& city,
+                     const std::string& postcode,
+                     std::vector<std::string>& keys);
+
+// Composite keys of a structured query, most specific first
+struct StructuredQueryKeys {
+  std::vector<std::string> keys;  // Without fields the query lacks
+  std::string postcode;           // Normalized postcode, may be empty
+  // Whether keys[0] includes the postcode, so only records with exactly
+  // that postcode hold it
+  bool has_postcode_key = false;
+};
+
+// Parse and normalize a structured query into its composite keys
+StructuredQueryKeys structuredQueryKeys(const std::string& query,
+                                        const AddressNormalizer& normalizer);
+
+// A structured query planned for a single trie walk. Its composite keys are
+// prefixes of one another, so they are built once, as the longest key of
+// all the normalized fields, in one buffer (on the stack unless the query
+// is unusually long), with the lengths of the prefixes that are keys:
+// number and street, then with the city, then with the postcode. The most
+// specific key that matches is then found by descending the trie once
+// along key() (see RadixTreeIndex::searchLongestPrefix()).
+class StructuredQueryPlan {
+ public:
+  // Longest query whose key is built in the inline buffer
+  static constexpr size_t kInlineQueryLength = 256;
+
+  StructuredQueryPlan(std::string_view query,
+                      const AddressNormalizer& normalizer);
+
+  // key() may point into the plan itself
+  StructuredQueryPlan(const StructuredQueryPlan&) = delete;
+  StructuredQueryPlan& operator=(const StructuredQueryPlan&) = delete;
+
+  // Get the most specific key, empty if the query has no number and street
+  std::string_view key() const;
+
+  // Get the lengths of the prefixes of key() that are keys, ascending
+  ArrayView<size_t> keyLengths() const { return {key_lengths_, key_count_}; }
+
+  // Get the normalized postcode, which may be empty
+  std::string_view postcode() const;
+
+  // Whether key() includes the postcode, so only records with exactly
+  // that postcode hold it
+  bool hasPostcodeKey() const { return key_count_ == 3; }
+
+ private:
+  char inline_buffer_[kInlineQueryLength + 3];  // Fields and separators
+  std::string long_buffer_;
+  const char* buffer_;
+  size_t key_lengths_[3];
+  size_t key_count_ = 0;
+  size_t postcode_begin_;
+  size_t postcode_length_;
+};
+
+#endif  // DATA_NODE_ADDRESS_KEYS_H_
@@ -1,26 +1,32 @@
 #ifndef DATA_NODE_ADDRESS_NORMALIZER_H_
 #define DATA_NODE_ADDRESS_NORMALIZER_H_
 
+#include <cstddef>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 
+// Normalizes address text for indexing and search: uppercase (ASCII), trim
+// leading/trailing whitespace and collapse inner whitespace runs to a single
+// space. Stateless, so safe to call concurrently.
 class AddressNormalizer {
  public:
-  AddressNormalizer();
-
   // Normalize a single address field
-  std::string normalize(const std::string& text);
+  std::string normalize(std::string_view text) const;
 
-  // Normalize street suffix abbreviations
-  std::string normalizeStreetSuffix(const std::string& street);
+  // Normalize text into out, replacing its contents. Reuses out's capacity,
+  // so normalizing into a caller-owned buffer does not allocate
+  void normalizeInto(std::string_view text, std::string& out) const;
 
- private:
-  std::string toUpperCase(const std::string& text);
-  std::string trimWhitespace(const std::string& text);
-  std::string collapseWhitespace(const std::string& text);
+  // Normalize text into a character buffer with room for text.size()
+  // characters, which is never exceeded. Returns the normalized length
+  size_t normalizeTo(std::string_view text, char* out) const;
+
+  // Normalize street suffix abbreviations
+  std::string normalizeStreetSuffix(std::string_view street) const;
 
-  // Map of common abbreviations to standard forms
-  std::unordered_map<std::string, std::string> suffix_map_;
+  // Get the standard form of a normalized street suffix abbreviation (e.g.
+  // "ST" -> "STREET"), or an empty view if the word is not an abbreviation
+  static std::string_view expandSuffix(std::string_view word);
 };
 
 #endif  // DATA_NODE_ADDRESS_NORMALIZER_H_
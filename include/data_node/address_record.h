@@ -4,6 +4,7 @@
 #include <cmath>
 #include <cstddef>
 #include <string>
+#include <string_view>
 
 struct AddressRecord {
   double longitude;
@@ -68,4 +69,30 @@ struct AddressRecord {
   bool operator!=(const AddressRecord& other) const { return !(*this == other); }
 };
 
+// Non-owning view of a stored address record. The string views point into
+// the ForwardIndex string pool and stay valid while the index is unmodified.
+struct AddressRecordView {
+  double longitude = 0.0;
+  double latitude = 0.0;
+  size_t hash = 0;
+  std::string_view number;
+  std::string_view street;
+  std::string_view unit;
+  std::string_view city;
+  std::string_view postcode;
+  std::string_view original_street;
+  std::string_view original_unit;
+  std::string_view original_city;
+
+  // Copy the viewed fields into an owning AddressRecord
+  AddressRecord toRecord() const {
+    return AddressRecord(longitude, latitude, hash, std::string(number),
+                         std::string(street), std::string(unit),
+                         std::string(city), std::string(postcode),
+                         std::string(original_street),
+                         std::string(original_unit),
+                         std::string(original_city));
+  }
+};
+
 #endif  // DATA_NODE_ADDRESS_RECORD_H_
@@ -0,0 +1,30 @@
+#ifndef DATA_NODE_ARRAY_VIEW_H_
+#define DATA_NODE_ARRAY_VIEW_H_
+
+#include <cstddef>
+#include <vector>
+
+// Non-owning read-only view of a contiguous array, pointing either into an
+// owned std::vector or into a memory-mapped snapshot
+template <typename T>
+class ArrayView {
+ public:
+  ArrayView() = default;
+  ArrayView(const T* data, size_t size) : data_(data), size_(size) {}
+  explicit ArrayView(const std::vector<T>& values)
+      : data_(values.data()), size_(values.size()) {}
+
+  const T* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const T& operator[](size_t index) const { return data_[index]; }
+  const T* begin() const { return data_; }
+  const T* end() const { return data_ + size_; }
+
+ private:
+  const T* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+#endif  // DATA_NODE_ARRAY_VIEW_H_
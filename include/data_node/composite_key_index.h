@@ -0,0 +1,86 @@
+#ifndef DATA_NODE_COMPOSITE_KEY_INDEX_H_
+#define DATA_NODE_COMPOSITE_KEY_INDEX_H_
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "data_node/array_view.h"
+#include "data_node/doc_id.h"
+#include "data_node/index_snapshot.h"
+
+// Static hash index of the composite keys of address records (see
+// address_keys.h), answering exact key lookups without walking the radix
+// tree. Keys are stored only as 64-bit hashes, sorted, each with a range of
+// sorted DocIds; a directory over the top bits of the hashes finds a key's
+// slot in O(1). The index is a few flat arrays, so it can also be served
+// read-only from a snapshot. Lookups are safe to run concurrently once the
+// index is built.
+class CompositeKeyIndex {
+ public:
+  // A record indexed under a key, by the key's hashKey()
+  struct KeyPosting {
+    uint64_t key_hash;
+    DocId id;
+  };
+
+  CompositeKeyIndex() = default;
+
+  // The views may point into the object's own storage
+  CompositeKeyIndex(const CompositeKeyIndex&) = delete;
+  CompositeKeyIndex& operator=(const CompositeKeyIndex&) = delete;
+
+  // Hash of a key as stored in the index
+  static uint64_t hashKey(std::string_view key);
+
+  // Build the index from postings in any order, replacing its contents.
+  // Repeated postings are stored once.
+  void build(std::vector<KeyPosting> postings);
+
+  // Get the IDs indexed under a key's hash in ascending order. Distinct
+  // keys may share a hash, so the records found must be checked against
+  // the key.
+  ArrayView<DocId> lookup(std::string_view key) const;
+
+  // Get number of distinct keys (hashes)
+  size_t size() const;
+
+  // Get memory usage (approximate bytes)
+  size_t getMemoryUsage() const;
+
+  // Add the index to a snapshot
+  void addToSnapshot(SnapshotWriter& writer) const;
+
+  // Serve the index read-only from a snapshot's sections, replacing its
+  // contents. Returns false if the sections are missing or inconsistent
+  bool loadFromSnapshot(std::shared_ptr<const IndexSnapshot> snapshot);
+
+ private:
+  // Most directory bits; the directory has about one slot per key
+  static constexpr uint32_t kMaxDirectoryBits = 24;
+
+  // Build storage, used until the index is loaded from a snapshot
+  std::vector<uint64_t> hashes_;     // Distinct key hashes, ascending
+  std::vector<uint32_t> offsets_;    // IDs of hashes_[i] are ids_[offsets_
+                                     // [i] .. offsets_[i + 1])
+  std::vector<DocId> ids_;
+  std::vector<uint32_t> directory_;  // Hashes with top bits b start at
+                                     // directory_[b], then hashes_.size()
+
+  // All reads go through these views of either the build storage or the
+  // snapshot, which is kept alive by snapshot_
+  ArrayView<uint64_t> hashes_view_;
+  ArrayView<uint32_t> offsets_view_;
+  ArrayView<DocId> ids_view_;
+  ArrayView<uint32_t> directory_view_;
+  uint32_t directory_bits_ = 0;
+  std::shared_ptr<const IndexSnapshot> snapshot_;
+
+  // Get the directory slot of a hash
+  size_t slotOf(uint64_t hash) const;
+
+  void syncViews();
+};
+
+#endif  // DATA_NODE_COMPOSITE_KEY_INDEX_H_
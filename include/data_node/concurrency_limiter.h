@@ -0,0 +1,125 @@
+#ifndef DATA_NODE_CONCURRENCY_LIMITER_H_
+#define DATA_NODE_CONCURRENCY_LIMITER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "data_node/metrics.h"
+
+// Configuration of a ConcurrencyLimiter
+struct ConcurrencyLimiterConfig {
+  size_t max_concurrency = 0;  // Fixed limit; 0 adapts it to latency
+  size_t initial_limit = 32;   // Adaptive limit: starting value
+  size_t min_limit = 1;        // Adaptive limit: bounds
+  size_t max_limit = 1024;
+  size_t max_queued = 128;     // Requests waiting for a slot at once
+  std::chrono::milliseconds max_queue_wait{100};  // Longest wait for a slot
+};
+
+// Admission control: caps the requests in flight, queuing those over the
+// limit for a bounded time and shedding the rest, so that a burst is
+// answered with quick rejections instead of a growing queue. The limit is
+// either fixed or adapted with AIMD: it grows by one per limit's worth of
+// requests that completed within kLatencyTolerance of the long-run latency
+// while it was in use, and shrinks by kBackoff on every request that was
+// slower or whose work was dropped (timed out or shed downstream). Safe to
+// use concurrently.
+class ConcurrencyLimiter {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Adaptive limit: latency over this multiple of the long-run latency
+  // counts as congestion
+  static constexpr double kLatencyTolerance = 2.0;
+
+  // Adaptive limit: factor applied on congestion
+  static constexpr double kBackoff = 0.9;
+
+  // Adaptive limit: weight of a request in the long-run latency
+  static constexpr double kLatencyWeight = 0.01;
+
+  // An admitted request's slot, released when the permit is destroyed.
+  // Empty (false) if the request was shed
+  class Permit {
+   public:
+    Permit() = default;
+    ~Permit();
+    Permit(Permit&& other) noexcept;
+    Permit& operator=(Permit&& other) noexcept;
+    Permit(const Permit&) = delete;
+    Permit& operator=(const Permit&) = delete;
+
+    explicit operator bool() const { return limiter_ != nullptr; }
+
+    // Report that the request's work was dropped (it timed out or was shed
+    // downstream), which backs the adaptive limit off
+    void setDropped() { dropped_ = true; }
+
+   private:
+    friend class ConcurrencyLimiter;
+    Permit(ConcurrencyLimiter* limiter, size_t in_flight)
+        : limiter_(limiter), start_time_(Clock::now()), in_flight_(in_flight) {}
+
+    ConcurrencyLimiter* limiter_ = nullptr;
+    Clock::time_point start_time_;
+    size_t in_flight_ = 0;  // Requests in flight once admitted
+    bool dropped_ = false;
+  };
+
+  struct Stats {
+    size_t limit;
+    size_t in_flight;
+    size_t queued;      // Waiting for a slot
+    uint64_t admitted;
+    uint64_t shed;      // Rejected: over the limit with the queue full, or
+                        // not admitted within the queue wait
+    uint64_t dropped;   // Admitted, then reported dropped
+  };
+
+  explicit ConcurrencyLimiter(const ConcurrencyLimiterConfig& config);
+
+  ConcurrencyLimiter(const ConcurrencyLimiter&) = delete;
+  ConcurrencyLimiter& operator=(const ConcurrencyLimiter&) = delete;
+
+  // Admit a request, waiting for a slot until max_queue_wait has passed or
+  // the deadline, whichever is first. Shed at once if max_queued requests
+  // are already waiting
+  Permit acquire(Clock::time_point deadline = Clock::time_point::max());
+
+  // Admit a request only if a slot is free now
+  Permit tryAcquire();
+
+  // Get the current limit and counters
+  Stats getStats() const;
+
+  // Check whether the limit adapts to latency
+  bool isAdaptive() const;
+
+ private:
+  const ConcurrencyLimiterConfig config_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable slot_free_;
+  double limit_;                 // Fractional, so it grows additively
+  double long_latency_ns_ = 0;   // EWMA of undropped requests, 0 until one
+  size_t in_flight_ = 0;
+  size_t queued_ = 0;
+
+  Counter admitted_;
+  Counter shed_;
+  Counter dropped_;
+
+  // Whole slots of the limit, at least one. Called with mutex_ held
+  size_t currentLimit() const;
+
+  // Admit a request into a free slot. Called with mutex_ held
+  Permit admit();
+
+  // Free a permit's slot and adapt the limit to its outcome
+  void release(const Permit& permit);
+};
+
+#endif  // DATA_NODE_CONCURRENCY_LIMITER_H_
@@ -1,8 +1,11 @@
 #ifndef DATA_NODE_CSV_PARSER_H_
 #define DATA_NODE_CSV_PARSER_H_
 
+#include <array>
+#include <functional>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "data_node/address_record.h"
@@ -11,8 +14,24 @@ class CSVParser {
  public:
   CSVParser();
 
-  // Parse CSV file and return vector of address records
-  std::vector<AddressRecord> parse(const std::string& filepath);
+  // Parse CSV file and return vector of address records, in file order.
+  // With num_threads > 1 the file is split into byte ranges on line
+  // boundaries that are parsed concurrently.
+  std::vector<AddressRecord> parse(const std::string& filepath,
+                                   size_t num_threads = 1);
+
+  // Callback invoked once per valid record, with the index of the byte
+  // range it was parsed from and the CSV line it was parsed from
+  using RecordVisitor = std::function<void(
+      size_t chunk, std::string_view line, AddressRecord& record)>;
+
+  // Parse a CSV file like parse(), passing each record to the visitor
+  // instead of collecting them. The file is split into at most num_threads
+  // byte ranges parsed concurrently; the records of a range are visited in
+  // file order from one thread. Returns false if the file cannot be opened.
+  bool scan(const std::string& filepath,
+            size_t num_threads,
+            const RecordVisitor& visitor);
 
   // Get count of successfully parsed records
   size_t getSuccessCount() const;
@@ -24,17 +43,40 @@ class CSVParser {
   size_t success_count_;
   size_t error_count_;
 
-  // Parse a single CSV record line
-  std::optional<AddressRecord> parseRecord(const std::string& line);
+  // Counters produced by parsing one byte range
+  struct ChunkResult {
+    size_t success_count = 0;
+    size_t error_count = 0;
+  };
+
+  // Parse the lines in [begin, end) of the file contents, passing each
+  // record to the visitor as range chunk
+  ChunkResult parseChunk(const std::string& contents,
+                         size_t begin,
+                         size_t end,
+                         size_t chunk,
+                         const RecordVisitor& visitor) const;
+
+  // Fields of one CSV line, sliced without copying
+  struct LineFields {
+    static constexpr size_t kMaxFields = 11;
+    std::array<std::string_view, kMaxFields> fields;
+    size_t count = 0;  // Fields on the line, including any beyond kMaxFields
+  };
+
+  // Parse a single CSV record line. scratch is reused between lines to hold
+  // the contents of quoted fields
+  std::optional<AddressRecord> parseRecord(std::string_view line,
+                                           std::string& scratch) const;
 
   // Validate coordinate ranges
   bool validateCoordinates(double lon, double lat) const;
 
-  // Helper to split CSV line into fields
-  std::vector<std::string> splitCSVLine(const std::string& line) const;
-
-  // Helper to trim whitespace from string
-  std::string trim(const std::string& str) const;
+  // Helper to split CSV line into fields. Unquoted fields point into the
+  // line; quoted fields are unquoted into scratch, which is cleared first
+  void splitCSVLine(std::string_view line,
+                    std::string& scratch,
+                    LineFields& fields) const;
 };
 
 #endif  // DATA_NODE_CSV_PARSER_H_
@@ -1,66 +1,395 @@
 #ifndef DATA_NODE_DATA_NODE_H_
 #define DATA_NODE_DATA_NODE_H_
 
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "data_node/address_normalizer.h"
 #include "data_node/address_record.h"
+#include "data_node/composite_key_index.h"
+#include "data_node/doc_id.h"
 #include "data_node/forward_index.h"
+#include "data_node/geo.h"
+#include "data_node/index_snapshot.h"
+#include "data_node/metrics.h"
+#include "data_node/postings_cache.h"
 #include "data_node/radix_tree_index.h"
+#include "data_node/spatial_index.h"
+#include "data_node/thread_pool.h"
 
+// Tunable options for a data node
+struct DataNodeOptions {
+  // Freeze the RadixTreeIndex into its flattened read-only layout once the
+  // indexes are built. Disable to serve from the pointer-based build tree.
+  bool flat_radix_layout = true;
+
+  // Worker threads used to parse the CSV file and build the indexes at
+  // startup (0 = one per hardware thread)
+  size_t load_threads = 0;
+
+  // Worker threads used to answer one searchTopKBatch() call (0 = one per
+  // hardware thread)
+  size_t batch_threads = 0;
+
+  // Pool that runs the extra workers of searchTopKBatch() calls, usually the
+  // server's own, so concurrent batches share its threads. Null starts
+  // threads of their own for each call.
+  std::shared_ptr<ThreadPool> batch_pool;
+
+  // Index snapshot to serve from at startup if it was built from the same
+  // data file, and to (re)write after building from the CSV file. Empty
+  // disables snapshots. Requires the flat radix layout.
+  std::string snapshot_path;
+
+  // Memory budget in bytes of the cache of hot prefix postings (see
+  // PostingsCache). 0 disables it. Requires the flat radix layout.
+  size_t postings_cache_bytes = 0;
+};
+
+// One shard of the address data and its indexes. Every search and
+// getStatistics() call is safe to make from any number of threads at once,
+// including while reload() builds a new generation: searches share the
+// read-only indexes of a generation and keep all mutable state per call,
+// per thread or in the internally synchronized postings cache.
 class DataNode {
  public:
+  using Clock = std::chrono::steady_clock;
+
   // Statistics structure for reporting node metrics
   struct Statistics {
+    // Wall time of each startup stage
+    struct LoadStageTimes {
+      std::chrono::milliseconds snapshot_load{0};   // Fingerprint and mmap
+      std::chrono::milliseconds parse{0};           // CSV parsing
+      std::chrono::milliseconds forward_index{0};   // Record storage
+      std::chrono::milliseconds key_generation{0};  // Normalization and keys
+      std::chrono::milliseconds radix_build{0};     // Radix tree inserts
+      std::chrono::milliseconds freeze{0};          // Flattening
+      std::chrono::milliseconds spatial_build{0};   // Spatial tree packing
+      std::chrono::milliseconds key_index{0};       // Composite key index
+      std::chrono::milliseconds snapshot_write{0};  // Saving the snapshot
+    };
+
     size_t total_records;
     size_t radix_tree_memory;
     size_t forward_index_size;
-    std::chrono::milliseconds load_time;
+    size_t spatial_index_memory;
+    size_t key_index_memory;
+    std::chrono::milliseconds load_time;  // Total of all stages
+    LoadStageTimes load_stages;
+    bool loaded_from_snapshot;  // Indexes are served from a mapped snapshot
+    PostingsCache::Stats postings_cache;  // All zero when disabled
+    uint64_t generation;  // Index generation served, 0 before the first load
+    std::chrono::system_clock::time_point loaded_at;  // When it was published
   };
 
   // Initialize with shard configuration
-  DataNode(int shard_id, const std::string& data_file_path);
+  DataNode(int shard_id,
+           const std::string& data_file_path,
+           const DataNodeOptions& options = DataNodeOptions());
+  ~DataNode();
+
+  DataNode(const DataNode&) = delete;
+  DataNode& operator=(const DataNode&) = delete;
 
-  // Load data and build indexes
+  // Load data and build indexes (the first generation, see reload())
   bool initialize();
 
+  // Build a new generation of indexes from the data file (or its snapshot)
+  // and publish it atomically. Searches keep running on the current
+  // generation meanwhile; those in flight when it is replaced finish on it,
+  // and it is freed once the last of them is done. Concurrent reloads are
+  // serialized. Returns the statistics of the generation this call
+  // published, or nothing if the data cannot be loaded, in which case the
+  // current generation keeps being served.
+  std::optional<Statistics> reload();
+
+  // Callback invoked once per matching record
+  using RecordVisitor = std::function<void(const AddressRecordView&)>;
+
+  // Callback invoked once per ranked record, with its relevance score
+  using ScoredRecordVisitor =
+      std::function<void(const AddressRecordView&, double score)>;
+
+  // Callback invoked once per nearby record, with its distance in meters
+  using NearbyRecordVisitor =
+      std::function<void(const AddressRecordView&, double distance_meters)>;
+
+  // No limit on the number of records returned by searchTopK()
+  static constexpr size_t kNoLimit = RadixTreeIndex::kNoLimit;
+
   // Search for addresses matching query terms
   std::vector<AddressRecord> search(const std::vector<std::string>& query_terms);
 
+  // Search for addresses matching query terms, passing each match to the
+  // visitor as a view into the ForwardIndex instead of copying it.
+  // Returns the number of records visited.
+  size_t searchViews(const std::vector<std::string>& query_terms,
+                     const RecordVisitor& visitor);
+
+  // Search and rank matches with RelevanceScorer, visiting only the
+  // max_results best records scoring at least min_score, best first (ties
+  // broken by DocId). Selection uses a bounded heap, so memory stays
+  // O(max_results) however many records match. With fuzziness > 0, each
+  // term may match with up to that many typos (see kMaxFuzziness), and
+  // every typo lowers a record's score. Structured (comma separated)
+  // queries are always matched exactly.
+  // Returns the number of records visited.
+  size_t searchTopK(const std::vector<std::string>& query_terms,
+                    size_t max_results,
+                    double min_score,
+                    const ScoredRecordVisitor& visitor,
+                    int fuzziness = 0);
+
+  // Most typos allowed per query term. Terms shorter than
+  // kMinOneTypoLength are matched exactly, and terms shorter than
+  // kMinTwoTypoLength with at most one typo.
+  static constexpr int kMaxFuzziness = RadixTreeIndex::kMaxFuzzyEdits;
+  static constexpr size_t kMinOneTypoLength = 3;
+  static constexpr size_t kMinTwoTypoLength = 6;
+
+  // Look up exact composite keys (see address_keys.h) in the composite key
+  // index, without walking the radix tree: the records holding the first
+  // of the keys that any record holds are ranked against query_terms like
+  // searchTopK(), and the max_results best are visited, best first.
+  // Returns the number of records visited.
+  size_t lookup(const std::vector<std::string>& keys,
+                const std::vector<std::string>& query_terms,
+                size_t max_results,
+                const ScoredRecordVisitor& visitor);
+
+  // Reverse geocode: visit the max_results records nearest to a point,
+  // closest first (ties broken by DocId), within max_distance_meters
+  // (0 = no limit). With query terms, only records matching all of them
+  // are considered. Returns the number of records visited, 0 if the point
+  // is invalid.
+  size_t searchNearest(const GeoPoint& point,
+                       size_t max_results,
+                       double max_distance_meters,
+                       const std::vector<std::string>& query_terms,
+                       const NearbyRecordVisitor& visitor);
+
+  // Visit up to max_results records inside a box in DocId order. With
+  // query terms, only records matching all of them are considered.
+  // Returns the number of records visited, 0 if the box is invalid.
+  size_t searchBox(const GeoBox& box,
+                   size_t max_results,
+                   const std::vector<std::string>& query_terms,
+                   const RecordVisitor& visitor);
+
+  // One query of a batch, ranked like searchTopK()
+  struct BatchQuery {
+    std::vector<std::string> query_terms;
+    size_t max_results = kNoLimit;
+    double min_score = 0.0;
+    int fuzziness = 0;
+  };
+
+  // Callback invoked once per ranked record of a batch query, with the
+  // query's index in the batch
+  using BatchRecordVisitor = std::function<void(
+      size_t query, const AddressRecordView&, double score)>;
+
+  // Rank many queries at once, each exactly as searchTopK() would. Identical
+  // queries are answered once. The queries are sorted and spread over
+  // worker threads, so each worker fetches the postings of the terms its
+  // queries share only once. The calling thread works through the batch
+  // too, so a call finishes even if every batch_pool worker is busy. The
+  // visitor may run concurrently for different queries; the records of one
+  // query are visited from one thread, best first. Returns the total number
+  // of records visited.
+  size_t searchTopKBatch(const std::vector<BatchQuery>& queries,
+                         const BatchRecordVisitor& visitor);
+
+  // Ranked matches of one query, visited a chunk at a time
+  class RankedCursor;
+
+  // Rank matches exactly like searchTopK(), but hand them out in chunks
+  // through a cursor, e.g. to stream them. Only the ranked IDs are held;
+  // each record is read from the ForwardIndex as its chunk is visited. The
+  // cursor keeps the generation it ranked on alive across reloads.
+  RankedCursor searchRanked(const std::vector<std::string>& query_terms,
+                            size_t max_results,
+                            double min_score,
+                            int fuzziness = 0);
+
   // Get node statistics
   Statistics getStatistics() const;
 
+  // Latency of each stage of the queries served, across generations
+  struct Metrics {
+    LatencyHistogram normalize;       // Normalizing query terms
+    LatencyHistogram trie_lookup;     // Collecting postings from the trie
+    LatencyHistogram key_lookup;      // Exact composite key lookups
+    LatencyHistogram intersection;    // Intersecting the terms' postings
+    LatencyHistogram record_fetch;    // Reading and scoring matched records
+    LatencyHistogram protobuf_build;  // Recorded by the gRPC server
+    Counter queries;
+  };
+
+  // Get the query metrics; recording into them is safe from any thread
+  Metrics& getMetrics() const;
+
  private:
   int shard_id_;
   std::string data_file_path_;
+  DataNodeOptions options_;
 
-  std::unique_ptr<RadixTreeIndex> radix_index_;
-  std::unique_ptr<ForwardIndex> forward_index_;
   std::unique_ptr<AddressNormalizer> normalizer_;
+  std::unique_ptr<Metrics> metrics_;
+
+  // One complete set of indexes and the statistics of its load. A
+  // published generation is never modified (the postings cache synchronizes
+  // itself), so searches read it without locks.
+  struct IndexGeneration {
+    IndexGeneration();
+
+    std::unique_ptr<RadixTreeIndex> radix_index;
+    std::unique_ptr<ForwardIndex> forward_index;
+    std::unique_ptr<SpatialIndex> spatial_index;
+    std::unique_ptr<CompositeKeyIndex> key_index;
+    // Keyed by trie node, so it belongs to one generation; null when
+    // disabled
+    std::unique_ptr<PostingsCache> postings_cache;
+    Statistics stats;
+  };
+
+  // Generation being served, published as a heap-allocated reference that
+  // reload() swaps in with one atomic exchange. Readers copy the reference
+  // without locking; each search holds its copy for as long as it runs.
+  std::atomic<const std::shared_ptr<const IndexGeneration>*> generation_;
+
+  // Epoch-based reclamation of replaced references: a reader registers in
+  // the counter of the current epoch's parity while it copies the
+  // reference, and reload() advances the epoch and waits for the previous
+  // parity's readers to leave before deleting the reference it replaced.
+  // Readers only wait for the epoch they read to still be current.
+  struct alignas(64) ReaderCount {
+    std::atomic<size_t> count{0};
+  };
+  std::atomic<uint64_t> epoch_{0};
+  mutable ReaderCount readers_[2];
+
+  // Serializes reloads
+  std::mutex reload_mutex_;
 
-  Statistics stats_;
+  // Get the generation being served
+  std::shared_ptr<const IndexGeneration> currentGeneration() const;
 
-  // Separator for composite keys
-  static constexpr char KEY_SEPARATOR = '\x01';
+  // Worker threads to use for loading, resolved from options_
+  size_t loadThreadCount() const;
 
-  void buildIndexes(const std::vector<AddressRecord>& records);
-  std::vector<size_t> findMatchingIds(
-      const std::vector<std::string>& query_terms);
+  // Most worker threads to use for one batch, resolved from options_
+  size_t batchThreadCount() const;
 
-  // Generate search keys for an address record
-  std::vector<std::string> generateSearchKeys(const AddressRecord& record);
+  // Fewest distinct queries worth a batch worker thread of their own
+  static constexpr size_t kMinBatchQueriesPerThread = 8;
 
-  // Parse a query string into address components
-  struct ParsedAddress {
-    std::string number;
-    std::string street;
-    std::string city;
-    std::string postcode;
+  // Postings of normalized terms already fetched by one batch worker
+  struct TermMemo {
+    std::unordered_map<std::string, std::vector<DocId>> postings;
+    size_t id_count = 0;  // IDs held, at most kMaxBatchMemoIds
   };
-  ParsedAddress parseQuery(const std::string& query);
+  static constexpr size_t kMaxBatchMemoIds = 1 << 20;
+
+  // A ranked match of searchTopK()
+  struct RankedMatch {
+    double score;
+    DocId id;
+  };
+
+  // Rank matching IDs with RelevanceScorer, keeping the max_results best
+  // scoring at least min_score, best first (ties broken by DocId). edits
+  // holds the typos each ID was matched with, or is empty if all matched
+  // exactly.
+  std::vector<RankedMatch> rankMatches(
+      const IndexGeneration& generation,
+      const std::vector<DocId>& ids,
+      const std::vector<uint8_t>& edits,
+      const std::vector<std::string>& query_terms,
+      size_t max_results,
+      double min_score) const;
+
+  // Load the data file (or its snapshot) into a new generation
+  bool loadGeneration(IndexGeneration& generation);
+
+  // Load a generation from the configured snapshot if it matches the data
+  // file
+  bool loadSnapshot(const SourceFingerprint& source,
+                    IndexGeneration& generation);
+
+  // Save a generation's indexes to the configured snapshot path
+  bool writeSnapshot(const SourceFingerprint& source,
+                     const IndexGeneration& generation);
+
+  // Record memory and load time statistics and log them
+  void finishLoad(IndexGeneration& generation,
+                  Clock::time_point start_time,
+                  const char* stage);
+
+  void buildIndexes(const std::vector<AddressRecord>& records,
+                    IndexGeneration& generation);
+
+  // Get the IDs matching a normalized term in ascending order, through the
+  // memo of a batch worker (if any) and the postings cache when enabled
+  std::vector<DocId> searchSorted(const IndexGeneration& generation,
+                                  const std::string& term,
+                                  TermMemo* memo = nullptr);
+
+  // Get the IDs matching every query term in ascending order (structured
+  // address queries: the matches of the most specific composite key).
+  // With fuzziness > 0, terms may match with typos, and the total typos of
+  // each ID are stored in edits.
+  std::vector<DocId> findMatchingIds(
+      const IndexGeneration& generation,
+      const std::vector<std::string>& query_terms,
+      TermMemo* memo = nullptr,
+      int fuzziness = 0,
+      std::vector<uint8_t>* edits = nullptr);
+
+  // Get the IDs matching every normalized term within its typo allowance
+  // in ascending order, storing the total typos of each in edits
+  std::vector<DocId> findFuzzyMatchingIds(
+      const IndexGeneration& generation,
+      const std::vector<std::string>& normalized_terms,
+      int fuzziness,
+      std::vector<uint8_t>& edits);
+
+  // Generate every term indexed for an address record: the composite
+  // search keys plus the individual normalized fields
+  std::vector<std::string> generateIndexTerms(const AddressRecord& record);
+
+  // Whether a record holds a composite key, to rule out records found by
+  // another key with the same hash
+  bool hasIndexKey(const AddressRecordView& record,
+                   const std::string& key) const;
+};
+
+class DataNode::RankedCursor {
+ public:
+  RankedCursor() = default;
+
+  // Visit up to max_records more records, best first. Returns the number
+  // of records visited, 0 once every match has been visited
+  size_t next(size_t max_records, const ScoredRecordVisitor& visitor);
+
+  // Get the number of matches not visited yet
+  size_t remaining() const;
+
+ private:
+  friend class DataNode;
+
+  std::shared_ptr<const IndexGeneration> generation_;
+  std::vector<RankedMatch> matches_;
+  size_t position_ = 0;
 };
 
 #endif  // DATA_NODE_DATA_NODE_H_
@@ -0,0 +1,9 @@
+#ifndef DATA_NODE_DOC_ID_H_
+#define DATA_NODE_DOC_ID_H_
+
+#include <cstdint>
+
+// Dense internal document ID, assigned by ForwardIndex in insertion order
+using DocId = uint32_t;
+
+#endif  // DATA_NODE_DOC_ID_H_
@@ -1,24 +1,41 @@
 #ifndef DATA_NODE_FORWARD_INDEX_H_
 #define DATA_NODE_FORWARD_INDEX_H_
 
+#include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
 #include "data_node/address_record.h"
+#include "data_node/array_view.h"
+#include "data_node/doc_id.h"
+#include "data_node/index_snapshot.h"
+#include "data_node/string_pool.h"
 
+// Columnar record store addressed by dense DocIds. Fixed-width fields live
+// in parallel arrays and all string fields are interned in a shared,
+// deduplicated StringPool, so a lookup is plain array indexing. The columns
+// can also be served read-only straight from a mapped IndexSnapshot. Const
+// members are safe to call concurrently once all records are inserted.
 class ForwardIndex {
  public:
   ForwardIndex() = default;
 
-  // Store an address record
-  void insert(size_t id, const AddressRecord& record);
+  // Store an address record and return its newly assigned DocId
+  // Throws std::length_error if the DocId space is exhausted, or
+  // std::logic_error if the index was loaded from a snapshot
+  DocId insert(const AddressRecord& record);
 
-  // Retrieve an address record by ID
-  std::optional<AddressRecord> get(size_t id) const;
+  // Retrieve an address record by DocId
+  std::optional<AddressRecord> get(DocId id) const;
 
-  // Check if an ID exists
-  bool contains(size_t id) const;
+  // Retrieve a non-owning view of an address record by DocId, without
+  // copying any string data
+  std::optional<AddressRecordView> getView(DocId id) const;
+
+  // Check if a DocId exists
+  bool contains(DocId id) const;
 
   // Get total storage size (approximate bytes)
   size_t getStorageSize() const;
@@ -26,8 +43,45 @@ class ForwardIndex {
   // Get total number of records
   size_t getRecordCount() const;
 
+  // Add the record columns and string pool to a snapshot
+  void addToSnapshot(SnapshotWriter& writer) const;
+
+  // Serve the index read-only from a snapshot's sections, replacing its
+  // contents. Returns false if the sections are missing or inconsistent
+  bool loadFromSnapshot(std::shared_ptr<const IndexSnapshot> snapshot);
+
  private:
-  std::unordered_map<size_t, AddressRecord> records_;
+  // String fields of a record, in storage order
+  enum StringField {
+    kNumber = 0,
+    kStreet,
+    kUnit,
+    kCity,
+    kPostcode,
+    kOriginalStreet,
+    kOriginalUnit,
+    kOriginalCity,
+    kStringFieldCount
+  };
+
+  // Build storage, used until the index is loaded from a snapshot
+  std::vector<double> longitudes_;
+  std::vector<double> latitudes_;
+  std::vector<uint64_t> hashes_;
+  // kStringFieldCount entries per record, indexed by DocId * count + field
+  std::vector<StringPool::StringId> string_fields_;
+  StringPool strings_;
+
+  // All reads go through these views of either the build storage or the
+  // snapshot, which is kept alive by snapshot_
+  ArrayView<double> longitudes_view_;
+  ArrayView<double> latitudes_view_;
+  ArrayView<uint64_t> hashes_view_;
+  ArrayView<StringPool::StringId> string_fields_view_;
+  std::shared_ptr<const IndexSnapshot> snapshot_;
+
+  std::string_view getString(DocId id, StringField field) const;
+  void syncViews();
 };
 
 #endif  // DATA_NODE_FORWARD_INDEX_H_
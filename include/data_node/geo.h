@@ -0,0 +1,37 @@
+#ifndef DATA_NODE_GEO_H_
+#define DATA_NODE_GEO_H_
+
+// Mean Earth radius used for all distances, in meters
+constexpr double kEarthRadiusMeters = 6371008.8;
+
+// A WGS84 position in degrees
+struct GeoPoint {
+  double longitude = 0.0;
+  double latitude = 0.0;
+
+  // Check that the coordinates are finite and in range
+  bool isValid() const;
+};
+
+// An axis-aligned longitude/latitude rectangle in degrees, edges included.
+// Boxes do not wrap around the antimeridian.
+struct GeoBox {
+  double min_longitude = 0.0;
+  double min_latitude = 0.0;
+  double max_longitude = 0.0;
+  double max_latitude = 0.0;
+
+  // Check that both corners are valid and ordered
+  bool isValid() const;
+
+  bool contains(const GeoPoint& point) const;
+};
+
+// Great-circle (haversine) distance between two points in meters
+double distanceMeters(const GeoPoint& a, const GeoPoint& b);
+
+// Lower bound of the distance in meters from a point to any point in a
+// box, 0 if the box contains it. Pruning by it never drops a closer point.
+double minDistanceMeters(const GeoPoint& point, const GeoBox& box);
+
+#endif  // DATA_NODE_GEO_H_
@@ -0,0 +1,138 @@
+#ifndef DATA_NODE_INDEX_SNAPSHOT_H_
+#define DATA_NODE_INDEX_SNAPSHOT_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "data_node/array_view.h"
+
+// Sections of an index snapshot file
+enum class SnapshotSection : uint32_t {
+  kDataNodeMeta = 1,
+  kRadixMeta,
+  kRadixNodes,
+  kRadixLabels,
+  kRadixPostings,
+  kForwardLongitudes,
+  kForwardLatitudes,
+  kForwardHashes,
+  kForwardStringFields,
+  kStringData,
+  kStringOffsets,
+  kSpatialItems,
+  kSpatialBoxes,
+  kSpatialLevels,
+  kRadixIdCount,
+  kKeyHashes,
+  kKeyOffsets,
+  kKeyIds,
+  kKeyDirectory,
+};
+
+// Identifies the CSV file a snapshot was built from
+struct SourceFingerprint {
+  uint64_t file_size = 0;
+  uint64_t content_hash = 0;
+
+  bool operator==(const SourceFingerprint& other) const {
+    return file_size == other.file_size && content_hash == other.content_hash;
+  }
+
+  // Fingerprint a file's contents; std::nullopt if it cannot be read
+  static std::optional<SourceFingerprint> ofFile(const std::string& path);
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+ public:
+  // Map a file; returns nullptr if it cannot be opened or mapped
+  static std::unique_ptr<MappedFile> open(const std::string& path);
+
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  MappedFile(const char* data, size_t size) : data_(data), size_(size) {}
+
+  const char* data_;
+  size_t size_;
+};
+
+// Writes a versioned snapshot file: a header with the source fingerprint,
+// a table of checksummed sections, then each section 64-byte aligned so
+// it can be used in place once the file is mapped
+class SnapshotWriter {
+ public:
+  // Queue a section; the memory must stay valid until write() returns
+  void addSection(SnapshotSection id, const void* data, size_t size);
+
+  template <typename T>
+  void addArray(SnapshotSection id, ArrayView<T> values) {
+    addSection(id, values.data(), values.size() * sizeof(T));
+  }
+
+  // Write all queued sections to path, replacing any existing file
+  // atomically. Returns false (and logs why) on I/O errors
+  bool write(const std::string& path, const SourceFingerprint& source) const;
+
+ private:
+  struct PendingSection {
+    SnapshotSection id;
+    const void* data;
+    size_t size;
+  };
+  std::vector<PendingSection> sections_;
+};
+
+// A memory-mapped, validated snapshot. Indexes loaded from it keep a
+// shared reference so the mapping lives as long as any of them.
+class IndexSnapshot {
+ public:
+  // Format version; bump whenever the file layout, any section's element
+  // layout, or the terms indexed for a record change
+  static constexpr uint32_t kFormatVersion = 4;
+
+  // Map a snapshot file and validate its header, checksums and source
+  // fingerprint. Returns nullptr (and logs why) if the file is missing,
+  // corrupt, from another format version or built from different data.
+  static std::shared_ptr<const IndexSnapshot> open(
+      const std::string& path, const SourceFingerprint& source);
+
+  // Get a section as an array of T; std::nullopt if the section is missing
+  // or its size is not a multiple of sizeof(T)
+  template <typename T>
+  std::optional<ArrayView<T>> getArray(SnapshotSection id) const {
+    const Section* section = findSection(id);
+    if (section == nullptr || section->size % sizeof(T) != 0) {
+      return std::nullopt;
+    }
+    return ArrayView<T>(reinterpret_cast<const T*>(section->data),
+                        section->size / sizeof(T));
+  }
+
+  // Get the size of the mapped file in bytes
+  size_t getMappedSize() const;
+
+ private:
+  struct Section {
+    SnapshotSection id;
+    const char* data;
+    size_t size;
+  };
+
+  explicit IndexSnapshot(std::unique_ptr<MappedFile> file);
+
+  std::unique_ptr<MappedFile> file_;
+  std::vector<Section> sections_;
+
+  const Section* findSection(SnapshotSection id) const;
+};
+
+#endif  // DATA_NODE_INDEX_SNAPSHOT_H_
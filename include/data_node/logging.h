@@ -0,0 +1,75 @@
+#ifndef DATA_NODE_LOGGING_H_
+#define DATA_NODE_LOGGING_H_
+
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <string>
+
+// Severity of a log line, least severe first
+enum class LogLevel { kDebug, kInfo, kWarning, kError };
+
+// Name of a level as printed in log lines, e.g. "INFO"
+const char* logLevelName(LogLevel level);
+
+// Set the least severe level that is written (kInfo by default). Safe to
+// call while other threads log.
+void setLogLevel(LogLevel level);
+
+// Check if lines of a level are written
+bool isLogEnabled(LogLevel level);
+
+// Parse a level name: DEBUG, INFO, WARN (or WARNING) or ERROR, in any case.
+// Returns std::nullopt for anything else
+std::optional<LogLevel> parseLogLevel(const std::string& name);
+
+// Per-query log lines (request received, results returned, ...) are
+// written for one query in every n, so that logging stops costing
+// throughput under load. 1, the default, logs every query. Safe to call
+// while other threads log.
+void setQueryLogSampling(uint32_t every);
+
+// Decide whether the query starting on this thread is logged and remember
+// the decision for isQueryLogged(). Every query is logged while debug
+// lines are enabled
+bool beginQueryLog();
+
+// Check if the query being served on this thread is logged. True on
+// threads that never called beginQueryLog()
+bool isQueryLogged();
+
+// One log line, built up with << and written when the LogLine is destroyed:
+//
+//   LogLine(LogLevel::kInfo, "DataNode") << "Found " << count << " IDs";
+//
+// writes "[INFO] [DataNode] Found 3 IDs". Debug and info lines go to
+// std::cout, warnings and errors to std::cerr. The line is formatted in a
+// per-thread buffer and handed to the stream in a single unflushed write,
+// so threads logging concurrently neither interleave within a line nor
+// wait on each other's formatting and flushes. Lines below the log level
+// are not formatted at all, nor are lines whose enabled argument is false
+// (per-query lines pass isQueryLogged()). Only one LogLine may be alive per
+// thread.
+class LogLine {
+ public:
+  // component is printed in brackets after the level; may be nullptr
+  LogLine(LogLevel level, const char* component, bool enabled = true);
+  ~LogLine();
+
+  LogLine(const LogLine&) = delete;
+  LogLine& operator=(const LogLine&) = delete;
+
+  template <typename T>
+  LogLine& operator<<(const T& value) {
+    if (stream_ != nullptr) {
+      *stream_ << value;
+    }
+    return *this;
+  }
+
+ private:
+  LogLevel level_;
+  std::ostringstream* stream_;  // Null when the level is disabled
+};
+
+#endif  // DATA_NODE_LOGGING_H_
@@ -0,0 +1,141 @@
+#ifndef DATA_NODE_METRICS_H_
+#define DATA_NODE_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Number of stripes of a LatencyHistogram or Counter. Each thread records
+// into one stripe, so threads rarely share a cache line
+constexpr size_t kMetricStripes = 8;
+
+// Get the stripe of the calling thread (assigned round-robin on first use)
+size_t metricStripe();
+
+// Latency distribution with HDR-style log-linear buckets: 16 buckets per
+// power of two, so a recorded value is known to within 1/16 (6.25%), from
+// 1 ns up to about half an hour (longer values are clamped). Recording is
+// lock-free: each thread increments relaxed atomics of its own stripe.
+// Safe to record and snapshot concurrently; a snapshot taken during
+// recording may miss the values being recorded.
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 4;
+  static constexpr size_t kSubBuckets = size_t{1} << kSubBucketBits;
+  static constexpr int kMaxValueBits = 40;
+  static constexpr size_t kBucketCount =
+      (kMaxValueBits - kSubBucketBits + 2) * kSubBuckets;
+
+  // Merged stripes of a histogram, in nanoseconds
+  struct Snapshot {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    std::vector<uint64_t> buckets;  // kBucketCount counts
+
+    // Value at quantile q (0..1): the upper end of the bucket holding it,
+    // at most max. 0 when empty
+    uint64_t percentile(double q) const;
+
+    // Mean value, 0 when empty
+    double mean() const;
+  };
+
+  LatencyHistogram() = default;
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  // Record one value
+  void record(std::chrono::nanoseconds latency);
+  void recordNanos(uint64_t nanos);
+
+  // Merge the stripes
+  Snapshot snapshot() const;
+
+  // Bucket of a value, and the lowest value of a bucket
+  static size_t bucketOf(uint64_t nanos);
+  static uint64_t bucketLowerBound(size_t bucket);
+
+ private:
+  struct alignas(64) Stripe {
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+  };
+  std::array<Stripe, kMetricStripes> stripes_;
+};
+
+// Monotonic count, striped like LatencyHistogram
+class Counter {
+ public:
+  Counter() = default;
+  Counter(const Counter&) = delete;
+  Counter& operator=(const Counter&) = delete;
+
+  void add(uint64_t amount = 1) {
+    stripes_[metricStripe()].value.fetch_add(amount,
+                                             std::memory_order_relaxed);
+  }
+
+  uint64_t value() const;
+
+ private:
+  struct alignas(64) Stripe {
+    std::atomic<uint64_t> value{0};
+  };
+  std::array<Stripe, kMetricStripes> stripes_;
+};
+
+// Records the time from its construction to its destruction (or to
+// stop()) into a histogram
+class ScopedLatency {
+ public:
+  explicit ScopedLatency(LatencyHistogram& histogram)
+      : histogram_(&histogram), start_(std::chrono::steady_clock::now()) {}
+  ~ScopedLatency() { stop(); }
+
+  ScopedLatency(const ScopedLatency&) = delete;
+  ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+  // Record now instead of at destruction
+  void stop() {
+    if (histogram_ != nullptr) {
+      histogram_->record(std::chrono::steady_clock::now() - start_);
+      histogram_ = nullptr;
+    }
+  }
+
+ private:
+  LatencyHistogram* histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Prometheus text exposition format (version 0.0.4). Families are written
+// as a header followed by their samples; labels are given preformatted,
+// e.g. "stage=\"parse\"", or empty.
+
+// Append the # HELP and # TYPE lines of a metric family
+void appendPrometheusHeader(std::string& out,
+                            const std::string& name,
+                            const char* type,
+                            const std::string& help);
+
+// Append a histogram as summary samples in seconds: the 0.5, 0.9, 0.99
+// and 0.999 quantiles, _sum and _count
+void appendPrometheusSummary(std::string& out,
+                             const std::string& name,
+                             const std::string& labels,
+                             const LatencyHistogram::Snapshot& snapshot);
+
+// Append one sample of a counter or gauge
+void appendPrometheusSample(std::string& out,
+                            const std::string& name,
+                            const std::string& labels,
+                            double value);
+
+#endif  // DATA_NODE_METRICS_H_
@@ -0,0 +1,25 @@
+#ifndef DATA_NODE_POSTING_INTERSECTION_H_
+#define DATA_NODE_POSTING_INTERSECTION_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "data_node/array_view.h"
+#include "data_node/doc_id.h"
+
+// Size ratio from which intersectSorted() gallops through the longer list
+// instead of merging both lists linearly
+constexpr size_t kGallopRatio = 8;
+
+// Find the first position at or after begin where ids[position] >= target,
+// probing 1, 2, 4, ... elements ahead and then binary searching the last
+// step. Costs O(log distance) rather than O(distance).
+size_t gallopTo(ArrayView<DocId> ids, size_t begin, DocId target);
+
+// Replace out with the IDs present in both ascending lists, in ascending
+// order. out must not alias either input.
+void intersectSorted(ArrayView<DocId> a,
+                     ArrayView<DocId> b,
+                     std::vector<DocId>& out);
+
+#endif  // DATA_NODE_POSTING_INTERSECTION_H_
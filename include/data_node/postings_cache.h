@@ -0,0 +1,94 @@
+#ifndef DATA_NODE_POSTINGS_CACHE_H_
+#define DATA_NODE_POSTINGS_CACHE_H_
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "data_node/doc_id.h"
+
+// Adaptive cache of the sorted, deduplicated ID lists of hot RadixTreeIndex
+// nodes, stored delta/varint-compressed within a memory budget. A node is
+// admitted once it has been looked up kAdmitLookups times (counted in a
+// small, periodically halved frequency table) and its list holds at least
+// kMinIds IDs, so only lists that are both reused and expensive to
+// re-collect take space. Least recently used lists are evicted first.
+// Safe to use concurrently.
+class PostingsCache {
+ public:
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t admissions;
+    uint64_t evictions;
+    size_t entries;
+    size_t bytes;
+    size_t max_bytes;
+  };
+
+  // Smallest list worth caching; shorter ones are cheap to re-collect
+  static constexpr size_t kMinIds = 64;
+
+  // Lookups within the current aging window before a list is admitted
+  static constexpr uint8_t kAdmitLookups = 2;
+
+  explicit PostingsCache(size_t max_bytes);
+
+  PostingsCache(const PostingsCache&) = delete;
+  PostingsCache& operator=(const PostingsCache&) = delete;
+
+  // Look up the IDs of a node, counting the access towards admission.
+  // Returns true and replaces ids with the cached list on a hit
+  bool lookup(uint32_t node, std::vector<DocId>& ids);
+
+  // Offer the IDs collected for a node after a miss; they are cached if the
+  // node is hot, the list is long enough and it fits the budget
+  void offer(uint32_t node, const std::vector<DocId>& ids);
+
+  // Get hit/miss counters and memory use
+  Stats getStats() const;
+
+  // Compress an ascending ID list: the first ID and then the gaps between
+  // neighbours, each as a little-endian base-128 varint
+  static std::vector<uint8_t> encode(const std::vector<DocId>& ids);
+
+  // Decompress a list produced by encode, replacing ids
+  static void decode(const std::vector<uint8_t>& encoded,
+                     size_t count,
+                     std::vector<DocId>& ids);
+
+ private:
+  struct Entry {
+    uint32_t node;
+    size_t count;
+    std::shared_ptr<const std::vector<uint8_t>> encoded;
+  };
+
+  // Saturating access counters indexed by node, halved every
+  // kAgingInterval accesses so that admission follows recent traffic
+  static constexpr size_t kFrequencySlots = 4096;
+  static constexpr size_t kAgingInterval = 8 * kFrequencySlots;
+
+  const size_t max_bytes_;
+
+  mutable std::mutex mutex_;
+  std::list<Entry> lru_;  // Most recently used first
+  std::unordered_map<uint32_t, std::list<Entry>::iterator> index_;
+  size_t bytes_;
+  std::array<uint8_t, kFrequencySlots> frequency_;
+  size_t accesses_since_aging_;
+
+  uint64_t hits_;
+  uint64_t misses_;
+  uint64_t admissions_;
+  uint64_t evictions_;
+
+  // Bytes an entry is charged against the budget
+  static size_t chargeOf(const Entry& entry);
+};
+
+#endif  // DATA_NODE_POSTINGS_CACHE_H_
@@ -1,19 +1,125 @@
 #ifndef DATA_NODE_RADIX_TREE_INDEX_H_
 #define DATA_NODE_RADIX_TREE_INDEX_H_
 
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "data_node/array_view.h"
+#include "data_node/doc_id.h"
+#include "data_node/index_snapshot.h"
+
+// Prefix index from terms to the sorted IDs of the documents containing
+// them. Built with insert() or buildFrom(), then usually frozen into a
+// flattened, compressed read-only layout. Once built, any number of threads
+// may call the const members concurrently: searches only read the index
+// and keep their scratch state per thread. Building, merging, freezing and
+// loading must not overlap with any other call.
 class RadixTreeIndex {
  public:
   RadixTreeIndex();
 
-  // Insert a term associated with an address ID
-  void insert(const std::string& term, size_t address_id);
+  // The frozen views may point into the object's own storage
+  RadixTreeIndex(const RadixTreeIndex&) = delete;
+  RadixTreeIndex& operator=(const RadixTreeIndex&) = delete;
+
+  // Insert a term associated with a document ID. IDs are expected to be dense
+  // (as assigned by ForwardIndex): search keeps a bitset over the ID space.
+  // Throws std::logic_error if the index has been frozen
+  void insert(const std::string& term, DocId doc_id);
+
+  // A term and one document it occurs in, as passed to buildFrom()
+  struct TermPosting {
+    std::string term;
+    DocId id;
+  };
+
+  // Order postings by term, then by ID, as buildFrom() expects
+  static bool postingLess(const TermPosting& a, const TermPosting& b);
+
+  // Replace the contents with a tree built from postings sorted by
+  // postingLess(), in one pass: each node's IDs are appended in order and
+  // children are created in label order, so nothing is searched or
+  // re-sorted. Adjacent duplicates and empty terms are skipped. The result
+  // is the same tree as inserting every distinct posting.
+  // Throws std::logic_error if the index is frozen and std::invalid_argument
+  // if the postings are not sorted
+  void buildFrom(const std::vector<TermPosting>& postings);
+
+  // No limit on the number of IDs returned by search()
+  static constexpr size_t kNoLimit = std::numeric_limits<size_t>::max();
+
+  // Search for all document IDs matching the prefix. Each ID is returned
+  // once, in deterministic order, at O(subtree + results) cost. Collection
+  // stops early once max_results IDs have been found.
+  std::vector<DocId> search(const std::string& prefix,
+                            size_t max_results = kNoLimit) const;
+
+  // Search for all document IDs matching the longest of several prefixes of
+  // a key that matches anything, as search() returns them for that prefix.
+  // The trie is descended once along the key, noting the node each prefix
+  // ends on, so falling back to a shorter prefix costs no further walk.
+  // prefix_lengths must be ascending, non-zero and at most the key's
+  // length. matched_length, if given, is set to the length of the prefix
+  // searched, 0 if none matches
+  std::vector<DocId> searchLongestPrefix(
+      std::string_view key,
+      ArrayView<size_t> prefix_lengths,
+      size_t* matched_length = nullptr) const;
+
+  // Search for all document IDs matching the prefix, in ascending order and
+  // each ID once, as needed to intersect the results of several terms
+  std::vector<DocId> searchSorted(const std::string& prefix) const;
+
+  // Keep the candidates (ascending, unique) that match the prefix, in
+  // ascending order: the intersection of candidates with
+  // searchSorted(prefix). Once frozen, only the postings blocks that may
+  // hold a candidate are decoded, so filtering a few candidates through a
+  // popular term costs far less than collecting the term's postings.
+  std::vector<DocId> filterSorted(const std::string& prefix,
+                                  const std::vector<DocId>& candidates) const;
+
+  // A document matched by searchFuzzy(), with the fewest edits any of its
+  // terms needed
+  struct FuzzyMatch {
+    DocId id;
+    uint8_t edits;
+  };
+
+  // Most edits searchFuzzy() allows
+  static constexpr int kMaxFuzzyEdits = 2;
+
+  // Search for all document IDs with a term starting within max_edits
+  // Levenshtein edits (insertions, deletions, substitutions) of the prefix,
+  // in ascending order, each ID once with the fewest edits it needed. The
+  // trie is walked in lockstep with the prefix's edit distance automaton,
+  // pruning every edge no match can lie under, so only the paths within
+  // max_edits of the prefix are visited, never the whole index. max_edits
+  // is clamped to 0..kMaxFuzzyEdits and below the prefix length; 0 is a
+  // plain prefix search.
+  std::vector<FuzzyMatch> searchFuzzy(const std::string& prefix,
+                                      int max_edits) const;
+
+  // Estimate how many IDs search(prefix) returns: the number of postings
+  // under the matching node, which counts an ID once per matching term.
+  // O(prefix length) once frozen. Returns 0 exactly when nothing matches.
+  size_t estimateCount(const std::string& prefix) const;
+
+  // Node-level access for callers that cache results per trie node, in the
+  // frozen layout only. Every prefix ending on or inside the same node's
+  // edge matches the same IDs.
+  static constexpr size_t kNoNode = std::numeric_limits<size_t>::max();
+
+  // Get the node a prefix search collects from, or kNoNode if nothing
+  // matches or the index is not frozen
+  size_t findPrefixNode(const std::string& prefix) const;
 
-  // Search for all address IDs matching the prefix
-  std::vector<size_t> search(const std::string& prefix) const;
+  // Get all IDs under a node returned by findPrefixNode(), in ascending
+  // order and each ID once
+  std::vector<DocId> collectSorted(size_t node) const;
 
   // Get memory usage statistics
   size_t getMemoryUsage() const;
@@ -21,30 +127,145 @@ class RadixTreeIndex {
   // Get total number of indexed terms
   size_t getTermCount() const;
 
+  // Move all terms of another index into this one. The indexes must not
+  // share any first term character, so each top-level edge comes from one
+  // of them (e.g. when a build is sharded by first character); the result
+  // is the same tree as inserting every term into a single index.
+  // Throws std::logic_error if either index is frozen or they overlap
+  void mergeDisjoint(RadixTreeIndex&& other);
+
+  // Convert the pointer-based build tree into the flattened read-only layout
+  // (one node array, one edge label pool, one shared postings pool of
+  // compressed blocks) and release the build tree. Search results are
+  // identical in both layouts.
+  void freeze();
+
+  // IDs per compressed postings block of the flattened layout
+  static constexpr size_t kPostingsBlockIds = 128;
+
+  // Check if the index has been frozen into the flattened layout
+  bool isFrozen() const;
+
+  // Add the flattened layout to a snapshot
+  // Throws std::logic_error if the index is not frozen
+  void addToSnapshot(SnapshotWriter& writer) const;
+
+  // Serve the index frozen and read-only from a snapshot's sections,
+  // replacing its contents. Returns false if the sections are missing or
+  // do not form a valid flattened tree
+  bool loadFromSnapshot(std::shared_ptr<const IndexSnapshot> snapshot);
+
  private:
   struct RadixNode {
     std::string edge_label;
-    std::vector<size_t> address_ids;
+    std::vector<DocId> doc_ids;
     std::vector<std::unique_ptr<RadixNode>> children;
 
     RadixNode() = default;
     explicit RadixNode(const std::string& label) : edge_label(label) {}
   };
 
+  // Node of the flattened layout. Nodes are stored in pre-order, so the
+  // descendants of node i occupy [i + 1, subtree_end) and the first child
+  // (if any) is i + 1. Postings are laid out in the same pre-order, so the
+  // IDs of a whole subtree form one contiguous range of the ID sequence,
+  // and node i's own IDs and encoded bytes end where node i + 1's begin.
+  //
+  // A node's ascending IDs are stored in blocks of kPostingsBlockIds, each
+  // ID as the varint gap from its predecessor. A node with more than one
+  // block starts its bytes with a PostingsSkip for every block after the
+  // first, so any block can be decoded without the ones before it.
+  struct FlatNode {
+    uint32_t label_offset;
+    uint16_t label_length;
+    char first_char;
+    uint32_t subtree_end;
+    uint32_t postings_begin;  // Position of this node's first ID
+    uint32_t bytes_begin;     // Start of this node's encoded postings
+  };
+
+  // Start of a postings block after the first; byte_offset is relative to
+  // the node's bytes_begin
+  struct PostingsSkip {
+    DocId first_id;
+    uint32_t byte_offset;
+  };
+
+  // Accumulates unique IDs for a single search, up to a limit
+  struct IdCollector;
+
+  // Edit distance rows and matches of one searchFuzzy() walk
+  struct FuzzyWalk;
+
   std::unique_ptr<RadixNode> root_;
   size_t term_count_;
 
+  // Flattened layout, populated by freeze()
+  bool frozen_;
+  std::vector<FlatNode> flat_nodes_;
+  std::string label_pool_;
+  std::vector<uint8_t> postings_pool_;
+  size_t id_count_;  // IDs in the postings pool
+
+  // Frozen searches read through these views of either the flattened
+  // arrays or a snapshot, which is kept alive by snapshot_
+  ArrayView<FlatNode> nodes_view_;
+  std::string_view labels_view_;
+  ArrayView<uint8_t> postings_view_;
+  std::shared_ptr<const IndexSnapshot> snapshot_;
+
   void insertHelper(RadixNode* node,
                     const std::string& term,
-                    size_t address_id,
+                    DocId doc_id,
                     size_t depth);
-  void searchHelper(const RadixNode* node,
-                    const std::string& prefix,
-                    std::vector<size_t>& results,
-                    size_t depth) const;
-  void collectAllIds(const RadixNode* node,
-                     std::vector<size_t>& results) const;
+  // Find the node whose subtree holds every term starting with prefix, or
+  // nullptr if there is none
+  const RadixNode* findNode(const std::string& prefix) const;
+  // Find the node of the longest of several prefixes of a key that has one,
+  // as searchLongestPrefix() does; nullptr if none has
+  const RadixNode* findLongestNode(std::string_view key,
+                                   ArrayView<size_t> prefix_lengths,
+                                   size_t& matched_length) const;
+  bool collectAllIds(const RadixNode* node, IdCollector& collector) const;
+  // Walk a node's edge and subtree for searchFuzzy(); depth is the length of
+  // the path above the edge and best the fewest edits matched along it
+  void fuzzyWalkNode(const RadixNode* node,
+                     FuzzyWalk& walk,
+                     size_t depth,
+                     uint8_t best) const;
   size_t getMemoryUsageHelper(const RadixNode* node) const;
+
+  void flattenHelper(const RadixNode* node);
+  // Flattened counterpart of findNode(): the index of the matching node, or
+  // kNoNode
+  size_t findFlatNode(const std::string& prefix) const;
+  // Flattened counterpart of findLongestNode()
+  size_t findLongestFlatNode(std::string_view key,
+                             ArrayView<size_t> prefix_lengths,
+                             size_t& matched_length) const;
+  void searchFlat(const std::string& prefix, IdCollector& collector) const;
+  void collectFlat(size_t node, IdCollector& collector) const;
+  void fuzzyWalkFlat(size_t node,
+                     FuzzyWalk& walk,
+                     size_t depth,
+                     uint8_t best) const;
+
+  // Position of a flat node's first ID and first encoded byte; for the
+  // node count, the ends of the last node's
+  size_t postingsBeginOf(size_t node) const;
+  size_t bytesBeginOf(size_t node) const;
+
+  // Append block `block` of a flat node's count IDs to out
+  void decodeBlock(size_t node,
+                   size_t count,
+                   size_t block,
+                   std::vector<DocId>& out) const;
+
+  // Mark the candidates found among a flat node's own IDs
+  void markCandidates(size_t node,
+                      const std::vector<DocId>& candidates,
+                      std::vector<bool>& found,
+                      std::vector<DocId>& buffer) const;
 };
 
 #endif  // DATA_NODE_RADIX_TREE_INDEX_H_
@@ -0,0 +1,31 @@
+#ifndef DATA_NODE_RELEVANCE_SCORER_H_
+#define DATA_NODE_RELEVANCE_SCORER_H_
+
+#include <string>
+#include <vector>
+
+#include "data_node/address_record.h"
+
+// Relevance scoring shared by the data nodes (which rank their own matches
+// before returning them) and the gateway (which merges the per-shard
+// results). Both sides score the raw query terms against the same record
+// fields, so a record gets the same score wherever it is ranked.
+class RelevanceScorer {
+ public:
+  explicit RelevanceScorer(const std::vector<std::string>& query_terms);
+
+  // Score a record against the query terms (higher = more relevant)
+  double score(const AddressRecordView& record) const;
+
+  // Score a record matched with this many typos in total; each typo scales
+  // the score by kEditFactor, so it stays positive, fuzzy matches rank below
+  // exact ones and fewer typos above more
+  double score(const AddressRecordView& record, int edits) const;
+
+  static constexpr double kEditFactor = 0.5;
+
+ private:
+  std::vector<std::string> query_terms_;
+};
+
+#endif  // DATA_NODE_RELEVANCE_SCORER_H_
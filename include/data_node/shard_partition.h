@@ -0,0 +1,53 @@
+#ifndef DATA_NODE_SHARD_PARTITION_H_
+#define DATA_NODE_SHARD_PARTITION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Assignment of address records to shards, shared by the shard builder
+// (which splits the data) and the gateway (which routes lookups that can
+// only match one shard). A record's routing key is hashed onto the shards
+// with jump consistent hashing, so going from n to n + 1 shards moves only
+// about 1 / (n + 1) of the records.
+class ShardPartition {
+ public:
+  // Routing key of a record
+  enum class Key {
+    kHash,      // The record's HASH field
+    kPostcode,  // The normalized postcode (the HASH field if it is empty)
+  };
+
+  ShardPartition(size_t shard_count, Key key);
+
+  // Parse a key name ("hash" or "postcode")
+  static std::optional<Key> parseKey(const std::string& name);
+  static const char* keyName(Key key);
+
+  size_t shardCount() const { return shard_count_; }
+  Key key() const { return key_; }
+
+  // Get the shard of a record from its hash and normalized postcode
+  size_t shardFor(size_t hash, std::string_view normalized_postcode) const;
+
+  // Get the only shard that can hold the record with this hash, if records
+  // are partitioned by hash
+  std::optional<size_t> shardForHash(size_t hash) const;
+
+  // Get the only shard that can hold records with this normalized
+  // postcode, if records are partitioned by postcode
+  std::optional<size_t> shardForPostcode(
+      std::string_view normalized_postcode) const;
+
+  // Map a key onto one of bucket_count buckets (Lamping and Veach's jump
+  // consistent hash)
+  static uint32_t jumpConsistentHash(uint64_t key, uint32_t bucket_count);
+
+ private:
+  size_t shard_count_;
+  Key key_;
+};
+
+#endif  // DATA_NODE_SHARD_PARTITION_H_
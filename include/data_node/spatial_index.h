@@ -0,0 +1,89 @@
+#ifndef DATA_NODE_SPATIAL_INDEX_H_
+#define DATA_NODE_SPATIAL_INDEX_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "data_node/array_view.h"
+#include "data_node/doc_id.h"
+#include "data_node/geo.h"
+#include "data_node/index_snapshot.h"
+
+// Static packed R-tree over record coordinates. Points are sorted along a
+// Hilbert curve and packed kNodeSize to a leaf; each upper level packs
+// kNodeSize boxes of the level below, up to a single root. The tree is a
+// few flat arrays, so it can also be served read-only from a snapshot.
+// Queries are safe to run concurrently once the tree is built.
+class SpatialIndex {
+ public:
+  // Children per node
+  static constexpr size_t kNodeSize = 16;
+
+  // A record found by nearest(), with its distance from the query point
+  struct Neighbor {
+    DocId id;
+    double distance_meters;
+  };
+
+  SpatialIndex() = default;
+
+  // The views may point into the object's own storage
+  SpatialIndex(const SpatialIndex&) = delete;
+  SpatialIndex& operator=(const SpatialIndex&) = delete;
+
+  // Build the tree over points[id] for every DocId, replacing its contents.
+  // Points with invalid coordinates are left out.
+  void build(const std::vector<GeoPoint>& points);
+
+  // Get the IDs of all points inside the box, in ascending order
+  std::vector<DocId> searchBox(const GeoBox& box) const;
+
+  // Get the max_results points nearest to a point, closest first (ties by
+  // DocId), within max_distance_meters (0 = no limit). Best-first search
+  // visits only nodes that could still hold a closer point.
+  std::vector<Neighbor> nearest(const GeoPoint& point,
+                                size_t max_results,
+                                double max_distance_meters = 0.0) const;
+
+  // Get number of indexed points
+  size_t size() const;
+
+  // Get memory usage (approximate bytes)
+  size_t getMemoryUsage() const;
+
+  // Add the tree to a snapshot
+  void addToSnapshot(SnapshotWriter& writer) const;
+
+  // Serve the tree read-only from a snapshot's sections, replacing its
+  // contents. Returns false if the sections are missing or inconsistent
+  bool loadFromSnapshot(std::shared_ptr<const IndexSnapshot> snapshot);
+
+ private:
+  struct Item {
+    GeoPoint point;
+    DocId id;
+    uint32_t hilbert;  // Position along the curve, used while building
+  };
+
+  // Build storage, used until the index is loaded from a snapshot
+  std::vector<Item> items_;          // Leaf entries in Hilbert order
+  std::vector<GeoBox> boxes_;        // Node boxes, leaves level first
+  std::vector<uint32_t> levels_;     // Start of each level in boxes_, then
+                                     // boxes_.size()
+
+  // All reads go through these views of either the build storage or the
+  // snapshot, which is kept alive by snapshot_
+  ArrayView<Item> items_view_;
+  ArrayView<GeoBox> boxes_view_;
+  ArrayView<uint32_t> levels_view_;
+  std::shared_ptr<const IndexSnapshot> snapshot_;
+
+  // Get the range of children of a node: items for leaves (level 0),
+  // otherwise boxes of the level below
+  void childRange(size_t level, size_t node, size_t& begin, size_t& end) const;
+
+  void syncViews();
+};
+
+#endif  // DATA_NODE_SPATIAL_INDEX_H_
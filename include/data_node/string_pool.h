@@ -0,0 +1,85 @@
+#ifndef DATA_NODE_STRING_POOL_H_
+#define DATA_NODE_STRING_POOL_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "data_node/array_view.h"
+#include "data_node/index_snapshot.h"
+
+// Append-only pool of deduplicated strings stored back to back in a single
+// buffer. Each distinct string is addressed by a dense 32-bit ID. A pool
+// can also be served read-only straight from a mapped IndexSnapshot. Const
+// members are safe to call concurrently while nothing is being interned.
+class StringPool {
+ public:
+  using StringId = uint32_t;
+
+  // ID of the empty string, which is always present
+  static constexpr StringId kEmptyStringId = 0;
+
+  StringPool();
+
+  // The lookup table refers back to the pool, so it cannot be copied or moved
+  StringPool(const StringPool&) = delete;
+  StringPool& operator=(const StringPool&) = delete;
+
+  // Add a string to the pool, returning the ID of the existing copy if the
+  // same string was interned before
+  // Throws std::length_error if the pool would exceed 32-bit offsets, or
+  // std::logic_error if the pool was loaded from a snapshot
+  StringId intern(std::string_view text);
+
+  // Get the string for an ID (valid until the next intern call)
+  std::string_view get(StringId id) const;
+
+  // Get number of distinct strings in the pool
+  size_t size() const;
+
+  // Get memory usage (approximate bytes)
+  size_t getMemoryUsage() const;
+
+  // Add the pool's string data and offsets to a snapshot
+  void addToSnapshot(SnapshotWriter& writer) const;
+
+  // Serve the pool read-only from a snapshot's sections, replacing its
+  // contents. Returns false (leaving the pool unchanged) if the sections
+  // are missing or inconsistent
+  bool loadFromSnapshot(std::shared_ptr<const IndexSnapshot> snapshot);
+
+ private:
+  // Hashes and compares string IDs by their content. The special kProbeId
+  // refers to probe_, which lets intern() look up a string_view without
+  // first copying it into the pool.
+  static constexpr StringId kProbeId = UINT32_MAX;
+
+  struct IdHash {
+    const StringPool* pool;
+    size_t operator()(StringId id) const;
+  };
+  struct IdEqual {
+    const StringPool* pool;
+    bool operator()(StringId a, StringId b) const;
+  };
+
+  // Build storage, used until the pool is loaded from a snapshot
+  std::string data_;
+  std::vector<uint32_t> offsets_;  // offsets_[id] .. offsets_[id + 1]
+  std::string_view probe_;
+  std::unordered_set<StringId, IdHash, IdEqual> lookup_;
+
+  // All reads go through these views of either the build storage or the
+  // snapshot, which is kept alive by snapshot_
+  std::string_view data_view_;
+  ArrayView<uint32_t> offsets_view_;
+  std::shared_ptr<const IndexSnapshot> snapshot_;
+
+  std::string_view resolve(StringId id) const;
+  void syncViews();
+};
+
+#endif  // DATA_NODE_STRING_POOL_H_
@@ -0,0 +1,42 @@
+#ifndef DATA_NODE_THREAD_POOL_H_
+#define DATA_NODE_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running submitted tasks in submission order.
+// The destructor runs every task still queued, then joins the workers.
+// Safe to use concurrently.
+class ThreadPool {
+ public:
+  // Start thread_count workers (0 = one per hardware thread)
+  explicit ThreadPool(size_t thread_count);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Queue a task for a worker. Tasks must not throw
+  void submit(std::function<void()> task);
+
+  // Get the number of worker threads
+  size_t getThreadCount() const;
+
+  // Get the number of tasks waiting for a worker
+  size_t getQueuedTaskCount() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::condition_variable task_ready_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_;
+  std::vector<std::thread> workers_;
+
+  void workerLoop();
+};
+
+#endif  // DATA_NODE_THREAD_POOL_H_
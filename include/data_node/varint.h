@@ -0,0 +1,36 @@
+#ifndef DATA_NODE_VARINT_H_
+#define DATA_NODE_VARINT_H_
+
+#include <cstdint>
+#include <vector>
+
+// Little-endian base-128 varints, as used for compressed postings: seven
+// bits per byte, the high bit set on every byte but the last. Gaps between
+// nearby IDs take one or two bytes instead of four.
+
+// Largest encoded size of a 32-bit value
+constexpr size_t kMaxVarintBytes = 5;
+
+inline void appendVarint(uint32_t value, std::vector<uint8_t>& out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+// Decode the varint at in and advance in past it. The input must hold a
+// complete varint.
+inline uint32_t readVarint(const uint8_t*& in) {
+  uint32_t value = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    byte = *in++;
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return value;
+}
+
+#endif  // DATA_NODE_VARINT_H_
@@ -2,26 +2,67 @@
 #define GATEWAY_SERVER_H
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <crow.h>
 #include <grpcpp/grpcpp.h>
 
 #include "data_node.grpc.pb.h"
+#include "data_node/address_normalizer.h"
+#include "data_node/concurrency_limiter.h"
+#include "data_node/metrics.h"
+#include "data_node/shard_partition.h"
+#include "health.grpc.pb.h"
+#include "gateway/query_cache.h"
 
-// Configuration for a single data node endpoint
+// Configuration for a single data node endpoint. Endpoints sharing a
+// shard_id are replicas serving the same shard
 struct DataNodeConfig {
   std::string address;  // e.g., "localhost:50051"
   int shard_id;
 };
 
+// How the replica of a shard answering a call is chosen
+enum class ReplicaSelection {
+  kLeastOutstanding,  // Fewest calls in flight
+  kEwmaLatency,       // Lowest recent latency, weighted by calls in flight
+};
+
 // Configuration for the gateway server
 struct GatewayConfig {
   int http_port;                          // HTTP server port (default: 18080)
   std::vector<DataNodeConfig> data_nodes; // List of data node endpoints
   int grpc_timeout_ms;                    // gRPC call timeout in milliseconds
+  int completion_queue_threads = 2;       // Threads completing data node calls
+  QueryCacheConfig query_cache;           // Cache of ranked responses
+  bool stream_search = false;             // Merge SearchStream results
+  int channels_per_replica = 1;           // gRPC connections to each replica
+  ReplicaSelection replica_selection = ReplicaSelection::kLeastOutstanding;
+  // Send a shard's call to a second replica once it has taken longer than
+  // this percentile of the shard's recent calls (0 = never hedge)
+  double hedge_percentile = 95.0;
+  // Interval of the health checks ejecting failed replicas (0 = only eject
+  // replicas whose calls fail, until they answer a call again)
+  int health_check_interval_ms = 1000;
+  // Routing key the shards were split by (see ShardPartition), with shard
+  // IDs 0 .. n-1; unset if records may be on any shard
+  std::optional<ShardPartition::Key> partition_key;
+  // Admission of the API requests that call the data nodes; those over the
+  // limit wait up to admission.max_queue_wait, then get a 503
+  ConcurrencyLimiterConfig admission;
+  // Time budget of an API request, shared by its wait for admission and
+  // its data node calls (0 = grpc_timeout_ms)
+  int request_timeout_ms = 0;
+  int http_threads = 0;  // Threads serving HTTP requests (0 = Crow default)
 };
 
 // Result from a single data node
@@ -30,6 +71,15 @@ struct DataNodeResult {
   bool success;
   std::string error_message;
   std::vector<datanode::AddressRecord> records;
+  std::vector<double> distances;  // Per record, for ReverseGeocode calls
+  // Per record, the relevance score the data node ranked it by, for search
+  // calls; empty if the data node did not send them
+  std::vector<double> scores;
+  bool overloaded = false;  // Timed out, or shed by a saturated data node
+
+  // For BatchSearch calls: the records of query i are
+  // records[query_offsets[i] .. query_offsets[i + 1])
+  std::vector<size_t> query_offsets;
 };
 
 // Scored address record for ranking
@@ -44,8 +94,53 @@ struct ScoredAddressRecord {
   }
 };
 
+// Address record with its distance from a reverse geocoding point
+struct NearbyAddressRecord {
+  datanode::AddressRecord record;
+  int shard_id;
+  double distance_meters;
+};
+
+// Crow middleware recording the latency, count and errors of each API
+// endpoint's requests. It also decides, before the handler runs on the same
+// thread, whether the request's per-query lines are logged.
+struct RequestMetrics {
+  // Metrics of one endpoint
+  struct Endpoint {
+    LatencyHistogram latency;
+    Counter requests;
+    Counter errors;  // Responses with a 4xx or 5xx status
+  };
+
+  // Keyed by URL path; only filled in before the server starts, so
+  // handlers read it without locking. Other paths are not recorded.
+  std::map<std::string, std::unique_ptr<Endpoint>> endpoints;
+
+  struct context {
+    std::chrono::steady_clock::time_point start_time;
+  };
+
+  void before_handle(crow::request& req, crow::response& res, context& ctx);
+  void after_handle(crow::request& req, crow::response& res, context& ctx);
+};
+
 class GatewayServer {
  public:
+  // Number of ranked results returned by /api/findAddress
+  static constexpr size_t kMaxResults = 5;
+
+  // Default and largest number of results of the spatial endpoints
+  static constexpr size_t kDefaultGeoResults = 10;
+  static constexpr size_t kMaxGeoResults = 100;
+
+  // Most typos per term a /api/findAddress request may allow
+  static constexpr int kMaxFuzziness = 2;
+
+  // Most addresses in one /api/findAddressBatch request, and the number of
+  // them sent to the data nodes per BatchSearch call
+  static constexpr size_t kMaxBatchQueries = 1000;
+  static constexpr size_t kBatchChunkQueries = 100;
+
   // Constructor with configuration
   explicit GatewayServer(const GatewayConfig& config);
 
@@ -64,49 +159,261 @@ class GatewayServer {
   // Check if shutdown has been requested
   bool isShutdownRequested() const;
 
+  // Get the query result cache counters
+  QueryCache::Stats getQueryCacheStats() const;
+
+  // Get the admission control limit and counters
+  ConcurrencyLimiter::Stats getAdmissionStats() const;
+
+  // Get the ID of the only shard that can hold the record with this hash,
+  // if the shards were split by hash; lookups of one record then need only
+  // that shard
+  std::optional<int> shardForHash(size_t hash) const;
+
+  // Render the metrics served by /metrics in the Prometheus text format:
+  // per-stage, per-shard, per-replica and per-endpoint latencies, replica
+  // health, hedging and failover counters, request counters, admission
+  // control and the query cache counters
+  std::string renderMetrics();
+
+  // Add the echoed query to a rendered /api/findAddress payload, which is
+  // cached without it because equivalent queries share an entry
+  static std::string addQueryToPayload(const std::string& query,
+                                       const std::string& payload);
+
+  // Split a request's address text into data node query terms: a
+  // structured address (with commas) stays one term, otherwise it is split
+  // on whitespace
+  static std::vector<std::string> splitQueryTerms(const std::string& address);
+
+  // Merge the ReverseGeocode results of all data nodes into the
+  // max_results nearest records, closest first, dropping duplicates
+  static std::vector<NearbyAddressRecord> mergeByDistance(
+      const std::vector<DataNodeResult>& results,
+      size_t max_results);
+
+  // Aggregate and rank results from multiple data nodes by the scores the
+  // data nodes sent, scoring only records that came without one; drop
+  // duplicates keeping the best score and return the max_results best
+  static std::vector<ScoredAddressRecord> aggregateAndRankResults(
+      const std::vector<DataNodeResult>& results,
+      const std::vector<std::string>& query_terms,
+      size_t max_results = kMaxResults);
+
  private:
   // Configuration
   GatewayConfig config_;
 
   // Crow HTTP server
-  crow::SimpleApp app_;
+  crow::App<RequestMetrics> app_;
 
-  // gRPC channels and stubs for each data node (connection pooling)
-  struct DataNodeConnection {
-    std::shared_ptr<grpc::Channel> channel;
-    std::unique_ptr<datanode::DataNodeService::Stub> stub;
+  // One data node serving a shard, reached over a pool of channels that
+  // each hold their own HTTP/2 connection
+  struct Replica {
     DataNodeConfig config;
+    std::vector<std::shared_ptr<grpc::Channel>> channels;
+    std::vector<std::unique_ptr<datanode::DataNodeService::Stub>> stubs;
+    std::unique_ptr<grpc::health::v1::Health::Stub> health_stub;
+    std::atomic<size_t> next_stub{0};       // Round-robin over stubs
+    std::atomic<int> outstanding{0};        // Calls and streams in flight
+    std::atomic<double> ewma_latency_ms{0.0};
+    std::atomic<bool> healthy{true};
+    LatencyHistogram rpc_latency;           // Calls and streams
+
+    // Next stub of the channel pool
+    datanode::DataNodeService::Stub& stub();
   };
-  std::vector<DataNodeConnection> connections_;
+
+  // A shard and the replicas serving it
+  struct Shard {
+    int shard_id;
+    std::vector<std::unique_ptr<Replica>> replicas;
+    LatencyHistogram rpc_latency;  // All replicas, for the hedge delay
+    // Age at which a call is hedged, refreshed from rpc_latency by the
+    // maintenance thread (0 = not hedging)
+    std::atomic<int64_t> hedge_delay_ns{0};
+    std::atomic<size_t> next_replica{0};  // Rotates ties between replicas
+    LatencyHistogram::Snapshot hedge_baseline;  // Maintenance thread only
+    Counter hedged_calls;
+    Counter failovers;
+    Counter routed_lookups;           // Structured queries sent here alone
+    Counter routed_lookup_fallbacks;  // Of those, broadcast after a miss
+  };
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // Partition of the records over shards_, set by initialize() when the
+  // configured partition matches the shards
+  std::optional<ShardPartition> partition_;
+
+  // Normalizes structured queries into composite keys, as the data nodes do
+  AddressNormalizer normalizer_;
+
+  // Health checks and hedge delay updates, every health_check_interval_ms
+  std::thread maintenance_thread_;
+  std::mutex maintenance_mutex_;
+  std::condition_variable maintenance_wakeup_;
+  bool stop_maintenance_ = false;
+
+  // Latency of the stages of a search request
+  struct StageMetrics {
+    LatencyHistogram parse;       // Reading and validating the request
+    LatencyHistogram fan_out;     // All data node calls, first to last
+    LatencyHistogram merge_rank;  // Merging the data nodes' results
+    LatencyHistogram serialize;   // Rendering the JSON response
+  };
+  StageMetrics stage_metrics_;
 
   // Shutdown flag
   std::atomic<bool> shutdown_requested_;
 
+  // Ranked responses of recent queries, served without querying data nodes
+  QueryCache query_cache_;
+
+  // Caps the API requests calling the data nodes at once
+  ConcurrencyLimiter admission_;
+
+  // Data node calls are issued asynchronously on one shared completion
+  // queue and completed by a fixed set of polling threads
+  struct QueueTag;     // Completion queue tag: a call or a hedge timer
+  struct PendingCall;  // One in-flight data node call
+  template <typename Request, typename Response>
+  struct TypedCall;    // PendingCall of one RPC method
+  struct HedgeTimer;   // Fires when a shard's call is due to be hedged
+  struct ShardCalls;   // The calls of one request to one shard
+  struct FanOut;       // Gathers the calls of one request to all shards
+  grpc::CompletionQueue completion_queue_;
+
+  // Stub method starting an asynchronous call of an RPC method
+  template <typename Request, typename Response>
+  using PrepareCall =
+      std::unique_ptr<grpc::ClientAsyncResponseReader<Response>> (
+          datanode::DataNodeService::Stub::*)(grpc::ClientContext*,
+                                              const Request&,
+                                              grpc::CompletionQueue*);
+  std::vector<std::thread> completion_threads_;
+
+  // Poll the completion queue until it is shut down and drained
+  void pollCompletionQueue();
+
+  // Shut down the completion queue and wait for the polling threads
+  void stopCompletionQueue();
+
+  // Check the replicas' health and refresh the hedge delays until stopped
+  void runMaintenance();
+  void stopMaintenance();
+
+  // Check every replica in parallel, ejecting those that do not report
+  // SERVING and restoring those that do
+  void checkReplicaHealth();
+
+  // Set each replicated shard's hedge delay to the hedge_percentile of its
+  // calls since the last update
+  void updateHedgeDelays();
+
+  // Pick the replica of a shard to call, skipping those already tried:
+  // healthy replicas first, then by the configured ReplicaSelection.
+  // nullptr once every replica has been tried
+  Replica* pickReplica(Shard& shard, const std::vector<const Replica*>& tried);
+
+  // Record the outcome of a finished call or stream on its replica
+  void recordReplicaCall(Shard& shard,
+                         Replica& replica,
+                         std::chrono::steady_clock::duration elapsed,
+                         const grpc::Status& status,
+                         bool cancelled);
+
   // Setup HTTP routes
   void setupRoutes();
 
-  // Query a single data node via gRPC
-  DataNodeResult queryDataNode(const DataNodeConnection& connection,
-                                const std::vector<std::string>& query_terms);
+  // Time budget of an API request
+  std::chrono::milliseconds requestTimeout() const;
+
+  // Deadline of a data node call started now: grpc_timeout_ms, cut short
+  // by the deadline of the admitted API request the calling thread serves
+  std::chrono::system_clock::time_point callDeadline() const;
+
+  // Start an asynchronous call to a replica of shard index; its result
+  // may land in fan_out.results[index]. Called with fan_out.mutex held
+  template <typename Request, typename Response>
+  void startDataNodeCall(Replica& replica,
+                         const Request& request,
+                         PrepareCall<Request, Response> prepare,
+                         FanOut& fan_out,
+                         size_t index);
+
+  // Start another call of a fan-out's request to a replica of shard index,
+  // or record the shard as failed if it cannot be started. Called with
+  // fan_out.mutex held
+  bool startShardCall(FanOut& fan_out, size_t index, Replica& replica);
+
+  // Settle shard index of a fan-out with its result, cancelling its other
+  // calls and its hedge timer. Called with fan_out.mutex held
+  void finishShard(FanOut& fan_out, size_t index, DataNodeResult result);
+
+  // Convert a completed call into a DataNodeResult
+  DataNodeResult finishDataNodeCall(const PendingCall& call, bool ok);
+
+  // Handle a completed call: the first success of a shard settles it; a
+  // failure fails over to another replica if no other call is in flight
+  void completeCall(std::unique_ptr<PendingCall> call, bool ok);
 
-  // Query all data nodes in parallel
+  // Handle a fired (ok) or cancelled hedge timer
+  void completeHedgeTimer(HedgeTimer& timer, bool ok);
+
+  // Send the same request to one replica of every shard (or of the shards
+  // at the given indexes of shards_) in parallel without a thread per call,
+  // hedging slow calls and failing over failed ones to other replicas, and
+  // wait until every shard called has a result. Results are in the order
+  // the shards were called.
+  template <typename Request, typename Response>
+  std::vector<DataNodeResult> fanOut(const Request& request,
+                                     PrepareCall<Request, Response> prepare,
+                                     std::vector<size_t> targets = {});
+
+  // The two halves of fanOut(), so that several requests can be in flight
+  // at once: start the calls, then wait for them and collect the results
+  template <typename Request, typename Response>
+  void startFanOut(const Request& request,
+                   PrepareCall<Request, Response> prepare,
+                   FanOut& fan_out,
+                   std::vector<size_t> targets = {});
+  std::vector<DataNodeResult> finishFanOut(FanOut& fan_out);
+
+  // Look a structured query up by its most specific composite key on the
+  // only shard that can hold it, if the shards are partitioned by postcode
+  // and the key includes one. Returns that shard's result if it found any
+  // records; otherwise std::nullopt, and the query must be broadcast,
+  // which also matches prefixes and less specific keys.
+  std::optional<DataNodeResult> lookupOnOwningShard(
+      const std::vector<std::string>& query_terms,
+      size_t max_results);
+
+  // Search all data nodes for their max_results best matches
   std::vector<DataNodeResult> queryAllDataNodes(
-      const std::vector<std::string>& query_terms);
+      const std::vector<std::string>& query_terms,
+      size_t max_results,
+      int fuzziness = 0);
 
-  // Aggregate and rank results from multiple data nodes
-  std::vector<ScoredAddressRecord> aggregateAndRankResults(
-      const std::vector<DataNodeResult>& results,
+  // Search all data nodes with SearchStream, merging the streams best
+  // first (a k-way merge on the shards' scores) until max_results distinct
+  // records are found, then cancelling the remaining streams. Each node's
+  // result holds the records merged from it.
+  struct ShardStream;  // One data node's SearchStream call
+  std::vector<DataNodeResult> streamAllDataNodes(
       const std::vector<std::string>& query_terms,
-      size_t max_results = 5);
+      size_t max_results,
+      int fuzziness = 0);
 
-  // Calculate relevance score for an address record
-  double calculateRelevanceScore(
-      const datanode::AddressRecord& record,
-      const std::vector<std::string>& query_terms);
+  // Search all data nodes for the max_results best matches of each query,
+  // in BatchSearch calls of up to kBatchChunkQueries queries that are all
+  // in flight together. Element i holds the per-node results of query i.
+  std::vector<std::vector<DataNodeResult>> queryAllDataNodesBatch(
+      const std::vector<std::vector<std::string>>& queries,
+      size_t max_results);
 
   // Check if two address records are duplicates
-  bool isDuplicate(const datanode::AddressRecord& a,
-                   const datanode::AddressRecord& b);
+  static bool isDuplicate(const datanode::AddressRecord& a,
+                          const datanode::AddressRecord& b);
 };
 
 #endif // GATEWAY_SERVER_H
@@ -0,0 +1,57 @@
+#ifndef GATEWAY_JSON_WRITER_H
+#define GATEWAY_JSON_WRITER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Direct JSON rendering for the hot HTTP responses, appending to a caller's
+// (usually reused) buffer instead of building a crow::json::wvalue tree.
+// Values are formatted byte for byte as crow::json::wvalue::dump() formats
+// them, so responses keep their format whichever way they are rendered.
+
+// Append a quoted, escaped JSON string
+void appendJsonString(std::string& out, std::string_view value);
+
+// Append a JSON number: integers in full, doubles with six decimals less
+// their trailing zeros (at least one is kept), non-finite doubles as null
+void appendJsonNumber(std::string& out, double value);
+void appendJsonNumber(std::string& out, int64_t value);
+void appendJsonNumber(std::string& out, uint64_t value);
+
+// The members of a flat JSON object, read in one pass without copying: keys
+// and values are views into the parsed text, which must outlive the object.
+// Only the common shape of small request bodies is handled: an object of at
+// most kMaxMembers strings without escape sequences, numbers, true, false
+// or null. Anything else, valid JSON or not, fails to parse, and callers
+// fall back to crow::json::load
+class FlatJsonObject {
+ public:
+  static constexpr size_t kMaxMembers = 8;
+
+  enum class Type { kString, kNumber, kLiteral };
+
+  struct Member {
+    std::string_view key;
+    std::string_view value;  // A string's contents without the quotes
+    Type type;
+  };
+
+  // Read the members of an object, false if it does not have the handled
+  // shape. Repeated keys are not handled
+  bool parse(std::string_view text);
+
+  // Get a member, nullptr if there is none with this key
+  const Member* find(std::string_view key) const;
+
+  // Get the value of a kNumber member
+  static double toNumber(const Member& member);
+
+ private:
+  std::array<Member, kMaxMembers> members_;
+  size_t size_ = 0;
+};
+
+#endif  // GATEWAY_JSON_WRITER_H
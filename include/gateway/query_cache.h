@@ -0,0 +1,102 @@
+#ifndef GATEWAY_QUERY_CACHE_H
+#define GATEWAY_QUERY_CACHE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Configuration for the gateway's query result cache
+struct QueryCacheConfig {
+  size_t max_bytes = 64 * 1024 * 1024;  // Total size limit; 0 disables it
+  std::chrono::milliseconds ttl{30000};  // How long an entry stays valid
+  size_t shard_count = 16;               // Independently locked LRU shards
+};
+
+// Bounded cache of rendered /api/findAddress payloads keyed by query.
+// Keys are spread over shards that each keep their own LRU list, byte
+// budget and lock, so concurrent requests rarely contend. Safe to use
+// concurrently.
+class QueryCache {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;    // Entries dropped to stay within max_bytes
+    uint64_t expirations;  // Entries dropped because their TTL passed
+    size_t entries;
+    size_t bytes;
+  };
+
+  explicit QueryCache(const QueryCacheConfig& config);
+
+  // Check if the cache stores anything at all
+  bool isEnabled() const;
+
+  // Get the payload cached for a key, or nullptr if there is no live entry
+  std::shared_ptr<const std::string> get(const std::string& key,
+                                         Clock::time_point now = Clock::now());
+
+  // Cache a payload, replacing any entry for the key and evicting the least
+  // recently used entries of its shard as needed. Payloads too large for a
+  // shard are not cached.
+  void put(const std::string& key,
+           std::string payload,
+           Clock::time_point now = Clock::now());
+
+  // Get hit/miss counters and current size
+  Stats getStats() const;
+
+  // Build the cache key for the query terms the gateway derived from a
+  // request. Requests that differ only in whitespace between words split
+  // into the same terms and share an entry. Case is kept because ranking is
+  // case-sensitive, and everything the payload echoes besides the raw query
+  // comes from the terms. Fuzzy queries (fuzziness > 0) get keys of their
+  // own.
+  static std::string makeKey(const std::vector<std::string>& query_terms,
+                             int fuzziness = 0);
+
+  // Approximate bytes an entry costs beyond its key and payload
+  static constexpr size_t kEntryOverhead = 128;
+
+ private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const std::string> payload;
+    Clock::time_point expires_at;
+    size_t charge;  // Bytes counted against the shard budget
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::list<Entry> lru;  // Most recently used first
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+    size_t bytes = 0;
+  };
+
+  QueryCacheConfig config_;
+  size_t shard_capacity_;  // Byte budget of each shard
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<uint64_t> insertions_{0};
+  std::atomic<uint64_t> evictions_{0};
+  std::atomic<uint64_t> expirations_{0};
+
+  Shard& shardFor(const std::string& key);
+
+  // Remove an entry; the shard's lock must be held
+  void erase(Shard& shard, std::list<Entry>::iterator entry);
+};
+
+#endif  // GATEWAY_QUERY_CACHE_H
@@ -0,0 +1,164 @@
+#include "data_node/address_keys.h"
+
+#include <initializer_list>
+
+namespace {
+
+// Whitespace as std::isspace classifies it in the "C" locale
+bool isSpace(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+std::string_view trim(std::string_view text) {
+  while (!text.empty() && isSpace(text.front())) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && isSpace(text.back())) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+// Join normalized address fields into one composite key
+std::string joinKey(std::initializer_list<const std::string*> fields) {
+  size_t length = fields.size() - 1;
+  for (const std::string* field : fields) {
+    length += field->size();
+  }
+  std::string key;
+  key.reserve(length);
+  for (const std::string* field : fields) {
+    if (field != *fields.begin()) {
+      key.push_back(kKeySeparator);
+    }
+    key.append(*field);
+  }
+  return key;
+}
+
+}  // namespace
+
+bool isStructuredQuery(const std::vector<std::string>& query_terms) {
+  return query_terms.size() == 1 &&
+         query_terms[0].find(',') != std::string::npos;
+}
+
+ParsedAddress parseStructuredQuery(std::string_view query) {
+  // Expected format: "number street, city, postcode" or variations. Empty
+  // parts (between adjacent commas) are skipped; blank ones are kept empty
+  ParsedAddress parsed;
+  size_t part_count = 0;
+  size_t part_begin = 0;
+  while (part_begin <= query.size() && part_count < 3) {
+    size_t part_end = query.find(',', part_begin);
+    if (part_end == std::string_view::npos) {
+      part_end = query.size();
+    }
+    if (part_end > part_begin) {
+      std::string_view part =
+          trim(query.substr(part_begin, part_end - part_begin));
+      if (part_count == 0) {
+        // The first token is the number, the rest of the part the street
+        size_t token_end = 0;
+        while (token_end < part.size() && !isSpace(part[token_end])) {
+          token_end++;
+        }
+        parsed.number = part.substr(0, token_end);
+        parsed.street = trim(part.substr(token_end));
+      } else if (part_count == 1) {
+        parsed.city = part;
+      } else {
+        parsed.postcode = part;
+      }
+      part_count++;
+    }
+    part_begin = part_end + 1;
+  }
+  return parsed;
+}
+
+void appendIndexKeys(const std::string& number,
+                     const std::string& street,
+                     const std::string& city,
+                     const std::string& postcode,
+                     std::vector<std::string>& keys) {
+  // Generate composite keys with different combinations
+  // Key 1: number + separator + street + separator + city
+  if (!number.empty() && !street.empty() && !city.empty()) {
+    keys.push_back(joinKey({&number, &street, &city}));
+  }
+
+  // Key 2: number + separator + street
+  if (!number.empty() && !street.empty()) {
+    keys.push_back(joinKey({&number, &street}));
+  }
+
+  // Key 3: number + separator + street + separator + city + separator + postcode
+  if (!number.empty() && !street.empty() && !city.empty() &&
+      !postcode.empty()) {
+    keys.push_back(joinKey({&number, &street, &city, &postcode}));
+  }
+}
+
+StructuredQueryKeys structuredQueryKeys(const std::string& query,
+                                        const AddressNormalizer& normalizer) {
+  StructuredQueryPlan plan(query, normalizer);
+  StructuredQueryKeys result;
+  result.postcode = plan.postcode();
+  result.has_postcode_key = plan.hasPostcodeKey();
+
+  // Most specific key first
+  ArrayView<size_t> key_lengths = plan.keyLengths();
+  for (size_t i = key_lengths.size(); i > 0; --i) {
+    result.keys.emplace_back(plan.key().substr(0, key_lengths[i - 1]));
+  }
+  return result;
+}
+
+StructuredQueryPlan::StructuredQueryPlan(std::string_view query,
+                                         const AddressNormalizer& normalizer) {
+  ParsedAddress parsed = parseStructuredQuery(query);
+
+  // The fields are disjoint parts of the query and never grow when
+  // normalized, so the query's length bounds the key's but for separators
+  char* buffer = inline_buffer_;
+  if (query.size() > kInlineQueryLength) {
+    long_buffer_.resize(query.size() + 3);
+    buffer = long_buffer_.data();
+  }
+  buffer_ = buffer;
+
+  // Write every field, each key ending where its last field does
+  size_t length = normalizer.normalizeTo(parsed.number, buffer);
+  bool has_number = length > 0;
+  buffer[length++] = kKeySeparator;
+  size_t street_length = normalizer.normalizeTo(parsed.street, buffer + length);
+  length += street_length;
+  if (has_number && street_length > 0) {
+    key_lengths_[key_count_++] = length;
+  }
+
+  buffer[length++] = kKeySeparator;
+  size_t city_length = normalizer.normalizeTo(parsed.city, buffer + length);
+  length += city_length;
+  if (key_count_ == 1 && city_length > 0) {
+    key_lengths_[key_count_++] = length;
+  }
+
+  buffer[length++] = kKeySeparator;
+  postcode_begin_ = length;
+  postcode_length_ = normalizer.normalizeTo(parsed.postcode, buffer + length);
+  length += postcode_length_;
+  if (key_count_ == 2 && postcode_length_ > 0) {
+    key_lengths_[key_count_++] = length;
+  }
+}
+
+std::string_view StructuredQueryPlan::key() const {
+  return std::string_view(buffer_,
+                          key_count_ == 0 ? 0 : key_lengths_[key_count_ - 1]);
+}
+
+std::string_view StructuredQueryPlan::postcode() const {
+  return std::string_view(buffer_ + postcode_begin_, postcode_length_);
+}
@@ -1,129 +1,138 @@
 #include "data_node/address_normalizer.h"
 
-#include <algorithm>
-#include <cctype>
-#include <sstream>
-#include <vector>
-
-AddressNormalizer::AddressNormalizer() {
-  // Initialize suffix map with common abbreviations
-  suffix_map_["ST"] = "STREET";
-  suffix_map_["AVE"] = "AVENUE";
-  suffix_map_["RD"] = "ROAD";
-  suffix_map_["BLVD"] = "BOULEVARD";
-  suffix_map_["DR"] = "DRIVE";
-  suffix_map_["LN"] = "LANE";
-  suffix_map_["CT"] = "COURT";
-  suffix_map_["PL"] = "PLACE";
-  suffix_map_["CIR"] = "CIRCLE";
-  suffix_map_["WAY"] = "WAY";
-  suffix_map_["PKWY"] = "PARKWAY";
-  suffix_map_["TER"] = "TERRACE";
-  suffix_map_["SQ"] = "SQUARE";
-  suffix_map_["HWY"] = "HIGHWAY";
-  suffix_map_["EXPY"] = "EXPRESSWAY";
+#include <array>
+#include <cstdint>
+
+namespace {
+
+// Per-byte uppercase mapping and whitespace class, matching std::toupper and
+// std::isspace in the "C" locale
+struct CharTable {
+  std::array<char, 256> upper{};
+  std::array<bool, 256> space{};
+};
+
+constexpr CharTable buildCharTable() {
+  CharTable table;
+  for (int c = 0; c < 256; ++c) {
+    table.upper[c] = static_cast<char>(c >= 'a' && c <= 'z' ? c - 'a' + 'A'
+                                                            : c);
+    table.space[c] = c == ' ' || (c >= '\t' && c <= '\r');
+  }
+  return table;
 }
 
-std::string AddressNormalizer::normalize(const std::string& text) {
-  // Apply normalization steps in order:
-  // 1. Convert to uppercase
-  // 2. Trim leading/trailing whitespace
-  // 3. Collapse multiple spaces to single space
-  std::string result = toUpperCase(text);
-  result = trimWhitespace(result);
-  result = collapseWhitespace(result);
-  return result;
-}
+constexpr CharTable kCharTable = buildCharTable();
 
-std::string AddressNormalizer::normalizeStreetSuffix(const std::string& street) {
-  // First apply general normalization
-  std::string normalized = normalize(street);
+// Common abbreviations and their standard forms
+struct Suffix {
+  std::string_view abbreviation;
+  std::string_view expansion;
+};
 
-  // Split the street into words
-  std::istringstream iss(normalized);
-  std::vector<std::string> words;
-  std::string word;
+constexpr Suffix kSuffixes[] = {
+    {"ST", "STREET"},     {"AVE", "AVENUE"},    {"RD", "ROAD"},
+    {"BLVD", "BOULEVARD"}, {"DR", "DRIVE"},      {"LN", "LANE"},
+    {"CT", "COURT"},      {"PL", "PLACE"},      {"CIR", "CIRCLE"},
+    {"WAY", "WAY"},       {"PKWY", "PARKWAY"},  {"TER", "TERRACE"},
+    {"SQ", "SQUARE"},     {"HWY", "HIGHWAY"},   {"EXPY", "EXPRESSWAY"},
+};
 
-  while (iss >> word) {
-    words.push_back(word);
-  }
+constexpr size_t kSuffixCount = sizeof(kSuffixes) / sizeof(kSuffixes[0]);
 
-  // If there are no words, return empty string
-  if (words.empty()) {
-    return normalized;
-  }
+// Perfect hash over kSuffixes: every abbreviation lands in its own slot, so
+// a lookup is one hash and one comparison
+constexpr size_t kSuffixSlots = 32;
 
-  // Check if the last word is a known abbreviation
-  std::string& last_word = words.back();
-  auto it = suffix_map_.find(last_word);
-  if (it != suffix_map_.end()) {
-    last_word = it->second;
-  }
+constexpr size_t suffixHash(std::string_view word) {
+  return (static_cast<unsigned char>(word.front()) * 5u +
+          static_cast<unsigned char>(word.back()) * 28u + word.size()) %
+         kSuffixSlots;
+}
 
-  // Reconstruct the street name
-  std::ostringstream oss;
-  for (size_t i = 0; i < words.size(); ++i) {
-    if (i > 0) {
-      oss << " ";
+struct SuffixTable {
+  std::array<int8_t, kSuffixSlots> slots{};  // Index into kSuffixes, or -1
+  bool collision_free = true;
+};
+
+constexpr SuffixTable buildSuffixTable() {
+  SuffixTable table;
+  for (size_t slot = 0; slot < kSuffixSlots; ++slot) {
+    table.slots[slot] = -1;
+  }
+  for (size_t i = 0; i < kSuffixCount; ++i) {
+    size_t slot = suffixHash(kSuffixes[i].abbreviation);
+    if (table.slots[slot] != -1) {
+      table.collision_free = false;
     }
-    oss << words[i];
+    table.slots[slot] = static_cast<int8_t>(i);
   }
-
-  return oss.str();
+  return table;
 }
 
-std::string AddressNormalizer::toUpperCase(const std::string& text) {
-  std::string result = text;
-  std::transform(result.begin(), result.end(), result.begin(),
-                 [](unsigned char c) { return std::toupper(c); });
+constexpr SuffixTable kSuffixTable = buildSuffixTable();
+static_assert(kSuffixTable.collision_free,
+              "suffixHash must map every abbreviation to its own slot");
+
+}  // namespace
+
+std::string AddressNormalizer::normalize(std::string_view text) const {
+  std::string result;
+  normalizeInto(text, result);
   return result;
 }
 
-std::string AddressNormalizer::trimWhitespace(const std::string& text) {
-  if (text.empty()) {
-    return text;
-  }
-
-  size_t start = 0;
-  size_t end = text.length();
+void AddressNormalizer::normalizeInto(std::string_view text,
+                                      std::string& out) const {
+  out.resize(text.size());
+  out.resize(normalizeTo(text, out.data()));
+}
 
-  // Find first non-whitespace character
-  while (start < end && std::isspace(static_cast<unsigned char>(text[start]))) {
-    ++start;
+size_t AddressNormalizer::normalizeTo(std::string_view text, char* out) const {
+  // Uppercase, trim and collapse whitespace in a single pass: whitespace is
+  // only written as one separator once the next word starts
+  size_t length = 0;
+  bool pending_space = false;
+  for (char c : text) {
+    unsigned char byte = static_cast<unsigned char>(c);
+    if (kCharTable.space[byte]) {
+      pending_space = true;
+      continue;
+    }
+    if (pending_space && length > 0) {
+      out[length++] = ' ';
+    }
+    pending_space = false;
+    out[length++] = kCharTable.upper[byte];
   }
+  return length;
+}
 
-  // Find last non-whitespace character
-  while (end > start &&
-         std::isspace(static_cast<unsigned char>(text[end - 1]))) {
-    --end;
+std::string AddressNormalizer::normalizeStreetSuffix(
+    std::string_view street) const {
+  // After normalization the words are separated by single spaces, so the
+  // last word is everything after the last space
+  std::string normalized = normalize(street);
+  size_t last_word_begin = normalized.rfind(' ');
+  last_word_begin =
+      last_word_begin == std::string::npos ? 0 : last_word_begin + 1;
+
+  std::string_view expansion = expandSuffix(
+      std::string_view(normalized).substr(last_word_begin));
+  if (!expansion.empty()) {
+    normalized.replace(last_word_begin, std::string::npos, expansion.data(),
+                       expansion.size());
   }
-
-  return text.substr(start, end - start);
+  return normalized;
 }
 
-std::string AddressNormalizer::collapseWhitespace(const std::string& text) {
-  if (text.empty()) {
-    return text;
+std::string_view AddressNormalizer::expandSuffix(std::string_view word) {
+  if (word.empty()) {
+    return {};
   }
-
-  std::string result;
-  result.reserve(text.length());
-
-  bool prev_was_space = false;
-
-  for (char c : text) {
-    bool is_space = std::isspace(static_cast<unsigned char>(c));
-
-    if (is_space) {
-      if (!prev_was_space) {
-        result += ' ';
-        prev_was_space = true;
-      }
-    } else {
-      result += c;
-      prev_was_space = false;
-    }
+  int8_t index = kSuffixTable.slots[suffixHash(word)];
+  if (index < 0 || kSuffixes[index].abbreviation != word) {
+    return {};
   }
-
-  return result;
+  return kSuffixes[index].expansion;
 }
@@ -0,0 +1,165 @@
+#include "data_node/composite_key_index.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+uint64_t CompositeKeyIndex::hashKey(std::string_view key) {
+  // FNV-1a, then the splitmix64 finalizer: the directory is addressed by
+  // the top bits, which FNV-1a alone leaves poorly mixed for short keys
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : key) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ull;
+  }
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9ull;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111ebull;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+void CompositeKeyIndex::build(std::vector<KeyPosting> postings) {
+  std::sort(postings.begin(), postings.end(),
+            [](const KeyPosting& a, const KeyPosting& b) {
+              return a.key_hash != b.key_hash ? a.key_hash < b.key_hash
+                                              : a.id < b.id;
+            });
+  postings.erase(std::unique(postings.begin(), postings.end(),
+                             [](const KeyPosting& a, const KeyPosting& b) {
+                               return a.key_hash == b.key_hash &&
+                                      a.id == b.id;
+                             }),
+                 postings.end());
+  if (postings.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::length_error("Too many composite key postings");
+  }
+
+  snapshot_.reset();
+  hashes_.clear();
+  offsets_.clear();
+  ids_.clear();
+  ids_.reserve(postings.size());
+  for (const KeyPosting& posting : postings) {
+    if (hashes_.empty() || hashes_.back() != posting.key_hash) {
+      hashes_.push_back(posting.key_hash);
+      offsets_.push_back(static_cast<uint32_t>(ids_.size()));
+    }
+    ids_.push_back(posting.id);
+  }
+  offsets_.push_back(static_cast<uint32_t>(ids_.size()));
+
+  // About one directory slot per key keeps each slot's scan short
+  directory_bits_ = 0;
+  while (directory_bits_ < kMaxDirectoryBits &&
+         (size_t{1} << directory_bits_) < hashes_.size()) {
+    directory_bits_++;
+  }
+  size_t slot_count = size_t{1} << directory_bits_;
+  directory_.assign(slot_count + 1, 0);
+  size_t next = 0;
+  for (size_t slot = 0; slot <= slot_count; ++slot) {
+    while (next < hashes_.size() && slotOf(hashes_[next]) < slot) {
+      next++;
+    }
+    directory_[slot] = static_cast<uint32_t>(next);
+  }
+
+  syncViews();
+}
+
+size_t CompositeKeyIndex::slotOf(uint64_t hash) const {
+  return directory_bits_ == 0 ? 0 : hash >> (64 - directory_bits_);
+}
+
+ArrayView<DocId> CompositeKeyIndex::lookup(std::string_view key) const {
+  if (hashes_view_.empty()) {
+    return {};
+  }
+  uint64_t hash = hashKey(key);
+  size_t slot = slotOf(hash);
+  for (size_t i = directory_view_[slot]; i < directory_view_[slot + 1]; ++i) {
+    if (hashes_view_[i] == hash) {
+      return ArrayView<DocId>(ids_view_.data() + offsets_view_[i],
+                              offsets_view_[i + 1] - offsets_view_[i]);
+    }
+    if (hashes_view_[i] > hash) {
+      break;
+    }
+  }
+  return {};
+}
+
+size_t CompositeKeyIndex::size() const {
+  return hashes_view_.size();
+}
+
+size_t CompositeKeyIndex::getMemoryUsage() const {
+  return hashes_view_.size() * sizeof(uint64_t) +
+         offsets_view_.size() * sizeof(uint32_t) +
+         ids_view_.size() * sizeof(DocId) +
+         directory_view_.size() * sizeof(uint32_t);
+}
+
+void CompositeKeyIndex::addToSnapshot(SnapshotWriter& writer) const {
+  writer.addArray(SnapshotSection::kKeyHashes, hashes_view_);
+  writer.addArray(SnapshotSection::kKeyOffsets, offsets_view_);
+  writer.addArray(SnapshotSection::kKeyIds, ids_view_);
+  writer.addArray(SnapshotSection::kKeyDirectory, directory_view_);
+}
+
+bool CompositeKeyIndex::loadFromSnapshot(
+    std::shared_ptr<const IndexSnapshot> snapshot) {
+  auto hashes = snapshot->getArray<uint64_t>(SnapshotSection::kKeyHashes);
+  auto offsets = snapshot->getArray<uint32_t>(SnapshotSection::kKeyOffsets);
+  auto ids = snapshot->getArray<DocId>(SnapshotSection::kKeyIds);
+  auto directory =
+      snapshot->getArray<uint32_t>(SnapshotSection::kKeyDirectory);
+  if (!hashes || !offsets || !ids || !directory ||
+      offsets->size() != hashes->size() + 1 || (*offsets)[0] != 0 ||
+      (*offsets)[hashes->size()] != ids->size() || directory->size() < 2) {
+    return false;
+  }
+
+  // The directory must have a power of two slots, and every range must be
+  // in order
+  size_t slot_count = directory->size() - 1;
+  if ((slot_count & (slot_count - 1)) != 0 || (*directory)[0] != 0 ||
+      (*directory)[slot_count] != hashes->size()) {
+    return false;
+  }
+  for (size_t i = 1; i < offsets->size(); ++i) {
+    if ((*offsets)[i] <= (*offsets)[i - 1]) {
+      return false;
+    }
+  }
+  for (size_t slot = 1; slot < directory->size(); ++slot) {
+    if ((*directory)[slot] < (*directory)[slot - 1]) {
+      return false;
+    }
+  }
+
+  std::vector<uint64_t>().swap(hashes_);
+  std::vector<uint32_t>().swap(offsets_);
+  std::vector<DocId>().swap(ids_);
+  std::vector<uint32_t>().swap(directory_);
+  hashes_view_ = *hashes;
+  offsets_view_ = *offsets;
+  ids_view_ = *ids;
+  directory_view_ = *directory;
+  directory_bits_ = 0;
+  while ((size_t{1} << directory_bits_) < slot_count) {
+    directory_bits_++;
+  }
+  snapshot_ = std::move(snapshot);
+  return true;
+}
+
+void CompositeKeyIndex::syncViews() {
+  hashes_view_ = ArrayView<uint64_t>(hashes_);
+  offsets_view_ = ArrayView<uint32_t>(offsets_);
+  ids_view_ = ArrayView<DocId>(ids_);
+  directory_view_ = ArrayView<uint32_t>(directory_);
+}
@@ -0,0 +1,144 @@
+#include "data_node/concurrency_limiter.h"
+
+#include <algorithm>
+#include <utility>
+
+ConcurrencyLimiter::Permit::~Permit() {
+  if (limiter_ != nullptr) {
+    limiter_->release(*this);
+  }
+}
+
+ConcurrencyLimiter::Permit::Permit(Permit&& other) noexcept
+    : limiter_(std::exchange(other.limiter_, nullptr)),
+      start_time_(other.start_time_),
+      in_flight_(other.in_flight_),
+      dropped_(other.dropped_) {}
+
+ConcurrencyLimiter::Permit& ConcurrencyLimiter::Permit::operator=(
+    Permit&& other) noexcept {
+  if (this != &other) {
+    if (limiter_ != nullptr) {
+      limiter_->release(*this);
+    }
+    limiter_ = std::exchange(other.limiter_, nullptr);
+    start_time_ = other.start_time_;
+    in_flight_ = other.in_flight_;
+    dropped_ = other.dropped_;
+  }
+  return *this;
+}
+
+ConcurrencyLimiter::ConcurrencyLimiter(const ConcurrencyLimiterConfig& config)
+    : config_(config) {
+  limit_ = static_cast<double>(
+      isAdaptive() ? std::clamp(config_.initial_limit, config_.min_limit,
+                                config_.max_limit)
+                   : config_.max_concurrency);
+}
+
+bool ConcurrencyLimiter::isAdaptive() const {
+  return config_.max_concurrency == 0;
+}
+
+ConcurrencyLimiter::Permit ConcurrencyLimiter::acquire(
+    Clock::time_point deadline) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (in_flight_ < currentLimit()) {
+    return admit();
+  }
+  if (queued_ >= config_.max_queued || config_.max_queue_wait.count() <= 0) {
+    shed_.add();
+    return Permit();
+  }
+
+  deadline = std::min(deadline, Clock::now() + config_.max_queue_wait);
+  queued_++;
+  bool free = slot_free_.wait_until(
+      lock, deadline, [this]() { return in_flight_ < currentLimit(); });
+  queued_--;
+  if (!free) {
+    shed_.add();
+    return Permit();
+  }
+  return admit();
+}
+
+ConcurrencyLimiter::Permit ConcurrencyLimiter::tryAcquire() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (in_flight_ < currentLimit()) {
+    return admit();
+  }
+  shed_.add();
+  return Permit();
+}
+
+ConcurrencyLimiter::Stats ConcurrencyLimiter::getStats() const {
+  Stats stats;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.limit = currentLimit();
+    stats.in_flight = in_flight_;
+    stats.queued = queued_;
+  }
+  stats.admitted = admitted_.value();
+  stats.shed = shed_.value();
+  stats.dropped = dropped_.value();
+  return stats;
+}
+
+size_t ConcurrencyLimiter::currentLimit() const {
+  return std::max<size_t>(1, static_cast<size_t>(limit_));
+}
+
+ConcurrencyLimiter::Permit ConcurrencyLimiter::admit() {
+  in_flight_++;
+  admitted_.add();
+  return Permit(this, in_flight_);
+}
+
+void ConcurrencyLimiter::release(const Permit& permit) {
+  double latency_ns = static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          Clock::now() - permit.start_time_)
+          .count());
+  if (permit.dropped_) {
+    dropped_.add();
+  }
+
+  bool grown = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_--;
+    if (isAdaptive()) {
+      size_t previous_limit = currentLimit();
+      bool congested =
+          permit.dropped_ ||
+          (long_latency_ns_ > 0 &&
+           latency_ns > kLatencyTolerance * long_latency_ns_);
+      if (congested) {
+        limit_ = std::max(static_cast<double>(config_.min_limit),
+                          limit_ * kBackoff);
+      } else if (2 * permit.in_flight_ >= currentLimit()) {
+        // Only grow a limit that is being used
+        limit_ = std::min(static_cast<double>(config_.max_limit),
+                          limit_ + 1.0 / limit_);
+      }
+      if (!permit.dropped_) {
+        long_latency_ns_ =
+            long_latency_ns_ == 0
+                ? latency_ns
+                : long_latency_ns_ +
+                      kLatencyWeight * (latency_ns - long_latency_ns_);
+      }
+      grown = currentLimit() > previous_limit;
+    }
+  }
+  // The permit's slot goes to one waiter, and a slot the limit grew by to
+  // another
+  if (grown) {
+    slot_free_.notify_all();
+  } else {
+    slot_free_.notify_one();
+  }
+}
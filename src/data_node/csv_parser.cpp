@@ -1,109 +1,296 @@
 #include "data_node/csv_parser.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <iterator>
+#include <system_error>
+#include <thread>
+
+namespace {
+
+// Find the first ',' or '"' in [begin, end), or end if there is none.
+// Scans 16 bytes per step where SSE2 is available.
+const char* findDelimiter(const char* begin, const char* end) {
+#if defined(__SSE2__)
+  const __m128i comma = _mm_set1_epi8(',');
+  const __m128i quote = _mm_set1_epi8('"');
+  while (end - begin >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, comma),
+                                              _mm_cmpeq_epi8(chunk, quote)));
+    if (mask != 0) {
+      return begin + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+    begin += 16;
+  }
+#endif
+  while (begin < end && *begin != ',' && *begin != '"') {
+    ++begin;
+  }
+  return begin;
+}
+
+bool isBlank(std::string_view text) {
+  return std::all_of(text.begin(), text.end(), [](char c) {
+    return std::isspace(static_cast<unsigned char>(c));
+  });
+}
+
+std::string_view skipLeadingSpace(std::string_view text) {
+  while (!text.empty() &&
+         std::isspace(static_cast<unsigned char>(text.front()))) {
+    text.remove_prefix(1);
+  }
+  return text;
+}
+
+// Parse a decimal number the way std::stod accepts it: leading whitespace
+// and a '+' sign are skipped, and parsing stops at the first character that
+// is not part of the number. Unlike std::stod this is locale-independent.
+std::errc parseDouble(std::string_view text, double& value) {
+  text = skipLeadingSpace(text);
+  if (!text.empty() && text.front() == '+') {
+    text.remove_prefix(1);
+    if (!text.empty() && text.front() == '-') {
+      return std::errc::invalid_argument;
+    }
+  }
+  return std::from_chars(text.data(), text.data() + text.size(), value).ec;
+}
+
+// Parse a hex number the way std::stoull(text, nullptr, 16) accepts it,
+// including an optional 0x prefix
+std::errc parseHex(std::string_view text, size_t& value) {
+  text = skipLeadingSpace(text);
+  if (!text.empty() && text.front() == '+') {
+    text.remove_prefix(1);
+  }
+  if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X') &&
+      std::isxdigit(static_cast<unsigned char>(text[2]))) {
+    text.remove_prefix(2);
+  }
+  unsigned long long parsed = 0;
+  auto ec =
+      std::from_chars(text.data(), text.data() + text.size(), parsed, 16).ec;
+  value = static_cast<size_t>(parsed);
+  return ec;
+}
+
+}  // namespace
 
 CSVParser::CSVParser() : success_count_(0), error_count_(0) {}
 
-std::vector<AddressRecord> CSVParser::parse(const std::string& filepath) {
+std::vector<AddressRecord> CSVParser::parse(const std::string& filepath,
+                                            size_t num_threads) {
+  // Collect each range's records separately, then concatenate in file order
+  num_threads = std::max<size_t>(1, num_threads);
+  std::vector<std::vector<AddressRecord>> chunks(num_threads);
+  scan(filepath, num_threads,
+       [&chunks](size_t chunk, std::string_view, AddressRecord& record) {
+         chunks[chunk].push_back(std::move(record));
+       });
+
   std::vector<AddressRecord> records;
-  std::ifstream file(filepath);
+  size_t total = 0;
+  for (const auto& chunk : chunks) {
+    total += chunk.size();
+  }
+  records.reserve(total);
+  for (auto& chunk : chunks) {
+    std::move(chunk.begin(), chunk.end(), std::back_inserter(records));
+  }
+  return records;
+}
+
+bool CSVParser::scan(const std::string& filepath,
+                     size_t num_threads,
+                     const RecordVisitor& visitor) {
+  std::ifstream file(filepath, std::ios::binary);
 
   if (!file.is_open()) {
     std::cerr << "Error: Could not open CSV file: " << filepath << std::endl;
-    return records;
+    return false;
   }
 
-  std::string line;
-  bool is_header = true;
-
   // Reset counters for new parse operation
   success_count_ = 0;
   error_count_ = 0;
 
-  while (std::getline(file, line)) {
-    // Skip header line
-    if (is_header) {
-      is_header = false;
+  // Read the whole file in one call so it can be split into independent
+  // byte ranges and tokenized in place
+  std::string contents;
+  file.seekg(0, std::ios::end);
+  std::streamoff file_size = file.tellg();
+  file.seekg(0, std::ios::beg);
+  if (file_size > 0) {
+    contents.resize(static_cast<size_t>(file_size));
+    file.read(&contents[0], file_size);
+    contents.resize(static_cast<size_t>(file.gcount()));
+  }
+  file.close();
+
+  // Skip header line
+  size_t header_end = contents.find('\n');
+  size_t data_begin =
+      header_end == std::string::npos ? contents.size() : header_end + 1;
+
+  // Split the data into ranges that each end just after a newline
+  num_threads = std::max<size_t>(1, num_threads);
+  size_t data_size = contents.size() - data_begin;
+  std::vector<size_t> bounds = {data_begin};
+  for (size_t i = 1; i < num_threads; ++i) {
+    size_t target = data_begin + data_size * i / num_threads;
+    if (target <= bounds.back()) {
       continue;
     }
+    size_t newline = contents.find('\n', target - 1);
+    if (newline == std::string::npos) {
+      break;
+    }
+    bounds.push_back(newline + 1);
+  }
+  bounds.push_back(contents.size());
+
+  size_t chunk_count = bounds.size() - 1;
+  std::vector<ChunkResult> chunks(chunk_count);
+  if (chunk_count == 1) {
+    chunks[0] = parseChunk(contents, bounds[0], bounds[1], 0, visitor);
+  } else {
+    std::vector<std::thread> workers;
+    workers.reserve(chunk_count);
+    for (size_t i = 0; i < chunk_count; ++i) {
+      workers.emplace_back([this, &contents, &bounds, &chunks, &visitor, i]() {
+        chunks[i] =
+            parseChunk(contents, bounds[i], bounds[i + 1], i, visitor);
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  for (const auto& chunk : chunks) {
+    success_count_ += chunk.success_count;
+    error_count_ += chunk.error_count;
+  }
+  return true;
+}
+
+CSVParser::ChunkResult CSVParser::parseChunk(const std::string& contents,
+                                             size_t begin,
+                                             size_t end,
+                                             size_t chunk,
+                                             const RecordVisitor& visitor) const {
+  ChunkResult result;
+  std::string scratch;
+
+  while (begin < end) {
+    size_t newline = contents.find('\n', begin);
+    size_t line_end = newline == std::string::npos || newline > end
+                          ? end
+                          : newline;
+    std::string_view line(contents.data() + begin, line_end - begin);
+    begin = line_end + 1;
 
     // Skip empty lines
-    if (trim(line).empty()) {
+    if (isBlank(line)) {
       continue;
     }
 
-    auto record = parseRecord(line);
+    auto record = parseRecord(line, scratch);
     if (record.has_value()) {
-      records.push_back(record.value());
-      success_count_++;
+      visitor(chunk, line, record.value());
+      result.success_count++;
     } else {
-      error_count_++;
+      result.error_count++;
     }
   }
 
-  file.close();
-  return records;
+  return result;
 }
 
 size_t CSVParser::getSuccessCount() const { return success_count_; }
 
 size_t CSVParser::getErrorCount() const { return error_count_; }
 
-std::optional<AddressRecord> CSVParser::parseRecord(const std::string& line) {
-  std::vector<std::string> fields = splitCSVLine(line);
+std::optional<AddressRecord> CSVParser::parseRecord(
+    std::string_view line,
+    std::string& scratch) const {
+  LineFields line_fields;
+  splitCSVLine(line, scratch, line_fields);
+  const auto& fields = line_fields.fields;
 
   // CSV format: LON,LAT,NUMBER,STREET,UNIT,CITY,DISTRICT,REGION,POSTCODE,ID,HASH
   // We need at least 11 fields
-  if (fields.size() < 11) {
+  if (line_fields.count < LineFields::kMaxFields) {
     std::cerr << "Warning: Malformed record - insufficient fields (expected 11, got "
-              << fields.size() << ")" << std::endl;
+              << line_fields.count << ")" << std::endl;
     return std::nullopt;
   }
 
-  try {
-    // Parse coordinates
-    double longitude = std::stod(fields[0]);
-    double latitude = std::stod(fields[1]);
+  // Parse coordinates
+  double longitude = 0.0;
+  double latitude = 0.0;
+  std::errc longitude_error = parseDouble(fields[0], longitude);
+  std::errc latitude_error = longitude_error == std::errc()
+                                 ? parseDouble(fields[1], latitude)
+                                 : std::errc();
+  if (longitude_error == std::errc::invalid_argument ||
+      latitude_error == std::errc::invalid_argument) {
+    std::cerr << "Warning: Invalid number format in record" << std::endl;
+    return std::nullopt;
+  }
+  if (longitude_error != std::errc() || latitude_error != std::errc()) {
+    std::cerr << "Warning: Number out of range in record" << std::endl;
+    return std::nullopt;
+  }
+
+  // Validate coordinates
+  if (!validateCoordinates(longitude, latitude)) {
+    std::cerr << "Warning: Invalid coordinates - lon=" << longitude
+              << ", lat=" << latitude << std::endl;
+    return std::nullopt;
+  }
 
-    // Validate coordinates
-    if (!validateCoordinates(longitude, latitude)) {
-      std::cerr << "Warning: Invalid coordinates - lon=" << longitude
-                << ", lat=" << latitude << std::endl;
+  // Convert hex string to size_t (handle empty fields gracefully)
+  size_t hash = 0;
+  if (!fields[10].empty()) {
+    std::errc hash_error = parseHex(fields[10], hash);
+    if (hash_error == std::errc::invalid_argument) {
+      std::cerr << "Warning: Invalid number format in record" << std::endl;
       return std::nullopt;
     }
-
-    // Extract other fields (handle empty fields gracefully)
-    std::string number = fields[2];
-    std::string street = fields[3];
-    std::string unit = fields[4];
-    std::string city = fields[5];
-    // Note: DISTRICT (fields[6]) and REGION (fields[7]) are not stored in AddressRecord
-    std::string postcode = fields[8];
-    // Note: ID (fields[9]) is not stored in AddressRecord
-    std::string hash_str = fields[10];
-
-    // Convert hex string to size_t
-    size_t hash = 0;
-    if (!hash_str.empty()) {
-      hash = std::stoull(hash_str, nullptr, 16);
+    if (hash_error != std::errc()) {
+      std::cerr << "Warning: Number out of range in record" << std::endl;
+      return std::nullopt;
     }
+  }
 
-    // Create AddressRecord with original values
-    // Note: normalized values will be set later by the normalizer
-    AddressRecord record(longitude, latitude, hash, number, street, unit, city,
-                         postcode, street, unit, city);
-
-    return record;
+  // Fill in the record's strings directly from the fields
+  // Note: DISTRICT (fields[6]), REGION (fields[7]) and ID (fields[9]) are not
+  // stored in AddressRecord. Normalized values will be set later by the
+  // normalizer; until then they hold the original values.
+  AddressRecord record;
+  record.longitude = longitude;
+  record.latitude = latitude;
+  record.hash = hash;
+  record.number.assign(fields[2]);
+  record.street.assign(fields[3]);
+  record.unit.assign(fields[4]);
+  record.city.assign(fields[5]);
+  record.postcode.assign(fields[8]);
+  record.original_street.assign(fields[3]);
+  record.original_unit.assign(fields[4]);
+  record.original_city.assign(fields[5]);
 
-  } catch (const std::invalid_argument& e) {
-    std::cerr << "Warning: Invalid number format in record" << std::endl;
-    return std::nullopt;
-  } catch (const std::out_of_range& e) {
-    std::cerr << "Warning: Number out of range in record" << std::endl;
-    return std::nullopt;
-  }
+  return record;
 }
 
 bool CSVParser::validateCoordinates(double lon, double lat) const {
@@ -112,43 +299,55 @@ bool CSVParser::validateCoordinates(double lon, double lat) const {
   return (lon >= -180.0 && lon <= 180.0) && (lat >= -90.0 && lat <= 90.0);
 }
 
-std::vector<std::string> CSVParser::splitCSVLine(const std::string& line) const {
-  std::vector<std::string> fields;
-  std::string field;
-  bool in_quotes = false;
+void CSVParser::splitCSVLine(std::string_view line,
+                             std::string& scratch,
+                             LineFields& fields) const {
+  // Unquoted text is never longer than the line, so reserving it up front
+  // keeps views into scratch valid while the line is split
+  scratch.clear();
+  scratch.reserve(line.size());
+  fields.count = 0;
 
-  for (size_t i = 0; i < line.length(); ++i) {
-    char c = line[i];
+  const char* end = line.data() + line.size();
+  const char* pos = line.data();
+  while (true) {
+    const char* field_begin = pos;
+    const char* delimiter = findDelimiter(pos, end);
+    std::string_view field;
 
-    if (c == '"') {
-      in_quotes = !in_quotes;
-    } else if (c == ',' && !in_quotes) {
-      fields.push_back(field);
-      field.clear();
+    if (delimiter == end || *delimiter == ',') {
+      // Fast path: slice the field in place
+      field = std::string_view(field_begin, delimiter - field_begin);
+      pos = delimiter;
     } else {
-      field += c;
+      // Quoted field: quotes toggle quoting and are dropped, and commas
+      // inside quotes are part of the field
+      size_t scratch_begin = scratch.size();
+      scratch.append(field_begin, delimiter);
+      bool in_quotes = false;
+      for (pos = delimiter; pos < end; ++pos) {
+        char c = *pos;
+        if (c == '"') {
+          in_quotes = !in_quotes;
+        } else if (c == ',' && !in_quotes) {
+          break;
+        } else {
+          scratch.push_back(c);
+        }
+      }
+      field = std::string_view(scratch.data() + scratch_begin,
+                               scratch.size() - scratch_begin);
     }
-  }
-
-  // Add the last field
-  fields.push_back(field);
-
-  return fields;
-}
-
-std::string CSVParser::trim(const std::string& str) const {
-  size_t start = 0;
-  size_t end = str.length();
 
-  // Find first non-whitespace character
-  while (start < end && std::isspace(static_cast<unsigned char>(str[start]))) {
-    ++start;
-  }
+    if (fields.count < LineFields::kMaxFields) {
+      fields.fields[fields.count] = field;
+    }
+    fields.count++;
 
-  // Find last non-whitespace character
-  while (end > start && std::isspace(static_cast<unsigned char>(str[end - 1]))) {
-    --end;
+    // The last field ends at the end of the line
+    if (pos == end) {
+      break;
+    }
+    ++pos;
   }
-
-  return str.substr(start, end - start);
 }
@@ -1,364 +1,1282 @@
 #include "data_node/data_node.h"
 
 #include <algorithm>
-#include <iostream>
-#include <sstream>
-#include <unordered_set>
-
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "data_node/address_keys.h"
 #include "data_node/address_normalizer.h"
+#include "data_node/composite_key_index.h"
 #include "data_node/csv_parser.h"
 #include "data_node/forward_index.h"
+#include "data_node/index_snapshot.h"
+#include "data_node/logging.h"
+#include "data_node/posting_intersection.h"
 #include "data_node/radix_tree_index.h"
+#include "data_node/relevance_scorer.h"
+#include "data_node/spatial_index.h"
+
+namespace {
+
+std::chrono::milliseconds elapsedSince(DataNode::Clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      DataNode::Clock::now() - start);
+}
+
+// Run task(0) .. task(count - 1) on their own threads and wait for all of
+// them, rethrowing the first exception a task threw
+template <typename Task>
+void runParallel(size_t count, const Task& task) {
+  if (count == 1) {
+    task(0);
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(count);
+  std::vector<std::thread> workers;
+  workers.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    workers.emplace_back([&task, &errors, i]() {
+      try {
+        task(i);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+// Run task(0) .. task(count - 1) on the calling thread and up to count - 1
+// helpers queued on pool, and wait for all of them, rethrowing the first
+// exception a task threw. Each thread claims the next unclaimed index until
+// none are left, so the call never waits for a helper that has not started:
+// if every pool worker is busy, the calling thread runs every task itself.
+// Helpers that start after the call returned find nothing to claim.
+template <typename Task>
+void runOnPool(ThreadPool& pool, size_t count, const Task& task) {
+  if (count == 1) {
+    task(0);
+    return;
+  }
+
+  struct Run {
+    std::function<void(size_t)> task;
+    size_t count = 0;
+    std::atomic<size_t> next{0};
+    std::vector<std::exception_ptr> errors;
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t done = 0;
+
+    void work() {
+      for (size_t i = next++; i < count; i = next++) {
+        try {
+          task(i);
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (++done == count) {
+          finished.notify_all();
+        }
+      }
+    }
+  };
+
+  auto run = std::make_shared<Run>();
+  run->task = [&task](size_t i) { task(i); };
+  run->count = count;
+  run->errors.resize(count);
+  for (size_t i = 1; i < count; ++i) {
+    pool.submit([run]() { run->work(); });
+  }
+  run->work();
+
+  std::unique_lock<std::mutex> lock(run->mutex);
+  run->finished.wait(lock, [&run]() { return run->done == run->count; });
+  for (const auto& error : run->errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+using TermPosting = RadixTreeIndex::TermPosting;
+
+// Typos allowed in a normalized query term: none in very short terms, where
+// almost every term is within reach, and more as the term grows
+int allowedEdits(const std::string& term, int fuzziness) {
+  if (term.size() < DataNode::kMinOneTypoLength) {
+    return 0;
+  }
+  if (term.size() < DataNode::kMinTwoTypoLength) {
+    return std::min(fuzziness, 1);
+  }
+  return std::min(fuzziness, DataNode::kMaxFuzziness);
+}
 
-DataNode::DataNode(int shard_id, const std::string& data_file_path)
+}  // namespace
+
+DataNode::DataNode(int shard_id,
+                   const std::string& data_file_path,
+                   const DataNodeOptions& options)
     : shard_id_(shard_id),
       data_file_path_(data_file_path),
-      radix_index_(std::make_unique<RadixTreeIndex>()),
-      forward_index_(std::make_unique<ForwardIndex>()),
-      normalizer_(std::make_unique<AddressNormalizer>()) {
-  stats_.total_records = 0;
-  stats_.radix_tree_memory = 0;
-  stats_.forward_index_size = 0;
-  stats_.load_time = std::chrono::milliseconds(0);
+      options_(options),
+      normalizer_(std::make_unique<AddressNormalizer>()),
+      metrics_(std::make_unique<Metrics>()),
+      generation_(new std::shared_ptr<const IndexGeneration>(
+          std::make_shared<IndexGeneration>())) {}
+
+DataNode::~DataNode() {
+  delete generation_.load();
+}
+
+DataNode::IndexGeneration::IndexGeneration()
+    : radix_index(std::make_unique<RadixTreeIndex>()),
+      forward_index(std::make_unique<ForwardIndex>()),
+      spatial_index(std::make_unique<SpatialIndex>()),
+      key_index(std::make_unique<CompositeKeyIndex>()) {
+  stats.total_records = 0;
+  stats.radix_tree_memory = 0;
+  stats.forward_index_size = 0;
+  stats.spatial_index_memory = 0;
+  stats.key_index_memory = 0;
+  stats.load_time = std::chrono::milliseconds(0);
+  stats.loaded_from_snapshot = false;
+  stats.postings_cache = PostingsCache::Stats{};
+  stats.generation = 0;
+}
+
+std::shared_ptr<const DataNode::IndexGeneration> DataNode::currentGeneration()
+    const {
+  // Register as a reader of the current epoch. If a reload advanced the
+  // epoch meanwhile, it may not wait for this parity, so register again.
+  ReaderCount* readers;
+  while (true) {
+    uint64_t epoch = epoch_.load();
+    readers = &readers_[epoch & 1];
+    readers->count.fetch_add(1);
+    if (epoch_.load() == epoch) {
+      break;
+    }
+    readers->count.fetch_sub(1);
+  }
+  std::shared_ptr<const IndexGeneration> generation = *generation_.load();
+  readers->count.fetch_sub(1);
+  return generation;
+}
+
+size_t DataNode::batchThreadCount() const {
+  if (options_.batch_threads > 0) {
+    return options_.batch_threads;
+  }
+  return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+size_t DataNode::loadThreadCount() const {
+  if (options_.load_threads > 0) {
+    return options_.load_threads;
+  }
+  return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+bool DataNode::initialize() { return reload().has_value(); }
+
+std::optional<DataNode::Statistics> DataNode::reload() {
+  std::lock_guard<std::mutex> lock(reload_mutex_);
+  std::shared_ptr<const IndexGeneration> current = currentGeneration();
+
+  // Build the next generation off to the side; searches keep using the
+  // current one until it is published
+  auto generation = std::make_shared<IndexGeneration>();
+  if (!loadGeneration(*generation)) {
+    if (current->stats.generation > 0) {
+      LogLine(LogLevel::kError, "DataNode")
+          << "Reload failed, still serving generation "
+          << current->stats.generation;
+    }
+    return std::nullopt;
+  }
+
+  generation->stats.generation = current->stats.generation + 1;
+  generation->stats.loaded_at = std::chrono::system_clock::now();
+  const std::shared_ptr<const IndexGeneration>* replaced = generation_.exchange(
+      new std::shared_ptr<const IndexGeneration>(generation));
+
+  // Readers registered before the epoch advances may still be copying the
+  // replaced reference; later ones can only see the new one
+  uint64_t epoch = epoch_.fetch_add(1);
+  while (readers_[epoch & 1].count.load() != 0) {
+    std::this_thread::yield();
+  }
+  delete replaced;
+
+  LogLine(LogLevel::kInfo, "DataNode")
+      << "Serving index generation " << generation->stats.generation;
+  return generation->stats;
 }
 
-bool DataNode::initialize() {
-  auto start_time = std::chrono::steady_clock::now();
+bool DataNode::loadGeneration(IndexGeneration& generation) {
+  auto start_time = Clock::now();
+  Statistics& stats = generation.stats;
 
-  std::cout << "[INFO] [DataNode] Starting data load from: " << data_file_path_
-            << " (shard_id=" << shard_id_ << ")" << std::endl;
+  LogLine(LogLevel::kInfo, "DataNode")
+      << "Starting data load from: " << data_file_path_ << " (shard_id="
+      << shard_id_ << ")";
 
   try {
+    if (options_.postings_cache_bytes > 0) {
+      if (options_.flat_radix_layout) {
+        generation.postings_cache =
+            std::make_unique<PostingsCache>(options_.postings_cache_bytes);
+      } else {
+        LogLine(LogLevel::kWarning, "DataNode")
+            << "The postings cache requires the flat radix layout, "
+            << "not enabling it";
+      }
+    }
+
+    // Prefer a snapshot built from the same data file
+    bool use_snapshot = !options_.snapshot_path.empty();
+    if (use_snapshot && !options_.flat_radix_layout) {
+      LogLine(LogLevel::kWarning, "DataNode")
+          << "Index snapshots require the flat radix layout, not using "
+          << options_.snapshot_path;
+      use_snapshot = false;
+    }
+
+    std::optional<SourceFingerprint> source;
+    if (use_snapshot) {
+      auto snapshot_start = Clock::now();
+      source = SourceFingerprint::ofFile(data_file_path_);
+      bool loaded = source.has_value() && loadSnapshot(*source, generation);
+      stats.load_stages.snapshot_load = elapsedSince(snapshot_start);
+      if (loaded) {
+        finishLoad(generation, start_time, "Snapshot load");
+        return true;
+      }
+    }
+
     // Parse CSV file
+    auto parse_start = Clock::now();
     CSVParser parser;
-    std::vector<AddressRecord> records = parser.parse(data_file_path_);
+    std::vector<AddressRecord> records =
+        parser.parse(data_file_path_, loadThreadCount());
+    stats.load_stages.parse = elapsedSince(parse_start);
 
     if (records.empty()) {
-      std::cerr << "[ERROR] [DataNode] No valid records loaded from "
-                << data_file_path_ << std::endl;
+      LogLine(LogLevel::kError, "DataNode")
+          << "No valid records loaded from " << data_file_path_;
       return false;
     }
 
-    std::cout << "[INFO] [DataNode] Successfully parsed " << records.size()
-              << " records (errors: " << parser.getErrorCount() << ")"
-              << std::endl;
+    LogLine(LogLevel::kInfo, "DataNode")
+        << "Successfully parsed " << records.size() << " records (errors: "
+        << parser.getErrorCount() << ")";
 
     // Build indexes
-    buildIndexes(records);
-
-    // Calculate statistics
-    auto end_time = std::chrono::steady_clock::now();
-    stats_.total_records = records.size();
-    stats_.radix_tree_memory = radix_index_->getMemoryUsage();
-    stats_.forward_index_size = forward_index_->getStorageSize();
-    stats_.load_time =
-        std::chrono::duration_cast<std::chrono::milliseconds>(end_time -
-                                                               start_time);
-
-    std::cout << "[INFO] [DataNode] Index building complete:" << std::endl;
-    std::cout << "  - Total records: " << stats_.total_records << std::endl;
-    std::cout << "  - RadixTree memory: " << stats_.radix_tree_memory
-              << " bytes" << std::endl;
-    std::cout << "  - ForwardIndex size: " << stats_.forward_index_size
-              << " bytes" << std::endl;
-    std::cout << "  - Load time: " << stats_.load_time.count() << " ms"
-              << std::endl;
+    buildIndexes(records, generation);
+
+    // Save the built indexes for the next start
+    if (use_snapshot && source.has_value()) {
+      auto snapshot_start = Clock::now();
+      writeSnapshot(*source, generation);
+      stats.load_stages.snapshot_write = elapsedSince(snapshot_start);
+    }
 
+    finishLoad(generation, start_time, "Index building");
     return true;
   } catch (const std::exception& e) {
-    std::cerr << "[ERROR] [DataNode] Exception during initialization: "
-              << e.what() << std::endl;
+    LogLine(LogLevel::kError, "DataNode")
+        << "Exception during initialization: " << e.what();
     return false;
   }
 }
 
-std::vector<std::string> DataNode::generateSearchKeys(const AddressRecord& record) {
-  std::vector<std::string> keys;
+void DataNode::finishLoad(IndexGeneration& generation,
+                          Clock::time_point start_time,
+                          const char* stage) {
+  // Calculate statistics
+  Statistics& stats = generation.stats;
+  stats.radix_tree_memory = generation.radix_index->getMemoryUsage();
+  stats.forward_index_size = generation.forward_index->getStorageSize();
+  stats.spatial_index_memory = generation.spatial_index->getMemoryUsage();
+  stats.key_index_memory = generation.key_index->getMemoryUsage();
+  stats.load_time = elapsedSince(start_time);
+
+  const Statistics::LoadStageTimes& stages = stats.load_stages;
+  LogLine(LogLevel::kInfo, "DataNode")
+      << stage << " complete:"
+      << "\n  - Total records: " << stats.total_records
+      << "\n  - RadixTree memory: " << stats.radix_tree_memory << " bytes"
+      << "\n  - ForwardIndex size: " << stats.forward_index_size << " bytes"
+      << "\n  - SpatialIndex memory: " << stats.spatial_index_memory
+      << " bytes"
+      << "\n  - CompositeKeyIndex memory: " << stats.key_index_memory
+      << " bytes"
+      << "\n  - Load time: " << stats.load_time.count() << " ms"
+      << " (snapshot load " << stages.snapshot_load.count()
+      << " ms, parse " << stages.parse.count()
+      << " ms, forward index " << stages.forward_index.count()
+      << " ms, key generation " << stages.key_generation.count()
+      << " ms, radix build " << stages.radix_build.count()
+      << " ms, freeze " << stages.freeze.count()
+      << " ms, spatial build " << stages.spatial_build.count()
+      << " ms, key index " << stages.key_index.count()
+      << " ms, snapshot write " << stages.snapshot_write.count() << " ms)";
+}
+
+bool DataNode::loadSnapshot(const SourceFingerprint& source,
+                            IndexGeneration& generation) {
+  std::shared_ptr<const IndexSnapshot> snapshot =
+      IndexSnapshot::open(options_.snapshot_path, source);
+  if (!snapshot) {
+    return false;
+  }
+
+  // Load into fresh indexes so a rejected snapshot leaves nothing behind
+  auto meta = snapshot->getArray<uint64_t>(SnapshotSection::kDataNodeMeta);
+  auto radix_index = std::make_unique<RadixTreeIndex>();
+  auto forward_index = std::make_unique<ForwardIndex>();
+  auto spatial_index = std::make_unique<SpatialIndex>();
+  auto key_index = std::make_unique<CompositeKeyIndex>();
+  if (!meta || meta->size() != 1 || !radix_index->loadFromSnapshot(snapshot) ||
+      !forward_index->loadFromSnapshot(snapshot) ||
+      !spatial_index->loadFromSnapshot(snapshot) ||
+      !key_index->loadFromSnapshot(snapshot)) {
+    LogLine(LogLevel::kWarning, "DataNode")
+        << "Ignoring inconsistent snapshot " << options_.snapshot_path;
+    return false;
+  }
+
+  generation.radix_index = std::move(radix_index);
+  generation.forward_index = std::move(forward_index);
+  generation.spatial_index = std::move(spatial_index);
+  generation.key_index = std::move(key_index);
+  generation.stats.total_records = static_cast<size_t>((*meta)[0]);
+  generation.stats.loaded_from_snapshot = true;
+
+  LogLine(LogLevel::kInfo, "DataNode")
+      << "Loaded indexes from snapshot " << options_.snapshot_path << " ("
+      << snapshot->getMappedSize() << " bytes mapped)";
+  return true;
+}
+
+bool DataNode::writeSnapshot(const SourceFingerprint& source,
+                             const IndexGeneration& generation) {
+  uint64_t total_records = generation.stats.total_records;
+
+  SnapshotWriter writer;
+  writer.addSection(SnapshotSection::kDataNodeMeta, &total_records,
+                    sizeof(total_records));
+  generation.radix_index->addToSnapshot(writer);
+  generation.forward_index->addToSnapshot(writer);
+  generation.spatial_index->addToSnapshot(writer);
+  generation.key_index->addToSnapshot(writer);
+
+  if (!writer.write(options_.snapshot_path, source)) {
+    LogLine(LogLevel::kWarning, "DataNode")
+        << "Could not write snapshot " << options_.snapshot_path;
+    return false;
+  }
+
+  LogLine(LogLevel::kInfo, "DataNode")
+      << "Wrote index snapshot " << options_.snapshot_path;
+  return true;
+}
 
-  // Normalize all components
+std::vector<std::string> DataNode::generateIndexTerms(
+    const AddressRecord& record) {
+  // Normalize each component once; the same strings are used to build the
+  // composite keys and are then moved in as terms of their own
   std::string norm_number = normalizer_->normalize(record.number);
   std::string norm_street = normalizer_->normalize(record.street);
   std::string norm_city = normalizer_->normalize(record.city);
   std::string norm_postcode = normalizer_->normalize(record.postcode);
 
-  // Generate composite keys with different combinations
-  // Key 1: number + separator + street + separator + city
-  if (!norm_number.empty() && !norm_street.empty() && !norm_city.empty()) {
-    std::string key1 = norm_number + KEY_SEPARATOR + norm_street + KEY_SEPARATOR + norm_city;
-    keys.push_back(key1);
+  std::vector<std::string> terms;
+  terms.reserve(7);
+  appendIndexKeys(norm_number, norm_street, norm_city, norm_postcode, terms);
+
+  // Also index individual fields for backward compatibility and partial matching
+  // This allows searching by individual terms like "STREET" or "SEATTLE"
+  for (std::string* field :
+       {&norm_street, &norm_city, &norm_postcode, &norm_number}) {
+    if (!field->empty()) {
+      terms.push_back(std::move(*field));
+    }
+  }
+
+  return terms;
+}
+
+void DataNode::buildIndexes(const std::vector<AddressRecord>& records,
+                            IndexGeneration& generation) {
+  size_t thread_count = loadThreadCount();
+  LogLine(LogLevel::kInfo, "DataNode")
+      << "Building indexes for " << records.size() << " records with "
+      << thread_count << " thread(s)...";
+
+  // Stage 1: store records in the ForwardIndex, which assigns dense
+  // document IDs in record order.
+  // Records sharing a HASH are the same address and the last one wins, as
+  // each row used to overwrite the one before it; the terms of every
+  // duplicate row still lead to that record. Records without a hash are
+  // always stored.
+  auto stage_start = Clock::now();
+  std::unordered_map<size_t, size_t> last_row_by_hash;
+  last_row_by_hash.reserve(records.size());
+  for (size_t row = 0; row < records.size(); ++row) {
+    if (records[row].hash != 0) {
+      last_row_by_hash[records[row].hash] = row;
+    }
+  }
+
+  auto is_stored = [&](size_t row) {
+    size_t hash = records[row].hash;
+    return hash == 0 || last_row_by_hash.at(hash) == row;
+  };
+  std::vector<const AddressRecord*> indexed_records;
+  indexed_records.reserve(records.size());
+  std::vector<DocId> row_ids(records.size());
+  for (size_t row = 0; row < records.size(); ++row) {
+    if (!is_stored(row)) {
+      continue;
+    }
+    DocId record_id = generation.forward_index->insert(records[row]);
+    if (record_id != indexed_records.size()) {
+      throw std::logic_error("ForwardIndex assigned a non-dense DocId");
+    }
+    indexed_records.push_back(&records[row]);
+    row_ids[row] = record_id;
   }
+  for (size_t row = 0; row < records.size(); ++row) {
+    if (!is_stored(row)) {
+      row_ids[row] = row_ids[last_row_by_hash.at(records[row].hash)];
+    }
+  }
+  generation.stats.total_records = indexed_records.size();
+  generation.stats.load_stages.forward_index = elapsedSince(stage_start);
+
+  // Stage 2: normalize and generate terms for contiguous ranges of rows in
+  // parallel. Terms are bucketed by the radix shard that owns their first
+  // character, so every shard can be built independently. The hashes of
+  // the composite keys are collected for the composite key index.
+  stage_start = Clock::now();
+  size_t shard_count = thread_count;
+  size_t row_count = records.size();
+  std::vector<std::vector<std::vector<TermPosting>>> buckets(
+      thread_count, std::vector<std::vector<TermPosting>>(shard_count));
+  using KeyPosting = CompositeKeyIndex::KeyPosting;
+  std::vector<std::vector<KeyPosting>> key_postings(thread_count);
+
+  runParallel(thread_count, [&](size_t worker) {
+    size_t begin = row_count * worker / thread_count;
+    size_t end = row_count * (worker + 1) / thread_count;
+    for (size_t row = begin; row < end; ++row) {
+      DocId id = row_ids[row];
+      for (std::string& term : generateIndexTerms(records[row])) {
+        if (term.find(kKeySeparator) != std::string::npos) {
+          key_postings[worker].push_back(
+              KeyPosting{CompositeKeyIndex::hashKey(term), id});
+        }
+        size_t shard = static_cast<unsigned char>(term[0]) % shard_count;
+        buckets[worker][shard].push_back(TermPosting{std::move(term), id});
+      }
+    }
+  });
+  generation.stats.load_stages.key_generation = elapsedSince(stage_start);
+
+  // Stage 3: build one partial radix tree per shard in parallel, then merge
+  // them. Each shard's postings are sorted once and the tree is built in a
+  // single pass over them. Shards share no first character, so merging only
+  // moves edges.
+  stage_start = Clock::now();
+  std::vector<RadixTreeIndex> partial_indexes(shard_count);
+
+  runParallel(shard_count, [&](size_t shard) {
+    size_t posting_count = 0;
+    for (size_t worker = 0; worker < thread_count; ++worker) {
+      posting_count += buckets[worker][shard].size();
+    }
+    std::vector<TermPosting> postings;
+    postings.reserve(posting_count);
+    for (size_t worker = 0; worker < thread_count; ++worker) {
+      std::vector<TermPosting>& bucket = buckets[worker][shard];
+      std::move(bucket.begin(), bucket.end(), std::back_inserter(postings));
+      std::vector<TermPosting>().swap(bucket);
+    }
+    std::sort(postings.begin(), postings.end(), RadixTreeIndex::postingLess);
+    partial_indexes[shard].buildFrom(postings);
+  });
 
-  // Key 2: number + separator + street
-  if (!norm_number.empty() && !norm_street.empty()) {
-    std::string key2 = norm_number + KEY_SEPARATOR + norm_street;
-    keys.push_back(key2);
+  for (RadixTreeIndex& partial_index : partial_indexes) {
+    generation.radix_index->mergeDisjoint(std::move(partial_index));
   }
+  generation.stats.load_stages.radix_build = elapsedSince(stage_start);
 
-  // Key 3: number + separator + street + separator + city + separator + postcode
-  if (!norm_number.empty() && !norm_street.empty() && !norm_city.empty() && !norm_postcode.empty()) {
-    std::string key3 = norm_number + KEY_SEPARATOR + norm_street + KEY_SEPARATOR +
-                       norm_city + KEY_SEPARATOR + norm_postcode;
-    keys.push_back(key3);
+  // Stage 4: flatten into the read-only layout
+  stage_start = Clock::now();
+  if (options_.flat_radix_layout) {
+    generation.radix_index->freeze();
+  }
+  generation.stats.load_stages.freeze = elapsedSince(stage_start);
+
+  // Stage 5: pack the spatial tree over the record coordinates
+  stage_start = Clock::now();
+  std::vector<GeoPoint> points;
+  points.reserve(indexed_records.size());
+  for (const AddressRecord* record : indexed_records) {
+    points.push_back(GeoPoint{record->longitude, record->latitude});
   }
+  generation.spatial_index->build(points);
+  generation.stats.load_stages.spatial_build = elapsedSince(stage_start);
+
+  // Stage 6: sort the composite key hashes into the key index
+  stage_start = Clock::now();
+  size_t key_posting_count = 0;
+  for (const auto& worker_postings : key_postings) {
+    key_posting_count += worker_postings.size();
+  }
+  std::vector<KeyPosting> all_key_postings;
+  all_key_postings.reserve(key_posting_count);
+  for (auto& worker_postings : key_postings) {
+    all_key_postings.insert(all_key_postings.end(), worker_postings.begin(),
+                            worker_postings.end());
+    std::vector<KeyPosting>().swap(worker_postings);
+  }
+  generation.key_index->build(std::move(all_key_postings));
+  generation.stats.load_stages.key_index = elapsedSince(stage_start);
 
-  return keys;
+  LogLine(LogLevel::kInfo, "DataNode") << "Indexes built successfully";
 }
 
-DataNode::ParsedAddress DataNode::parseQuery(const std::string& query) {
-  ParsedAddress parsed;
-
-  // Simple parser: split by comma and whitespace
-  // Expected format: "number street, city, postcode" or variations
-  std::vector<std::string> parts;
-  std::string current;
+std::vector<DocId> DataNode::findMatchingIds(
+    const IndexGeneration& generation,
+    const std::vector<std::string>& query_terms,
+    TermMemo* memo,
+    int fuzziness,
+    std::vector<uint8_t>* edits) {
+  if (query_terms.empty()) {
+    return {};
+  }
 
-  for (char c : query) {
-    if (c == ',') {
-      if (!current.empty()) {
-        parts.push_back(current);
-        current.clear();
-      }
-    } else {
-      current += c;
+  // Check if this is a single query string that looks like a full address
+  // (contains comma, suggesting it's a structured address query)
+  if (isStructuredQuery(query_terms)) {
+    // Plan the structured address's composite keys, which share prefixes
+    ScopedLatency normalize_latency(metrics_->normalize);
+    StructuredQueryPlan plan(query_terms[0], *normalizer_);
+    normalize_latency.stop();
+
+    // Search with the most specific key that matches, in one trie walk
+    ScopedLatency lookup_latency(metrics_->trie_lookup);
+    size_t matched_length;
+    std::vector<DocId> results = generation.radix_index->searchLongestPrefix(
+        plan.key(), plan.keyLengths(), &matched_length);
+    std::sort(results.begin(), results.end());
+    if (!results.empty()) {
+      LogLine(LogLevel::kDebug, "DataNode")
+          << "Found " << results.size() << " matches using key: "
+          << plan.key().substr(0, matched_length);
     }
+    return results;
   }
-  if (!current.empty()) {
-    parts.push_back(current);
+
+  // Normalize query terms
+  ScopedLatency normalize_latency(metrics_->normalize);
+  std::vector<std::string> normalized_terms;
+  normalized_terms.reserve(query_terms.size());
+  for (const auto& term : query_terms) {
+    normalized_terms.push_back(normalizer_->normalize(term));
   }
+  normalize_latency.stop();
 
-  // Trim whitespace from parts
-  for (auto& part : parts) {
-    // Trim leading whitespace
-    size_t start = 0;
-    while (start < part.length() && std::isspace(static_cast<unsigned char>(part[start]))) {
-      start++;
-    }
-    // Trim trailing whitespace
-    size_t end = part.length();
-    while (end > start && std::isspace(static_cast<unsigned char>(part[end - 1]))) {
-      end--;
-    }
-    part = part.substr(start, end - start);
+  if (fuzziness > 0 && edits != nullptr) {
+    return findFuzzyMatchingIds(generation, normalized_terms, fuzziness,
+                                *edits);
   }
 
-  // Parse based on number of parts
-  if (parts.size() >= 1) {
-    // First part should contain number and street
-    std::string first_part = parts[0];
-    std::istringstream iss(first_part);
-    std::string token;
-    std::vector<std::string> tokens;
+  if (normalized_terms.size() == 1) {
+    ScopedLatency lookup_latency(metrics_->trie_lookup);
+    return searchSorted(generation, normalized_terms[0], memo);
+  }
 
-    while (iss >> token) {
-      tokens.push_back(token);
+  // Lookups and intersections alternate below; each stage's time is
+  // summed and recorded once
+  Clock::duration lookup_time{};
+  Clock::duration intersection_time{};
+  Clock::time_point stage_start = Clock::now();
+
+  // Conjunctive query: intersect the most selective terms first, so every
+  // intermediate result is at most as large as the smallest posting list
+  std::vector<std::pair<size_t, const std::string*>> terms_by_count;
+  terms_by_count.reserve(normalized_terms.size());
+  for (const auto& term : normalized_terms) {
+    size_t estimate = generation.radix_index->estimateCount(term);
+    if (estimate == 0) {
+      // A term without matches empties the intersection
+      metrics_->trie_lookup.record(Clock::now() - stage_start);
+      return {};
+    }
+    terms_by_count.emplace_back(estimate, &term);
+  }
+  std::stable_sort(terms_by_count.begin(), terms_by_count.end(),
+                   [](const auto& a, const auto& b) {
+                     return a.first < b.first;
+                   });
+
+  std::vector<DocId> result_ids =
+      searchSorted(generation, *terms_by_count[0].second, memo);
+  std::vector<DocId> intersection;
+  for (size_t i = 1; i < terms_by_count.size() && !result_ids.empty(); ++i) {
+    // Probe a much longer postings list for the remaining candidates
+    // instead of collecting it: only its blocks that may hold one are
+    // decoded
+    if (result_ids.size() * kGallopRatio < terms_by_count[i].first) {
+      Clock::time_point probe_start = Clock::now();
+      lookup_time += probe_start - stage_start;
+      result_ids = generation.radix_index->filterSorted(
+          *terms_by_count[i].second, result_ids);
+      stage_start = Clock::now();
+      intersection_time += stage_start - probe_start;
+      continue;
     }
+    std::vector<DocId> term_ids =
+        searchSorted(generation, *terms_by_count[i].second, memo);
+    Clock::time_point intersect_start = Clock::now();
+    lookup_time += intersect_start - stage_start;
+    intersectSorted(ArrayView<DocId>(result_ids), ArrayView<DocId>(term_ids),
+                    intersection);
+    result_ids.swap(intersection);
+    stage_start = Clock::now();
+    intersection_time += stage_start - intersect_start;
+  }
+  lookup_time += Clock::now() - stage_start;
 
-    // First token is likely the number
-    if (!tokens.empty()) {
-      parsed.number = tokens[0];
+  metrics_->trie_lookup.record(lookup_time);
+  metrics_->intersection.record(intersection_time);
+  return result_ids;
+}
 
-      // Rest is the street
-      if (tokens.size() > 1) {
-        for (size_t i = 1; i < tokens.size(); ++i) {
-          if (i > 1) parsed.street += " ";
-          parsed.street += tokens[i];
-        }
-      }
+std::vector<DocId> DataNode::findFuzzyMatchingIds(
+    const IndexGeneration& generation,
+    const std::vector<std::string>& normalized_terms,
+    int fuzziness,
+    std::vector<uint8_t>& edits) {
+  using FuzzyMatch = RadixTreeIndex::FuzzyMatch;
+
+  Clock::time_point lookup_start = Clock::now();
+  std::vector<std::vector<FuzzyMatch>> term_matches;
+  term_matches.reserve(normalized_terms.size());
+  for (const auto& term : normalized_terms) {
+    term_matches.push_back(generation.radix_index->searchFuzzy(
+        term, allowedEdits(term, fuzziness)));
+    if (term_matches.back().empty()) {
+      // A term without matches empties the intersection
+      metrics_->trie_lookup.record(Clock::now() - lookup_start);
+      edits.clear();
+      return {};
     }
   }
-
-  if (parts.size() >= 2) {
-    parsed.city = parts[1];
+  Clock::time_point intersect_start = Clock::now();
+  metrics_->trie_lookup.record(intersect_start - lookup_start);
+
+  // Intersect the smallest lists first, summing the typos of each ID
+  std::sort(term_matches.begin(), term_matches.end(),
+            [](const auto& a, const auto& b) { return a.size() < b.size(); });
+  std::vector<FuzzyMatch> result = std::move(term_matches[0]);
+  std::vector<FuzzyMatch> intersection;
+  for (size_t i = 1; i < term_matches.size() && !result.empty(); ++i) {
+    const std::vector<FuzzyMatch>& other = term_matches[i];
+    intersection.clear();
+    size_t a = 0;
+    size_t b = 0;
+    while (a < result.size() && b < other.size()) {
+      if (result[a].id < other[b].id) {
+        ++a;
+      } else if (other[b].id < result[a].id) {
+        ++b;
+      } else {
+        int total = result[a].edits + other[b].edits;
+        intersection.push_back(FuzzyMatch{
+            result[a].id,
+            static_cast<uint8_t>(std::min(total, 255))});
+        ++a;
+        ++b;
+      }
+    }
+    result.swap(intersection);
   }
 
-  if (parts.size() >= 3) {
-    parsed.postcode = parts[2];
+  std::vector<DocId> ids;
+  ids.reserve(result.size());
+  edits.clear();
+  edits.reserve(result.size());
+  for (const FuzzyMatch& match : result) {
+    ids.push_back(match.id);
+    edits.push_back(match.edits);
   }
+  metrics_->intersection.record(Clock::now() - intersect_start);
+  return ids;
+}
 
-  return parsed;
+std::vector<AddressRecord> DataNode::search(
+    const std::vector<std::string>& query_terms) {
+  std::vector<AddressRecord> results;
+  searchViews(query_terms, [&results](const AddressRecordView& record) {
+    results.push_back(record.toRecord());
+  });
+  return results;
 }
 
-void DataNode::buildIndexes(const std::vector<AddressRecord>& records) {
-  std::cout << "[INFO] [DataNode] Building indexes for " << records.size()
-            << " records..." << std::endl;
+size_t DataNode::searchViews(const std::vector<std::string>& query_terms,
+                             const RecordVisitor& visitor) {
+  try {
+    metrics_->queries.add();
+    LogLine(LogLevel::kInfo, "DataNode", isQueryLogged())
+        << "Processing search query with " << query_terms.size() << " terms";
+
+    if (query_terms.empty()) {
+      LogLine(LogLevel::kDebug, "DataNode")
+          << "Empty query, returning 0 results";
+      return 0;
+    }
 
-  for (const AddressRecord& record : records) {
-    // Use the hash field as the unique ID
-    size_t record_id = record.hash;
+    // Find matching IDs using RadixTreeIndex
+    std::shared_ptr<const IndexGeneration> generation = currentGeneration();
+    std::vector<DocId> matching_ids =
+        findMatchingIds(*generation, query_terms);
 
-    // Insert into ForwardIndex
-    forward_index_->insert(record_id, record);
+    LogLine(LogLevel::kDebug, "DataNode")
+        << "Found " << matching_ids.size() << " matching IDs";
 
-    // Generate and insert composite search keys for structured queries
-    std::vector<std::string> search_keys = generateSearchKeys(record);
-    for (const auto& key : search_keys) {
-      radix_index_->insert(key, record_id);
+    // Visit records in place in the ForwardIndex
+    ScopedLatency fetch_latency(metrics_->record_fetch);
+    size_t visited = 0;
+    for (const auto& id : matching_ids) {
+      std::optional<AddressRecordView> record =
+          generation->forward_index->getView(id);
+      if (record.has_value()) {
+        visitor(record.value());
+        visited++;
+      } else {
+        LogLine(LogLevel::kWarning, "DataNode")
+            << "Index inconsistency: ID " << id
+            << " found in RadixTree but not in ForwardIndex";
+      }
     }
 
-    // Also index individual fields for backward compatibility and partial matching
-    // This allows searching by individual terms like "STREET" or "SEATTLE"
-    if (!record.street.empty()) {
-      std::string normalized_street = normalizer_->normalize(record.street);
-      radix_index_->insert(normalized_street, record_id);
-    }
+    LogLine(LogLevel::kDebug, "DataNode")
+        << "Returning " << visited << " complete records";
 
-    if (!record.city.empty()) {
-      std::string normalized_city = normalizer_->normalize(record.city);
-      radix_index_->insert(normalized_city, record_id);
-    }
+    return visited;
+  } catch (const std::exception& e) {
+    LogLine(LogLevel::kError, "DataNode")
+        << "Exception during query processing: " << e.what();
+    return 0;  // Report no results on exception
+  }
+}
 
-    if (!record.postcode.empty()) {
-      std::string normalized_postcode = normalizer_->normalize(record.postcode);
-      radix_index_->insert(normalized_postcode, record_id);
+std::vector<DataNode::RankedMatch> DataNode::rankMatches(
+    const IndexGeneration& generation,
+    const std::vector<DocId>& ids,
+    const std::vector<uint8_t>& edits,
+    const std::vector<std::string>& query_terms,
+    size_t max_results,
+    double min_score) const {
+  // Orders matches best first; the heap keeps the worst one on top so it
+  // can be evicted when a better match arrives
+  auto better = [](const RankedMatch& a, const RankedMatch& b) {
+    return a.score != b.score ? a.score > b.score : a.id < b.id;
+  };
+
+  ScopedLatency fetch_latency(metrics_->record_fetch);
+  RelevanceScorer scorer(query_terms);
+  std::vector<RankedMatch> heap;
+  if (max_results != kNoLimit) {
+    heap.reserve(max_results);
+  }
+
+  for (size_t i = 0; i < ids.size(); ++i) {
+    DocId id = ids[i];
+    std::optional<AddressRecordView> record =
+        generation.forward_index->getView(id);
+    if (!record.has_value()) {
+      LogLine(LogLevel::kWarning, "DataNode")
+          << "Index inconsistency: ID " << id
+          << " found in RadixTree but not in ForwardIndex";
+      continue;
     }
 
-    if (!record.number.empty()) {
-      std::string normalized_number = normalizer_->normalize(record.number);
-      radix_index_->insert(normalized_number, record_id);
+    RankedMatch match{edits.empty() ? scorer.score(record.value())
+                                    : scorer.score(record.value(), edits[i]),
+                      id};
+    if (match.score < min_score) {
+      continue;
+    }
+    if (heap.size() < max_results) {
+      heap.push_back(match);
+      std::push_heap(heap.begin(), heap.end(), better);
+    } else if (better(match, heap.front())) {
+      std::pop_heap(heap.begin(), heap.end(), better);
+      heap.back() = match;
+      std::push_heap(heap.begin(), heap.end(), better);
     }
   }
 
-  std::cout << "[INFO] [DataNode] Indexes built successfully" << std::endl;
+  // sort_heap leaves the matches ordered best first
+  std::sort_heap(heap.begin(), heap.end(), better);
+  return heap;
 }
 
-std::vector<size_t> DataNode::findMatchingIds(
-    const std::vector<std::string>& query_terms) {
-  if (query_terms.empty()) {
-    return {};
+size_t DataNode::searchTopK(const std::vector<std::string>& query_terms,
+                            size_t max_results,
+                            double min_score,
+                            const ScoredRecordVisitor& visitor,
+                            int fuzziness) {
+  if (max_results == 0) {
+    return 0;
   }
 
-  // Check if this is a single query string that looks like a full address
-  // (contains comma, suggesting it's a structured address query)
-  if (query_terms.size() == 1 && query_terms[0].find(',') != std::string::npos) {
-    // Parse the query as a structured address
-    ParsedAddress parsed = parseQuery(query_terms[0]);
+  try {
+    metrics_->queries.add();
+    LogLine(LogLevel::kInfo, "DataNode", isQueryLogged())
+        << "Processing top-K search query with " << query_terms.size()
+        << " terms (max_results="
+        << (max_results == kNoLimit ? std::string("unlimited")
+                                    : std::to_string(max_results))
+        << ", min_score=" << min_score << ", fuzziness=" << fuzziness << ")";
 
-    // Generate search keys from the parsed address
-    std::vector<std::string> search_keys;
+    if (query_terms.empty()) {
+      LogLine(LogLevel::kDebug, "DataNode")
+          << "Empty query, returning 0 results";
+      return 0;
+    }
 
-    // Normalize components
-    std::string norm_number = normalizer_->normalize(parsed.number);
-    std::string norm_street = normalizer_->normalize(parsed.street);
-    std::string norm_city = normalizer_->normalize(parsed.city);
-    std::string norm_postcode = normalizer_->normalize(parsed.postcode);
+    std::shared_ptr<const IndexGeneration> generation = currentGeneration();
+    std::vector<uint8_t> edits;
+    std::vector<DocId> matching_ids =
+        findMatchingIds(*generation, query_terms, nullptr, fuzziness, &edits);
 
-    // Try most specific key first (with postcode)
-    if (!norm_number.empty() && !norm_street.empty() && !norm_city.empty() && !norm_postcode.empty()) {
-      std::string key = norm_number + KEY_SEPARATOR + norm_street + KEY_SEPARATOR +
-                       norm_city + KEY_SEPARATOR + norm_postcode;
-      search_keys.push_back(key);
-    }
+    LogLine(LogLevel::kDebug, "DataNode")
+        << "Found " << matching_ids.size() << " matching IDs";
 
-    // Try key with city
-    if (!norm_number.empty() && !norm_street.empty() && !norm_city.empty()) {
-      std::string key = norm_number + KEY_SEPARATOR + norm_street + KEY_SEPARATOR + norm_city;
-      search_keys.push_back(key);
+    std::vector<RankedMatch> ranked = rankMatches(
+        *generation, matching_ids, edits, query_terms, max_results, min_score);
+    for (const RankedMatch& match : ranked) {
+      visitor(*generation->forward_index->getView(match.id), match.score);
     }
 
-    // Try key without city
-    if (!norm_number.empty() && !norm_street.empty()) {
-      std::string key = norm_number + KEY_SEPARATOR + norm_street;
-      search_keys.push_back(key);
-    }
+    LogLine(LogLevel::kDebug, "DataNode")
+        << "Returning top " << ranked.size() << " records";
+
+    return ranked.size();
+  } catch (const std::exception& e) {
+    LogLine(LogLevel::kError, "DataNode")
+        << "Exception during query processing: " << e.what();
+    return 0;  // Report no results on exception
+  }
+}
+
+size_t DataNode::lookup(const std::vector<std::string>& keys,
+                        const std::vector<std::string>& query_terms,
+                        size_t max_results,
+                        const ScoredRecordVisitor& visitor) {
+  if (max_results == 0 || keys.empty()) {
+    return 0;
+  }
 
-    // Search with each key and return first match
-    for (const auto& key : search_keys) {
-      std::vector<size_t> results = radix_index_->search(key);
-      if (!results.empty()) {
-        std::cout << "[INFO] [DataNode] Found " << results.size()
-                  << " matches using key: " << key << std::endl;
-        return results;
+  try {
+    metrics_->queries.add();
+    LogLine(LogLevel::kInfo, "DataNode", isQueryLogged())
+        << "Processing lookup of " << keys.size() << " composite key(s)";
+
+    std::shared_ptr<const IndexGeneration> generation = currentGeneration();
+    ScopedLatency lookup_latency(metrics_->key_lookup);
+    std::vector<DocId> matching_ids;
+    for (const std::string& key : keys) {
+      for (DocId id : generation->key_index->lookup(key)) {
+        std::optional<AddressRecordView> record =
+            generation->forward_index->getView(id);
+        if (record && hasIndexKey(*record, key)) {
+          matching_ids.push_back(id);
+        }
+      }
+      if (!matching_ids.empty()) {
+        break;
       }
     }
+    lookup_latency.stop();
 
-    // No matches found with composite keys
-    return {};
+    LogLine(LogLevel::kDebug, "DataNode")
+        << "Found " << matching_ids.size() << " records by composite key";
+
+    std::vector<RankedMatch> ranked = rankMatches(
+        *generation, matching_ids, {}, query_terms, max_results, 0.0);
+    for (const RankedMatch& match : ranked) {
+      visitor(*generation->forward_index->getView(match.id), match.score);
+    }
+    return ranked.size();
+  } catch (const std::exception& e) {
+    LogLine(LogLevel::kError, "DataNode")
+        << "Exception during key lookup: " << e.what();
+    return 0;
   }
+}
 
-  // Original logic for multi-term queries
-  // Normalize query terms
-  std::vector<std::string> normalized_terms;
-  for (const auto& term : query_terms) {
-    normalized_terms.push_back(normalizer_->normalize(term));
+bool DataNode::hasIndexKey(const AddressRecordView& record,
+                           const std::string& key) const {
+  std::vector<std::string> keys;
+  appendIndexKeys(normalizer_->normalize(record.number),
+                  normalizer_->normalize(record.street),
+                  normalizer_->normalize(record.city),
+                  normalizer_->normalize(record.postcode), keys);
+  return std::find(keys.begin(), keys.end(), key) != keys.end();
+}
+
+DataNode::RankedCursor DataNode::searchRanked(
+    const std::vector<std::string>& query_terms,
+    size_t max_results,
+    double min_score,
+    int fuzziness) {
+  RankedCursor cursor;
+  cursor.generation_ = currentGeneration();
+  if (max_results == 0 || query_terms.empty()) {
+    return cursor;
   }
 
-  // Find IDs matching the first term
-  std::vector<size_t> first_term_ids =
-      radix_index_->search(normalized_terms[0]);
+  try {
+    metrics_->queries.add();
+    LogLine(LogLevel::kInfo, "DataNode", isQueryLogged())
+        << "Processing ranked search query with " << query_terms.size()
+        << " terms";
+
+    std::vector<uint8_t> edits;
+    std::vector<DocId> matching_ids = findMatchingIds(
+        *cursor.generation_, query_terms, nullptr, fuzziness, &edits);
+    cursor.matches_ = rankMatches(*cursor.generation_, matching_ids, edits,
+                                  query_terms, max_results, min_score);
+
+    LogLine(LogLevel::kDebug, "DataNode")
+        << "Ranked " << cursor.matches_.size() << " of " << matching_ids.size()
+        << " matching IDs";
+  } catch (const std::exception& e) {
+    LogLine(LogLevel::kError, "DataNode")
+        << "Exception during query processing: " << e.what();
+    cursor.matches_.clear();  // Report no results on exception
+  }
+  return cursor;
+}
 
-  if (first_term_ids.empty() || normalized_terms.size() == 1) {
-    return first_term_ids;
+size_t DataNode::RankedCursor::next(size_t max_records,
+                                    const ScoredRecordVisitor& visitor) {
+  size_t count = std::min(max_records, remaining());
+  for (size_t i = 0; i < count; ++i) {
+    const RankedMatch& match = matches_[position_ + i];
+    visitor(*generation_->forward_index->getView(match.id), match.score);
   }
+  position_ += count;
+  return count;
+}
 
-  // Convert to set for efficient intersection
-  std::unordered_set<size_t> result_ids(first_term_ids.begin(),
-                                         first_term_ids.end());
+size_t DataNode::RankedCursor::remaining() const {
+  return matches_.size() - position_;
+}
 
-  // Intersect with results from remaining terms
-  for (size_t i = 1; i < normalized_terms.size(); ++i) {
-    std::vector<size_t> term_ids =
-        radix_index_->search(normalized_terms[i]);
-    std::unordered_set<size_t> term_id_set(term_ids.begin(),
-                                            term_ids.end());
+size_t DataNode::searchTopKBatch(const std::vector<BatchQuery>& queries,
+                                 const BatchRecordVisitor& visitor) {
+  auto start_time = Clock::now();
 
-    // Keep only IDs that appear in both sets
-    std::unordered_set<size_t> intersection;
-    for (const auto& id : result_ids) {
-      if (term_id_set.count(id) > 0) {
-        intersection.insert(id);
-      }
+  // Sort the queries so identical ones are adjacent and answered once, and
+  // queries sharing leading terms end up on the same worker
+  std::vector<size_t> order(queries.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  auto key_less = [&queries](size_t a, size_t b) {
+    const BatchQuery& x = queries[a];
+    const BatchQuery& y = queries[b];
+    if (x.query_terms != y.query_terms) {
+      return x.query_terms < y.query_terms;
     }
+    if (x.max_results != y.max_results) {
+      return x.max_results < y.max_results;
+    }
+    if (x.fuzziness != y.fuzziness) {
+      return x.fuzziness < y.fuzziness;
+    }
+    return x.min_score < y.min_score;
+  };
+  std::sort(order.begin(), order.end(), key_less);
+
+  // group_begins[g] is the first position in order of group g
+  std::vector<size_t> group_begins;
+  for (size_t i = 0; i < order.size(); ++i) {
+    if (i == 0 || key_less(order[i - 1], order[i])) {
+      group_begins.push_back(i);
+    }
+  }
+  size_t group_count = group_begins.size();
+  group_begins.push_back(order.size());
+
+  size_t wanted_threads =
+      (group_count + kMinBatchQueriesPerThread - 1) / kMinBatchQueriesPerThread;
+  size_t thread_count =
+      std::max<size_t>(1, std::min(batchThreadCount(), wanted_threads));
+
+  metrics_->queries.add(queries.size());
+  LogLine(LogLevel::kInfo, "DataNode", isQueryLogged())
+      << "Processing batch of " << queries.size() << " queries (" << group_count
+      << " distinct) with " << thread_count << " thread(s)";
+
+  std::shared_ptr<const IndexGeneration> generation = currentGeneration();
+  std::vector<size_t> visited(thread_count, 0);
+  auto answer_groups = [&](size_t worker) {
+    TermMemo memo;
+    size_t first_group = group_count * worker / thread_count;
+    size_t last_group = group_count * (worker + 1) / thread_count;
+    for (size_t group = first_group; group < last_group; ++group) {
+      const BatchQuery& query = queries[order[group_begins[group]]];
+      std::vector<RankedMatch> ranked;
+      if (!query.query_terms.empty() && query.max_results > 0) {
+        try {
+          std::vector<uint8_t> edits;
+          std::vector<DocId> ids = findMatchingIds(
+              *generation, query.query_terms, &memo, query.fuzziness, &edits);
+          ranked = rankMatches(*generation, ids, edits, query.query_terms,
+                               query.max_results, query.min_score);
+        } catch (const std::exception& e) {
+          LogLine(LogLevel::kError, "DataNode")
+              << "Exception during batch query processing: " << e.what();
+        }
+      }
 
-    result_ids = std::move(intersection);
-
-    if (result_ids.empty()) {
-      break;  // No matches, can stop early
+      for (size_t i = group_begins[group]; i < group_begins[group + 1]; ++i) {
+        for (const RankedMatch& match : ranked) {
+          visitor(order[i], *generation->forward_index->getView(match.id),
+                  match.score);
+        }
+        visited[worker] += ranked.size();
+      }
     }
+  };
+  if (options_.batch_pool) {
+    runOnPool(*options_.batch_pool, thread_count, answer_groups);
+  } else {
+    runParallel(thread_count, answer_groups);
   }
 
-  // Convert back to vector
-  return std::vector<size_t>(result_ids.begin(), result_ids.end());
+  size_t total_visited = 0;
+  for (size_t count : visited) {
+    total_visited += count;
+  }
+  LogLine(LogLevel::kInfo, "DataNode", isQueryLogged())
+      << "Batch complete: " << total_visited << " records for "
+      << queries.size() << " queries in " << elapsedSince(start_time).count()
+      << " ms";
+  return total_visited;
 }
 
-std::vector<AddressRecord> DataNode::search(
-    const std::vector<std::string>& query_terms) {
+size_t DataNode::searchNearest(const GeoPoint& point,
+                               size_t max_results,
+                               double max_distance_meters,
+                               const std::vector<std::string>& query_terms,
+                               const NearbyRecordVisitor& visitor) {
   try {
-    std::cout << "[INFO] [DataNode] Processing search query with "
-              << query_terms.size() << " terms" << std::endl;
+    metrics_->queries.add();
+    LogLine(LogLevel::kInfo, "DataNode", isQueryLogged())
+        << "Processing nearest search at (" << point.latitude << ", "
+        << point.longitude << ") with " << query_terms.size() << " terms";
+
+    if (!point.isValid()) {
+      LogLine(LogLevel::kWarning, "DataNode")
+          << "Invalid search point, returning 0 results";
+      return 0;
+    }
 
+    std::shared_ptr<const IndexGeneration> generation = currentGeneration();
+    std::vector<SpatialIndex::Neighbor> neighbors;
     if (query_terms.empty()) {
-      std::cout << "[INFO] [DataNode] Empty query, returning 0 results"
-                << std::endl;
-      return {};
+      neighbors = generation->spatial_index->nearest(point, max_results,
+                                                     max_distance_meters);
+    } else {
+      // The text matches are usually far fewer than the records in range,
+      // so rank them by distance directly with a bounded heap
+      auto closer = [](const SpatialIndex::Neighbor& a,
+                       const SpatialIndex::Neighbor& b) {
+        return a.distance_meters != b.distance_meters
+                   ? a.distance_meters < b.distance_meters
+                   : a.id < b.id;
+      };
+      for (DocId id : findMatchingIds(*generation, query_terms)) {
+        std::optional<AddressRecordView> record =
+            generation->forward_index->getView(id);
+        if (!record.has_value()) {
+          continue;
+        }
+        GeoPoint record_point{record->longitude, record->latitude};
+        if (!record_point.isValid()) {
+          continue;
+        }
+        SpatialIndex::Neighbor neighbor{id,
+                                        distanceMeters(point, record_point)};
+        if (max_distance_meters > 0.0 &&
+            neighbor.distance_meters > max_distance_meters) {
+          continue;
+        }
+        if (neighbors.size() < max_results) {
+          neighbors.push_back(neighbor);
+          std::push_heap(neighbors.begin(), neighbors.end(), closer);
+        } else if (max_results > 0 && closer(neighbor, neighbors.front())) {
+          std::pop_heap(neighbors.begin(), neighbors.end(), closer);
+          neighbors.back() = neighbor;
+          std::push_heap(neighbors.begin(), neighbors.end(), closer);
+        }
+      }
+      std::sort_heap(neighbors.begin(), neighbors.end(), closer);
     }
 
-    // Find matching IDs using RadixTreeIndex
-    std::vector<size_t> matching_ids = findMatchingIds(query_terms);
+    size_t visited = 0;
+    for (const SpatialIndex::Neighbor& neighbor : neighbors) {
+      std::optional<AddressRecordView> record =
+          generation->forward_index->getView(neighbor.id);
+      if (!record.has_value()) {
+        LogLine(LogLevel::kWarning, "DataNode")
+            << "Index inconsistency: ID " << neighbor.id
+            << " found in SpatialIndex but not in ForwardIndex";
+        continue;
+      }
+      visitor(record.value(), neighbor.distance_meters);
+      visited++;
+    }
 
-    std::cout << "[INFO] [DataNode] Found " << matching_ids.size()
-              << " matching IDs" << std::endl;
+    LogLine(LogLevel::kDebug, "DataNode")
+        << "Returning " << visited << " nearest records";
+    return visited;
+  } catch (const std::exception& e) {
+    LogLine(LogLevel::kError, "DataNode")
+        << "Exception during query processing: " << e.what();
+    return 0;  // Report no results on exception
+  }
+}
 
-    // Retrieve complete records from ForwardIndex
-    std::vector<AddressRecord> results;
-    for (const auto& id : matching_ids) {
-      std::optional<AddressRecord> record = forward_index_->get(id);
-      if (record.has_value()) {
-        results.push_back(record.value());
-      } else {
-        std::cerr << "[WARNING] [DataNode] Index inconsistency: ID " << id
-                  << " found in RadixTree but not in ForwardIndex" << std::endl;
-      }
+size_t DataNode::searchBox(const GeoBox& box,
+                           size_t max_results,
+                           const std::vector<std::string>& query_terms,
+                           const RecordVisitor& visitor) {
+  try {
+    metrics_->queries.add();
+    LogLine(LogLevel::kInfo, "DataNode", isQueryLogged())
+        << "Processing box search (" << box.min_latitude << ", "
+        << box.min_longitude << ") - (" << box.max_latitude << ", "
+        << box.max_longitude << ") with " << query_terms.size() << " terms";
+
+    if (!box.isValid()) {
+      LogLine(LogLevel::kWarning, "DataNode")
+          << "Invalid search box, returning 0 results";
+      return 0;
     }
 
-    std::cout << "[INFO] [DataNode] Returning " << results.size()
-              << " complete records" << std::endl;
+    // With query terms, filter the text matches by area instead of
+    // intersecting two ID lists
+    std::shared_ptr<const IndexGeneration> generation = currentGeneration();
+    bool filter_by_box = !query_terms.empty();
+    std::vector<DocId> ids;
+    if (filter_by_box) {
+      ids = findMatchingIds(*generation, query_terms);
+    } else {
+      ids = generation->spatial_index->searchBox(box);
+    }
 
-    return results;
+    size_t visited = 0;
+    for (DocId id : ids) {
+      if (visited >= max_results) {
+        break;
+      }
+      std::optional<AddressRecordView> record =
+          generation->forward_index->getView(id);
+      if (!record.has_value()) {
+        LogLine(LogLevel::kWarning, "DataNode")
+            << "Index inconsistency: ID " << id
+            << " found in an index but not in ForwardIndex";
+        continue;
+      }
+      if (filter_by_box &&
+          !box.contains(GeoPoint{record->longitude, record->latitude})) {
+        continue;
+      }
+      visitor(record.value());
+      visited++;
+    }
+
+    LogLine(LogLevel::kDebug, "DataNode")
+        << "Returning " << visited << " records in box";
+    return visited;
   } catch (const std::exception& e) {
-    std::cerr << "[ERROR] [DataNode] Exception during query processing: "
-              << e.what() << std::endl;
-    return {};  // Return empty result on exception
+    LogLine(LogLevel::kError, "DataNode")
+        << "Exception during query processing: " << e.what();
+    return 0;  // Report no results on exception
+  }
+}
+
+std::vector<DocId> DataNode::searchSorted(const IndexGeneration& generation,
+                                          const std::string& term,
+                                          TermMemo* memo) {
+  if (memo != nullptr) {
+    auto it = memo->postings.find(term);
+    if (it != memo->postings.end()) {
+      return it->second;
+    }
+  }
+
+  const RadixTreeIndex& radix_index = *generation.radix_index;
+  PostingsCache* postings_cache = generation.postings_cache.get();
+  std::vector<DocId> ids;
+  if (!postings_cache) {
+    ids = radix_index.searchSorted(term);
+  } else {
+    // Cache per trie node, so every prefix ending on the same node shares
+    // one list
+    size_t node = radix_index.findPrefixNode(term);
+    if (node != RadixTreeIndex::kNoNode) {
+      uint32_t cache_key = static_cast<uint32_t>(node);
+      if (!postings_cache->lookup(cache_key, ids)) {
+        ids = radix_index.collectSorted(node);
+        postings_cache->offer(cache_key, ids);
+      }
+    }
   }
+
+  if (memo != nullptr && memo->id_count + ids.size() <= kMaxBatchMemoIds) {
+    memo->id_count += ids.size();
+    memo->postings.emplace(term, ids);
+  }
+  return ids;
 }
 
-DataNode::Statistics DataNode::getStatistics() const { return stats_; }
+DataNode::Metrics& DataNode::getMetrics() const { return *metrics_; }
+
+DataNode::Statistics DataNode::getStatistics() const {
+  std::shared_ptr<const IndexGeneration> generation = currentGeneration();
+  Statistics stats = generation->stats;
+  stats.postings_cache = generation->postings_cache
+                             ? generation->postings_cache->getStats()
+                             : PostingsCache::Stats{};
+  return stats;
+}
@@ -1,49 +1,149 @@
 #include "data_node/forward_index.h"
 
-void ForwardIndex::insert(size_t id, const AddressRecord& record) {
-  records_[id] = record;
+#include <limits>
+#include <stdexcept>
+
+DocId ForwardIndex::insert(const AddressRecord& record) {
+  if (snapshot_) {
+    throw std::logic_error("Cannot insert into a snapshot-backed ForwardIndex");
+  }
+  if (hashes_.size() >= std::numeric_limits<DocId>::max()) {
+    throw std::length_error("ForwardIndex exceeds 32-bit DocId space");
+  }
+
+  DocId id = static_cast<DocId>(hashes_.size());
+
+  longitudes_.push_back(record.longitude);
+  latitudes_.push_back(record.latitude);
+  hashes_.push_back(record.hash);
+
+  string_fields_.push_back(strings_.intern(record.number));
+  string_fields_.push_back(strings_.intern(record.street));
+  string_fields_.push_back(strings_.intern(record.unit));
+  string_fields_.push_back(strings_.intern(record.city));
+  string_fields_.push_back(strings_.intern(record.postcode));
+  string_fields_.push_back(strings_.intern(record.original_street));
+  string_fields_.push_back(strings_.intern(record.original_unit));
+  string_fields_.push_back(strings_.intern(record.original_city));
+
+  syncViews();
+  return id;
 }
 
-std::optional<AddressRecord> ForwardIndex::get(size_t id) const {
-  auto it = records_.find(id);
-  if (it != records_.end()) {
-    return it->second;
+std::optional<AddressRecord> ForwardIndex::get(DocId id) const {
+  std::optional<AddressRecordView> view = getView(id);
+  if (!view.has_value()) {
+    return std::nullopt;
   }
-  return std::nullopt;
+  return view->toRecord();
 }
 
-bool ForwardIndex::contains(size_t id) const {
-  return records_.find(id) != records_.end();
+std::optional<AddressRecordView> ForwardIndex::getView(DocId id) const {
+  if (!contains(id)) {
+    return std::nullopt;
+  }
+
+  AddressRecordView view;
+  view.longitude = longitudes_view_[id];
+  view.latitude = latitudes_view_[id];
+  view.hash = hashes_view_[id];
+  view.number = getString(id, kNumber);
+  view.street = getString(id, kStreet);
+  view.unit = getString(id, kUnit);
+  view.city = getString(id, kCity);
+  view.postcode = getString(id, kPostcode);
+  view.original_street = getString(id, kOriginalStreet);
+  view.original_unit = getString(id, kOriginalUnit);
+  view.original_city = getString(id, kOriginalCity);
+  return view;
+}
+
+bool ForwardIndex::contains(DocId id) const {
+  return id < hashes_view_.size();
 }
 
 size_t ForwardIndex::getStorageSize() const {
-  size_t total_size = 0;
+  size_t total_size = sizeof(ForwardIndex);
+  if (snapshot_) {
+    total_size += longitudes_view_.size() * sizeof(double);
+    total_size += latitudes_view_.size() * sizeof(double);
+    total_size += hashes_view_.size() * sizeof(uint64_t);
+    total_size +=
+        string_fields_view_.size() * sizeof(StringPool::StringId);
+    return total_size + strings_.getMemoryUsage();
+  }
 
-  // Size of the unordered_map overhead
-  total_size += sizeof(records_);
+  // Fixed-width columns
+  total_size += longitudes_.capacity() * sizeof(double);
+  total_size += latitudes_.capacity() * sizeof(double);
+  total_size += hashes_.capacity() * sizeof(uint64_t);
+  total_size += string_fields_.capacity() * sizeof(StringPool::StringId);
 
-  // Size of each entry in the map
-  for (const auto& [id, record] : records_) {
-    // Size of the key (size_t)
-    total_size += sizeof(size_t);
+  // Deduplicated string content
+  total_size += strings_.getMemoryUsage();
 
-    // Size of the AddressRecord
-    total_size += sizeof(AddressRecord);
+  return total_size;
+}
 
-    // Size of dynamic string content in AddressRecord
-    total_size += record.number.capacity();
-    total_size += record.street.capacity();
-    total_size += record.unit.capacity();
-    total_size += record.city.capacity();
-    total_size += record.postcode.capacity();
-    total_size += record.original_street.capacity();
-    total_size += record.original_unit.capacity();
-    total_size += record.original_city.capacity();
+size_t ForwardIndex::getRecordCount() const {
+  return hashes_view_.size();
+}
+
+void ForwardIndex::addToSnapshot(SnapshotWriter& writer) const {
+  writer.addArray(SnapshotSection::kForwardLongitudes, longitudes_view_);
+  writer.addArray(SnapshotSection::kForwardLatitudes, latitudes_view_);
+  writer.addArray(SnapshotSection::kForwardHashes, hashes_view_);
+  writer.addArray(SnapshotSection::kForwardStringFields, string_fields_view_);
+  strings_.addToSnapshot(writer);
+}
+
+bool ForwardIndex::loadFromSnapshot(
+    std::shared_ptr<const IndexSnapshot> snapshot) {
+  auto longitudes =
+      snapshot->getArray<double>(SnapshotSection::kForwardLongitudes);
+  auto latitudes =
+      snapshot->getArray<double>(SnapshotSection::kForwardLatitudes);
+  auto hashes = snapshot->getArray<uint64_t>(SnapshotSection::kForwardHashes);
+  auto string_fields = snapshot->getArray<StringPool::StringId>(
+      SnapshotSection::kForwardStringFields);
+  if (!longitudes || !latitudes || !hashes || !string_fields) {
+    return false;
   }
 
-  return total_size;
+  // All columns must describe the same records
+  size_t count = hashes->size();
+  if (longitudes->size() != count || latitudes->size() != count ||
+      string_fields->size() != count * kStringFieldCount ||
+      count > std::numeric_limits<DocId>::max()) {
+    return false;
+  }
+  if (!strings_.loadFromSnapshot(snapshot)) {
+    return false;
+  }
+
+  longitudes_view_ = *longitudes;
+  latitudes_view_ = *latitudes;
+  hashes_view_ = *hashes;
+  string_fields_view_ = *string_fields;
+  snapshot_ = std::move(snapshot);
+
+  // Release the build storage
+  std::vector<double>().swap(longitudes_);
+  std::vector<double>().swap(latitudes_);
+  std::vector<uint64_t>().swap(hashes_);
+  std::vector<StringPool::StringId>().swap(string_fields_);
+  return true;
 }
 
-size_t ForwardIndex::getRecordCount() const {
-  return records_.size();
+std::string_view ForwardIndex::getString(DocId id, StringField field) const {
+  return strings_.get(
+      string_fields_view_[static_cast<size_t>(id) * kStringFieldCount +
+                          field]);
+}
+
+void ForwardIndex::syncViews() {
+  longitudes_view_ = ArrayView<double>(longitudes_);
+  latitudes_view_ = ArrayView<double>(latitudes_);
+  hashes_view_ = ArrayView<uint64_t>(hashes_);
+  string_fields_view_ = ArrayView<StringPool::StringId>(string_fields_);
 }
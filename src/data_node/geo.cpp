@@ -0,0 +1,79 @@
+#include "data_node/geo.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double kRadiansPerDegree = M_PI / 180.0;
+
+// sin^2(angle / 2) for an angle in degrees
+double haversine(double degrees) {
+  double half_sine = std::sin(degrees * kRadiansPerDegree / 2.0);
+  return half_sine * half_sine;
+}
+
+double centralAngleMeters(double haversine_value) {
+  return 2.0 * kEarthRadiusMeters *
+         std::asin(std::sqrt(std::min(1.0, haversine_value)));
+}
+
+// Smallest longitude difference in degrees, going either way around
+double longitudeGap(double a, double b) {
+  double gap = std::fabs(a - b);
+  return std::min(gap, 360.0 - gap);
+}
+
+}  // namespace
+
+bool GeoPoint::isValid() const {
+  return std::isfinite(longitude) && std::isfinite(latitude) &&
+         longitude >= -180.0 && longitude <= 180.0 && latitude >= -90.0 &&
+         latitude <= 90.0;
+}
+
+bool GeoBox::isValid() const {
+  return GeoPoint{min_longitude, min_latitude}.isValid() &&
+         GeoPoint{max_longitude, max_latitude}.isValid() &&
+         min_longitude <= max_longitude && min_latitude <= max_latitude;
+}
+
+bool GeoBox::contains(const GeoPoint& point) const {
+  return point.longitude >= min_longitude &&
+         point.longitude <= max_longitude && point.latitude >= min_latitude &&
+         point.latitude <= max_latitude;
+}
+
+double distanceMeters(const GeoPoint& a, const GeoPoint& b) {
+  double value = haversine(b.latitude - a.latitude) +
+                 std::cos(a.latitude * kRadiansPerDegree) *
+                     std::cos(b.latitude * kRadiansPerDegree) *
+                     haversine(longitudeGap(a.longitude, b.longitude));
+  return centralAngleMeters(value);
+}
+
+double minDistanceMeters(const GeoPoint& point, const GeoBox& box) {
+  if (box.contains(point)) {
+    return 0.0;
+  }
+
+  // Any point of the box is at least this far in latitude and longitude
+  double latitude_gap = std::max({0.0, box.min_latitude - point.latitude,
+                                  point.latitude - box.max_latitude});
+  double longitude_gap = 0.0;
+  if (point.longitude < box.min_longitude ||
+      point.longitude > box.max_longitude) {
+    longitude_gap = std::min(longitudeGap(point.longitude, box.min_longitude),
+                             longitudeGap(point.longitude, box.max_longitude));
+  }
+
+  // Bound each haversine term: the cosine of a latitude within the box is
+  // smallest at one of its edges
+  double min_cosine =
+      std::min(std::cos(box.min_latitude * kRadiansPerDegree),
+               std::cos(box.max_latitude * kRadiansPerDegree));
+  double value = haversine(latitude_gap) +
+                 std::cos(point.latitude * kRadiansPerDegree) *
+                     std::max(0.0, min_cosine) * haversine(longitude_gap);
+  return centralAngleMeters(value);
+}
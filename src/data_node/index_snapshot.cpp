@@ -0,0 +1,284 @@
+#include "data_node/index_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#include "data_node/logging.h"
+
+namespace {
+
+constexpr char kMagic[8] = {'G', 'E', 'O', 'I', 'N', 'D', 'E', 'X'};
+constexpr uint32_t kByteOrderMark = 0x01020304;
+constexpr size_t kSectionAlignment = 64;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;  // kByteOrderMark as written by the producing host
+  uint64_t source_size;
+  uint64_t source_hash;
+  uint32_t section_count;
+  uint32_t reserved;
+  uint64_t table_checksum;   // Checksum of the section table
+  uint64_t header_checksum;  // Checksum of this header with this field zero
+};
+
+struct SectionEntry {
+  uint32_t id;
+  uint32_t reserved;
+  uint64_t offset;
+  uint64_t size;
+  uint64_t checksum;
+};
+
+static_assert(std::is_trivially_copyable<FileHeader>::value &&
+                  sizeof(FileHeader) == 56,
+              "FileHeader layout is part of the snapshot format");
+static_assert(std::is_trivially_copyable<SectionEntry>::value &&
+                  sizeof(SectionEntry) == 32,
+              "SectionEntry layout is part of the snapshot format");
+
+// 64-bit checksum consuming 8 bytes per step; the tail is zero-padded
+uint64_t checksum64(const void* data, size_t size) {
+  constexpr uint64_t kMultiplier = 0x9E3779B97F4A7C15ULL;
+  const char* bytes = static_cast<const char*>(data);
+  uint64_t hash = size * kMultiplier;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, 8);
+    hash = (hash ^ word) * kMultiplier;
+    hash ^= hash >> 29;
+  }
+  if (i < size) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes + i, size - i);
+    hash = (hash ^ word) * kMultiplier;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
+
+uint64_t headerChecksum(FileHeader header) {
+  header.header_checksum = 0;
+  return checksum64(&header, sizeof(header));
+}
+
+size_t alignUp(size_t value) {
+  return (value + kSectionAlignment - 1) / kSectionAlignment *
+         kSectionAlignment;
+}
+
+}  // namespace
+
+std::optional<SourceFingerprint> SourceFingerprint::ofFile(
+    const std::string& path) {
+  std::unique_ptr<MappedFile> file = MappedFile::open(path);
+  if (!file) {
+    return std::nullopt;
+  }
+  SourceFingerprint fingerprint;
+  fingerprint.file_size = file->size();
+  fingerprint.content_hash = checksum64(file->data(), file->size());
+  return fingerprint;
+}
+
+std::unique_ptr<MappedFile> MappedFile::open(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0) {
+    ::close(fd);
+    return nullptr;
+  }
+
+  size_t size = static_cast<size_t>(file_stat.st_size);
+  const char* data = nullptr;
+  if (size > 0) {
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      ::close(fd);
+      return nullptr;
+    }
+    data = static_cast<const char*>(mapping);
+  }
+
+  // The mapping stays valid after the descriptor is closed
+  ::close(fd);
+  return std::unique_ptr<MappedFile>(new MappedFile(data, size));
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    ::munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+void SnapshotWriter::addSection(SnapshotSection id,
+                                const void* data,
+                                size_t size) {
+  sections_.push_back(PendingSection{id, data, size});
+}
+
+bool SnapshotWriter::write(const std::string& path,
+                           const SourceFingerprint& source) const {
+  // Lay out the header, the section table, then the aligned sections
+  std::vector<SectionEntry> table(sections_.size());
+  size_t offset =
+      alignUp(sizeof(FileHeader) + table.size() * sizeof(SectionEntry));
+  for (size_t i = 0; i < sections_.size(); ++i) {
+    table[i].id = static_cast<uint32_t>(sections_[i].id);
+    table[i].reserved = 0;
+    table[i].offset = offset;
+    table[i].size = sections_[i].size;
+    table[i].checksum = checksum64(sections_[i].data, sections_[i].size);
+    offset = alignUp(offset + sections_[i].size);
+  }
+
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = IndexSnapshot::kFormatVersion;
+  header.byte_order = kByteOrderMark;
+  header.source_size = source.file_size;
+  header.source_hash = source.content_hash;
+  header.section_count = static_cast<uint32_t>(table.size());
+  header.table_checksum =
+      checksum64(table.data(), table.size() * sizeof(SectionEntry));
+  header.header_checksum = headerChecksum(header);
+
+  // Write to a temporary file and rename it over the target, so readers
+  // never observe a partially written snapshot
+  std::string temp_path = path + ".tmp";
+  {
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+      LogLine(LogLevel::kWarning, "Snapshot")
+          << "Could not create snapshot file: " << temp_path;
+      return false;
+    }
+
+    const char padding[kSectionAlignment] = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table.data()),
+              table.size() * sizeof(SectionEntry));
+    size_t written = sizeof(header) + table.size() * sizeof(SectionEntry);
+    for (size_t i = 0; i < sections_.size(); ++i) {
+      out.write(padding, table[i].offset - written);
+      out.write(static_cast<const char*>(sections_[i].data),
+                sections_[i].size);
+      written = table[i].offset + sections_[i].size;
+    }
+
+    out.flush();
+    if (!out.good()) {
+      LogLine(LogLevel::kWarning, "Snapshot")
+          << "Failed writing snapshot file: " << temp_path;
+      out.close();
+      std::remove(temp_path.c_str());
+      return false;
+    }
+  }
+
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    LogLine(LogLevel::kWarning, "Snapshot")
+        << "Could not move snapshot into place: " << path;
+    std::remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+IndexSnapshot::IndexSnapshot(std::unique_ptr<MappedFile> file)
+    : file_(std::move(file)) {}
+
+std::shared_ptr<const IndexSnapshot> IndexSnapshot::open(
+    const std::string& path, const SourceFingerprint& source) {
+  std::unique_ptr<MappedFile> file = MappedFile::open(path);
+  if (!file) {
+    LogLine(LogLevel::kInfo, "Snapshot") << "No snapshot found at " << path;
+    return nullptr;
+  }
+
+  auto reject = [&path](const std::string& reason) {
+    LogLine(LogLevel::kWarning, "Snapshot")
+        << "Ignoring snapshot " << path << ": " << reason;
+    return nullptr;
+  };
+
+  FileHeader header;
+  if (file->size() < sizeof(header)) {
+    return reject("file too small");
+  }
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    return reject("not a snapshot file");
+  }
+  if (header.header_checksum != headerChecksum(header)) {
+    return reject("header checksum mismatch");
+  }
+  if (header.version != kFormatVersion) {
+    return reject("format version " + std::to_string(header.version) +
+                  " (expected " + std::to_string(kFormatVersion) + ")");
+  }
+  if (header.byte_order != kByteOrderMark) {
+    return reject("written with a different byte order");
+  }
+  if (header.source_size != source.file_size ||
+      header.source_hash != source.content_hash) {
+    return reject("built from a different data file");
+  }
+
+  size_t table_size = static_cast<size_t>(header.section_count) *
+                      sizeof(SectionEntry);
+  if (file->size() - sizeof(header) < table_size) {
+    return reject("truncated section table");
+  }
+  std::vector<SectionEntry> table(header.section_count);
+  std::memcpy(table.data(), file->data() + sizeof(header), table_size);
+  if (header.table_checksum != checksum64(table.data(), table_size)) {
+    return reject("section table checksum mismatch");
+  }
+
+  std::shared_ptr<IndexSnapshot> snapshot(new IndexSnapshot(std::move(file)));
+  const char* base = snapshot->file_->data();
+  size_t file_size = snapshot->file_->size();
+  for (const SectionEntry& entry : table) {
+    if (entry.offset % kSectionAlignment != 0 || entry.offset > file_size ||
+        entry.size > file_size - entry.offset) {
+      return reject("section out of bounds");
+    }
+    if (entry.checksum != checksum64(base + entry.offset, entry.size)) {
+      return reject("section " + std::to_string(entry.id) +
+                    " checksum mismatch");
+    }
+    snapshot->sections_.push_back(Section{
+        static_cast<SnapshotSection>(entry.id), base + entry.offset,
+        static_cast<size_t>(entry.size)});
+  }
+
+  return snapshot;
+}
+
+size_t IndexSnapshot::getMappedSize() const { return file_->size(); }
+
+const IndexSnapshot::Section* IndexSnapshot::findSection(
+    SnapshotSection id) const {
+  for (const Section& section : sections_) {
+    if (section.id == id) {
+      return &section;
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,108 @@
+#include "data_node/logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <iostream>
+
+namespace {
+
+std::atomic<int> g_log_level{static_cast<int>(LogLevel::kInfo)};
+std::atomic<uint32_t> g_query_log_sampling{1};
+
+// Whether the query being served on this thread is logged
+thread_local bool t_query_logged = true;
+
+// Reused for every line of a thread, so formatting allocates only until the
+// buffer has grown to the longest line
+std::ostringstream& threadLineStream() {
+  thread_local std::ostringstream stream;
+  return stream;
+}
+
+}  // namespace
+
+const char* logLevelName(LogLevel level) {
+  switch (level) {
+    case LogLevel::kDebug:
+      return "DEBUG";
+    case LogLevel::kInfo:
+      return "INFO";
+    case LogLevel::kWarning:
+      return "WARNING";
+    case LogLevel::kError:
+      return "ERROR";
+  }
+  return "INFO";
+}
+
+void setLogLevel(LogLevel level) {
+  g_log_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool isLogEnabled(LogLevel level) {
+  return static_cast<int>(level) >=
+         g_log_level.load(std::memory_order_relaxed);
+}
+
+void setQueryLogSampling(uint32_t every) {
+  g_query_log_sampling.store(every > 0 ? every : 1,
+                             std::memory_order_relaxed);
+}
+
+bool beginQueryLog() {
+  uint32_t every = g_query_log_sampling.load(std::memory_order_relaxed);
+  if (every <= 1 || isLogEnabled(LogLevel::kDebug)) {
+    t_query_logged = true;
+  } else {
+    // Counted per thread, so sampling needs no shared state
+    thread_local uint32_t queries = 0;
+    t_query_logged = queries++ % every == 0;
+  }
+  return t_query_logged;
+}
+
+bool isQueryLogged() { return t_query_logged; }
+
+std::optional<LogLevel> parseLogLevel(const std::string& name) {
+  std::string upper(name);
+  std::transform(upper.begin(), upper.end(), upper.begin(), [](char c) {
+    return static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+  });
+  if (upper == "DEBUG") {
+    return LogLevel::kDebug;
+  }
+  if (upper == "INFO") {
+    return LogLevel::kInfo;
+  }
+  if (upper == "WARN" || upper == "WARNING") {
+    return LogLevel::kWarning;
+  }
+  if (upper == "ERROR") {
+    return LogLevel::kError;
+  }
+  return std::nullopt;
+}
+
+LogLine::LogLine(LogLevel level, const char* component, bool enabled)
+    : level_(level), stream_(nullptr) {
+  if (!enabled || !isLogEnabled(level)) {
+    return;
+  }
+  stream_ = &threadLineStream();
+  stream_->str(std::string());
+  *stream_ << '[' << logLevelName(level) << "] ";
+  if (component != nullptr) {
+    *stream_ << '[' << component << "] ";
+  }
+}
+
+LogLine::~LogLine() {
+  if (stream_ == nullptr) {
+    return;
+  }
+  *stream_ << '\n';
+  std::string line = stream_->str();
+  std::ostream& out = level_ >= LogLevel::kWarning ? std::cerr : std::cout;
+  out.write(line.data(), static_cast<std::streamsize>(line.size()));
+}
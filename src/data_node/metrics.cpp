@@ -0,0 +1,179 @@
+#include "data_node/metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+std::atomic<size_t> g_next_stripe{0};
+
+// Index of the highest set bit of a non-zero value
+int highestBit(uint64_t value) {
+  int bit = 0;
+  while (value >>= 1) {
+    bit++;
+  }
+  return bit;
+}
+
+// Format a sample value: integers without a fraction, others with enough
+// digits to round-trip a latency in seconds
+std::string formatValue(double value) {
+  char buffer[32];
+  if (value == std::floor(value) && std::fabs(value) < 1e15) {
+    std::snprintf(buffer, sizeof(buffer), "%.0f", value);
+  } else {
+    std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+  }
+  return buffer;
+}
+
+// Append "name{labels,extra} value\n", leaving out empty braces
+void appendSample(std::string& out,
+                  const std::string& name,
+                  const std::string& labels,
+                  const std::string& extra,
+                  double value) {
+  out += name;
+  if (!labels.empty() || !extra.empty()) {
+    out += '{';
+    out += labels;
+    if (!labels.empty() && !extra.empty()) {
+      out += ',';
+    }
+    out += extra;
+    out += '}';
+  }
+  out += ' ';
+  out += formatValue(value);
+  out += '\n';
+}
+
+}  // namespace
+
+size_t metricStripe() {
+  thread_local size_t stripe =
+      g_next_stripe.fetch_add(1, std::memory_order_relaxed) % kMetricStripes;
+  return stripe;
+}
+
+size_t LatencyHistogram::bucketOf(uint64_t nanos) {
+  if (nanos < kSubBuckets) {
+    return static_cast<size_t>(nanos);
+  }
+  int bit = highestBit(nanos);
+  if (bit > kMaxValueBits) {
+    return kBucketCount - 1;
+  }
+  int shift = bit - kSubBucketBits;
+  size_t sub_bucket = static_cast<size_t>(nanos >> shift) & (kSubBuckets - 1);
+  return static_cast<size_t>(shift + 1) * kSubBuckets + sub_bucket;
+}
+
+uint64_t LatencyHistogram::bucketLowerBound(size_t bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+  int shift = static_cast<int>(bucket / kSubBuckets) - 1;
+  uint64_t sub_bucket = bucket % kSubBuckets;
+  return (kSubBuckets + sub_bucket) << shift;
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency) {
+  recordNanos(latency.count() > 0 ? static_cast<uint64_t>(latency.count())
+                                  : 0);
+}
+
+void LatencyHistogram::recordNanos(uint64_t nanos) {
+  Stripe& stripe = stripes_[metricStripe()];
+  stripe.buckets[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+  stripe.count.fetch_add(1, std::memory_order_relaxed);
+  stripe.sum.fetch_add(nanos, std::memory_order_relaxed);
+  // Only this thread's stripe mates compete for max, so the loop rarely
+  // retries
+  uint64_t max = stripe.max.load(std::memory_order_relaxed);
+  while (nanos > max && !stripe.max.compare_exchange_weak(
+                            max, nanos, std::memory_order_relaxed)) {
+  }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+  Snapshot snapshot;
+  snapshot.buckets.assign(kBucketCount, 0);
+  for (const Stripe& stripe : stripes_) {
+    for (size_t i = 0; i < kBucketCount; ++i) {
+      uint64_t count = stripe.buckets[i].load(std::memory_order_relaxed);
+      snapshot.buckets[i] += count;
+      snapshot.count += count;
+    }
+    snapshot.sum += stripe.sum.load(std::memory_order_relaxed);
+    snapshot.max =
+        std::max(snapshot.max, stripe.max.load(std::memory_order_relaxed));
+  }
+  return snapshot;
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double q) const {
+  if (count == 0) {
+    return 0;
+  }
+  q = std::min(std::max(q, 0.0), 1.0);
+  uint64_t rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(count))));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      uint64_t upper = i + 1 < kBucketCount ? bucketLowerBound(i + 1) - 1
+                                            : bucketLowerBound(i);
+      return std::min(upper, max);
+    }
+  }
+  return max;
+}
+
+double LatencyHistogram::Snapshot::mean() const {
+  return count == 0 ? 0.0
+                    : static_cast<double>(sum) / static_cast<double>(count);
+}
+
+uint64_t Counter::value() const {
+  uint64_t total = 0;
+  for (const Stripe& stripe : stripes_) {
+    total += stripe.value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+void appendPrometheusHeader(std::string& out,
+                            const std::string& name,
+                            const char* type,
+                            const std::string& help) {
+  out += "# HELP " + name + " " + help + "\n";
+  out += "# TYPE " + name + " " + type + "\n";
+}
+
+void appendPrometheusSummary(std::string& out,
+                             const std::string& name,
+                             const std::string& labels,
+                             const LatencyHistogram::Snapshot& snapshot) {
+  static const char* const kQuantiles[] = {"0.5", "0.9", "0.99", "0.999"};
+  for (const char* quantile : kQuantiles) {
+    double seconds =
+        static_cast<double>(snapshot.percentile(std::stod(quantile))) / 1e9;
+    appendSample(out, name, labels,
+                 std::string("quantile=\"") + quantile + "\"", seconds);
+  }
+  appendSample(out, name + "_sum", labels, "",
+               static_cast<double>(snapshot.sum) / 1e9);
+  appendSample(out, name + "_count", labels, "",
+               static_cast<double>(snapshot.count));
+}
+
+void appendPrometheusSample(std::string& out,
+                            const std::string& name,
+                            const std::string& labels,
+                            double value) {
+  appendSample(out, name, labels, "", value);
+}
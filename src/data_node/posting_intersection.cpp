@@ -0,0 +1,66 @@
+#include "data_node/posting_intersection.h"
+
+#include <algorithm>
+#include <utility>
+
+size_t gallopTo(ArrayView<DocId> ids, size_t begin, DocId target) {
+  size_t size = ids.size();
+  if (begin >= size || ids[begin] >= target) {
+    return begin;
+  }
+
+  // ids[low] < target throughout; stop once ids[high] >= target or past end
+  size_t low = begin;
+  size_t step = 1;
+  size_t high = begin + step;
+  while (high < size && ids[high] < target) {
+    low = high;
+    step *= 2;
+    high = low + step;
+  }
+  high = std::min(high, size);
+  return static_cast<size_t>(
+      std::lower_bound(ids.begin() + low + 1, ids.begin() + high, target) -
+      ids.begin());
+}
+
+void intersectSorted(ArrayView<DocId> a,
+                     ArrayView<DocId> b,
+                     std::vector<DocId>& out) {
+  out.clear();
+  if (a.size() > b.size()) {
+    std::swap(a, b);
+  }
+  if (a.empty()) {
+    return;
+  }
+  out.reserve(a.size());
+
+  if (b.size() / a.size() >= kGallopRatio) {
+    // Skewed sizes: look each ID of the short list up in the long one
+    size_t position = 0;
+    for (DocId id : a) {
+      position = gallopTo(b, position, id);
+      if (position == b.size()) {
+        break;
+      }
+      if (b[position] == id) {
+        out.push_back(id);
+      }
+    }
+    return;
+  }
+
+  // Similar sizes: linear merge
+  size_t i = 0;
+  size_t j = 0;
+  while (i < a.size() && j < b.size()) {
+    DocId x = a[i];
+    DocId y = b[j];
+    if (x == y) {
+      out.push_back(x);
+    }
+    i += x <= y;
+    j += y <= x;
+  }
+}
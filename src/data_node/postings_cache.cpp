@@ -0,0 +1,128 @@
+#include "data_node/postings_cache.h"
+
+#include <utility>
+
+#include "data_node/varint.h"
+
+PostingsCache::PostingsCache(size_t max_bytes)
+    : max_bytes_(max_bytes),
+      bytes_(0),
+      frequency_{},
+      accesses_since_aging_(0),
+      hits_(0),
+      misses_(0),
+      admissions_(0),
+      evictions_(0) {}
+
+bool PostingsCache::lookup(uint32_t node, std::vector<DocId>& ids) {
+  std::shared_ptr<const std::vector<uint8_t>> encoded;
+  size_t count = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    uint8_t& frequency = frequency_[node % kFrequencySlots];
+    if (frequency < UINT8_MAX) {
+      frequency++;
+    }
+    if (++accesses_since_aging_ >= kAgingInterval) {
+      for (uint8_t& slot : frequency_) {
+        slot /= 2;
+      }
+      accesses_since_aging_ = 0;
+    }
+
+    auto it = index_.find(node);
+    if (it == index_.end()) {
+      misses_++;
+      return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    encoded = it->second->encoded;
+    count = it->second->count;
+    hits_++;
+  }
+
+  // Decompress outside the lock; the shared list outlives any eviction
+  decode(*encoded, count, ids);
+  return true;
+}
+
+void PostingsCache::offer(uint32_t node, const std::vector<DocId>& ids) {
+  if (ids.size() < kMinIds) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (frequency_[node % kFrequencySlots] < kAdmitLookups ||
+        index_.count(node) > 0) {
+      return;
+    }
+  }
+
+  // Compress outside the lock, then check the budget again under it
+  Entry entry{node, ids.size(),
+              std::make_shared<const std::vector<uint8_t>>(encode(ids))};
+  size_t charge = chargeOf(entry);
+  if (charge > max_bytes_) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (index_.count(node) > 0) {
+    return;  // Another thread cached it meanwhile
+  }
+  while (bytes_ + charge > max_bytes_) {
+    const Entry& oldest = lru_.back();
+    bytes_ -= chargeOf(oldest);
+    index_.erase(oldest.node);
+    lru_.pop_back();
+    evictions_++;
+  }
+  lru_.push_front(std::move(entry));
+  index_.emplace(node, lru_.begin());
+  bytes_ += charge;
+  admissions_++;
+}
+
+PostingsCache::Stats PostingsCache::getStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.admissions = admissions_;
+  stats.evictions = evictions_;
+  stats.entries = index_.size();
+  stats.bytes = bytes_;
+  stats.max_bytes = max_bytes_;
+  return stats;
+}
+
+std::vector<uint8_t> PostingsCache::encode(const std::vector<DocId>& ids) {
+  std::vector<uint8_t> encoded;
+  encoded.reserve(ids.size() + ids.size() / 2);
+  DocId previous = 0;
+  for (DocId id : ids) {
+    appendVarint(id - previous, encoded);
+    previous = id;
+  }
+  encoded.shrink_to_fit();
+  return encoded;
+}
+
+void PostingsCache::decode(const std::vector<uint8_t>& encoded,
+                           size_t count,
+                           std::vector<DocId>& ids) {
+  ids.resize(count);
+  const uint8_t* in = encoded.data();
+  DocId previous = 0;
+  for (size_t i = 0; i < count; ++i) {
+    previous += readVarint(in);
+    ids[i] = previous;
+  }
+}
+
+size_t PostingsCache::chargeOf(const Entry& entry) {
+  // List and map nodes plus the control block, approximately
+  constexpr size_t kEntryOverhead = 96;
+  return entry.encoded->capacity() + sizeof(Entry) + kEntryOverhead;
+}
@@ -1,165 +1,618 @@
 #include "data_node/radix_tree_index.h"
 
 #include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <utility>
 
-RadixTreeIndex::RadixTreeIndex() : root_(std::make_unique<RadixNode>()), term_count_(0) {}
+#include "data_node/varint.h"
 
-void RadixTreeIndex::insert(const std::string& term, size_t address_id) {
+namespace {
+
+// Per-thread bitset over the DocId space used to drop duplicate IDs during a
+// search. Only the bits set by a search are cleared afterwards, so reusing
+// it costs O(results) instead of O(documents) per query.
+std::vector<uint64_t>& threadSeenBits() {
+  thread_local std::vector<uint64_t> seen_bits;
+  return seen_bits;
+}
+
+}  // namespace
+
+struct RadixTreeIndex::IdCollector {
+  std::vector<DocId>& results;
+  size_t max_results;
+  std::vector<uint64_t>& seen;
+
+  IdCollector(std::vector<DocId>& results_, size_t max_results_)
+      : results(results_), max_results(max_results_), seen(threadSeenBits()) {}
+
+  ~IdCollector() {
+    for (DocId id : results) {
+      seen[id >> 6] &= ~(uint64_t{1} << (id & 63));
+    }
+  }
+
+  // Add an ID if not seen before; returns false once the limit is reached
+  bool add(DocId id) {
+    size_t word = id >> 6;
+    if (word >= seen.size()) {
+      seen.resize(word + 1, 0);
+    }
+    uint64_t bit = uint64_t{1} << (id & 63);
+    if ((seen[word] & bit) == 0) {
+      seen[word] |= bit;
+      results.push_back(id);
+    }
+    return results.size() < max_results;
+  }
+};
+
+struct RadixTreeIndex::FuzzyWalk {
+  // How an edge leaves the terms below it
+  enum class Step {
+    kOpen,     // Terms below may still match with fewer edits: descend
+    kSettled,  // Every term below matches with the best edits so far
+    kPruned,   // No term below matches
+  };
+
+  std::string_view prefix;
+  uint8_t max_edits;
+  // Row d holds the edit distances from the path's first d characters to
+  // each leading part of the prefix, saturated at max_edits + 1. Rows past
+  // the current path are reused by its siblings.
+  std::vector<uint8_t> rows;
+  std::vector<FuzzyMatch> matches;  // Unsorted, IDs may repeat
+  std::vector<DocId> buffer;        // Decoded postings block
+
+  FuzzyWalk(std::string_view prefix_, uint8_t max_edits_)
+      : prefix(prefix_), max_edits(max_edits_), rows(prefix_.size() + 1) {
+    for (size_t j = 0; j < rows.size(); ++j) {
+      rows[j] = saturate(j);
+    }
+  }
+
+  uint8_t saturate(size_t edits) const {
+    return static_cast<uint8_t>(std::min<size_t>(edits, max_edits + 1u));
+  }
+
+  // Extend the path of length depth by an edge label one character at a
+  // time, keeping best the fewest edits to the whole prefix along it. A
+  // row's minimum bounds every longer path's distance from below, which
+  // is what settles or prunes an edge before its end.
+  Step advance(std::string_view label, size_t& depth, uint8_t& best) {
+    size_t width = prefix.size() + 1;
+    for (char c : label) {
+      if (rows.size() < (depth + 2) * width) {
+        rows.resize((depth + 2) * width);
+      }
+      uint8_t* previous = rows.data() + depth * width;
+      uint8_t* current = previous + width;
+      current[0] = saturate(depth + 1);
+      uint8_t row_min = current[0];
+      for (size_t j = 1; j < width; ++j) {
+        size_t substitution = previous[j - 1] + (prefix[j - 1] != c ? 1u : 0u);
+        size_t deletion = current[j - 1] + 1u;
+        size_t insertion = previous[j] + 1u;
+        current[j] = saturate(std::min({substitution, deletion, insertion}));
+        row_min = std::min(row_min, current[j]);
+      }
+      depth++;
+      best = std::min(best, current[width - 1]);
+
+      if (best <= max_edits && row_min >= best) {
+        return Step::kSettled;
+      }
+      if (row_min > max_edits) {
+        return Step::kPruned;
+      }
+    }
+    return Step::kOpen;
+  }
+};
+
+RadixTreeIndex::RadixTreeIndex()
+    : root_(std::make_unique<RadixNode>()),
+      term_count_(0),
+      frozen_(false),
+      id_count_(0) {}
+
+void RadixTreeIndex::insert(const std::string& term, DocId doc_id) {
+  if (frozen_) {
+    throw std::logic_error("Cannot insert into a frozen RadixTreeIndex");
+  }
   if (term.empty()) {
     return;
   }
-  insertHelper(root_.get(), term, address_id, 0);
+  insertHelper(root_.get(), term, doc_id, 0);
   term_count_++;
 }
 
 void RadixTreeIndex::insertHelper(RadixNode* node,
                                    const std::string& term,
-                                   size_t address_id,
+                                   DocId doc_id,
                                    size_t depth) {
-  // If we've consumed the entire term, add the address_id to this node
-  if (depth >= term.length()) {
-    // Check if this address_id is already in the list
-    if (std::find(node->address_ids.begin(), node->address_ids.end(), address_id) ==
-        node->address_ids.end()) {
-      node->address_ids.push_back(address_id);
-      // Keep address_ids sorted for deterministic behavior
-      std::sort(node->address_ids.begin(), node->address_ids.end());
-    }
-    return;
-  }
+  // Children are kept sorted by edge_label and have distinct first
+  // characters (compared as unsigned char, like std::string)
+  auto first_char_less = [](const std::unique_ptr<RadixNode>& child, char c) {
+    return static_cast<unsigned char>(child->edge_label[0]) <
+           static_cast<unsigned char>(c);
+  };
 
-  std::string remaining = term.substr(depth);
+  while (depth < term.length()) {
+    auto it = std::lower_bound(node->children.begin(), node->children.end(),
+                               term[depth], first_char_less);
+    if (it == node->children.end() || (*it)->edge_label[0] != term[depth]) {
+      // No child shares a prefix: add one at its sorted position
+      auto new_child = std::make_unique<RadixNode>(term.substr(depth));
+      new_child->doc_ids.push_back(doc_id);
+      node->children.insert(it, std::move(new_child));
+      return;
+    }
 
-  // Find a child that shares a prefix with remaining
-  for (auto& child : node->children) {
+    std::unique_ptr<RadixNode>& child = *it;
     const std::string& edge_label = child->edge_label;
-    size_t common_prefix_len = 0;
-
-    // Find the length of the common prefix
+    size_t common_prefix_len = 1;
     while (common_prefix_len < edge_label.length() &&
-           common_prefix_len < remaining.length() &&
-           edge_label[common_prefix_len] == remaining[common_prefix_len]) {
+           depth + common_prefix_len < term.length() &&
+           edge_label[common_prefix_len] == term[depth + common_prefix_len]) {
       common_prefix_len++;
     }
 
-    if (common_prefix_len > 0) {
-      // We found a child with a common prefix
-      if (common_prefix_len == edge_label.length()) {
-        // The entire edge label matches, continue down this path
-        insertHelper(child.get(), term, address_id, depth + common_prefix_len);
-        return;
-      } else {
-        // Need to split the edge
-        // Create a new intermediate node
-        auto new_node = std::make_unique<RadixNode>(edge_label.substr(0, common_prefix_len));
-
-        // Update the existing child's edge label
-        std::string old_suffix = edge_label.substr(common_prefix_len);
-        child->edge_label = old_suffix;
-
-        // Move the old child under the new node
-        new_node->children.push_back(std::move(child));
-
-        // Replace the old child with the new node
-        child = std::move(new_node);
-
-        // Now continue insertion from the new node
-        if (common_prefix_len == remaining.length()) {
-          // The term ends at this split point
-          if (std::find(child->address_ids.begin(), child->address_ids.end(), address_id) ==
-              child->address_ids.end()) {
-            child->address_ids.push_back(address_id);
-            std::sort(child->address_ids.begin(), child->address_ids.end());
-          }
-        } else {
-          // Create a new child for the remaining part of the term
-          std::string new_suffix = remaining.substr(common_prefix_len);
-          auto new_child = std::make_unique<RadixNode>(new_suffix);
-          new_child->address_ids.push_back(address_id);
-          child->children.push_back(std::move(new_child));
-          // Keep children sorted by edge_label for deterministic traversal
-          std::sort(child->children.begin(), child->children.end(),
-                    [](const std::unique_ptr<RadixNode>& a, const std::unique_ptr<RadixNode>& b) {
-                      return a->edge_label < b->edge_label;
-                    });
-        }
-        return;
+    if (common_prefix_len == edge_label.length()) {
+      // The entire edge label matches, continue down this path
+      node = child.get();
+      depth += common_prefix_len;
+      continue;
+    }
+
+    // Split the edge: a new intermediate node takes the common prefix and
+    // the old child keeps the rest of its label
+    auto new_node =
+        std::make_unique<RadixNode>(edge_label.substr(0, common_prefix_len));
+    child->edge_label.erase(0, common_prefix_len);
+    new_node->children.push_back(std::move(child));
+    child = std::move(new_node);
+    depth += common_prefix_len;
+
+    if (depth == term.length()) {
+      // The term ends at this split point
+      child->doc_ids.push_back(doc_id);
+    } else {
+      auto new_child = std::make_unique<RadixNode>(term.substr(depth));
+      new_child->doc_ids.push_back(doc_id);
+      auto& children = child->children;
+      auto position = first_char_less(children.front(), term[depth])
+                          ? children.end()
+                          : children.begin();
+      children.insert(position, std::move(new_child));
+    }
+    return;
+  }
+
+  // The entire term is consumed: add the doc_id to this node, keeping
+  // doc_ids sorted and unique. IDs usually arrive in ascending order, which
+  // appends in O(1).
+  std::vector<DocId>& ids = node->doc_ids;
+  if (ids.empty() || ids.back() < doc_id) {
+    ids.push_back(doc_id);
+    return;
+  }
+  auto it = std::lower_bound(ids.begin(), ids.end(), doc_id);
+  if (*it != doc_id) {
+    ids.insert(it, doc_id);
+  }
+}
+
+bool RadixTreeIndex::postingLess(const TermPosting& a, const TermPosting& b) {
+  int order = a.term.compare(b.term);
+  return order < 0 || (order == 0 && a.id < b.id);
+}
+
+void RadixTreeIndex::buildFrom(const std::vector<TermPosting>& postings) {
+  if (frozen_) {
+    throw std::logic_error("Cannot build a frozen RadixTreeIndex");
+  }
+
+  auto root = std::make_unique<RadixNode>();
+  size_t term_count = 0;
+
+  // Nodes from the root to the node of the previous term, each with the
+  // term length at the end of its edge. Only the last child of a node on
+  // this path can still change.
+  std::vector<std::pair<RadixNode*, size_t>> path = {{root.get(), 0}};
+  static const std::string kNoTerm;
+  const std::string* previous_term = &kNoTerm;
+
+  for (size_t i = 0; i < postings.size(); ++i) {
+    const TermPosting& posting = postings[i];
+    if (i > 0) {
+      if (postingLess(posting, postings[i - 1])) {
+        throw std::invalid_argument(
+            "RadixTreeIndex::buildFrom requires sorted postings");
       }
+      if (!postingLess(postings[i - 1], posting)) {
+        continue;
+      }
+    }
+    const std::string& term = posting.term;
+    if (term.empty()) {
+      continue;
+    }
+
+    size_t shared = 0;
+    size_t shared_limit = std::min(term.length(), previous_term->length());
+    while (shared < shared_limit && term[shared] == (*previous_term)[shared]) {
+      shared++;
     }
+
+    // Close the nodes the term does not pass through
+    while (path.back().second > shared) {
+      path.pop_back();
+    }
+    RadixNode* parent = path.back().first;
+    size_t parent_end = path.back().second;
+    if (parent_end < shared) {
+      // The term leaves the previous term's path part way along the last
+      // child's edge: split it there
+      std::unique_ptr<RadixNode>& child = parent->children.back();
+      auto split = std::make_unique<RadixNode>(
+          child->edge_label.substr(0, shared - parent_end));
+      child->edge_label.erase(0, shared - parent_end);
+      split->children.push_back(std::move(child));
+      child = std::move(split);
+      parent = child.get();
+      path.emplace_back(parent, shared);
+    }
+
+    if (term.length() == shared) {
+      // Same term as before with a larger ID
+      parent->doc_ids.push_back(posting.id);
+    } else {
+      // The term sorts after every term already under parent
+      auto leaf = std::make_unique<RadixNode>(term.substr(shared));
+      leaf->doc_ids.push_back(posting.id);
+      path.emplace_back(leaf.get(), term.length());
+      parent->children.push_back(std::move(leaf));
+    }
+    previous_term = &term;
+    term_count++;
   }
 
-  // No matching child found, create a new one
-  auto new_child = std::make_unique<RadixNode>(remaining);
-  new_child->address_ids.push_back(address_id);
-  node->children.push_back(std::move(new_child));
-  // Keep children sorted by edge_label for deterministic traversal
-  std::sort(node->children.begin(), node->children.end(),
-            [](const std::unique_ptr<RadixNode>& a, const std::unique_ptr<RadixNode>& b) {
+  root_ = std::move(root);
+  term_count_ = term_count;
+}
+
+void RadixTreeIndex::mergeDisjoint(RadixTreeIndex&& other) {
+  if (frozen_ || other.frozen_) {
+    throw std::logic_error("Cannot merge a frozen RadixTreeIndex");
+  }
+  if (&other == this) {
+    return;
+  }
+
+  // Children are sorted by label with distinct first characters, so the
+  // first characters of each root can be compared as sorted sequences
+  auto& children = root_->children;
+  auto& other_children = other.root_->children;
+  size_t i = 0;
+  for (const auto& child : other_children) {
+    // std::string orders characters as unsigned char
+    while (i < children.size() &&
+           static_cast<unsigned char>(children[i]->edge_label[0]) <
+               static_cast<unsigned char>(child->edge_label[0])) {
+      i++;
+    }
+    if (i < children.size() &&
+        children[i]->edge_label[0] == child->edge_label[0]) {
+      throw std::logic_error(
+          "Cannot merge RadixTreeIndexes sharing a first character");
+    }
+  }
+
+  for (auto& child : other_children) {
+    children.push_back(std::move(child));
+  }
+  std::sort(children.begin(), children.end(),
+            [](const std::unique_ptr<RadixNode>& a,
+               const std::unique_ptr<RadixNode>& b) {
               return a->edge_label < b->edge_label;
             });
+  term_count_ += other.term_count_;
+
+  other.root_ = std::make_unique<RadixNode>();
+  other.term_count_ = 0;
 }
 
-std::vector<size_t> RadixTreeIndex::search(const std::string& prefix) const {
-  std::vector<size_t> results;
-  if (prefix.empty()) {
+std::vector<DocId> RadixTreeIndex::search(const std::string& prefix,
+                                           size_t max_results) const {
+  std::vector<DocId> results;
+  if (prefix.empty() || max_results == 0) {
     return results;
   }
-  searchHelper(root_.get(), prefix, results, 0);
+  {
+    IdCollector collector(results, max_results);
+    if (frozen_) {
+      searchFlat(prefix, collector);
+    } else if (const RadixNode* node = findNode(prefix)) {
+      collectAllIds(node, collector);
+    }
+  }
   return results;
 }
 
-void RadixTreeIndex::searchHelper(const RadixNode* node,
-                                   const std::string& prefix,
-                                   std::vector<size_t>& results,
-                                   size_t depth) const {
-  // If we've matched the entire prefix, collect all IDs from this subtree
-  if (depth >= prefix.length()) {
-    collectAllIds(node, results);
-    return;
+std::vector<DocId> RadixTreeIndex::searchLongestPrefix(
+    std::string_view key,
+    ArrayView<size_t> prefix_lengths,
+    size_t* matched_length) const {
+  std::vector<DocId> results;
+  size_t length = 0;
+  if (!prefix_lengths.empty()) {
+    IdCollector collector(results, kNoLimit);
+    if (frozen_) {
+      size_t node = findLongestFlatNode(key, prefix_lengths, length);
+      if (node != kNoNode) {
+        collectFlat(node, collector);
+      }
+    } else if (const RadixNode* node =
+                   findLongestNode(key, prefix_lengths, length)) {
+      collectAllIds(node, collector);
+    }
+  }
+  if (matched_length != nullptr) {
+    *matched_length = length;
   }
+  return results;
+}
 
-  std::string remaining = prefix.substr(depth);
+std::vector<DocId> RadixTreeIndex::searchSorted(
+    const std::string& prefix) const {
+  std::vector<DocId> results = search(prefix);
+  std::sort(results.begin(), results.end());
+  return results;
+}
 
-  // Search through children
-  for (const auto& child : node->children) {
-    const std::string& edge_label = child->edge_label;
+std::vector<DocId> RadixTreeIndex::filterSorted(
+    const std::string& prefix,
+    const std::vector<DocId>& candidates) const {
+  std::vector<DocId> results;
+  if (prefix.empty() || candidates.empty()) {
+    return results;
+  }
+  if (!frozen_) {
+    std::vector<DocId> ids = searchSorted(prefix);
+    std::set_intersection(candidates.begin(), candidates.end(), ids.begin(),
+                          ids.end(), std::back_inserter(results));
+    return results;
+  }
 
-    // Check if the edge_label matches the remaining prefix
-    if (remaining.length() <= edge_label.length()) {
-      // Check if remaining is a prefix of edge_label
-      if (edge_label.substr(0, remaining.length()) == remaining) {
-        // We've matched the entire prefix, collect all IDs from this subtree
-        collectAllIds(child.get(), results);
-        return;
+  size_t match = findFlatNode(prefix);
+  if (match == kNoNode) {
+    return results;
+  }
+  std::vector<bool> found(candidates.size(), false);
+  std::vector<DocId> buffer;
+  buffer.reserve(kPostingsBlockIds);
+  for (size_t node = match; node < nodes_view_[match].subtree_end; ++node) {
+    markCandidates(node, candidates, found, buffer);
+  }
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (found[i]) {
+      results.push_back(candidates[i]);
+    }
+  }
+  return results;
+}
+
+std::vector<RadixTreeIndex::FuzzyMatch> RadixTreeIndex::searchFuzzy(
+    const std::string& prefix,
+    int max_edits) const {
+  std::vector<FuzzyMatch> matches;
+  if (prefix.empty()) {
+    return matches;
+  }
+
+  // As many edits as the prefix has characters would match every term
+  int edits = std::clamp(
+      max_edits, 0,
+      std::min(kMaxFuzzyEdits, static_cast<int>(prefix.length()) - 1));
+  if (edits == 0) {
+    for (DocId id : searchSorted(prefix)) {
+      matches.push_back(FuzzyMatch{id, 0});
+    }
+    return matches;
+  }
+
+  FuzzyWalk walk(prefix, static_cast<uint8_t>(edits));
+  uint8_t no_match = walk.saturate(edits + 1);
+  if (frozen_) {
+    if (!nodes_view_.empty()) {
+      fuzzyWalkFlat(0, walk, 0, no_match);
+    }
+  } else {
+    fuzzyWalkNode(root_.get(), walk, 0, no_match);
+  }
+
+  // Keep each ID once, with the fewest edits any of its terms needed
+  std::sort(walk.matches.begin(), walk.matches.end(),
+            [](const FuzzyMatch& a, const FuzzyMatch& b) {
+              return a.id != b.id ? a.id < b.id : a.edits < b.edits;
+            });
+  walk.matches.erase(
+      std::unique(walk.matches.begin(), walk.matches.end(),
+                  [](const FuzzyMatch& a, const FuzzyMatch& b) {
+                    return a.id == b.id;
+                  }),
+      walk.matches.end());
+  return std::move(walk.matches);
+}
+
+size_t RadixTreeIndex::estimateCount(const std::string& prefix) const {
+  if (prefix.empty()) {
+    return 0;
+  }
+  if (frozen_) {
+    size_t node = findFlatNode(prefix);
+    if (node == kNoNode) {
+      return 0;
+    }
+    return postingsBeginOf(nodes_view_[node].subtree_end) -
+           nodes_view_[node].postings_begin;
+  }
+
+  const RadixNode* node = findNode(prefix);
+  if (!node) {
+    return 0;
+  }
+  size_t count = 0;
+  std::vector<const RadixNode*> stack = {node};
+  while (!stack.empty()) {
+    const RadixNode* current = stack.back();
+    stack.pop_back();
+    count += current->doc_ids.size();
+    for (const auto& child : current->children) {
+      stack.push_back(child.get());
+    }
+  }
+  return count;
+}
+
+const RadixTreeIndex::RadixNode* RadixTreeIndex::findNode(
+    const std::string& prefix) const {
+  const RadixNode* node = root_.get();
+  size_t depth = 0;
+
+  while (depth < prefix.length()) {
+    size_t remaining = prefix.length() - depth;
+    const RadixNode* next = nullptr;
+
+    // Children have distinct first characters, so at most one can match
+    for (const auto& child : node->children) {
+      const std::string& edge_label = child->edge_label;
+      if (edge_label[0] != prefix[depth]) {
+        continue;
       }
-    } else {
-      // Check if edge_label is a prefix of remaining
-      if (remaining.substr(0, edge_label.length()) == edge_label) {
-        // Continue searching down this path
-        searchHelper(child.get(), prefix, results, depth + edge_label.length());
-        return;
+      size_t compare_len = std::min(remaining, edge_label.length());
+      if (prefix.compare(depth, compare_len, edge_label, 0, compare_len) ==
+          0) {
+        next = child.get();
       }
+      break;
+    }
+    if (!next) {
+      return nullptr;
     }
+
+    // If the prefix ends inside this edge, the whole subtree matches
+    node = next;
+    depth += std::min(remaining, next->edge_label.length());
   }
+  return node;
 }
 
-void RadixTreeIndex::collectAllIds(const RadixNode* node,
-                                    std::vector<size_t>& results) const {
-  // Add all address_ids from this node
-  for (const auto& id : node->address_ids) {
-    // Avoid duplicates
-    if (std::find(results.begin(), results.end(), id) == results.end()) {
-      results.push_back(id);
+const RadixTreeIndex::RadixNode* RadixTreeIndex::findLongestNode(
+    std::string_view key,
+    ArrayView<size_t> prefix_lengths,
+    size_t& matched_length) const {
+  const RadixNode* found = nullptr;
+  matched_length = 0;
+  const RadixNode* node = root_.get();
+  size_t depth = 0;
+  size_t next_prefix = 0;
+
+  while (next_prefix < prefix_lengths.size()) {
+    const RadixNode* child = nullptr;
+    for (const auto& candidate : node->children) {
+      if (candidate->edge_label[0] == key[depth]) {
+        child = candidate.get();
+        break;
+      }
+    }
+    if (!child) {
+      break;
+    }
+
+    // Every prefix ending within the part of the edge that matches the key
+    // ends on this node
+    const std::string& edge_label = child->edge_label;
+    size_t compare_len = std::min(key.size() - depth, edge_label.length());
+    size_t matched = 1;
+    while (matched < compare_len &&
+           edge_label[matched] == key[depth + matched]) {
+      matched++;
+    }
+    while (next_prefix < prefix_lengths.size() &&
+           prefix_lengths[next_prefix] <= depth + matched) {
+      found = child;
+      matched_length = prefix_lengths[next_prefix++];
+    }
+    if (matched < compare_len) {
+      break;
+    }
+    node = child;
+    depth += compare_len;
+  }
+  return found;
+}
+
+bool RadixTreeIndex::collectAllIds(const RadixNode* node,
+                                   IdCollector& collector) const {
+  // Add all doc_ids from this node
+  for (const auto& id : node->doc_ids) {
+    if (!collector.add(id)) {
+      return false;
     }
   }
 
   // Recursively collect from all children (in sorted order for determinism)
   for (const auto& child : node->children) {
-    collectAllIds(child.get(), results);
+    if (!collectAllIds(child.get(), collector)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void RadixTreeIndex::fuzzyWalkNode(const RadixNode* node,
+                                   FuzzyWalk& walk,
+                                   size_t depth,
+                                   uint8_t best) const {
+  FuzzyWalk::Step step = walk.advance(node->edge_label, depth, best);
+  if (step == FuzzyWalk::Step::kPruned) {
+    return;
+  }
+  if (step == FuzzyWalk::Step::kSettled) {
+    std::vector<const RadixNode*> pending = {node};
+    while (!pending.empty()) {
+      const RadixNode* current = pending.back();
+      pending.pop_back();
+      for (DocId id : current->doc_ids) {
+        walk.matches.push_back(FuzzyMatch{id, best});
+      }
+      for (const auto& child : current->children) {
+        pending.push_back(child.get());
+      }
+    }
+    return;
+  }
+
+  if (best <= walk.max_edits) {
+    for (DocId id : node->doc_ids) {
+      walk.matches.push_back(FuzzyMatch{id, best});
+    }
+  }
+  for (const auto& child : node->children) {
+    fuzzyWalkNode(child.get(), walk, depth, best);
   }
 }
 
 size_t RadixTreeIndex::getMemoryUsage() const {
+  if (frozen_) {
+    return nodes_view_.size() * sizeof(FlatNode) + labels_view_.size() +
+           postings_view_.size();
+  }
   return getMemoryUsageHelper(root_.get());
 }
 
@@ -170,7 +623,7 @@ size_t RadixTreeIndex::getMemoryUsageHelper(const RadixNode* node) const {
 
   size_t usage = sizeof(RadixNode);
   usage += node->edge_label.capacity();
-  usage += node->address_ids.capacity() * sizeof(size_t);
+  usage += node->doc_ids.capacity() * sizeof(DocId);
   usage += node->children.capacity() * sizeof(std::unique_ptr<RadixNode>);
 
   for (const auto& child : node->children) {
@@ -183,3 +636,456 @@ size_t RadixTreeIndex::getMemoryUsageHelper(const RadixNode* node) const {
 size_t RadixTreeIndex::getTermCount() const {
   return term_count_;
 }
+
+void RadixTreeIndex::freeze() {
+  if (frozen_) {
+    return;
+  }
+
+  flat_nodes_.clear();
+  label_pool_.clear();
+  postings_pool_.clear();
+  id_count_ = 0;
+
+  flattenHelper(root_.get());
+
+  flat_nodes_.shrink_to_fit();
+  label_pool_.shrink_to_fit();
+  postings_pool_.shrink_to_fit();
+
+  nodes_view_ = ArrayView<FlatNode>(flat_nodes_);
+  labels_view_ = label_pool_;
+  postings_view_ = ArrayView<uint8_t>(postings_pool_);
+
+  // The build tree is no longer needed once the flat layout exists
+  root_.reset();
+  frozen_ = true;
+}
+
+bool RadixTreeIndex::isFrozen() const { return frozen_; }
+
+void RadixTreeIndex::flattenHelper(const RadixNode* node) {
+  constexpr size_t kMaxOffset = std::numeric_limits<uint32_t>::max();
+  const std::vector<DocId>& ids = node->doc_ids;
+  size_t skip_count = ids.empty() ? 0 : (ids.size() - 1) / kPostingsBlockIds;
+  if (node->edge_label.length() > std::numeric_limits<uint16_t>::max() ||
+      label_pool_.size() + node->edge_label.length() > kMaxOffset ||
+      id_count_ + ids.size() > kMaxOffset ||
+      postings_pool_.size() + skip_count * sizeof(PostingsSkip) +
+              kMaxVarintBytes * ids.size() >
+          kMaxOffset ||
+      flat_nodes_.size() >= kMaxOffset) {
+    throw std::length_error("RadixTreeIndex too large to flatten");
+  }
+
+  size_t index = flat_nodes_.size();
+
+  FlatNode flat;
+  flat.label_offset = static_cast<uint32_t>(label_pool_.size());
+  flat.label_length = static_cast<uint16_t>(node->edge_label.length());
+  flat.first_char = node->edge_label.empty() ? '\0' : node->edge_label[0];
+  flat.subtree_end = 0;
+  flat.postings_begin = static_cast<uint32_t>(id_count_);
+  flat.bytes_begin = static_cast<uint32_t>(postings_pool_.size());
+  flat_nodes_.push_back(flat);
+
+  label_pool_ += node->edge_label;
+
+  // doc_ids are kept sorted and unique by insertHelper() and buildFrom().
+  // The skip table is filled in as the blocks it points to are encoded.
+  size_t table = postings_pool_.size();
+  postings_pool_.resize(table + skip_count * sizeof(PostingsSkip));
+  DocId previous = 0;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    if (i != 0 && i % kPostingsBlockIds == 0) {
+      PostingsSkip skip{ids[i],
+                        static_cast<uint32_t>(postings_pool_.size() - table)};
+      std::memcpy(&postings_pool_[table + (i / kPostingsBlockIds - 1) *
+                                              sizeof(PostingsSkip)],
+                  &skip, sizeof(skip));
+    } else {
+      appendVarint(ids[i] - previous, postings_pool_);
+    }
+    previous = ids[i];
+  }
+  id_count_ += ids.size();
+
+  // Children are already sorted by edge label, so pre-order keeps the same
+  // deterministic result order as the pointer layout
+  for (const auto& child : node->children) {
+    flattenHelper(child.get());
+  }
+
+  flat_nodes_[index].subtree_end = static_cast<uint32_t>(flat_nodes_.size());
+}
+
+size_t RadixTreeIndex::findFlatNode(const std::string& prefix) const {
+  size_t node = 0;
+  size_t depth = 0;
+
+  while (depth < prefix.length()) {
+    const FlatNode& parent = nodes_view_[node];
+    size_t child = node + 1;
+    bool descended = false;
+
+    // Siblings are found by skipping over each child's subtree
+    while (child < parent.subtree_end) {
+      const FlatNode& candidate = nodes_view_[child];
+      if (candidate.first_char == prefix[depth]) {
+        size_t remaining = prefix.length() - depth;
+        size_t compare_len = std::min<size_t>(remaining, candidate.label_length);
+        if (labels_view_.compare(candidate.label_offset, compare_len, prefix,
+                                 depth, compare_len) != 0) {
+          return kNoNode;
+        }
+        // If the prefix ends inside this edge, the whole subtree matches
+        node = child;
+        depth += compare_len;
+        descended = true;
+        break;
+      }
+      child = candidate.subtree_end;
+    }
+
+    if (!descended) {
+      return kNoNode;
+    }
+  }
+  return node;
+}
+
+size_t RadixTreeIndex::findLongestFlatNode(std::string_view key,
+                                           ArrayView<size_t> prefix_lengths,
+                                           size_t& matched_length) const {
+  size_t found = kNoNode;
+  matched_length = 0;
+  size_t node = 0;
+  size_t depth = 0;
+  size_t next_prefix = 0;
+
+  while (next_prefix < prefix_lengths.size()) {
+    const FlatNode& parent = nodes_view_[node];
+    size_t child = node + 1;
+    while (child < parent.subtree_end &&
+           nodes_view_[child].first_char != key[depth]) {
+      child = nodes_view_[child].subtree_end;
+    }
+    if (child >= parent.subtree_end) {
+      break;
+    }
+
+    // Every prefix ending within the part of the edge that matches the key
+    // ends on this node
+    const FlatNode& edge = nodes_view_[child];
+    size_t compare_len =
+        std::min<size_t>(key.size() - depth, edge.label_length);
+    size_t matched = 1;
+    while (matched < compare_len &&
+           labels_view_[edge.label_offset + matched] == key[depth + matched]) {
+      matched++;
+    }
+    while (next_prefix < prefix_lengths.size() &&
+           prefix_lengths[next_prefix] <= depth + matched) {
+      found = child;
+      matched_length = prefix_lengths[next_prefix++];
+    }
+    if (matched < compare_len) {
+      break;
+    }
+    node = child;
+    depth += compare_len;
+  }
+  return found;
+}
+
+void RadixTreeIndex::searchFlat(const std::string& prefix,
+                                IdCollector& collector) const {
+  size_t node = findFlatNode(prefix);
+  if (node != kNoNode) {
+    collectFlat(node, collector);
+  }
+}
+
+void RadixTreeIndex::collectFlat(size_t node, IdCollector& collector) const {
+  // The matched subtree is one contiguous range of nodes, whose blocks are
+  // stored back to back after each node's skip table: only the first ID of
+  // a later block comes from the table instead of the bytes
+  const FlatNode& match = nodes_view_[node];
+  for (size_t i = node; i < match.subtree_end; ++i) {
+    const FlatNode& current = nodes_view_[i];
+    size_t count = postingsBeginOf(i + 1) - current.postings_begin;
+    size_t skip_count = count == 0 ? 0 : (count - 1) / kPostingsBlockIds;
+    const uint8_t* table = postings_view_.data() + current.bytes_begin;
+    const uint8_t* in = table + skip_count * sizeof(PostingsSkip);
+    DocId id = 0;
+    for (size_t j = 0; j < count; ++j) {
+      if (j != 0 && j % kPostingsBlockIds == 0) {
+        PostingsSkip skip;
+        std::memcpy(&skip, table, sizeof(skip));
+        table += sizeof(skip);
+        id = skip.first_id;
+      } else {
+        id += readVarint(in);
+      }
+      if (!collector.add(id)) {
+        return;
+      }
+    }
+  }
+}
+
+void RadixTreeIndex::fuzzyWalkFlat(size_t node,
+                                   FuzzyWalk& walk,
+                                   size_t depth,
+                                   uint8_t best) const {
+  const FlatNode& current = nodes_view_[node];
+  FuzzyWalk::Step step = walk.advance(
+      labels_view_.substr(current.label_offset, current.label_length), depth,
+      best);
+  if (step == FuzzyWalk::Step::kPruned) {
+    return;
+  }
+
+  // A settled subtree is one contiguous range of nodes; an open node only
+  // matches with its own IDs here
+  size_t end = step == FuzzyWalk::Step::kSettled ? current.subtree_end
+                                                  : node + 1;
+  if (best <= walk.max_edits) {
+    for (size_t i = node; i < end; ++i) {
+      size_t count = postingsBeginOf(i + 1) - nodes_view_[i].postings_begin;
+      for (size_t block = 0; block * kPostingsBlockIds < count; ++block) {
+        walk.buffer.clear();
+        decodeBlock(i, count, block, walk.buffer);
+        for (DocId id : walk.buffer) {
+          walk.matches.push_back(FuzzyMatch{id, best});
+        }
+      }
+    }
+  }
+  if (step == FuzzyWalk::Step::kSettled) {
+    return;
+  }
+
+  for (size_t child = node + 1; child < current.subtree_end;
+       child = nodes_view_[child].subtree_end) {
+    fuzzyWalkFlat(child, walk, depth, best);
+  }
+}
+
+size_t RadixTreeIndex::postingsBeginOf(size_t node) const {
+  return node < nodes_view_.size() ? nodes_view_[node].postings_begin
+                                   : id_count_;
+}
+
+size_t RadixTreeIndex::bytesBeginOf(size_t node) const {
+  return node < nodes_view_.size() ? nodes_view_[node].bytes_begin
+                                   : postings_view_.size();
+}
+
+void RadixTreeIndex::decodeBlock(size_t node,
+                                 size_t count,
+                                 size_t block,
+                                 std::vector<DocId>& out) const {
+  size_t skip_count = (count - 1) / kPostingsBlockIds;
+  const uint8_t* table = postings_view_.data() + nodes_view_[node].bytes_begin;
+  size_t first = block * kPostingsBlockIds;
+  size_t end = std::min(count, first + kPostingsBlockIds);
+
+  const uint8_t* in = table + skip_count * sizeof(PostingsSkip);
+  DocId id = 0;
+  if (block != 0) {
+    PostingsSkip skip;
+    std::memcpy(&skip, table + (block - 1) * sizeof(PostingsSkip),
+                sizeof(skip));
+    in = table + skip.byte_offset;
+    id = skip.first_id;
+    out.push_back(id);
+    first++;
+  }
+  for (size_t j = first; j < end; ++j) {
+    id += readVarint(in);
+    out.push_back(id);
+  }
+}
+
+void RadixTreeIndex::markCandidates(size_t node,
+                                    const std::vector<DocId>& candidates,
+                                    std::vector<bool>& found,
+                                    std::vector<DocId>& buffer) const {
+  size_t count = postingsBeginOf(node + 1) - nodes_view_[node].postings_begin;
+  if (count == 0) {
+    return;
+  }
+  size_t block_count = (count + kPostingsBlockIds - 1) / kPostingsBlockIds;
+  const uint8_t* table = postings_view_.data() + nodes_view_[node].bytes_begin;
+
+  // The first ID of block b (b >= 1), from the skip table
+  auto block_start = [table](size_t block) {
+    DocId id;
+    std::memcpy(&id, table + (block - 1) * sizeof(PostingsSkip), sizeof(id));
+    return id;
+  };
+
+  // Each round decodes the block that may hold the next candidate and
+  // checks every candidate up to the start of the following block, so a
+  // block is decoded at most once and only if a candidate may be in it
+  auto begin = candidates.begin();
+  size_t next = 0;
+  size_t block = 0;
+  while (next < candidates.size()) {
+    // Binary search for the last block starting at or before the candidate
+    size_t low = block + 1;
+    size_t high = block_count;
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      if (block_start(middle) <= candidates[next]) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    block = low - 1;
+    size_t end = candidates.size();
+    if (block + 1 < block_count) {
+      end = std::lower_bound(begin + next, candidates.end(),
+                             block_start(block + 1)) -
+            begin;
+    }
+
+    buffer.clear();
+    decodeBlock(node, count, block, buffer);
+    size_t position = next;
+    for (DocId id : buffer) {
+      position = std::lower_bound(begin + position, begin + end, id) - begin;
+      if (position == end) {
+        break;
+      }
+      if (candidates[position] == id) {
+        found[position] = true;
+      }
+    }
+    next = end;
+  }
+}
+
+size_t RadixTreeIndex::findPrefixNode(const std::string& prefix) const {
+  if (!frozen_ || prefix.empty()) {
+    return kNoNode;
+  }
+  return findFlatNode(prefix);
+}
+
+std::vector<DocId> RadixTreeIndex::collectSorted(size_t node) const {
+  std::vector<DocId> results;
+  if (!frozen_ || node >= nodes_view_.size()) {
+    return results;
+  }
+  {
+    IdCollector collector(results, kNoLimit);
+    collectFlat(node, collector);
+  }
+  std::sort(results.begin(), results.end());
+  return results;
+}
+
+void RadixTreeIndex::addToSnapshot(SnapshotWriter& writer) const {
+  if (!frozen_) {
+    throw std::logic_error("Only a frozen RadixTreeIndex can be snapshotted");
+  }
+  static_assert(sizeof(term_count_) == sizeof(uint64_t) &&
+                    sizeof(id_count_) == sizeof(uint64_t),
+                "counts are stored as uint64_t");
+  writer.addSection(SnapshotSection::kRadixMeta, &term_count_,
+                    sizeof(term_count_));
+  writer.addSection(SnapshotSection::kRadixIdCount, &id_count_,
+                    sizeof(id_count_));
+  writer.addArray(SnapshotSection::kRadixNodes, nodes_view_);
+  writer.addSection(SnapshotSection::kRadixLabels, labels_view_.data(),
+                    labels_view_.size());
+  writer.addArray(SnapshotSection::kRadixPostings, postings_view_);
+}
+
+bool RadixTreeIndex::loadFromSnapshot(
+    std::shared_ptr<const IndexSnapshot> snapshot) {
+  auto meta = snapshot->getArray<uint64_t>(SnapshotSection::kRadixMeta);
+  auto nodes = snapshot->getArray<FlatNode>(SnapshotSection::kRadixNodes);
+  auto labels = snapshot->getArray<char>(SnapshotSection::kRadixLabels);
+  auto postings = snapshot->getArray<uint8_t>(SnapshotSection::kRadixPostings);
+  auto ids = snapshot->getArray<uint64_t>(SnapshotSection::kRadixIdCount);
+  if (!meta || meta->size() != 1 || !nodes || nodes->empty() || !labels ||
+      !postings || !ids || ids->size() != 1) {
+    return false;
+  }
+  size_t node_count = nodes->size();
+  uint64_t id_count = (*ids)[0];
+
+  // Check that a node's count IDs decode exactly to the end of its bytes,
+  // with a skip table entry pointing at each later block
+  auto valid_postings = [&](size_t begin, size_t end, size_t count) {
+    size_t skip_count = count == 0 ? 0 : (count - 1) / kPostingsBlockIds;
+    if (skip_count * sizeof(PostingsSkip) > end - begin) {
+      return false;
+    }
+    size_t offset = begin + skip_count * sizeof(PostingsSkip);
+    for (size_t j = 0; j < count; ++j) {
+      if (j != 0 && j % kPostingsBlockIds == 0) {
+        PostingsSkip skip;
+        std::memcpy(&skip,
+                    postings->data() + begin +
+                        (j / kPostingsBlockIds - 1) * sizeof(PostingsSkip),
+                    sizeof(skip));
+        if (skip.byte_offset != offset - begin) {
+          return false;
+        }
+        continue;
+      }
+      size_t length = 0;
+      do {
+        if (offset + length == end || length == kMaxVarintBytes) {
+          return false;
+        }
+      } while ((*postings)[offset + length++] & 0x80);
+      offset += length;
+    }
+    return offset == end;
+  };
+
+  // Check every range so a search can never leave the arrays; decoding
+  // then needs no bounds checks
+  const FlatNode& root = (*nodes)[0];
+  if (root.subtree_end != node_count || root.postings_begin != 0 ||
+      root.bytes_begin != 0 ||
+      id_count > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+  for (size_t i = 0; i < node_count; ++i) {
+    const FlatNode& node = (*nodes)[i];
+    bool last = i + 1 == node_count;
+    size_t postings_end = last ? id_count : (*nodes)[i + 1].postings_begin;
+    size_t bytes_end = last ? postings->size() : (*nodes)[i + 1].bytes_begin;
+    if (node.subtree_end <= i || node.subtree_end > node_count ||
+        static_cast<size_t>(node.label_offset) + node.label_length >
+            labels->size() ||
+        node.postings_begin > postings_end ||
+        node.bytes_begin > bytes_end || bytes_end > postings->size() ||
+        !valid_postings(node.bytes_begin, bytes_end,
+                        postings_end - node.postings_begin)) {
+      return false;
+    }
+  }
+
+  nodes_view_ = *nodes;
+  labels_view_ = std::string_view(labels->data(), labels->size());
+  postings_view_ = *postings;
+  term_count_ = static_cast<size_t>((*meta)[0]);
+  id_count_ = static_cast<size_t>(id_count);
+  snapshot_ = std::move(snapshot);
+
+  // Release the build tree and any previously flattened arrays
+  root_.reset();
+  std::vector<FlatNode>().swap(flat_nodes_);
+  std::string().swap(label_pool_);
+  std::vector<uint8_t>().swap(postings_pool_);
+  frozen_ = true;
+  return true;
+}
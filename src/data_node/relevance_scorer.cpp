@@ -0,0 +1,76 @@
+#include "data_node/relevance_scorer.h"
+
+#include <cmath>
+#include <string_view>
+
+RelevanceScorer::RelevanceScorer(const std::vector<std::string>& query_terms)
+    : query_terms_(query_terms) {}
+
+double RelevanceScorer::score(const AddressRecordView& record) const {
+  double score = 0.0;
+
+  // One pass over the terms finds each term in each field once; a term
+  // matches if any field contains it. Bonus points are for the position of
+  // the matches: street matches are most important, then city, then
+  // postcode
+  int matching_terms = 0;
+  double position_bonus = 0.0;
+  for (const auto& term : query_terms_) {
+    bool matched = false;
+
+    size_t street_pos = record.street.find(term);
+    if (street_pos != std::string_view::npos) {
+      // Street match at beginning is worth more
+      position_bonus += street_pos == 0 ? 15.0 : 10.0;
+      matched = true;
+    }
+
+    size_t city_pos = record.city.find(term);
+    if (city_pos != std::string_view::npos) {
+      // City match at beginning is worth more
+      position_bonus += city_pos == 0 ? 8.0 : 5.0;
+      matched = true;
+    }
+
+    if (record.postcode.find(term) != std::string_view::npos) {
+      position_bonus += 3.0;
+      matched = true;
+    }
+
+    if (record.number.find(term) != std::string_view::npos) {
+      position_bonus += 5.0;
+      matched = true;
+    }
+
+    matching_terms += matched ? 1 : 0;
+  }
+
+  // Base score: percentage of query terms that match
+  // This is the most important factor
+  if (!query_terms_.empty()) {
+    score += (static_cast<double>(matching_terms) / query_terms_.size()) * 100.0;
+  }
+  score += position_bonus;
+
+  // Bonus points for completeness of address data
+  // More complete addresses are more useful
+  int completeness = 0;
+  if (!record.number.empty()) completeness++;
+  if (!record.street.empty()) completeness++;
+  if (!record.unit.empty()) completeness++;
+  if (!record.city.empty()) completeness++;
+  if (!record.postcode.empty()) completeness++;
+
+  // Add up to 10 points for completeness (2 points per field)
+  score += completeness * 2.0;
+
+  return score;
+}
+
+double RelevanceScorer::score(const AddressRecordView& record,
+                              int edits) const {
+  // Scaled rather than reduced: a typo'd term matches no field, so fuzzy
+  // matches start from a low score that a fixed penalty would take below
+  // zero, tying them all there
+  return score(record) * std::pow(kEditFactor, edits);
+}
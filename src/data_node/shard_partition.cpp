@@ -0,0 +1,76 @@
+#include "data_node/shard_partition.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// 64-bit FNV-1a: stable across processes and platforms, unlike std::hash
+uint64_t hashText(std::string_view text) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (char c : text) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+}  // namespace
+
+ShardPartition::ShardPartition(size_t shard_count, Key key)
+    : shard_count_(std::clamp<size_t>(
+          shard_count, 1, std::numeric_limits<int32_t>::max())),
+      key_(key) {}
+
+std::optional<ShardPartition::Key> ShardPartition::parseKey(
+    const std::string& name) {
+  if (name == "hash") {
+    return Key::kHash;
+  }
+  if (name == "postcode") {
+    return Key::kPostcode;
+  }
+  return std::nullopt;
+}
+
+const char* ShardPartition::keyName(Key key) {
+  return key == Key::kPostcode ? "postcode" : "hash";
+}
+
+size_t ShardPartition::shardFor(size_t hash,
+                                std::string_view normalized_postcode) const {
+  uint64_t routing_key = key_ == Key::kPostcode && !normalized_postcode.empty()
+                             ? hashText(normalized_postcode)
+                             : static_cast<uint64_t>(hash);
+  return jumpConsistentHash(routing_key, static_cast<uint32_t>(shard_count_));
+}
+
+std::optional<size_t> ShardPartition::shardForHash(size_t hash) const {
+  if (key_ != Key::kHash) {
+    return std::nullopt;
+  }
+  return shardFor(hash, {});
+}
+
+std::optional<size_t> ShardPartition::shardForPostcode(
+    std::string_view normalized_postcode) const {
+  if (key_ != Key::kPostcode || normalized_postcode.empty()) {
+    return std::nullopt;
+  }
+  return shardFor(0, normalized_postcode);
+}
+
+uint32_t ShardPartition::jumpConsistentHash(uint64_t key,
+                                            uint32_t bucket_count) {
+  int64_t bucket = -1;
+  int64_t next = 0;
+  while (next < static_cast<int64_t>(bucket_count)) {
+    bucket = next;
+    key = key * 2862933555777941757ULL + 1;
+    next = static_cast<int64_t>(
+        (bucket + 1) *
+        (static_cast<double>(1LL << 31) /
+         static_cast<double>((key >> 33) + 1)));
+  }
+  return static_cast<uint32_t>(std::max<int64_t>(bucket, 0));
+}
@@ -0,0 +1,308 @@
+#include "data_node/spatial_index.h"
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace {
+
+// Cells per axis of the grid points are snapped to for Hilbert ordering
+constexpr uint32_t kHilbertBits = 16;
+constexpr uint32_t kHilbertCells = 1u << kHilbertBits;
+
+// Distances are computed by different formulas for nodes and points, so
+// node bounds are lowered by this much to stay below any rounding error
+constexpr double kBoundSlackMeters = 1e-6;
+
+// Position of a grid cell along the Hilbert curve
+uint32_t hilbertIndex(uint32_t x, uint32_t y) {
+  uint32_t index = 0;
+  for (uint32_t s = kHilbertCells / 2; s > 0; s /= 2) {
+    uint32_t rx = (x & s) > 0 ? 1 : 0;
+    uint32_t ry = (y & s) > 0 ? 1 : 0;
+    index += s * s * ((3 * rx) ^ ry);
+    // Rotate the quadrant so the curve stays continuous
+    if (ry == 0) {
+      if (rx == 1) {
+        x = kHilbertCells - 1 - x;
+        y = kHilbertCells - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return index;
+}
+
+uint32_t gridCell(double value, double min, double max) {
+  double scaled = (value - min) / (max - min) * (kHilbertCells - 1);
+  return static_cast<uint32_t>(
+      std::clamp(scaled, 0.0, static_cast<double>(kHilbertCells - 1)));
+}
+
+bool intersects(const GeoBox& a, const GeoBox& b) {
+  return a.min_longitude <= b.max_longitude &&
+         a.max_longitude >= b.min_longitude &&
+         a.min_latitude <= b.max_latitude && a.max_latitude >= b.min_latitude;
+}
+
+bool containsBox(const GeoBox& outer, const GeoBox& inner) {
+  return outer.min_longitude <= inner.min_longitude &&
+         outer.max_longitude >= inner.max_longitude &&
+         outer.min_latitude <= inner.min_latitude &&
+         outer.max_latitude >= inner.max_latitude;
+}
+
+// Grow a box to cover another
+void extend(GeoBox& box, const GeoBox& other) {
+  box.min_longitude = std::min(box.min_longitude, other.min_longitude);
+  box.min_latitude = std::min(box.min_latitude, other.min_latitude);
+  box.max_longitude = std::max(box.max_longitude, other.max_longitude);
+  box.max_latitude = std::max(box.max_latitude, other.max_latitude);
+}
+
+GeoBox pointBox(const GeoPoint& point) {
+  return GeoBox{point.longitude, point.latitude, point.longitude,
+                point.latitude};
+}
+
+size_t packedSize(size_t children) {
+  return (children + SpatialIndex::kNodeSize - 1) / SpatialIndex::kNodeSize;
+}
+
+}  // namespace
+
+void SpatialIndex::build(const std::vector<GeoPoint>& points) {
+  if (points.size() > std::numeric_limits<DocId>::max()) {
+    throw std::length_error("Too many points for the spatial index");
+  }
+
+  snapshot_.reset();
+  items_.clear();
+  items_.reserve(points.size());
+  for (size_t id = 0; id < points.size(); ++id) {
+    const GeoPoint& point = points[id];
+    if (!point.isValid()) {
+      continue;
+    }
+    uint32_t x = gridCell(point.longitude, -180.0, 180.0);
+    uint32_t y = gridCell(point.latitude, -90.0, 90.0);
+    items_.push_back(Item{point, static_cast<DocId>(id), hilbertIndex(x, y)});
+  }
+  items_.shrink_to_fit();
+  std::sort(items_.begin(), items_.end(), [](const Item& a, const Item& b) {
+    return a.hilbert != b.hilbert ? a.hilbert < b.hilbert : a.id < b.id;
+  });
+
+  // Pack leaves from the sorted points, then each level from the one below
+  boxes_.clear();
+  levels_.assign(1, 0);
+  size_t level_begin = 0;
+  size_t level_size = packedSize(items_.size());
+  for (size_t node = 0; node < level_size; ++node) {
+    size_t begin = node * kNodeSize;
+    size_t end = std::min(begin + kNodeSize, items_.size());
+    GeoBox box = pointBox(items_[begin].point);
+    for (size_t i = begin + 1; i < end; ++i) {
+      extend(box, pointBox(items_[i].point));
+    }
+    boxes_.push_back(box);
+  }
+  levels_.push_back(static_cast<uint32_t>(boxes_.size()));
+
+  while (level_size > 1) {
+    size_t parent_count = packedSize(level_size);
+    for (size_t node = 0; node < parent_count; ++node) {
+      size_t begin = level_begin + node * kNodeSize;
+      size_t end = std::min(begin + kNodeSize, level_begin + level_size);
+      GeoBox box = boxes_[begin];
+      for (size_t i = begin + 1; i < end; ++i) {
+        extend(box, boxes_[i]);
+      }
+      boxes_.push_back(box);
+    }
+    level_begin += level_size;
+    level_size = parent_count;
+    levels_.push_back(static_cast<uint32_t>(boxes_.size()));
+  }
+  if (boxes_.empty()) {
+    levels_.assign(1, 0);
+  }
+
+  syncViews();
+}
+
+void SpatialIndex::childRange(size_t level,
+                              size_t node,
+                              size_t& begin,
+                              size_t& end) const {
+  size_t child_count = level == 0
+                           ? items_view_.size()
+                           : levels_view_[level] - levels_view_[level - 1];
+  begin = node * kNodeSize;
+  end = std::min(begin + kNodeSize, child_count);
+}
+
+std::vector<DocId> SpatialIndex::searchBox(const GeoBox& box) const {
+  std::vector<DocId> ids;
+  if (levels_view_.size() < 2) {
+    return ids;  // Empty tree
+  }
+  size_t level_count = levels_view_.size() - 1;
+
+  // Depth-first over (level, node) pairs, starting from the root
+  std::vector<std::pair<size_t, size_t>> stack = {{level_count - 1, 0}};
+  while (!stack.empty()) {
+    auto [level, node] = stack.back();
+    stack.pop_back();
+    const GeoBox& node_box = boxes_view_[levels_view_[level] + node];
+    if (!intersects(box, node_box)) {
+      continue;
+    }
+
+    size_t begin, end;
+    childRange(level, node, begin, end);
+    if (level > 0) {
+      for (size_t child = begin; child < end; ++child) {
+        stack.emplace_back(level - 1, child);
+      }
+      continue;
+    }
+    bool inside = containsBox(box, node_box);
+    for (size_t i = begin; i < end; ++i) {
+      if (inside || box.contains(items_view_[i].point)) {
+        ids.push_back(items_view_[i].id);
+      }
+    }
+  }
+
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+std::vector<SpatialIndex::Neighbor> SpatialIndex::nearest(
+    const GeoPoint& point,
+    size_t max_results,
+    double max_distance_meters) const {
+  std::vector<Neighbor> neighbors;
+  if (levels_view_.size() < 2 || max_results == 0) {
+    return neighbors;  // Empty tree
+  }
+  size_t level_count = levels_view_.size() - 1;
+  double limit = max_distance_meters > 0.0
+                     ? max_distance_meters
+                     : std::numeric_limits<double>::infinity();
+
+  // Nodes and points ordered by (lower bound of) distance. At equal
+  // distances nodes come first, so points can be emitted in DocId order.
+  struct Candidate {
+    double distance;
+    bool is_point;
+    size_t level;
+    size_t index;  // Node index within its level, or the point's DocId
+  };
+  auto farther = [](const Candidate& a, const Candidate& b) {
+    if (a.distance != b.distance) {
+      return a.distance > b.distance;
+    }
+    if (a.is_point != b.is_point) {
+      return a.is_point;
+    }
+    return a.index > b.index;
+  };
+  std::priority_queue<Candidate, std::vector<Candidate>, decltype(farther)>
+      queue(farther);
+  queue.push(Candidate{0.0, false, level_count - 1, 0});
+
+  while (!queue.empty() && neighbors.size() < max_results) {
+    Candidate candidate = queue.top();
+    queue.pop();
+    if (candidate.distance > limit) {
+      break;
+    }
+    if (candidate.is_point) {
+      neighbors.push_back(
+          Neighbor{static_cast<DocId>(candidate.index), candidate.distance});
+      continue;
+    }
+
+    size_t begin, end;
+    childRange(candidate.level, candidate.index, begin, end);
+    for (size_t child = begin; child < end; ++child) {
+      if (candidate.level == 0) {
+        const Item& item = items_view_[child];
+        queue.push(Candidate{distanceMeters(point, item.point), true, 0,
+                             item.id});
+      } else {
+        const GeoBox& child_box =
+            boxes_view_[levels_view_[candidate.level - 1] + child];
+        double bound = std::max(
+            0.0, minDistanceMeters(point, child_box) - kBoundSlackMeters);
+        queue.push(Candidate{bound, false, candidate.level - 1, child});
+      }
+    }
+  }
+
+  return neighbors;
+}
+
+size_t SpatialIndex::size() const {
+  return items_view_.size();
+}
+
+size_t SpatialIndex::getMemoryUsage() const {
+  return items_view_.size() * sizeof(Item) +
+         boxes_view_.size() * sizeof(GeoBox) +
+         levels_view_.size() * sizeof(uint32_t);
+}
+
+void SpatialIndex::addToSnapshot(SnapshotWriter& writer) const {
+  static_assert(std::is_trivially_copyable<Item>::value &&
+                    std::is_trivially_copyable<GeoBox>::value,
+                "Spatial index arrays are stored as raw bytes");
+  writer.addArray(SnapshotSection::kSpatialItems, items_view_);
+  writer.addArray(SnapshotSection::kSpatialBoxes, boxes_view_);
+  writer.addArray(SnapshotSection::kSpatialLevels, levels_view_);
+}
+
+bool SpatialIndex::loadFromSnapshot(
+    std::shared_ptr<const IndexSnapshot> snapshot) {
+  auto items = snapshot->getArray<Item>(SnapshotSection::kSpatialItems);
+  auto boxes = snapshot->getArray<GeoBox>(SnapshotSection::kSpatialBoxes);
+  auto levels = snapshot->getArray<uint32_t>(SnapshotSection::kSpatialLevels);
+  if (!items || !boxes || !levels || levels->empty() || (*levels)[0] != 0 ||
+      (*levels)[levels->size() - 1] != boxes->size()) {
+    return false;
+  }
+
+  // Every level must pack the one below, ending in a single root
+  size_t children = items->size();
+  for (size_t level = 1; level < levels->size(); ++level) {
+    size_t level_size = (*levels)[level] - (*levels)[level - 1];
+    if ((*levels)[level] < (*levels)[level - 1] ||
+        level_size != packedSize(children)) {
+      return false;
+    }
+    children = level_size;
+  }
+  if (children > 1 || (levels->size() == 1) != items->empty()) {
+    return false;
+  }
+
+  std::vector<Item>().swap(items_);
+  std::vector<GeoBox>().swap(boxes_);
+  std::vector<uint32_t>().swap(levels_);
+  items_view_ = *items;
+  boxes_view_ = *boxes;
+  levels_view_ = *levels;
+  snapshot_ = std::move(snapshot);
+  return true;
+}
+
+void SpatialIndex::syncViews() {
+  items_view_ = ArrayView<Item>(items_);
+  boxes_view_ = ArrayView<GeoBox>(boxes_);
+  levels_view_ = ArrayView<uint32_t>(levels_);
+}
@@ -0,0 +1,121 @@
+#include "data_node/string_pool.h"
+
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+StringPool::StringPool()
+    : offsets_{0}, lookup_(16, IdHash{this}, IdEqual{this}) {
+  // Reserve ID 0 for the empty string
+  offsets_.push_back(0);
+  syncViews();
+  lookup_.insert(kEmptyStringId);
+}
+
+StringPool::StringId StringPool::intern(std::string_view text) {
+  if (snapshot_) {
+    throw std::logic_error("Cannot intern into a snapshot-backed StringPool");
+  }
+
+  probe_ = text;
+  auto it = lookup_.find(kProbeId);
+  probe_ = std::string_view();
+  if (it != lookup_.end()) {
+    return *it;
+  }
+
+  constexpr size_t kMaxOffset = std::numeric_limits<uint32_t>::max();
+  if (data_.size() + text.size() > kMaxOffset ||
+      offsets_.size() >= kProbeId) {
+    throw std::length_error("StringPool exceeds 32-bit offsets");
+  }
+
+  StringId id = static_cast<StringId>(offsets_.size() - 1);
+  data_.append(text.data(), text.size());
+  offsets_.push_back(static_cast<uint32_t>(data_.size()));
+  syncViews();
+  lookup_.insert(id);
+  return id;
+}
+
+std::string_view StringPool::get(StringId id) const {
+  if (static_cast<size_t>(id) + 1 >= offsets_view_.size()) {
+    return std::string_view();
+  }
+  return resolve(id);
+}
+
+size_t StringPool::size() const { return offsets_view_.size() - 1; }
+
+size_t StringPool::getMemoryUsage() const {
+  size_t usage = sizeof(StringPool);
+  if (snapshot_) {
+    return usage + data_view_.size() +
+           offsets_view_.size() * sizeof(uint32_t);
+  }
+  usage += data_.capacity();
+  usage += offsets_.capacity() * sizeof(uint32_t);
+  // Each node of the lookup table holds one ID plus its bucket pointers
+  usage += lookup_.size() * (sizeof(StringId) + 2 * sizeof(void*));
+  usage += lookup_.bucket_count() * sizeof(void*);
+  return usage;
+}
+
+std::string_view StringPool::resolve(StringId id) const {
+  if (id == kProbeId) {
+    return probe_;
+  }
+  return data_view_.substr(offsets_view_[id],
+                           offsets_view_[id + 1] - offsets_view_[id]);
+}
+
+void StringPool::syncViews() {
+  data_view_ = data_;
+  offsets_view_ = ArrayView<uint32_t>(offsets_);
+}
+
+void StringPool::addToSnapshot(SnapshotWriter& writer) const {
+  writer.addSection(SnapshotSection::kStringData, data_view_.data(),
+                    data_view_.size());
+  writer.addArray(SnapshotSection::kStringOffsets, offsets_view_);
+}
+
+bool StringPool::loadFromSnapshot(
+    std::shared_ptr<const IndexSnapshot> snapshot) {
+  std::optional<ArrayView<char>> data =
+      snapshot->getArray<char>(SnapshotSection::kStringData);
+  std::optional<ArrayView<uint32_t>> offsets =
+      snapshot->getArray<uint32_t>(SnapshotSection::kStringOffsets);
+  if (!data || !offsets || offsets->size() < 2 || (*offsets)[0] != 0 ||
+      (*offsets)[1] != 0) {
+    return false;
+  }
+
+  // Offsets must be non-decreasing and stay inside the string data
+  for (size_t i = 1; i < offsets->size(); ++i) {
+    if ((*offsets)[i] < (*offsets)[i - 1]) {
+      return false;
+    }
+  }
+  if (offsets->end()[-1] > data->size()) {
+    return false;
+  }
+
+  data_view_ = std::string_view(data->data(), data->size());
+  offsets_view_ = *offsets;
+  snapshot_ = std::move(snapshot);
+
+  // Release the build storage
+  lookup_.clear();
+  std::string().swap(data_);
+  std::vector<uint32_t>().swap(offsets_);
+  return true;
+}
+
+size_t StringPool::IdHash::operator()(StringId id) const {
+  return std::hash<std::string_view>()(pool->resolve(id));
+}
+
+bool StringPool::IdEqual::operator()(StringId a, StringId b) const {
+  return pool->resolve(a) == pool->resolve(b);
+}
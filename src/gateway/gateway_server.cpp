@@ -2,60 +2,633 @@
 
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <fstream>
-#include <future>
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 
+#include <grpcpp/alarm.h>
+
+#include "data_node/address_keys.h"
 #include "data_node/address_normalizer.h"
+#include "data_node/geo.h"
+#include "data_node/logging.h"
+#include "data_node/relevance_scorer.h"
+#include "gateway/json_writer.h"
+
+namespace {
+
+// View a protobuf address record's fields for scoring
+AddressRecordView toRecordView(const datanode::AddressRecord& record) {
+  AddressRecordView view;
+  view.longitude = record.longitude();
+  view.latitude = record.latitude();
+  view.hash = record.hash();
+  view.number = record.number();
+  view.street = record.street();
+  view.unit = record.unit();
+  view.city = record.city();
+  view.postcode = record.postcode();
+  return view;
+}
+
+// Hash of the fields GatewayServer::isDuplicate() compares
+size_t addressKeyHash(const datanode::AddressRecord& record) {
+  std::hash<std::string_view> hasher;
+  size_t hash = hasher(record.number());
+  for (std::string_view field :
+       {std::string_view(record.street()), std::string_view(record.city()),
+        std::string_view(record.postcode())}) {
+    hash ^= hasher(field) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  }
+  return hash;
+}
+
+// Render a record of a data node for an HTTP response
+crow::json::wvalue recordToJson(const datanode::AddressRecord& record,
+                                int shard_id) {
+  crow::json::wvalue json_record;
+  json_record["hash"] = record.hash();
+  json_record["longitude"] = record.longitude();
+  json_record["latitude"] = record.latitude();
+  json_record["number"] = record.number();
+  json_record["street"] = record.street();
+  json_record["unit"] = record.unit();
+  json_record["city"] = record.city();
+  json_record["postcode"] = record.postcode();
+  json_record["shard_id"] = shard_id;
+  return json_record;
+}
+
+// Count the data nodes that answered and pick the HTTP status of the
+// response: 200 OK (even if empty), 207 Multi-Status if some nodes failed,
+// 503 Service Unavailable if all of them failed
+int summarizeResults(const std::vector<DataNodeResult>& results,
+                     int& successful_nodes,
+                     int& failed_nodes) {
+  successful_nodes = 0;
+  failed_nodes = 0;
+  for (const auto& result : results) {
+    if (result.success) {
+      successful_nodes++;
+    } else {
+      failed_nodes++;
+      LogLine(LogLevel::kWarning, nullptr)
+          << "Data node " << result.shard_id << " failed: "
+          << result.error_message;
+    }
+  }
+  if (failed_nodes > 0 && successful_nodes == 0) {
+    return 503;
+  }
+  return failed_nodes > 0 ? 207 : 200;
+}
+
+crow::response errorResponse(int status_code, const std::string& message) {
+  crow::json::wvalue error_response;
+  error_response["error"] = message;
+  return crow::response(status_code, error_response);
+}
+
+// Deadline of the API request the calling thread serves, while it is
+// admitted; its data node calls never outlive it
+thread_local std::optional<std::chrono::system_clock::time_point>
+    t_request_deadline;
+
+// Admission of an API request to call the data nodes: holds its slot of the
+// limiter, and while it lives the data node calls of the thread share the
+// request's deadline. Empty (false) if the request was shed
+class Admission {
+ public:
+  Admission(ConcurrencyLimiter& limiter, std::chrono::milliseconds budget) {
+    auto deadline = std::chrono::system_clock::now() + budget;
+    permit_ = limiter.acquire(std::chrono::steady_clock::now() + budget);
+    if (permit_) {
+      t_request_deadline = deadline;
+    }
+  }
+  ~Admission() {
+    if (permit_) {
+      t_request_deadline.reset();
+    }
+  }
+
+  Admission(const Admission&) = delete;
+  Admission& operator=(const Admission&) = delete;
+
+  explicit operator bool() const { return static_cast<bool>(permit_); }
+
+  // Back the adaptive limit off if any data node timed out or shed a call
+  void recordResults(const std::vector<DataNodeResult>& results) {
+    for (const auto& result : results) {
+      if (result.overloaded) {
+        permit_.setDropped();
+      }
+    }
+  }
+
+ private:
+  ConcurrencyLimiter::Permit permit_;
+};
+
+// Response to an API request shed by admission control
+crow::response overloadedResponse() {
+  crow::response response =
+      errorResponse(503, "Gateway overloaded, retry later");
+  response.set_header("Retry-After", "1");
+  return response;
+}
+
+// Read a numeric member of a JSON request body
+bool readNumber(const crow::json::rvalue& body,
+                const char* key,
+                double& value) {
+  if (!body.has(key) || body[key].t() != crow::json::type::Number) {
+    return false;
+  }
+  value = body[key].d();
+  return true;
+}
+
+// Read the optional "limit" member of a spatial request: 1 ..
+// kMaxGeoResults, kDefaultGeoResults when absent
+bool readLimit(const crow::json::rvalue& body, size_t& limit) {
+  limit = GatewayServer::kDefaultGeoResults;
+  if (!body.has("limit")) {
+    return true;
+  }
+  double value;
+  if (!readNumber(body, "limit", value) || value < 1 ||
+      value > GatewayServer::kMaxGeoResults ||
+      value != static_cast<int>(value)) {
+    return false;
+  }
+  limit = static_cast<size_t>(value);
+  return true;
+}
+
+// Check a search request's "fuzziness": an integer from 0 to
+// kMaxFuzziness
+bool toFuzziness(double value, int& fuzziness) {
+  if (value < 0 || value > GatewayServer::kMaxFuzziness ||
+      value != static_cast<int>(value)) {
+    return false;
+  }
+  fuzziness = static_cast<int>(value);
+  return true;
+}
+
+const std::string& fuzzinessError() {
+  static const std::string message =
+      "'fuzziness' must be an integer from 0 to " +
+      std::to_string(GatewayServer::kMaxFuzziness);
+  return message;
+}
+
+// Read a /api/findAddress request body: the "address" text and the
+// optional "fuzziness", 0 when absent. Bodies of the usual flat shape are
+// scanned in place; any other goes through crow::json::load. Returns the
+// response rejecting the request if it is invalid
+std::optional<crow::response> readSearchRequest(const std::string& body,
+                                                std::string& address,
+                                                int& fuzziness) {
+  fuzziness = 0;
+  FlatJsonObject flat_body;
+  if (flat_body.parse(body)) {
+    const FlatJsonObject::Member* address_member = flat_body.find("address");
+    if (address_member == nullptr) {
+      return errorResponse(400, "Missing 'address' field in request body");
+    }
+    if (address_member->type == FlatJsonObject::Type::kString) {
+      if (address_member->value.empty()) {
+        return errorResponse(400, "Address keyword cannot be empty");
+      }
+      const FlatJsonObject::Member* fuzziness_member =
+          flat_body.find("fuzziness");
+      if (fuzziness_member != nullptr &&
+          (fuzziness_member->type != FlatJsonObject::Type::kNumber ||
+           !toFuzziness(FlatJsonObject::toNumber(*fuzziness_member),
+                        fuzziness))) {
+        return errorResponse(400, fuzzinessError());
+      }
+      address.assign(address_member->value);
+      return std::nullopt;
+    }
+  }
+
+  auto json_body = crow::json::load(body);
+  if (!json_body) {
+    return errorResponse(400, "Invalid JSON in request body");
+  }
+  if (!json_body.has("address")) {
+    return errorResponse(400, "Missing 'address' field in request body");
+  }
+  address = json_body["address"].s();
+  if (address.empty()) {
+    return errorResponse(400, "Address keyword cannot be empty");
+  }
+  double value;
+  if (json_body.has("fuzziness") &&
+      (!readNumber(json_body, "fuzziness", value) ||
+       !toFuzziness(value, fuzziness))) {
+    return errorResponse(400, fuzzinessError());
+  }
+  return std::nullopt;
+}
+
+// Copy the records of a completed call into its DataNodeResult
+void readResults(const datanode::SearchResponse& response,
+                 DataNodeResult& result) {
+  result.records.assign(response.results().begin(), response.results().end());
+  result.scores.assign(response.scores().begin(), response.scores().end());
+}
+
+void readResults(const datanode::BatchSearchResponse& response,
+                 DataNodeResult& result) {
+  result.query_offsets.reserve(response.responses_size() + 1);
+  result.query_offsets.push_back(0);
+  for (const auto& query_response : response.responses()) {
+    result.records.insert(result.records.end(),
+                          query_response.results().begin(),
+                          query_response.results().end());
+    result.scores.insert(result.scores.end(), query_response.scores().begin(),
+                         query_response.scores().end());
+    result.query_offsets.push_back(result.records.size());
+  }
+  if (result.scores.size() != result.records.size()) {
+    result.scores.clear();
+  }
+}
+
+void readResults(const datanode::ReverseGeocodeResponse& response,
+                 DataNodeResult& result) {
+  result.records.reserve(response.results_size());
+  result.distances.reserve(response.results_size());
+  for (const auto& nearby : response.results()) {
+    result.records.push_back(nearby.record());
+    result.distances.push_back(nearby.distance_meters());
+  }
+}
+
+// Render the ranked matches of a query as a /api/findAddress payload,
+// without the echoed query, into out. Written directly rather than through
+// crow::json::wvalue, which would allocate a node per field; the fields
+// are in the documented order, and the values as crow would format them
+void renderSearchPayload(const std::vector<std::string>& query_terms,
+                         const std::vector<ScoredAddressRecord>& ranked_results,
+                         int successful_nodes,
+                         int failed_nodes,
+                         int status_code,
+                         std::string& out) {
+  out += "{\"query_terms\":[";
+  for (size_t i = 0; i < query_terms.size(); ++i) {
+    if (i > 0) {
+      out += ',';
+    }
+    appendJsonString(out, query_terms[i]);
+  }
+
+  out += "],\"results\":[";
+  for (size_t i = 0; i < ranked_results.size(); ++i) {
+    const ScoredAddressRecord& scored = ranked_results[i];
+    const datanode::AddressRecord& record = scored.record;
+    out += i > 0 ? ",{\"hash\":" : "{\"hash\":";
+    appendJsonNumber(out, static_cast<uint64_t>(record.hash()));
+    out += ",\"longitude\":";
+    appendJsonNumber(out, record.longitude());
+    out += ",\"latitude\":";
+    appendJsonNumber(out, record.latitude());
+    out += ",\"number\":";
+    appendJsonString(out, record.number());
+    out += ",\"street\":";
+    appendJsonString(out, record.street());
+    out += ",\"unit\":";
+    appendJsonString(out, record.unit());
+    out += ",\"city\":";
+    appendJsonString(out, record.city());
+    out += ",\"postcode\":";
+    appendJsonString(out, record.postcode());
+    out += ",\"shard_id\":";
+    appendJsonNumber(out, static_cast<int64_t>(scored.shard_id));
+    out += ",\"relevance_score\":";
+    appendJsonNumber(out, scored.relevance_score);
+    out += '}';
+  }
+
+  out += "],\"result_count\":";
+  appendJsonNumber(out, static_cast<int64_t>(ranked_results.size()));
+  out += ",\"successful_nodes\":";
+  appendJsonNumber(out, static_cast<int64_t>(successful_nodes));
+  out += ",\"failed_nodes\":";
+  appendJsonNumber(out, static_cast<int64_t>(failed_nodes));
+  if (status_code == 503) {
+    out += ",\"error\":\"All data nodes failed to respond\"";
+  }
+  out += '}';
+}
+
+// Buffer the calling thread renders /api/findAddress payloads into, reused
+// so that its capacity is allocated once per thread rather than per request
+thread_local std::string t_payload_buffer;
+
+// Weight of the newest call in a replica's latency EWMA
+constexpr double kEwmaWeight = 0.2;
+
+// Latency assumed for a replica without an EWMA yet, so that its calls in
+// flight still count
+constexpr double kMinEwmaLatencyMs = 0.01;
+
+// Calls a shard must have made since the last update of its hedge delay
+// before the delay is recomputed
+constexpr uint64_t kMinHedgeSamples = 100;
+
+// The values recorded into a histogram between two of its snapshots. The
+// max is that of the later snapshot, which bounds the window's max
+LatencyHistogram::Snapshot subtractSnapshot(
+    const LatencyHistogram::Snapshot& later,
+    const LatencyHistogram::Snapshot& earlier) {
+  LatencyHistogram::Snapshot window = later;
+  if (earlier.buckets.size() != later.buckets.size()) {
+    return window;
+  }
+  window.count -= earlier.count;
+  window.sum -= earlier.sum;
+  for (size_t i = 0; i < window.buckets.size(); ++i) {
+    window.buckets[i] -= earlier.buckets[i];
+  }
+  return window;
+}
+
+// API endpoints whose requests are recorded by RequestMetrics
+const char* const kApiEndpoints[] = {"/api/findAddress",
+                                     "/api/findAddressBatch",
+                                     "/api/reverseGeocode", "/api/searchBox"};
+
+}  // namespace
+
+void RequestMetrics::before_handle(crow::request& /*req*/,
+                                   crow::response& /*res*/,
+                                   context& ctx) {
+  ctx.start_time = std::chrono::steady_clock::now();
+  beginQueryLog();
+}
+
+void RequestMetrics::after_handle(crow::request& req,
+                                  crow::response& res,
+                                  context& ctx) {
+  auto it = endpoints.find(req.url);
+  if (it == endpoints.end()) {
+    return;
+  }
+  Endpoint& endpoint = *it->second;
+  endpoint.latency.record(std::chrono::steady_clock::now() - ctx.start_time);
+  endpoint.requests.add();
+  if (res.code >= 400) {
+    endpoint.errors.add();
+  }
+}
+
+struct GatewayServer::QueueTag {
+  virtual ~QueueTag() = default;
+
+  // Handle the completion of the tagged operation, with the ok flag of
+  // CompletionQueue::Next()
+  virtual void onCompleted(GatewayServer& server, bool ok) = 0;
+};
+
+struct GatewayServer::PendingCall : GatewayServer::QueueTag {
+  // Copy the response of a successful call into result
+  virtual void readResponse(DataNodeResult& result) const = 0;
+
+  void onCompleted(GatewayServer& server, bool ok) override {
+    server.completeCall(std::unique_ptr<PendingCall>(this), ok);
+  }
+
+  Shard* shard;
+  Replica* replica;
+  FanOut* fan_out;
+  size_t index;
+  std::chrono::steady_clock::time_point start_time;
+  // Cancelled because another call of the shard settled it (guarded by
+  // fan_out->mutex)
+  bool cancelled = false;
+
+  grpc::ClientContext context;
+  grpc::Status status;
+};
+
+template <typename Request, typename Response>
+struct GatewayServer::TypedCall : GatewayServer::PendingCall {
+  void readResponse(DataNodeResult& result) const override {
+    readResults(response, result);
+  }
+
+  Request request;
+  Response response;
+  std::unique_ptr<grpc::ClientAsyncResponseReader<Response>> reader;
+};
+
+struct GatewayServer::HedgeTimer : GatewayServer::QueueTag {
+  void onCompleted(GatewayServer& server, bool ok) override {
+    server.completeHedgeTimer(*this, ok);
+  }
+
+  FanOut* fan_out;
+  size_t index;
+  grpc::Alarm alarm;
+};
+
+struct GatewayServer::ShardCalls {
+  std::vector<PendingCall*> in_flight;
+  std::vector<const Replica*> tried;  // Replicas called so far
+  bool done = false;                  // Result settled
+  std::unique_ptr<HedgeTimer> hedge_timer;
+};
+
+struct GatewayServer::FanOut {
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t pending = 0;                   // Calls and timers in flight
+  std::vector<size_t> targets;          // Indexes of the shards called
+  std::vector<DataNodeResult> results;  // Indexed like shards_
+  std::vector<ShardCalls> shards;       // Indexed like shards_
+  std::chrono::steady_clock::time_point start_time;
+  // Shared by all calls, so hedging and failing over never extend it
+  std::chrono::system_clock::time_point deadline;
+  // Start a call of the request to a replica of a shard
+  std::function<void(size_t index, Replica& replica)> start_call;
+  // Whether the request's per-query lines are logged, for the completion
+  // threads
+  bool log_query = true;
+};
+
+struct GatewayServer::ShardStream {
+  // At most one operation is in flight; its completion queue tag is the
+  // stream itself
+  enum class State { kStarting, kReading, kReady, kFinishing, kDone };
+
+  Shard* shard;
+  Replica* replica;
+  std::chrono::steady_clock::time_point start_time;
+  grpc::ClientContext context;
+  std::unique_ptr<grpc::ClientAsyncReader<datanode::SearchChunk>> reader;
+  State state = State::kStarting;
+  datanode::SearchChunk chunk;
+  int position = 0;        // Next record of chunk to merge (kReady)
+  bool cancelled = false;  // Cancelled by the merge once it had enough
+  grpc::Status status;
+  DataNodeResult result;
+
+  double headScore() const { return chunk.scores(position); }
+};
 
 GatewayServer::GatewayServer(const GatewayConfig& config)
-    : config_(config), shutdown_requested_(false) {
+    : config_(config),
+      shutdown_requested_(false),
+      query_cache_(config.query_cache),
+      admission_(config.admission) {
   std::cout << "[INFO] GatewayServer created with configuration:" << std::endl;
   std::cout << "  HTTP Port: " << config_.http_port << std::endl;
   std::cout << "  Data Nodes: " << config_.data_nodes.size() << std::endl;
   std::cout << "  gRPC Timeout: " << config_.grpc_timeout_ms << " ms"
             << std::endl;
+  std::cout << "  Channels per Replica: "
+            << std::max(1, config_.channels_per_replica) << std::endl;
+  std::cout << "  Replica Selection: "
+            << (config_.replica_selection == ReplicaSelection::kEwmaLatency
+                    ? "ewma"
+                    : "least_outstanding")
+            << std::endl;
+  if (config_.hedge_percentile > 0) {
+    std::cout << "  Hedging: after p" << config_.hedge_percentile
+              << " latency" << std::endl;
+  } else {
+    std::cout << "  Hedging: disabled" << std::endl;
+  }
+  std::cout << "  Partition: "
+            << (config_.partition_key
+                    ? ShardPartition::keyName(*config_.partition_key)
+                    : "unknown")
+            << std::endl;
+  if (admission_.isAdaptive()) {
+    std::cout << "  Admission: adaptive limit, starting at "
+              << admission_.getStats().limit;
+  } else {
+    std::cout << "  Admission: up to " << config_.admission.max_concurrency
+              << " requests";
+  }
+  std::cout << ", " << config_.admission.max_queued << " queued for up to "
+            << config_.admission.max_queue_wait.count() << " ms" << std::endl;
+  std::cout << "  Request Timeout: " << requestTimeout().count() << " ms"
+            << std::endl;
+  if (query_cache_.isEnabled()) {
+    std::cout << "  Query Cache: " << config_.query_cache.max_bytes
+              << " bytes, TTL " << config_.query_cache.ttl.count() << " ms"
+              << std::endl;
+  } else {
+    std::cout << "  Query Cache: disabled" << std::endl;
+  }
 }
 
 GatewayServer::~GatewayServer() {
   std::cout << "[INFO] GatewayServer destructor called" << std::endl;
+  stopMaintenance();
+  stopCompletionQueue();
+}
+
+datanode::DataNodeService::Stub& GatewayServer::Replica::stub() {
+  return *stubs[next_stub.fetch_add(1, std::memory_order_relaxed) %
+                stubs.size()];
 }
 
 bool GatewayServer::initialize() {
   std::cout << "[INFO] Initializing gateway server..." << std::endl;
 
-  // Create gRPC channels and stubs for each data node
+  // Give every channel of a pool its own subchannel, and so its own
+  // connection, instead of sharing the global subchannel pool
+  grpc::ChannelArguments channel_args;
+  channel_args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+  int channel_count = std::max(1, config_.channels_per_replica);
+
+  // Create gRPC channels and stubs for each data node, grouping the nodes
+  // serving the same shard as its replicas
   for (const auto& node_config : config_.data_nodes) {
-    DataNodeConnection connection;
-    connection.config = node_config;
+    auto shard_it = std::find_if(
+        shards_.begin(), shards_.end(), [&node_config](const auto& shard) {
+          return shard->shard_id == node_config.shard_id;
+        });
+    if (shard_it == shards_.end()) {
+      auto shard = std::make_unique<Shard>();
+      shard->shard_id = node_config.shard_id;
+      shards_.push_back(std::move(shard));
+      shard_it = shards_.end() - 1;
+    }
 
-    // Create gRPC channel with insecure credentials
-    connection.channel = grpc::CreateChannel(
-        node_config.address, grpc::InsecureChannelCredentials());
+    auto replica = std::make_unique<Replica>();
+    replica->config = node_config;
+    for (int i = 0; i < channel_count; ++i) {
+      // Create gRPC channel with insecure credentials
+      auto channel = grpc::CreateCustomChannel(
+          node_config.address, grpc::InsecureChannelCredentials(),
+          channel_args);
+      if (!channel) {
+        std::cerr << "[ERROR] Failed to create gRPC channel for data node "
+                  << node_config.shard_id << " at " << node_config.address
+                  << std::endl;
+        return false;
+      }
 
-    if (!connection.channel) {
-      std::cerr << "[ERROR] Failed to create gRPC channel for data node "
-                << node_config.shard_id << " at " << node_config.address
-                << std::endl;
-      return false;
+      // Create stub for the data node service
+      auto stub = datanode::DataNodeService::NewStub(channel);
+      if (!stub) {
+        std::cerr << "[ERROR] Failed to create gRPC stub for data node "
+                  << node_config.shard_id << std::endl;
+        return false;
+      }
+      replica->channels.push_back(std::move(channel));
+      replica->stubs.push_back(std::move(stub));
     }
+    replica->health_stub =
+        grpc::health::v1::Health::NewStub(replica->channels.front());
+    (*shard_it)->replicas.push_back(std::move(replica));
 
-    // Create stub for the data node service
-    connection.stub = datanode::DataNodeService::NewStub(connection.channel);
+    std::cout << "[INFO] Created " << channel_count
+              << " gRPC connection(s) to data node " << node_config.shard_id
+              << " at " << node_config.address << std::endl;
+  }
 
-    if (!connection.stub) {
-      std::cerr << "[ERROR] Failed to create gRPC stub for data node "
-                << node_config.shard_id << std::endl;
-      return false;
+  // Route by the partition only if every shard it maps records to is
+  // configured
+  if (config_.partition_key) {
+    bool contiguous = !shards_.empty();
+    for (const auto& shard : shards_) {
+      contiguous = contiguous && shard->shard_id >= 0 &&
+                   static_cast<size_t>(shard->shard_id) < shards_.size();
     }
+    if (contiguous) {
+      partition_.emplace(shards_.size(), *config_.partition_key);
+    } else {
+      std::cout << "[WARNING] Shard IDs are not 0.." << shards_.size()
+                << " - 1, ignoring the partition" << std::endl;
+    }
+  }
 
-    connections_.push_back(std::move(connection));
-
-    std::cout << "[INFO] Created gRPC connection to data node "
-              << node_config.shard_id << " at " << node_config.address
-              << std::endl;
+  // Start the threads completing asynchronous data node calls
+  int thread_count = std::max(1, config_.completion_queue_threads);
+  for (int i = 0; i < thread_count; ++i) {
+    completion_threads_.emplace_back(&GatewayServer::pollCompletionQueue, this);
   }
+  std::cout << "[INFO] Started " << thread_count
+            << " gRPC completion queue thread(s)" << std::endl;
+
+  // Start checking replica health and updating hedge delays
+  maintenance_thread_ = std::thread(&GatewayServer::runMaintenance, this);
 
   // Setup HTTP routes
   setupRoutes();
@@ -65,12 +638,28 @@ bool GatewayServer::initialize() {
 }
 
 void GatewayServer::setupRoutes() {
+  RequestMetrics& request_metrics = app_.get_middleware<RequestMetrics>();
+  for (const char* endpoint : kApiEndpoints) {
+    request_metrics.endpoints[endpoint] =
+        std::make_unique<RequestMetrics::Endpoint>();
+  }
+
   // Health check endpoint
   CROW_ROUTE(app_, "/health")
   ([this]() {
     crow::json::wvalue response;
+    size_t healthy_data_nodes = 0;
+    for (const auto& shard : shards_) {
+      for (const auto& replica : shard->replicas) {
+        healthy_data_nodes += replica->healthy.load() ? 1 : 0;
+      }
+    }
     response["status"] = "healthy";
-    response["data_nodes"] = connections_.size();
+    response["data_nodes"] = config_.data_nodes.size();
+    response["healthy_data_nodes"] = healthy_data_nodes;
+    response["shards"] = shards_.size();
+    response["partition"] =
+        partition_ ? ShardPartition::keyName(partition_->key()) : "unknown";
     return response;
   });
 
@@ -84,8 +673,10 @@ void GatewayServer::setupRoutes() {
       crow::json::wvalue response;
       response["service"] = "Geocoding Gateway";
       response["version"] = "1.0.0";
-      response["endpoints"] = crow::json::wvalue::list({"/health",
-                                                         "/api/findAddress"});
+      response["endpoints"] = crow::json::wvalue::list(
+          {"/health", "/api/findAddress", "/api/findAddressBatch",
+           "/api/reverseGeocode", "/api/searchBox", "/api/cacheStats",
+           "/metrics"});
       return crow::response(response);
     }
 
@@ -98,331 +689,1358 @@ void GatewayServer::setupRoutes() {
     return res;
   });
 
+  // Query cache counters
+  CROW_ROUTE(app_, "/api/cacheStats")
+  ([this]() {
+    QueryCache::Stats stats = query_cache_.getStats();
+    uint64_t lookups = stats.hits + stats.misses;
+    crow::json::wvalue response;
+    response["enabled"] = query_cache_.isEnabled();
+    response["hits"] = stats.hits;
+    response["misses"] = stats.misses;
+    response["hit_rate"] =
+        lookups == 0 ? 0.0 : static_cast<double>(stats.hits) / lookups;
+    response["insertions"] = stats.insertions;
+    response["evictions"] = stats.evictions;
+    response["expirations"] = stats.expirations;
+    response["entries"] = stats.entries;
+    response["bytes"] = stats.bytes;
+    response["max_bytes"] = config_.query_cache.max_bytes;
+    return response;
+  });
+
+  // Prometheus metrics
+  CROW_ROUTE(app_, "/metrics")
+  ([this]() {
+    crow::response response(renderMetrics());
+    response.set_header("Content-Type", "text/plain; version=0.0.4");
+    return response;
+  });
+
   // Find address endpoint
   CROW_ROUTE(app_, "/api/findAddress")
       .methods(crow::HTTPMethod::POST)([this](const crow::request& req) {
         try {
-          // Parse JSON request
-          auto json_body = crow::json::load(req.body);
-          if (!json_body) {
-            crow::json::wvalue error_response;
-            error_response["error"] = "Invalid JSON in request body";
-            return crow::response(400, error_response);
+          ScopedLatency parse_latency(stage_metrics_.parse);
+
+          std::string address_keyword;
+          int fuzziness;
+          if (auto rejection =
+                  readSearchRequest(req.body, address_keyword, fuzziness)) {
+            return std::move(*rejection);
           }
 
-          // Extract address keyword
-          if (!json_body.has("address")) {
+          LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+              << "Received findAddress request: \"" << address_keyword
+              << "\", fuzziness " << fuzziness;
+
+          std::vector<std::string> query_terms =
+              splitQueryTerms(address_keyword);
+
+          if (query_terms.empty()) {
             crow::json::wvalue error_response;
             error_response["error"] =
-                "Missing 'address' field in request body";
+                "Address keyword must contain at least one term";
             return crow::response(400, error_response);
           }
 
-          std::string address_keyword = json_body["address"].s();
+          {
+            LogLine line(LogLevel::kInfo, nullptr, isQueryLogged());
+            line << "Query terms: ";
+            for (size_t i = 0; i < query_terms.size(); ++i) {
+              line << "\"" << query_terms[i] << "\"";
+              if (i < query_terms.size() - 1) {
+                line << ", ";
+              }
+            }
+          }
 
-          // Validate that address keyword is not empty
-          if (address_keyword.empty()) {
-            crow::json::wvalue error_response;
-            error_response["error"] = "Address keyword cannot be empty";
-            return crow::response(400, error_response);
+          // Serve repeated queries from the cache without any gRPC calls
+          std::string cache_key = QueryCache::makeKey(query_terms, fuzziness);
+          parse_latency.stop();
+          if (auto cached = query_cache_.get(cache_key)) {
+            LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+                << "Returning cached result";
+            ScopedLatency serialize_latency(stage_metrics_.serialize);
+            crow::response cached_response(
+                200, addQueryToPayload(address_keyword, *cached));
+            cached_response.set_header("Content-Type", "application/json");
+            cached_response.set_header("X-Cache", "HIT");
+            return cached_response;
+          }
+
+          // Calling the data nodes takes a slot of the admission limit
+          Admission admission(admission_, requestTimeout());
+          if (!admission) {
+            return overloadedResponse();
+          }
+
+          // Ask only the shard that can hold a structured query's exact
+          // address; otherwise (or if it has no such address) query all
+          // data nodes, each returning only its own top results
+          std::vector<DataNodeResult> results;
+          if (auto routed = lookupOnOwningShard(query_terms, kMaxResults)) {
+            results.push_back(std::move(*routed));
+          } else if (config_.stream_search) {
+            results = streamAllDataNodes(query_terms, kMaxResults, fuzziness);
+          } else {
+            results = queryAllDataNodes(query_terms, kMaxResults, fuzziness);
           }
+          admission.recordResults(results);
 
-          std::cout << "[INFO] Received findAddress request: \""
-                    << address_keyword << "\"" << std::endl;
+          // Count successful and failed nodes
+          int successful_nodes;
+          int failed_nodes;
+          int status_code =
+              summarizeResults(results, successful_nodes, failed_nodes);
+
+          // Aggregate and rank results
+          ScopedLatency merge_latency(stage_metrics_.merge_rank);
+          auto ranked_results =
+              aggregateAndRankResults(results, query_terms, kMaxResults);
+          merge_latency.stop();
+
+          LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+              << "Returning " << ranked_results.size()
+              << " ranked result(s) from " << successful_nodes
+              << " successful node(s)";
+
+          // Build JSON response; the query itself is added after rendering.
+          // Only complete results are cached
+          ScopedLatency serialize_latency(stage_metrics_.serialize);
+          std::string& payload = t_payload_buffer;
+          payload.clear();
+          renderSearchPayload(query_terms, ranked_results, successful_nodes,
+                              failed_nodes, status_code, payload);
+          if (status_code == 200) {
+            query_cache_.put(cache_key, payload);
+          }
 
+          crow::response http_response(
+              status_code, addQueryToPayload(address_keyword, payload));
+          http_response.set_header("Content-Type", "application/json");
+          http_response.set_header("X-Cache", "MISS");
+          return http_response;
+
+        } catch (const std::exception& e) {
+          LogLine(LogLevel::kError, nullptr)
+              << "Exception in findAddress endpoint: " << e.what();
+          crow::json::wvalue error_response;
+          error_response["error"] = "Internal server error";
+          error_response["details"] = e.what();
+          return crow::response(500, error_response);
+        }
+      });
+
+  // Batch find address endpoint: the findAddress response of every address
+  // of a request, with the data nodes answering them in BatchSearch calls
+  CROW_ROUTE(app_, "/api/findAddressBatch")
+      .methods(crow::HTTPMethod::POST)([this](const crow::request& req) {
+        try {
+          ScopedLatency parse_latency(stage_metrics_.parse);
+          auto json_body = crow::json::load(req.body);
+          if (!json_body) {
+            return errorResponse(400, "Invalid JSON in request body");
+          }
+          if (!json_body.has("addresses") ||
+              json_body["addresses"].t() != crow::json::type::List) {
+            return errorResponse(
+                400, "Missing 'addresses' array in request body");
+          }
+          const auto& addresses = json_body["addresses"];
+          if (addresses.size() == 0 || addresses.size() > kMaxBatchQueries) {
+            return errorResponse(400, "'addresses' must hold 1 to " +
+                                          std::to_string(kMaxBatchQueries) +
+                                          " addresses");
+          }
+
+          // Serve what the cache can, sending each distinct remaining
+          // query to the data nodes once
+          size_t query_count = addresses.size();
+          std::vector<std::string> address_keywords(query_count);
+          std::vector<std::string> payloads(query_count);
+          std::vector<std::string> cache_keys;
+          std::vector<std::vector<std::string>> misses;
+          std::unordered_map<std::string, size_t> miss_index;
+          std::vector<size_t> query_miss(query_count, SIZE_MAX);
+          size_t cached_count = 0;
+          for (size_t i = 0; i < query_count; ++i) {
+            if (addresses[i].t() != crow::json::type::String) {
+              return errorResponse(400, "Address " + std::to_string(i) +
+                                            " is not a string");
+            }
+            address_keywords[i] = addresses[i].s();
+            std::vector<std::string> query_terms =
+                splitQueryTerms(address_keywords[i]);
+            if (query_terms.empty()) {
+              return errorResponse(400, "Address " + std::to_string(i) +
+                                            " must contain at least one term");
+            }
+
+            std::string cache_key = QueryCache::makeKey(query_terms);
+            if (auto cached = query_cache_.get(cache_key)) {
+              payloads[i] = std::move(*cached);
+              cached_count++;
+              continue;
+            }
+            auto inserted = miss_index.emplace(cache_key, misses.size());
+            if (inserted.second) {
+              cache_keys.push_back(std::move(cache_key));
+              misses.push_back(std::move(query_terms));
+            }
+            query_miss[i] = inserted.first->second;
+          }
+
+          parse_latency.stop();
+
+          LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+              << "Received findAddressBatch request: " << query_count
+              << " address(es), " << cached_count << " cached, "
+              << misses.size() << " distinct to query";
+
+          // Rank each query like /api/findAddress does; the overall status
+          // is the worst of the queries
+          std::vector<std::string> miss_payloads(misses.size());
+          int status_code = 200;
+          int unavailable_count = 0;
+          if (!misses.empty()) {
+            Admission admission(admission_, requestTimeout());
+            if (!admission) {
+              return overloadedResponse();
+            }
+            auto query_results = queryAllDataNodesBatch(misses, kMaxResults);
+            for (size_t m = 0; m < misses.size(); ++m) {
+              admission.recordResults(query_results[m]);
+              int successful_nodes;
+              int failed_nodes;
+              int query_status = summarizeResults(
+                  query_results[m], successful_nodes, failed_nodes);
+              ScopedLatency merge_latency(stage_metrics_.merge_rank);
+              auto ranked_results = aggregateAndRankResults(
+                  query_results[m], misses[m], kMaxResults);
+              merge_latency.stop();
+              ScopedLatency serialize_latency(stage_metrics_.serialize);
+              renderSearchPayload(misses[m], ranked_results,
+                                  successful_nodes, failed_nodes, query_status,
+                                  miss_payloads[m]);
+              if (query_status == 200) {
+                query_cache_.put(cache_keys[m], miss_payloads[m]);
+              } else {
+                status_code = 207;
+                unavailable_count += query_status == 503 ? 1 : 0;
+              }
+            }
+          }
+          if (cached_count == 0 &&
+              unavailable_count == static_cast<int>(misses.size())) {
+            status_code = 503;
+          }
+
+          ScopedLatency serialize_latency(stage_metrics_.serialize);
+          std::string body = "{\"results\":[";
+          for (size_t i = 0; i < query_count; ++i) {
+            if (i > 0) {
+              body += ',';
+            }
+            const std::string& payload = query_miss[i] == SIZE_MAX
+                                             ? payloads[i]
+                                             : miss_payloads[query_miss[i]];
+            body += addQueryToPayload(address_keywords[i], payload);
+          }
+          body += "],\"query_count\":" + std::to_string(query_count) +
+                  ",\"cached_count\":" + std::to_string(cached_count) + "}";
+
+          crow::response http_response(status_code, std::move(body));
+          http_response.set_header("Content-Type", "application/json");
+          return http_response;
+
+        } catch (const std::exception& e) {
+          LogLine(LogLevel::kError, nullptr)
+              << "Exception in findAddressBatch endpoint: " << e.what();
+          crow::json::wvalue error_response;
+          error_response["error"] = "Internal server error";
+          error_response["details"] = e.what();
+          return crow::response(500, error_response);
+        }
+      });
+
+  // Reverse geocoding endpoint: the addresses nearest to a point, across
+  // all shards, optionally restricted to those matching an address text
+  CROW_ROUTE(app_, "/api/reverseGeocode")
+      .methods(crow::HTTPMethod::POST)([this](const crow::request& req) {
+        try {
+          ScopedLatency parse_latency(stage_metrics_.parse);
+          auto json_body = crow::json::load(req.body);
+          if (!json_body) {
+            return errorResponse(400, "Invalid JSON in request body");
+          }
+
+          GeoPoint point;
+          if (!readNumber(json_body, "latitude", point.latitude) ||
+              !readNumber(json_body, "longitude", point.longitude) ||
+              !point.isValid()) {
+            return errorResponse(
+                400, "'latitude' and 'longitude' must be valid coordinates");
+          }
+          size_t limit;
+          if (!readLimit(json_body, limit)) {
+            return errorResponse(400, "'limit' must be an integer from 1 to " +
+                                          std::to_string(kMaxGeoResults));
+          }
+          double max_distance_meters = 0.0;
+          if (json_body.has("max_distance_meters") &&
+              (!readNumber(json_body, "max_distance_meters",
+                           max_distance_meters) ||
+               max_distance_meters < 0.0)) {
+            return errorResponse(
+                400, "'max_distance_meters' must be a non-negative number");
+          }
           std::vector<std::string> query_terms;
+          if (json_body.has("address")) {
+            query_terms = splitQueryTerms(json_body["address"].s());
+          }
 
-          // Check if this is a structured address query (contains comma)
-          if (address_keyword.find(',') != std::string::npos) {
-            // Structured address query - pass as single term to preserve structure
-            // The DataNode will parse it into components
-            std::cout << "[INFO] Detected structured address query" << std::endl;
-            query_terms.push_back(address_keyword);
-          } else {
-            // Traditional multi-term query - split by whitespace
-            std::cout << "[INFO] Detected traditional multi-term query" << std::endl;
-            std::istringstream iss(address_keyword);
-            std::string term;
-            while (iss >> term) {
-              query_terms.push_back(term);
+          parse_latency.stop();
+
+          LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+              << "Received reverseGeocode request: (" << point.latitude
+              << ", " << point.longitude << "), limit " << limit << ", "
+              << query_terms.size() << " term(s)";
+
+          Admission admission(admission_, requestTimeout());
+          if (!admission) {
+            return overloadedResponse();
+          }
+
+          // Each data node returns its own nearest records
+          datanode::ReverseGeocodeRequest request;
+          request.set_longitude(point.longitude);
+          request.set_latitude(point.latitude);
+          request.set_max_results(static_cast<int32_t>(limit));
+          request.set_max_distance_meters(max_distance_meters);
+          for (const auto& term : query_terms) {
+            request.add_query_terms(term);
+          }
+          auto results = fanOut(
+              request,
+              &datanode::DataNodeService::Stub::PrepareAsyncReverseGeocode);
+          admission.recordResults(results);
+
+          int successful_nodes;
+          int failed_nodes;
+          int status_code =
+              summarizeResults(results, successful_nodes, failed_nodes);
+          ScopedLatency merge_latency(stage_metrics_.merge_rank);
+          std::vector<NearbyAddressRecord> nearest =
+              mergeByDistance(results, limit);
+          merge_latency.stop();
+
+          ScopedLatency serialize_latency(stage_metrics_.serialize);
+          crow::json::wvalue response;
+          response["latitude"] = point.latitude;
+          response["longitude"] = point.longitude;
+          std::vector<crow::json::wvalue> results_array;
+          for (const auto& nearby : nearest) {
+            crow::json::wvalue json_record =
+                recordToJson(nearby.record, nearby.shard_id);
+            json_record["distance_meters"] = nearby.distance_meters;
+            results_array.push_back(std::move(json_record));
+          }
+          response["results"] = std::move(results_array);
+          response["result_count"] = static_cast<int>(nearest.size());
+          response["successful_nodes"] = successful_nodes;
+          response["failed_nodes"] = failed_nodes;
+          if (status_code == 503) {
+            response["error"] = "All data nodes failed to respond";
+          }
+
+          crow::response http_response(status_code, response);
+          serialize_latency.stop();
+
+          LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+              << "Returning " << nearest.size() << " nearest result(s) from "
+              << successful_nodes << " successful node(s)";
+          return http_response;
+
+        } catch (const std::exception& e) {
+          LogLine(LogLevel::kError, nullptr)
+              << "Exception in reverseGeocode endpoint: " << e.what();
+          crow::json::wvalue error_response;
+          error_response["error"] = "Internal server error";
+          error_response["details"] = e.what();
+          return crow::response(500, error_response);
+        }
+      });
+
+  // Bounding box endpoint: addresses inside a longitude/latitude box,
+  // optionally restricted to those matching an address text
+  CROW_ROUTE(app_, "/api/searchBox")
+      .methods(crow::HTTPMethod::POST)([this](const crow::request& req) {
+        try {
+          ScopedLatency parse_latency(stage_metrics_.parse);
+          auto json_body = crow::json::load(req.body);
+          if (!json_body) {
+            return errorResponse(400, "Invalid JSON in request body");
+          }
+
+          GeoBox box;
+          if (!readNumber(json_body, "min_latitude", box.min_latitude) ||
+              !readNumber(json_body, "min_longitude", box.min_longitude) ||
+              !readNumber(json_body, "max_latitude", box.max_latitude) ||
+              !readNumber(json_body, "max_longitude", box.max_longitude) ||
+              !box.isValid()) {
+            return errorResponse(
+                400,
+                "'min_latitude', 'min_longitude', 'max_latitude' and "
+                "'max_longitude' must form a valid box");
+          }
+          size_t limit;
+          if (!readLimit(json_body, limit)) {
+            return errorResponse(400, "'limit' must be an integer from 1 to " +
+                                          std::to_string(kMaxGeoResults));
+          }
+          std::vector<std::string> query_terms;
+          if (json_body.has("address")) {
+            query_terms = splitQueryTerms(json_body["address"].s());
+          }
+
+          parse_latency.stop();
+
+          LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+              << "Received searchBox request: (" << box.min_latitude << ", "
+              << box.min_longitude << ") - (" << box.max_latitude << ", "
+              << box.max_longitude << "), limit " << limit << ", "
+              << query_terms.size() << " term(s)";
+
+          Admission admission(admission_, requestTimeout());
+          if (!admission) {
+            return overloadedResponse();
+          }
+
+          datanode::SearchBoxRequest request;
+          request.set_min_longitude(box.min_longitude);
+          request.set_min_latitude(box.min_latitude);
+          request.set_max_longitude(box.max_longitude);
+          request.set_max_latitude(box.max_latitude);
+          request.set_max_results(static_cast<int32_t>(limit));
+          for (const auto& term : query_terms) {
+            request.add_query_terms(term);
+          }
+          auto results = fanOut(
+              request, &datanode::DataNodeService::Stub::PrepareAsyncSearchBox);
+          admission.recordResults(results);
+
+          int successful_nodes;
+          int failed_nodes;
+          int status_code =
+              summarizeResults(results, successful_nodes, failed_nodes);
+
+          // Any records in the box will do: take them in data node order.
+          // Rendering them is all the merging there is
+          ScopedLatency serialize_latency(stage_metrics_.serialize);
+          std::vector<crow::json::wvalue> results_array;
+          for (const auto& result : results) {
+            for (const auto& record : result.records) {
+              if (results_array.size() == limit) {
+                break;
+              }
+              results_array.push_back(recordToJson(record, result.shard_id));
             }
           }
+          size_t result_count = results_array.size();
+
+          crow::json::wvalue response;
+          response["results"] = std::move(results_array);
+          response["result_count"] = static_cast<int>(result_count);
+          response["successful_nodes"] = successful_nodes;
+          response["failed_nodes"] = failed_nodes;
+          if (status_code == 503) {
+            response["error"] = "All data nodes failed to respond";
+          }
+
+          crow::response http_response(status_code, response);
+          serialize_latency.stop();
+
+          LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+              << "Returning " << result_count << " result(s) in box from "
+              << successful_nodes << " successful node(s)";
+          return http_response;
+
+        } catch (const std::exception& e) {
+          LogLine(LogLevel::kError, nullptr)
+              << "Exception in searchBox endpoint: " << e.what();
+          crow::json::wvalue error_response;
+          error_response["error"] = "Internal server error";
+          error_response["details"] = e.what();
+          return crow::response(500, error_response);
+        }
+      });
+
+  std::cout << "[INFO] HTTP routes configured" << std::endl;
+}
+
+template <typename Request, typename Response>
+void GatewayServer::startDataNodeCall(Replica& replica,
+                                      const Request& request,
+                                      PrepareCall<Request, Response> prepare,
+                                      FanOut& fan_out,
+                                      size_t index) {
+  // Owned by the completion queue until the call completes
+  auto call = std::make_unique<TypedCall<Request, Response>>();
+  call->shard = shards_[index].get();
+  call->replica = &replica;
+  call->fan_out = &fan_out;
+  call->index = index;
+  call->start_time = std::chrono::steady_clock::now();
+  call->request = request;
+
+  // Set the call deadline
+  call->context.set_deadline(fan_out.deadline);
+
+  LogLine(LogLevel::kDebug, nullptr)
+      << "Starting gRPC call to data node " << replica.config.shard_id
+      << " at " << replica.config.address
+      << " (deadline in "
+      << std::chrono::duration_cast<std::chrono::milliseconds>(
+             fan_out.deadline - std::chrono::system_clock::now())
+             .count()
+      << "ms)";
+
+  // Issue the call without blocking; a polling thread picks up the result
+  call->reader = (replica.stub().*prepare)(&call->context, call->request,
+                                           &completion_queue_);
+  call->reader->StartCall();
+  TypedCall<Request, Response>* tag = call.release();
+  tag->reader->Finish(&tag->response, &tag->status,
+                      static_cast<QueueTag*>(tag));
+
+  // The call cannot complete before fan_out.mutex is released
+  fan_out.shards[index].in_flight.push_back(tag);
+  fan_out.pending++;
+  replica.outstanding.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool GatewayServer::startShardCall(FanOut& fan_out,
+                                   size_t index,
+                                   Replica& replica) {
+  ShardCalls& calls = fan_out.shards[index];
+  calls.tried.push_back(&replica);
+  try {
+    fan_out.start_call(index, replica);
+    return true;
+  } catch (const std::exception& e) {
+    LogLine(LogLevel::kError, nullptr)
+        << "Exception starting gRPC call to data node "
+        << replica.config.shard_id << " at " << replica.config.address
+        << ": " << e.what();
+    if (calls.in_flight.empty()) {
+      // Record a failed result for this shard
+      DataNodeResult failed_result;
+      failed_result.shard_id = replica.config.shard_id;
+      failed_result.success = false;
+      failed_result.error_message = std::string("Exception: ") + e.what();
+      finishShard(fan_out, index, std::move(failed_result));
+    }
+    return false;
+  }
+}
+
+void GatewayServer::finishShard(FanOut& fan_out,
+                                size_t index,
+                                DataNodeResult result) {
+  ShardCalls& calls = fan_out.shards[index];
+  calls.done = true;
+  fan_out.results[index] = std::move(result);
+
+  // The losing calls and the timer still complete on the queue, promptly
+  for (PendingCall* call : calls.in_flight) {
+    call->cancelled = true;
+    call->context.TryCancel();
+  }
+  if (calls.hedge_timer) {
+    calls.hedge_timer->alarm.Cancel();
+  }
+}
+
+DataNodeResult GatewayServer::finishDataNodeCall(const PendingCall& call,
+                                                 bool ok) {
+  const DataNodeConfig& node = call.replica->config;
+  DataNodeResult result;
+  result.shard_id = node.shard_id;
+  result.success = false;
+
+  // Calculate elapsed time
+  auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - call.start_time)
+                        .count();
+
+  if (!ok) {
+    result.error_message = "gRPC error: call aborted by completion queue";
+    LogLine(LogLevel::kError, nullptr)
+        << "Data node " << node.shard_id << " at " << node.address
+        << " query aborted after " << elapsed_ms << "ms";
+  } else if (call.status.ok()) {
+    result.success = true;
+    call.readResponse(result);
+
+    LogLine(LogLevel::kInfo, nullptr, call.fan_out->log_query)
+        << "Data node " << node.shard_id << " at " << node.address
+        << " returned " << result.records.size() << " result(s) in "
+        << elapsed_ms << "ms";
+  } else {
+    // Check if it was a timeout
+    const grpc::Status& status = call.status;
+    result.overloaded =
+        status.error_code() == grpc::StatusCode::DEADLINE_EXCEEDED ||
+        status.error_code() == grpc::StatusCode::RESOURCE_EXHAUSTED;
+    if (status.error_code() == grpc::StatusCode::DEADLINE_EXCEEDED) {
+      result.error_message =
+          "gRPC timeout after " + std::to_string(elapsed_ms) + "ms";
+      LogLine(LogLevel::kError, nullptr)
+          << "Data node " << node.shard_id << " at " << node.address
+          << " query timed out after " << elapsed_ms << "ms";
+    } else {
+      result.error_message = "gRPC error: " + status.error_message() +
+                             " (code: " +
+                             std::to_string(status.error_code()) + ")";
+      LogLine(LogLevel::kError, nullptr)
+          << "Data node " << node.shard_id << " at " << node.address
+          << " query failed after " << elapsed_ms
+          << "ms: " << status.error_message()
+          << " (code: " << status.error_code() << ")";
+    }
+  }
+
+  return result;
+}
+
+void GatewayServer::completeCall(std::unique_ptr<PendingCall> call, bool ok) {
+  FanOut& fan_out = *call->fan_out;
+  Shard& shard = *call->shard;
+  Replica& replica = *call->replica;
+  size_t index = call->index;
+  auto elapsed = std::chrono::steady_clock::now() - call->start_time;
+
+  // Notify while holding the lock: the waiter owns fan_out and may destroy
+  // it as soon as it sees nothing pending
+  std::lock_guard<std::mutex> lock(fan_out.mutex);
+  ShardCalls& calls = fan_out.shards[index];
+  calls.in_flight.erase(
+      std::find(calls.in_flight.begin(), calls.in_flight.end(), call.get()));
+  replica.outstanding.fetch_sub(1, std::memory_order_relaxed);
+  recordReplicaCall(shard, replica, elapsed,
+                    ok ? call->status
+                       : grpc::Status(grpc::StatusCode::UNAVAILABLE,
+                                      "call aborted by completion queue"),
+                    call->cancelled);
+
+  if (!call->cancelled && !calls.done) {
+    DataNodeResult result = finishDataNodeCall(*call, ok);
+    if (result.success) {
+      finishShard(fan_out, index, std::move(result));
+    } else if (calls.in_flight.empty()) {
+      // Nothing else can answer for the shard: fail over to a replica not
+      // tried yet while there is time left
+      Replica* next = std::chrono::system_clock::now() < fan_out.deadline
+                          ? pickReplica(shard, calls.tried)
+                          : nullptr;
+      if (next == nullptr) {
+        finishShard(fan_out, index, std::move(result));
+      } else {
+        shard.failovers.add();
+        LogLine(LogLevel::kWarning, nullptr)
+            << "Failing over data node " << shard.shard_id << " from "
+            << replica.config.address << " to " << next->config.address;
+        startShardCall(fan_out, index, *next);
+      }
+    }
+    // Otherwise another call of the shard is still running and decides
+  }
+  call.reset();
+
+  if (--fan_out.pending == 0) {
+    fan_out.done.notify_one();
+  }
+}
+
+void GatewayServer::completeHedgeTimer(HedgeTimer& timer, bool ok) {
+  FanOut& fan_out = *timer.fan_out;
+  std::lock_guard<std::mutex> lock(fan_out.mutex);
+  ShardCalls& calls = fan_out.shards[timer.index];
+
+  // Fired (rather than cancelled) with the shard still unanswered: ask a
+  // second replica and take whichever answers first
+  if (ok && !calls.done) {
+    Shard& shard = *shards_[timer.index];
+    Replica* replica = pickReplica(shard, calls.tried);
+    if (replica != nullptr) {
+      shard.hedged_calls.add();
+      LogLine(LogLevel::kDebug, nullptr)
+          << "Hedging slow call to data node " << shard.shard_id << " with "
+          << replica->config.address;
+      startShardCall(fan_out, timer.index, *replica);
+    }
+  }
+
+  if (--fan_out.pending == 0) {
+    fan_out.done.notify_one();
+  }
+}
+
+void GatewayServer::pollCompletionQueue() {
+  void* tag;
+  bool ok;
+  while (completion_queue_.Next(&tag, &ok)) {
+    static_cast<QueueTag*>(tag)->onCompleted(*this, ok);
+  }
+}
+
+void GatewayServer::stopCompletionQueue() {
+  completion_queue_.Shutdown();
+  if (completion_threads_.empty()) {
+    // Never started: drain the queue here so it can be destroyed
+    void* tag;
+    bool ok;
+    while (completion_queue_.Next(&tag, &ok)) {
+    }
+    return;
+  }
+  for (auto& thread : completion_threads_) {
+    thread.join();
+  }
+  completion_threads_.clear();
+}
+
+GatewayServer::Replica* GatewayServer::pickReplica(
+    Shard& shard,
+    const std::vector<const Replica*>& tried) {
+  // Start from a rotating replica so that ties are spread evenly
+  size_t count = shard.replicas.size();
+  size_t first = shard.next_replica.fetch_add(1, std::memory_order_relaxed);
+  Replica* best = nullptr;
+  bool best_healthy = false;
+  double best_load = 0.0;
+  for (size_t i = 0; i < count; ++i) {
+    Replica* replica = shard.replicas[(first + i) % count].get();
+    if (std::find(tried.begin(), tried.end(), replica) != tried.end()) {
+      continue;
+    }
+    bool healthy = replica->healthy.load(std::memory_order_relaxed);
+    double load =
+        replica->outstanding.load(std::memory_order_relaxed) + 1.0;
+    if (config_.replica_selection == ReplicaSelection::kEwmaLatency) {
+      load *= std::max(
+          replica->ewma_latency_ms.load(std::memory_order_relaxed),
+          kMinEwmaLatencyMs);
+    }
+    if (best == nullptr || (healthy && !best_healthy) ||
+        (healthy == best_healthy && load < best_load)) {
+      best = replica;
+      best_healthy = healthy;
+      best_load = load;
+    }
+  }
+  return best;
+}
 
-          if (query_terms.empty()) {
-            crow::json::wvalue error_response;
-            error_response["error"] =
-                "Address keyword must contain at least one term";
-            return crow::response(400, error_response);
-          }
+void GatewayServer::recordReplicaCall(
+    Shard& shard,
+    Replica& replica,
+    std::chrono::steady_clock::duration elapsed,
+    const grpc::Status& status,
+    bool cancelled) {
+  // A cancelled call's latency says nothing about the replica
+  if (cancelled) {
+    return;
+  }
+  replica.rpc_latency.record(elapsed);
+  shard.rpc_latency.record(elapsed);
+
+  if (status.ok()) {
+    double latency_ms =
+        std::chrono::duration<double, std::milli>(elapsed).count();
+    double ewma = replica.ewma_latency_ms.load(std::memory_order_relaxed);
+    replica.ewma_latency_ms.store(
+        ewma == 0.0 ? latency_ms : ewma + kEwmaWeight * (latency_ms - ewma),
+        std::memory_order_relaxed);
+    if (!replica.healthy.exchange(true)) {
+      LogLine(LogLevel::kInfo, nullptr)
+          << "Data node " << shard.shard_id << " at "
+          << replica.config.address << " answered again, restored";
+    }
+  } else if (status.error_code() == grpc::StatusCode::UNAVAILABLE) {
+    // Passive ejection: the replica is only called again once no healthy
+    // replica is left, or once a health check restores it
+    if (replica.healthy.exchange(false)) {
+      LogLine(LogLevel::kWarning, nullptr)
+          << "Data node " << shard.shard_id << " at "
+          << replica.config.address
+          << " is unavailable, ejected: " << status.error_message();
+    }
+  }
+}
 
-          std::cout << "[INFO] Query terms: ";
-          for (size_t i = 0; i < query_terms.size(); ++i) {
-            std::cout << "\"" << query_terms[i] << "\"";
-            if (i < query_terms.size() - 1) {
-              std::cout << ", ";
-            }
-          }
-          std::cout << std::endl;
+void GatewayServer::runMaintenance() {
+  auto interval = std::chrono::milliseconds(
+      config_.health_check_interval_ms > 0 ? config_.health_check_interval_ms
+                                           : 1000);
+  std::unique_lock<std::mutex> lock(maintenance_mutex_);
+  while (!maintenance_wakeup_.wait_for(
+      lock, interval, [this]() { return stop_maintenance_; })) {
+    lock.unlock();
+    if (config_.health_check_interval_ms > 0) {
+      checkReplicaHealth();
+    }
+    updateHedgeDelays();
+    lock.lock();
+  }
+}
 
-          // Query all data nodes
-          auto results = queryAllDataNodes(query_terms);
+void GatewayServer::stopMaintenance() {
+  {
+    std::lock_guard<std::mutex> lock(maintenance_mutex_);
+    stop_maintenance_ = true;
+  }
+  maintenance_wakeup_.notify_all();
+  if (maintenance_thread_.joinable()) {
+    maintenance_thread_.join();
+  }
+}
 
-          // Count successful and failed nodes
-          int successful_nodes = 0;
-          int failed_nodes = 0;
-          for (const auto& result : results) {
-            if (result.success) {
-              successful_nodes++;
-            } else {
-              failed_nodes++;
-              std::cerr << "[WARNING] Data node " << result.shard_id
-                        << " failed: " << result.error_message << std::endl;
-            }
-          }
+void GatewayServer::checkReplicaHealth() {
+  struct HealthCheck {
+    Shard* shard;
+    Replica* replica;
+    grpc::ClientContext context;
+    grpc::health::v1::HealthCheckResponse response;
+    grpc::Status status;
+    std::unique_ptr<
+        grpc::ClientAsyncResponseReader<grpc::health::v1::HealthCheckResponse>>
+        reader;
+  };
 
-          // Aggregate and rank results (top 5)
-          auto ranked_results = aggregateAndRankResults(results, query_terms, 5);
+  // All checks share one deadline, so a round never outlasts the interval
+  auto deadline =
+      std::chrono::system_clock::now() +
+      std::chrono::milliseconds(std::min(config_.grpc_timeout_ms,
+                                         config_.health_check_interval_ms));
+  grpc::health::v1::HealthCheckRequest request;
+  grpc::CompletionQueue queue;
+  std::vector<std::unique_ptr<HealthCheck>> checks;
+  for (const auto& shard : shards_) {
+    for (const auto& replica : shard->replicas) {
+      auto check = std::make_unique<HealthCheck>();
+      check->shard = shard.get();
+      check->replica = replica.get();
+      check->context.set_deadline(deadline);
+      check->reader = replica->health_stub->AsyncCheck(&check->context,
+                                                       request, &queue);
+      check->reader->Finish(&check->response, &check->status, check.get());
+      checks.push_back(std::move(check));
+    }
+  }
 
-          // Build JSON response
-          crow::json::wvalue response;
-          response["query"] = address_keyword;
+  for (size_t i = 0; i < checks.size(); ++i) {
+    void* tag;
+    bool ok;
+    if (!queue.Next(&tag, &ok)) {
+      break;
+    }
+    const HealthCheck& check = *static_cast<HealthCheck*>(tag);
+    Replica& replica = *check.replica;
 
-          // Build query_terms array
-          std::vector<crow::json::wvalue> terms_array;
-          for (const auto& term : query_terms) {
-            terms_array.push_back(term);
-          }
-          response["query_terms"] = std::move(terms_array);
+    // A node without the health service is judged by its calls alone
+    if (check.status.error_code() == grpc::StatusCode::UNIMPLEMENTED) {
+      continue;
+    }
+    bool serving = check.status.ok() &&
+                   check.response.status() ==
+                       grpc::health::v1::HealthCheckResponse::SERVING;
+    if (serving && !replica.healthy.exchange(true)) {
+      LogLine(LogLevel::kInfo, nullptr)
+          << "Data node " << check.shard->shard_id << " at "
+          << replica.config.address << " passed its health check, restored";
+    } else if (!serving && replica.healthy.exchange(false)) {
+      LogLine(LogLevel::kWarning, nullptr)
+          << "Data node " << check.shard->shard_id << " at "
+          << replica.config.address << " failed its health check, "
+          << "ejected: "
+          << (check.status.ok() ? "not serving"
+                                : check.status.error_message());
+    }
+  }
 
-          // Build results array with ranked records
-          std::vector<crow::json::wvalue> results_array;
-          for (const auto& scored : ranked_results) {
-            crow::json::wvalue json_record;
-            json_record["hash"] = scored.record.hash();
-            json_record["longitude"] = scored.record.longitude();
-            json_record["latitude"] = scored.record.latitude();
-            json_record["number"] = scored.record.number();
-            json_record["street"] = scored.record.street();
-            json_record["unit"] = scored.record.unit();
-            json_record["city"] = scored.record.city();
-            json_record["postcode"] = scored.record.postcode();
-            json_record["shard_id"] = scored.shard_id;
-            json_record["relevance_score"] = scored.relevance_score;
-            results_array.push_back(std::move(json_record));
-          }
+  queue.Shutdown();
+  void* tag;
+  bool ok;
+  while (queue.Next(&tag, &ok)) {
+  }
+}
 
-          response["results"] = std::move(results_array);
-          response["result_count"] = static_cast<int>(ranked_results.size());
-          response["successful_nodes"] = successful_nodes;
-          response["failed_nodes"] = failed_nodes;
+void GatewayServer::updateHedgeDelays() {
+  if (config_.hedge_percentile <= 0) {
+    return;
+  }
+  for (const auto& shard : shards_) {
+    if (shard->replicas.size() < 2) {
+      continue;  // No other replica to hedge with
+    }
+    LatencyHistogram::Snapshot snapshot = shard->rpc_latency.snapshot();
+    LatencyHistogram::Snapshot window =
+        subtractSnapshot(snapshot, shard->hedge_baseline);
+    if (window.count < kMinHedgeSamples) {
+      continue;
+    }
+    shard->hedge_delay_ns.store(static_cast<int64_t>(window.percentile(
+                                    config_.hedge_percentile / 100.0)),
+                                std::memory_order_relaxed);
+    shard->hedge_baseline = std::move(snapshot);
+  }
+}
 
-          std::cout << "[INFO] Returning " << ranked_results.size()
-                    << " ranked result(s) from " << successful_nodes
-                    << " successful node(s)" << std::endl;
+std::vector<DataNodeResult> GatewayServer::queryAllDataNodes(
+    const std::vector<std::string>& query_terms,
+    size_t max_results,
+    int fuzziness) {
+  datanode::SearchRequest request;
+  for (const auto& term : query_terms) {
+    request.add_query_terms(term);
+  }
+  request.set_max_results(static_cast<int32_t>(max_results));
+  request.set_fuzziness(fuzziness);
+  return fanOut(request, &datanode::DataNodeService::Stub::PrepareAsyncSearch);
+}
 
-          // Return 200 OK with results (even if empty)
-          // Return 207 Multi-Status if some nodes failed but we have results
-          // Return 503 Service Unavailable if all nodes failed
-          if (failed_nodes > 0 && successful_nodes == 0) {
-            response["error"] = "All data nodes failed to respond";
-            return crow::response(503, response);
-          } else if (failed_nodes > 0) {
-            return crow::response(207, response);
-          } else {
-            return crow::response(200, response);
-          }
+std::optional<DataNodeResult> GatewayServer::lookupOnOwningShard(
+    const std::vector<std::string>& query_terms,
+    size_t max_results) {
+  if (!partition_ || partition_->key() != ShardPartition::Key::kPostcode ||
+      !isStructuredQuery(query_terms)) {
+    return std::nullopt;
+  }
 
-        } catch (const std::exception& e) {
-          std::cerr << "[ERROR] Exception in findAddress endpoint: " << e.what()
-                    << std::endl;
-          crow::json::wvalue error_response;
-          error_response["error"] = "Internal server error";
-          error_response["details"] = e.what();
-          return crow::response(500, error_response);
-        }
+  // Only the key with the postcode is held by records of one postcode, so
+  // by one shard alone
+  StructuredQueryKeys keys = structuredQueryKeys(query_terms[0], normalizer_);
+  if (!keys.has_postcode_key) {
+    return std::nullopt;
+  }
+  std::optional<size_t> shard_id = partition_->shardForPostcode(keys.postcode);
+  if (!shard_id) {
+    return std::nullopt;
+  }
+  // initialize() only sets partition_ if every shard ID it maps to is
+  // configured
+  auto shard_it = std::find_if(
+      shards_.begin(), shards_.end(), [&shard_id](const auto& shard) {
+        return static_cast<size_t>(shard->shard_id) == *shard_id;
       });
-
-  std::cout << "[INFO] HTTP routes configured" << std::endl;
+  Shard& shard = **shard_it;
+  size_t index = static_cast<size_t>(shard_it - shards_.begin());
+
+  datanode::LookupRequest request;
+  request.add_keys(keys.keys[0]);
+  request.add_query_terms(query_terms[0]);
+  request.set_max_results(static_cast<int32_t>(max_results));
+  LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+      << "Looking up postcode " << keys.postcode << " on data node "
+      << shard.shard_id << " only";
+  shard.routed_lookups.add();
+  std::vector<DataNodeResult> results = fanOut(
+      request, &datanode::DataNodeService::Stub::PrepareAsyncLookup, {index});
+
+  if (!results[0].success || results[0].records.empty()) {
+    LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+        << "Routed lookup found nothing, querying all data nodes";
+    shard.routed_lookup_fallbacks.add();
+    return std::nullopt;
+  }
+  return std::move(results[0]);
 }
 
-DataNodeResult GatewayServer::queryDataNode(
-    const DataNodeConnection& connection,
-    const std::vector<std::string>& query_terms) {
-  DataNodeResult result;
-  result.shard_id = connection.config.shard_id;
-  result.success = false;
+std::vector<DataNodeResult> GatewayServer::streamAllDataNodes(
+    const std::vector<std::string>& query_terms,
+    size_t max_results,
+    int fuzziness) {
+  // No per-shard limit: each stream is cancelled once the merge has read
+  // enough of it
+  datanode::SearchRequest request;
+  for (const auto& term : query_terms) {
+    request.add_query_terms(term);
+  }
+  request.set_fuzziness(fuzziness);
 
-  // Start timing the gRPC call
-  auto start_time = std::chrono::steady_clock::now();
+  LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+      << "Streaming from " << shards_.size()
+      << " data node(s) in parallel...";
+  auto overall_start = std::chrono::steady_clock::now();
 
-  try {
-    // Create gRPC context with timeout
-    grpc::ClientContext context;
-    auto deadline = std::chrono::system_clock::now() +
-                    std::chrono::milliseconds(config_.grpc_timeout_ms);
-    context.set_deadline(deadline);
-
-    std::cout << "[INFO] Starting gRPC call to data node "
-              << connection.config.shard_id << " at "
-              << connection.config.address << " (timeout: "
-              << config_.grpc_timeout_ms << "ms)" << std::endl;
-
-    // Prepare request
-    datanode::SearchRequest request;
-    for (const auto& term : query_terms) {
-      request.add_query_terms(term);
-    }
-
-    // Make gRPC call
-    datanode::SearchResponse response;
-    grpc::Status status = connection.stub->Search(&context, request, &response);
-
-    // Calculate elapsed time
-    auto end_time = std::chrono::steady_clock::now();
-    auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                          end_time - start_time)
-                          .count();
-
-    if (status.ok()) {
-      result.success = true;
-      // Copy results
-      for (const auto& record : response.results()) {
-        result.records.push_back(record);
-      }
+  // The merge runs on this thread, driving a completion queue of its own
+  grpc::CompletionQueue queue;
+  std::vector<std::unique_ptr<ShardStream>> streams;
+  // Streams are neither hedged nor failed over: each reads one replica
+  for (const auto& shard : shards_) {
+    auto stream = std::make_unique<ShardStream>();
+    stream->shard = shard.get();
+    stream->replica = pickReplica(*shard, {});
+    stream->replica->outstanding.fetch_add(1, std::memory_order_relaxed);
+    stream->start_time = std::chrono::steady_clock::now();
+    stream->result.shard_id = shard->shard_id;
+    stream->result.success = false;
+    stream->context.set_deadline(callDeadline());
+    stream->reader = stream->replica->stub().PrepareAsyncSearchStream(
+        &stream->context, request, &queue);
+    stream->reader->StartCall(stream.get());
+    streams.push_back(std::move(stream));
+  }
 
-      std::cout << "[INFO] Data node " << connection.config.shard_id
-                << " returned " << result.records.size() << " result(s) in "
-                << elapsed_ms << "ms" << std::endl;
-    } else {
-      // Check if it was a timeout
-      if (status.error_code() == grpc::StatusCode::DEADLINE_EXCEEDED) {
+  auto finish_stream = [](ShardStream& stream) {
+    stream.state = ShardStream::State::kFinishing;
+    stream.reader->Finish(&stream.status, &stream);
+  };
+  auto read_stream = [](ShardStream& stream) {
+    stream.state = ShardStream::State::kReading;
+    stream.reader->Read(&stream.chunk, &stream);
+  };
+
+  // Streams with a record ready to merge, the best next record on top
+  auto worse_head = [](const ShardStream* a, const ShardStream* b) {
+    return a->headScore() < b->headScore();
+  };
+  std::vector<ShardStream*> heads;
+  size_t waiting = streams.size();  // Live streams with no record ready
+  size_t done = 0;
+  size_t merged = 0;
+  bool cancelling = false;
+
+  while (done < streams.size()) {
+    void* tag;
+    bool ok;
+    if (!queue.Next(&tag, &ok)) {
+      break;
+    }
+    ShardStream& stream = *static_cast<ShardStream*>(tag);
+
+    if (stream.state == ShardStream::State::kFinishing) {
+      stream.state = ShardStream::State::kDone;
+      done++;
+
+      DataNodeResult& result = stream.result;
+      auto elapsed = std::chrono::steady_clock::now() - stream.start_time;
+      stream.replica->outstanding.fetch_sub(1, std::memory_order_relaxed);
+      recordReplicaCall(*stream.shard, *stream.replica, elapsed,
+                        stream.status, stream.cancelled);
+      auto elapsed_ms =
+          std::chrono::duration_cast<std::chrono::milliseconds>(elapsed)
+              .count();
+      const grpc::Status& status = stream.status;
+      if (!result.error_message.empty()) {
+        // Already failed by the merge (malformed chunk)
+      } else if (status.ok() || stream.cancelled) {
+        result.success = true;
+      } else if (status.error_code() == grpc::StatusCode::DEADLINE_EXCEEDED) {
+        result.overloaded = true;
         result.error_message =
             "gRPC timeout after " + std::to_string(elapsed_ms) + "ms";
-        std::cerr << "[ERROR] Data node " << connection.config.shard_id
-                  << " query timed out after " << elapsed_ms << "ms"
-                  << std::endl;
       } else {
+        result.overloaded =
+            status.error_code() == grpc::StatusCode::RESOURCE_EXHAUSTED;
         result.error_message = "gRPC error: " + status.error_message() +
                                " (code: " +
                                std::to_string(status.error_code()) + ")";
-        std::cerr << "[ERROR] Data node " << connection.config.shard_id
-                  << " query failed after " << elapsed_ms
-                  << "ms: " << status.error_message()
-                  << " (code: " << status.error_code() << ")" << std::endl;
       }
+      if (result.success) {
+        LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+            << "Data node " << result.shard_id << " contributed "
+            << result.records.size() << " streamed result(s) in "
+            << elapsed_ms << "ms"
+            << (stream.cancelled ? " before cancellation" : "");
+      } else {
+        LogLine(LogLevel::kError, nullptr)
+            << "Data node " << result.shard_id << " stream failed: "
+            << result.error_message;
+      }
+      continue;
     }
 
-  } catch (const std::exception& e) {
-    auto end_time = std::chrono::steady_clock::now();
-    auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                          end_time - start_time)
-                          .count();
+    // The start or a read of the stream completed
+    waiting--;
+    bool started = stream.state == ShardStream::State::kStarting;
+    if (!ok || stream.cancelled) {
+      finish_stream(stream);  // Ended, failed or cancelled
+    } else if (started || stream.chunk.results_size() == 0) {
+      waiting++;
+      read_stream(stream);
+    } else if (stream.chunk.scores_size() != stream.chunk.results_size()) {
+      stream.result.error_message = "Malformed SearchStream chunk";
+      stream.context.TryCancel();
+      finish_stream(stream);
+    } else {
+      stream.state = ShardStream::State::kReady;
+      stream.position = 0;
+      heads.push_back(&stream);
+      std::push_heap(heads.begin(), heads.end(), worse_head);
+    }
+
+    // A record can be merged only once every live stream offers one, since
+    // later records of a stream never score higher
+    while (waiting == 0 && !heads.empty() && merged < max_results) {
+      std::pop_heap(heads.begin(), heads.end(), worse_head);
+      ShardStream& best = *heads.back();
+      heads.pop_back();
+
+      double score = best.headScore();
+      const datanode::AddressRecord& record =
+          best.chunk.results(best.position++);
+      bool duplicate = false;
+      for (const auto& other : streams) {
+        for (const auto& existing : other->result.records) {
+          duplicate = duplicate || isDuplicate(existing, record);
+        }
+      }
+      if (!duplicate) {
+        best.result.records.push_back(record);
+        best.result.scores.push_back(score);
+        merged++;
+      }
+
+      if (best.position < best.chunk.results_size()) {
+        heads.push_back(&best);
+        std::push_heap(heads.begin(), heads.end(), worse_head);
+      } else {
+        waiting++;
+        read_stream(best);
+      }
+    }
+
+    // Enough top results: stop the streams still running
+    if (merged == max_results && !cancelling) {
+      cancelling = true;
+      for (auto& other : streams) {
+        if (other->state == ShardStream::State::kFinishing ||
+            other->state == ShardStream::State::kDone) {
+          continue;
+        }
+        other->cancelled = true;
+        other->context.TryCancel();
+        if (other->state == ShardStream::State::kReady) {
+          finish_stream(*other);
+        }
+      }
+      heads.clear();
+    }
+  }
 
-    result.error_message = std::string("Exception: ") + e.what();
-    std::cerr << "[ERROR] Exception querying data node "
-              << connection.config.shard_id << " after " << elapsed_ms
-              << "ms: " << e.what() << std::endl;
+  queue.Shutdown();
+  void* tag;
+  bool ok;
+  while (queue.Next(&tag, &ok)) {
   }
 
-  return result;
+  auto overall_elapsed = std::chrono::steady_clock::now() - overall_start;
+  stage_metrics_.fan_out.record(overall_elapsed);
+  LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+      << "Streamed merge of " << merged << " result(s) completed in "
+      << std::chrono::duration_cast<std::chrono::milliseconds>(
+             overall_elapsed)
+             .count()
+      << "ms";
+
+  std::vector<DataNodeResult> results;
+  for (auto& stream : streams) {
+    results.push_back(std::move(stream->result));
+  }
+  return results;
 }
 
-std::vector<DataNodeResult> GatewayServer::queryAllDataNodes(
-    const std::vector<std::string>& query_terms) {
-  std::cout << "[INFO] Querying " << connections_.size()
-            << " data node(s) in parallel..." << std::endl;
+std::vector<std::vector<DataNodeResult>> GatewayServer::queryAllDataNodesBatch(
+    const std::vector<std::vector<std::string>>& queries,
+    size_t max_results) {
+  // Start the calls of every chunk before waiting for any of them, so the
+  // data nodes work on all chunks at once
+  std::vector<std::unique_ptr<FanOut>> fan_outs;
+  for (size_t first = 0; first < queries.size(); first += kBatchChunkQueries) {
+    size_t last = std::min(queries.size(), first + kBatchChunkQueries);
+    datanode::BatchSearchRequest request;
+    for (size_t i = first; i < last; ++i) {
+      datanode::SearchRequest* query = request.add_queries();
+      for (const auto& term : queries[i]) {
+        query->add_query_terms(term);
+      }
+      query->set_max_results(static_cast<int32_t>(max_results));
+    }
+    fan_outs.push_back(std::make_unique<FanOut>());
+    startFanOut(request,
+                &datanode::DataNodeService::Stub::PrepareAsyncBatchSearch,
+                *fan_outs.back());
+  }
 
-  // Start timing the overall parallel query operation
-  auto overall_start = std::chrono::steady_clock::now();
+  // Split each node's answer to a chunk into one result per query
+  std::vector<std::vector<DataNodeResult>> query_results(queries.size());
+  for (size_t chunk = 0; chunk < fan_outs.size(); ++chunk) {
+    size_t first = chunk * kBatchChunkQueries;
+    size_t count = std::min(queries.size() - first, kBatchChunkQueries);
+    for (const DataNodeResult& result : finishFanOut(*fan_outs[chunk])) {
+      bool complete =
+          result.success && result.query_offsets.size() == count + 1;
+      for (size_t i = 0; i < count; ++i) {
+        DataNodeResult query_result;
+        query_result.shard_id = result.shard_id;
+        query_result.success = complete;
+        query_result.overloaded = result.overloaded;
+        if (complete) {
+          query_result.records.assign(
+              result.records.begin() + result.query_offsets[i],
+              result.records.begin() + result.query_offsets[i + 1]);
+          if (!result.scores.empty()) {
+            query_result.scores.assign(
+                result.scores.begin() + result.query_offsets[i],
+                result.scores.begin() + result.query_offsets[i + 1]);
+          }
+        } else if (result.success) {
+          query_result.error_message = "Malformed BatchSearch response";
+        } else {
+          query_result.error_message = result.error_message;
+        }
+        query_results[first + i].push_back(std::move(query_result));
+      }
+    }
+  }
+  return query_results;
+}
+
+template <typename Request, typename Response>
+std::vector<DataNodeResult> GatewayServer::fanOut(
+    const Request& request,
+    PrepareCall<Request, Response> prepare,
+    std::vector<size_t> targets) {
+  FanOut fan_out;
+  startFanOut(request, prepare, fan_out, std::move(targets));
+  return finishFanOut(fan_out);
+}
+
+template <typename Request, typename Response>
+void GatewayServer::startFanOut(const Request& request,
+                                PrepareCall<Request, Response> prepare,
+                                FanOut& fan_out,
+                                std::vector<size_t> targets) {
+  if (targets.empty()) {
+    targets.resize(shards_.size());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      targets[i] = i;
+    }
+  }
+  fan_out.targets = std::move(targets);
+  fan_out.log_query = isQueryLogged();
+  LogLine(LogLevel::kInfo, nullptr, fan_out.log_query)
+      << "Querying " << fan_out.targets.size()
+      << " data node(s) in parallel...";
 
-  // Launch async queries to all data nodes using std::async
-  // std::launch::async ensures each call runs in a separate thread
-  std::vector<std::future<DataNodeResult>> futures;
-  futures.reserve(connections_.size());
+  // Start timing the overall parallel query operation
+  fan_out.start_time = std::chrono::steady_clock::now();
+  fan_out.deadline = callDeadline();
+  fan_out.results.resize(shards_.size());
+  fan_out.shards.resize(shards_.size());
+  fan_out.start_call = [this, request, prepare, &fan_out](size_t index,
+                                                          Replica& replica) {
+    startDataNodeCall(replica, request, prepare, fan_out, index);
+  };
 
-  for (const auto& connection : connections_) {
-    std::cout << "[INFO] Launching async gRPC call to data node "
-              << connection.config.shard_id << std::endl;
+  // Issue all shard calls up front; none of them blocks this thread. The
+  // lock keeps completions from racing the setup of their shard
+  std::lock_guard<std::mutex> lock(fan_out.mutex);
+  for (size_t i : fan_out.targets) {
+    Shard& shard = *shards_[i];
+    Replica* replica = pickReplica(shard, {});
+    LogLine(LogLevel::kDebug, nullptr)
+        << "Launching async gRPC call to data node " << shard.shard_id
+        << " at " << replica->config.address;
+    if (!startShardCall(fan_out, i, *replica)) {
+      continue;
+    }
 
-    futures.push_back(std::async(std::launch::async,
-                                 &GatewayServer::queryDataNode, this,
-                                 std::cref(connection), std::cref(query_terms)));
+    // Ask a second replica if the call outlives the shard's hedge delay
+    auto hedge_delay = std::chrono::nanoseconds(
+        shard.hedge_delay_ns.load(std::memory_order_relaxed));
+    auto hedge_time = std::chrono::system_clock::now() + hedge_delay;
+    if (hedge_delay.count() > 0 && hedge_time < fan_out.deadline) {
+      ShardCalls& calls = fan_out.shards[i];
+      calls.hedge_timer = std::make_unique<HedgeTimer>();
+      calls.hedge_timer->fan_out = &fan_out;
+      calls.hedge_timer->index = i;
+      calls.hedge_timer->alarm.Set(&completion_queue_, hedge_time,
+                                   static_cast<QueueTag*>(
+                                       calls.hedge_timer.get()));
+      fan_out.pending++;
+    }
   }
 
-  std::cout << "[INFO] All " << futures.size()
-            << " async gRPC calls launched, waiting for results..." << std::endl;
+  LogLine(LogLevel::kDebug, nullptr)
+      << "All " << fan_out.targets.size()
+      << " async gRPC calls launched, waiting for results...";
+}
+
+std::vector<DataNodeResult> GatewayServer::finishFanOut(FanOut& fan_out) {
+  // Every call carries the fan-out's deadline, so each one completes
+  // (possibly with DEADLINE_EXCEEDED) by then
+  {
+    std::unique_lock<std::mutex> lock(fan_out.mutex);
+    fan_out.done.wait(lock, [&fan_out]() { return fan_out.pending == 0; });
+  }
 
-  // Collect results from all futures
   std::vector<DataNodeResult> results;
-  results.reserve(futures.size());
+  results.reserve(fan_out.targets.size());
+  for (size_t index : fan_out.targets) {
+    results.push_back(std::move(fan_out.results[index]));
+  }
 
   int successful_count = 0;
   int failed_count = 0;
   int timeout_count = 0;
 
-  for (size_t i = 0; i < futures.size(); ++i) {
-    try {
-      // Wait for the future to complete and get the result
-      // Note: future.get() will block until the result is available
-      // The timeout is handled within queryDataNode via gRPC context deadline
-      DataNodeResult result = futures[i].get();
-
-      results.push_back(result);
-
-      if (result.success) {
-        successful_count++;
-      } else {
-        failed_count++;
-        // Check if it was a timeout
-        if (result.error_message.find("timeout") != std::string::npos ||
-            result.error_message.find("DEADLINE_EXCEEDED") !=
-                std::string::npos) {
-          timeout_count++;
-        }
-      }
-
-    } catch (const std::exception& e) {
-      std::cerr << "[ERROR] Exception collecting result from future " << i
-                << ": " << e.what() << std::endl;
-
-      // Add a failed result for this node
-      DataNodeResult failed_result;
-      failed_result.shard_id = (i < connections_.size())
-                                   ? connections_[i].config.shard_id
-                                   : -1;
-      failed_result.success = false;
-      failed_result.error_message =
-          std::string("Future exception: ") + e.what();
-      results.push_back(failed_result);
+  for (const auto& result : results) {
+    if (result.success) {
+      successful_count++;
+    } else {
       failed_count++;
+      // Check if it was a timeout
+      if (result.error_message.find("timeout") != std::string::npos ||
+          result.error_message.find("DEADLINE_EXCEEDED") !=
+              std::string::npos) {
+        timeout_count++;
+      }
     }
   }
 
   // Calculate overall elapsed time
   auto overall_end = std::chrono::steady_clock::now();
+  stage_metrics_.fan_out.record(overall_end - fan_out.start_time);
   auto overall_elapsed_ms =
-      std::chrono::duration_cast<std::chrono::milliseconds>(overall_end -
-                                                            overall_start)
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          overall_end - fan_out.start_time)
           .count();
 
   // Log performance metrics
-  std::cout << "[INFO] Parallel query completed in " << overall_elapsed_ms
-            << "ms" << std::endl;
-  std::cout << "[INFO] Results summary: " << successful_count
-            << " successful, " << failed_count << " failed";
-  if (timeout_count > 0) {
-    std::cout << " (" << timeout_count << " timeouts)";
+  LogLine(LogLevel::kInfo, nullptr, fan_out.log_query)
+      << "Parallel query completed in " << overall_elapsed_ms << "ms";
+  {
+    LogLine line(LogLevel::kInfo, nullptr, fan_out.log_query);
+    line << "Results summary: " << successful_count << " successful, "
+         << failed_count << " failed";
+    if (timeout_count > 0) {
+      line << " (" << timeout_count << " timeouts)";
+    }
   }
-  std::cout << std::endl;
 
   // Log partial failure warning if applicable
   if (failed_count > 0 && successful_count > 0) {
-    std::cout << "[WARNING] Partial failure: " << successful_count
-              << " node(s) succeeded but " << failed_count << " node(s) failed"
-              << std::endl;
+    LogLine(LogLevel::kWarning, nullptr)
+        << "Partial failure: " << successful_count << " node(s) succeeded but "
+        << failed_count << " node(s) failed";
   } else if (failed_count > 0 && successful_count == 0) {
-    std::cerr << "[ERROR] Complete failure: all " << failed_count
-              << " data node(s) failed to respond" << std::endl;
+    LogLine(LogLevel::kError, nullptr)
+        << "Complete failure: all " << failed_count
+        << " data node(s) failed to respond";
   }
 
   return results;
@@ -434,6 +2052,9 @@ void GatewayServer::run() {
 
   // Configure Crow to use the specified port
   app_.port(config_.http_port);
+  if (config_.http_threads > 0) {
+    app_.concurrency(static_cast<uint16_t>(config_.http_threads));
+  }
 
   // Run the server (blocking call)
   // Note: Crow's run() is blocking, so this will block until shutdown
@@ -457,102 +2078,320 @@ void GatewayServer::shutdown() {
   std::cout << "[INFO] Gateway server shutdown complete" << std::endl;
 }
 
-bool GatewayServer::isShutdownRequested() const {
-  return shutdown_requested_.load();
+QueryCache::Stats GatewayServer::getQueryCacheStats() const {
+  return query_cache_.getStats();
 }
 
-bool GatewayServer::isDuplicate(const datanode::AddressRecord& a,
-                                 const datanode::AddressRecord& b) {
-  // Two addresses are considered duplicates if they have the same:
-  // - Street number
-  // - Street name
-  // - City
-  // - Postcode
-  // We ignore unit numbers as they might differ in formatting
+ConcurrencyLimiter::Stats GatewayServer::getAdmissionStats() const {
+  return admission_.getStats();
+}
 
-  return a.number() == b.number() &&
-         a.street() == b.street() &&
-         a.city() == b.city() &&
-         a.postcode() == b.postcode();
+std::chrono::milliseconds GatewayServer::requestTimeout() const {
+  return std::chrono::milliseconds(config_.request_timeout_ms > 0
+                                       ? config_.request_timeout_ms
+                                       : config_.grpc_timeout_ms);
 }
 
-double GatewayServer::calculateRelevanceScore(
-    const datanode::AddressRecord& record,
-    const std::vector<std::string>& query_terms) {
-  double score = 0.0;
+std::chrono::system_clock::time_point GatewayServer::callDeadline() const {
+  auto deadline = std::chrono::system_clock::now() +
+                  std::chrono::milliseconds(config_.grpc_timeout_ms);
+  if (t_request_deadline) {
+    deadline = std::min(deadline, *t_request_deadline);
+  }
+  return deadline;
+}
 
-  // Collect all searchable fields from the record
-  std::vector<std::string> fields = {
-    record.street(),
-    record.city(),
-    record.postcode(),
-    record.number()
-  };
+std::optional<int> GatewayServer::shardForHash(size_t hash) const {
+  if (!partition_) {
+    return std::nullopt;
+  }
+  std::optional<size_t> shard = partition_->shardForHash(hash);
+  if (!shard) {
+    return std::nullopt;
+  }
+  return static_cast<int>(*shard);
+}
 
-  // Count how many query terms match in the record
-  int matching_terms = 0;
-  for (const auto& term : query_terms) {
-    bool found = false;
-    for (const auto& field : fields) {
-      if (field.find(term) != std::string::npos) {
-        found = true;
-        break;
-      }
+std::string GatewayServer::renderMetrics() {
+  std::string out;
+
+  appendPrometheusHeader(out, "gateway_stage_latency_seconds", "summary",
+                         "Latency of each stage of the search requests");
+  const std::pair<const char*, const LatencyHistogram*> stages[] = {
+      {"parse", &stage_metrics_.parse},
+      {"fan_out", &stage_metrics_.fan_out},
+      {"merge_rank", &stage_metrics_.merge_rank},
+      {"serialize", &stage_metrics_.serialize}};
+  for (const auto& [stage, histogram] : stages) {
+    appendPrometheusSummary(out, "gateway_stage_latency_seconds",
+                            std::string("stage=\"") + stage + "\"",
+                            histogram->snapshot());
+  }
+
+  appendPrometheusHeader(out, "gateway_shard_rpc_latency_seconds", "summary",
+                         "Latency of the calls to each data node");
+  for (const auto& shard : shards_) {
+    appendPrometheusSummary(
+        out, "gateway_shard_rpc_latency_seconds",
+        "shard=\"" + std::to_string(shard->shard_id) + "\"",
+        shard->rpc_latency.snapshot());
+  }
+
+  // Replicas are labelled with their shard and address
+  auto replica_labels = [](const Shard& shard, const Replica& replica) {
+    return "shard=\"" + std::to_string(shard.shard_id) + "\",replica=\"" +
+           replica.config.address + "\"";
+  };
+  appendPrometheusHeader(out, "gateway_replica_rpc_latency_seconds",
+                         "summary",
+                         "Latency of the calls to each data node replica");
+  for (const auto& shard : shards_) {
+    for (const auto& replica : shard->replicas) {
+      appendPrometheusSummary(out, "gateway_replica_rpc_latency_seconds",
+                              replica_labels(*shard, *replica),
+                              replica->rpc_latency.snapshot());
+    }
+  }
+  appendPrometheusHeader(out, "gateway_replica_healthy", "gauge",
+                         "Whether each data node replica receives calls "
+                         "(0 while ejected)");
+  for (const auto& shard : shards_) {
+    for (const auto& replica : shard->replicas) {
+      appendPrometheusSample(out, "gateway_replica_healthy",
+                             replica_labels(*shard, *replica),
+                             replica->healthy.load() ? 1 : 0);
     }
-    if (found) {
-      matching_terms++;
+  }
+  appendPrometheusHeader(out, "gateway_replica_outstanding_calls", "gauge",
+                         "Calls in flight to each data node replica");
+  for (const auto& shard : shards_) {
+    for (const auto& replica : shard->replicas) {
+      appendPrometheusSample(out, "gateway_replica_outstanding_calls",
+                             replica_labels(*shard, *replica),
+                             replica->outstanding.load());
     }
   }
 
-  // Base score: percentage of query terms that match
-  // This is the most important factor
-  if (!query_terms.empty()) {
-    score += (static_cast<double>(matching_terms) / query_terms.size()) * 100.0;
+  const std::tuple<const char*, const char*, Counter Shard::*>
+      shard_counters[] = {
+          {"gateway_hedged_calls_total",
+           "Second calls sent to another replica of a slow shard",
+           &Shard::hedged_calls},
+          {"gateway_failover_calls_total",
+           "Calls retried on another replica of a shard after a failure",
+           &Shard::failovers},
+          {"gateway_routed_lookups_total",
+           "Structured queries looked up on the only shard holding their "
+           "postcode",
+           &Shard::routed_lookups},
+          {"gateway_routed_lookup_fallbacks_total",
+           "Routed lookups that found nothing, so the query was sent to "
+           "every shard",
+           &Shard::routed_lookup_fallbacks}};
+  for (const auto& [name, help, counter] : shard_counters) {
+    appendPrometheusHeader(out, name, "counter", help);
+    for (const auto& shard : shards_) {
+      appendPrometheusSample(
+          out, name, "shard=\"" + std::to_string(shard->shard_id) + "\"",
+          static_cast<double>(((*shard).*counter).value()));
+    }
+  }
+  appendPrometheusHeader(out, "gateway_hedge_delay_seconds", "gauge",
+                         "Age at which a call to each shard is hedged "
+                         "(0 = not hedging)");
+  for (const auto& shard : shards_) {
+    appendPrometheusSample(
+        out, "gateway_hedge_delay_seconds",
+        "shard=\"" + std::to_string(shard->shard_id) + "\"",
+        static_cast<double>(shard->hedge_delay_ns.load()) / 1e9);
   }
 
-  // Bonus points for position of matches in address fields
-  // Street matches are most important, then city, then postcode
-  for (const auto& term : query_terms) {
-    if (record.street().find(term) != std::string::npos) {
-      // Street match at beginning is worth more
-      if (record.street().find(term) == 0) {
-        score += 15.0;
-      } else {
-        score += 10.0;
-      }
+  // Endpoints are only registered by setupRoutes()
+  const auto& endpoints = app_.get_middleware<RequestMetrics>().endpoints;
+  appendPrometheusHeader(out, "gateway_request_latency_seconds", "summary",
+                         "Latency of the requests to each API endpoint");
+  for (const auto& [url, endpoint] : endpoints) {
+    appendPrometheusSummary(out, "gateway_request_latency_seconds",
+                            "endpoint=\"" + url + "\"",
+                            endpoint->latency.snapshot());
+  }
+  appendPrometheusHeader(out, "gateway_requests_total", "counter",
+                         "Requests to each API endpoint");
+  for (const auto& [url, endpoint] : endpoints) {
+    appendPrometheusSample(out, "gateway_requests_total",
+                           "endpoint=\"" + url + "\"",
+                           static_cast<double>(endpoint->requests.value()));
+  }
+  appendPrometheusHeader(out, "gateway_request_errors_total", "counter",
+                         "Requests to each API endpoint answered with a "
+                         "4xx or 5xx status");
+  for (const auto& [url, endpoint] : endpoints) {
+    appendPrometheusSample(out, "gateway_request_errors_total",
+                           "endpoint=\"" + url + "\"",
+                           static_cast<double>(endpoint->errors.value()));
+  }
+
+  ConcurrencyLimiter::Stats admission = admission_.getStats();
+  const std::tuple<const char*, const char*, double> admission_gauges[] = {
+      {"gateway_admission_limit",
+       "Requests admitted to call the data nodes at once",
+       static_cast<double>(admission.limit)},
+      {"gateway_admission_in_flight", "Admitted requests in flight",
+       static_cast<double>(admission.in_flight)},
+      {"gateway_admission_queue_depth",
+       "Requests waiting for admission",
+       static_cast<double>(admission.queued)}};
+  for (const auto& [name, help, value] : admission_gauges) {
+    appendPrometheusHeader(out, name, "gauge", help);
+    appendPrometheusSample(out, name, "", value);
+  }
+  const std::tuple<const char*, const char*, uint64_t> admission_counters[] = {
+      {"gateway_admitted_requests_total",
+       "Requests admitted to call the data nodes", admission.admitted},
+      {"gateway_shed_requests_total",
+       "Requests answered 503 because the admission queue was full or "
+       "waited too long",
+       admission.shed},
+      {"gateway_overloaded_requests_total",
+       "Admitted requests with a data node call that timed out or was shed",
+       admission.dropped}};
+  for (const auto& [name, help, value] : admission_counters) {
+    appendPrometheusHeader(out, name, "counter", help);
+    appendPrometheusSample(out, name, "", static_cast<double>(value));
+  }
+
+  QueryCache::Stats cache = query_cache_.getStats();
+  const std::pair<const char*, uint64_t> cache_counters[] = {
+      {"hits", cache.hits},
+      {"misses", cache.misses},
+      {"insertions", cache.insertions},
+      {"evictions", cache.evictions},
+      {"expirations", cache.expirations}};
+  for (const auto& [name, value] : cache_counters) {
+    std::string metric = std::string("gateway_query_cache_") + name + "_total";
+    appendPrometheusHeader(out, metric, "counter",
+                           std::string("Query cache ") + name);
+    appendPrometheusSample(out, metric, "", static_cast<double>(value));
+  }
+  appendPrometheusHeader(out, "gateway_query_cache_entries", "gauge",
+                         "Responses in the query cache");
+  appendPrometheusSample(out, "gateway_query_cache_entries", "",
+                         static_cast<double>(cache.entries));
+  appendPrometheusHeader(out, "gateway_query_cache_bytes", "gauge",
+                         "Memory used by the query cache");
+  appendPrometheusSample(out, "gateway_query_cache_bytes", "",
+                         static_cast<double>(cache.bytes));
+
+  return out;
+}
+
+std::string GatewayServer::addQueryToPayload(const std::string& query,
+                                             const std::string& payload) {
+  std::string result = "{\"query\":\"";
+  result.reserve(payload.size() + query.size() + 16);
+  for (char c : query) {
+    unsigned char byte = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if (byte < 0x20) {
+      static const char kHex[] = "0123456789abcdef";
+      result += "\\u00";
+      result += kHex[byte >> 4];
+      result += kHex[byte & 0xF];
+    } else {
+      result += c;
     }
+  }
+  result += '"';
 
-    if (record.city().find(term) != std::string::npos) {
-      // City match at beginning is worth more
-      if (record.city().find(term) == 0) {
-        score += 8.0;
-      } else {
-        score += 5.0;
-      }
+  // Splice the query in as the first member of the payload object
+  if (payload.size() > 2) {
+    result += ',';
+  }
+  result.append(payload, 1, std::string::npos);
+  return result;
+}
+
+std::vector<std::string> GatewayServer::splitQueryTerms(
+    const std::string& address) {
+  std::vector<std::string> query_terms;
+
+  // Check if this is a structured address query (contains comma)
+  if (address.find(',') != std::string::npos) {
+    // Structured address query - pass as single term to preserve structure
+    // The DataNode will parse it into components
+    LogLine(LogLevel::kDebug, nullptr) << "Detected structured address query";
+    query_terms.push_back(address);
+  } else {
+    // Traditional multi-term query - split by whitespace
+    LogLine(LogLevel::kDebug, nullptr)
+        << "Detected traditional multi-term query";
+    std::istringstream iss(address);
+    std::string term;
+    while (iss >> term) {
+      query_terms.push_back(term);
     }
+  }
+  return query_terms;
+}
 
-    if (record.postcode().find(term) != std::string::npos) {
-      score += 3.0;
+std::vector<NearbyAddressRecord> GatewayServer::mergeByDistance(
+    const std::vector<DataNodeResult>& results,
+    size_t max_results) {
+  std::vector<NearbyAddressRecord> merged;
+  for (const auto& result : results) {
+    if (!result.success || result.distances.size() != result.records.size()) {
+      continue;
+    }
+    for (size_t i = 0; i < result.records.size(); ++i) {
+      merged.push_back(NearbyAddressRecord{result.records[i], result.shard_id,
+                                           result.distances[i]});
     }
+  }
 
-    if (record.number().find(term) != std::string::npos) {
-      score += 5.0;
+  // Closest first; the stable sort keeps data node order between ties
+  std::stable_sort(merged.begin(), merged.end(),
+                   [](const NearbyAddressRecord& a,
+                      const NearbyAddressRecord& b) {
+                     return a.distance_meters < b.distance_meters;
+                   });
+
+  // Keep the closest copy of each address
+  std::vector<NearbyAddressRecord> nearest;
+  for (auto& nearby : merged) {
+    if (nearest.size() == max_results) {
+      break;
+    }
+    bool duplicate = std::any_of(
+        nearest.begin(), nearest.end(),
+        [&nearby](const NearbyAddressRecord& kept) {
+          return isDuplicate(kept.record, nearby.record);
+        });
+    if (!duplicate) {
+      nearest.push_back(std::move(nearby));
     }
   }
+  return nearest;
+}
 
-  // Bonus points for completeness of address data
-  // More complete addresses are more useful
-  int completeness = 0;
-  if (!record.number().empty()) completeness++;
-  if (!record.street().empty()) completeness++;
-  if (!record.unit().empty()) completeness++;
-  if (!record.city().empty()) completeness++;
-  if (!record.postcode().empty()) completeness++;
+bool GatewayServer::isShutdownRequested() const {
+  return shutdown_requested_.load();
+}
 
-  // Add up to 10 points for completeness (2 points per field)
-  score += completeness * 2.0;
+bool GatewayServer::isDuplicate(const datanode::AddressRecord& a,
+                                 const datanode::AddressRecord& b) {
+  // Two addresses are considered duplicates if they have the same:
+  // - Street number
+  // - Street name
+  // - City
+  // - Postcode
+  // We ignore unit numbers as they might differ in formatting
 
-  return score;
+  return a.number() == b.number() &&
+         a.street() == b.street() &&
+         a.city() == b.city() &&
+         a.postcode() == b.postcode();
 }
 
 std::vector<ScoredAddressRecord> GatewayServer::aggregateAndRankResults(
@@ -560,69 +2399,121 @@ std::vector<ScoredAddressRecord> GatewayServer::aggregateAndRankResults(
     const std::vector<std::string>& query_terms,
     size_t max_results) {
 
-  std::cout << "[INFO] Aggregating and ranking results..." << std::endl;
-
-  // Collect all records with their scores
-  std::vector<ScoredAddressRecord> scored_records;
+  LogLine(LogLevel::kDebug, nullptr) << "Aggregating and ranking results...";
+
+  // Records are merged on the scores their data nodes ranked them by, which
+  // include the penalty of any typos a fuzzy match needed. Records sent
+  // without scores (exact key lookups, older data nodes) are scored here
+  // with the same scorer, which matches a data node's score for an exact
+  // match
+  RelevanceScorer scorer(query_terms);
+
+  // A scored record, pointing into results until it is returned
+  struct Candidate {
+    const datanode::AddressRecord* record;
+    int shard_id;
+    double score;
+    size_t order;  // First seen position, to break ties
+  };
+  size_t total_records = 0;
+  for (const auto& result : results) {
+    total_records += result.success ? result.records.size() : 0;
+  }
+  std::vector<Candidate> candidates;
+  candidates.reserve(total_records);
+
+  // Records are keyed by their record hash when they have one, so copies
+  // from overlapping shards are settled without hashing or comparing
+  // strings. Records without a hash are keyed by the fields isDuplicate()
+  // compares.
+  auto key_hash = [](const datanode::AddressRecord* record) {
+    return record->hash() != 0 ? std::hash<uint64_t>()(record->hash())
+                               : addressKeyHash(*record);
+  };
+  auto key_equal = [](const datanode::AddressRecord* a,
+                      const datanode::AddressRecord* b) {
+    if (a->hash() != 0 || b->hash() != 0) {
+      return a->hash() == b->hash();
+    }
+    return isDuplicate(*a, *b);
+  };
+  std::unordered_map<const datanode::AddressRecord*, size_t,
+                     decltype(key_hash), decltype(key_equal)>
+      candidate_index(total_records, key_hash, key_equal);
 
   for (const auto& result : results) {
     if (!result.success) {
       continue;
     }
 
-    for (const auto& record : result.records) {
-      // Calculate relevance score
-      double score = calculateRelevanceScore(record, query_terms);
-
-      // Check if this is a duplicate of an existing record
-      bool is_duplicate = false;
-      for (auto& existing : scored_records) {
-        if (isDuplicate(existing.record, record)) {
-          is_duplicate = true;
-          // Keep the one with higher score
-          if (score > existing.relevance_score) {
-            std::cout << "[INFO] Found duplicate address, keeping higher scored version (new score: "
-                      << score << " vs old score: " << existing.relevance_score << ")" << std::endl;
-            existing.record = record;
-            existing.shard_id = result.shard_id;
-            existing.relevance_score = score;
-          } else {
-            std::cout << "[INFO] Found duplicate address, keeping existing higher scored version" << std::endl;
-          }
-          break;
-        }
+    bool scored = result.scores.size() == result.records.size();
+    for (size_t i = 0; i < result.records.size(); ++i) {
+      const datanode::AddressRecord& record = result.records[i];
+      double score =
+          scored ? result.scores[i] : scorer.score(toRecordView(record));
+
+      auto inserted = candidate_index.emplace(&record, candidates.size());
+      if (inserted.second) {
+        candidates.push_back(
+            Candidate{&record, result.shard_id, score, candidates.size()});
+        continue;
       }
 
-      if (!is_duplicate) {
-        ScoredAddressRecord scored;
-        scored.record = record;
-        scored.shard_id = result.shard_id;
-        scored.relevance_score = score;
-        scored_records.push_back(scored);
+      // Duplicate of an earlier record: keep the one with higher score
+      Candidate& existing = candidates[inserted.first->second];
+      if (score > existing.score) {
+        LogLine(LogLevel::kDebug, nullptr)
+            << "Found duplicate address, keeping higher scored version "
+            << "(new score: " << score << " vs old score: " << existing.score
+            << ")";
+        existing.record = &record;
+        existing.shard_id = result.shard_id;
+        existing.score = score;
+      } else {
+        LogLine(LogLevel::kDebug, nullptr)
+            << "Found duplicate address, keeping existing higher scored "
+            << "version";
       }
     }
   }
 
-  std::cout << "[INFO] Total unique records after deduplication: "
-            << scored_records.size() << std::endl;
-
-  // Sort by relevance score (descending)
-  std::sort(scored_records.begin(), scored_records.end());
+  LogLine(LogLevel::kInfo, nullptr, isQueryLogged())
+      << "Total unique records after deduplication: " << candidates.size();
 
-  // Return top N results
-  if (scored_records.size() > max_results) {
-    std::cout << "[INFO] Limiting results to top " << max_results << std::endl;
-    scored_records.resize(max_results);
+  // Only the top max_results are ordered, by relevance score (descending)
+  // and then in the order they were first seen
+  size_t top_count = std::min(max_results, candidates.size());
+  if (top_count < candidates.size()) {
+    LogLine(LogLevel::kDebug, nullptr)
+        << "Limiting results to top " << max_results;
+  }
+  std::partial_sort(candidates.begin(), candidates.begin() + top_count,
+                    candidates.end(),
+                    [](const Candidate& a, const Candidate& b) {
+                      return a.score != b.score ? a.score > b.score
+                                                : a.order < b.order;
+                    });
+
+  // Copy out only the records returned
+  std::vector<ScoredAddressRecord> scored_records(top_count);
+  for (size_t i = 0; i < top_count; ++i) {
+    scored_records[i].record = *candidates[i].record;
+    scored_records[i].shard_id = candidates[i].shard_id;
+    scored_records[i].relevance_score = candidates[i].score;
   }
 
   // Log the top results with their scores
-  std::cout << "[INFO] Top " << scored_records.size() << " results:" << std::endl;
-  for (size_t i = 0; i < scored_records.size(); ++i) {
-    const auto& scored = scored_records[i];
-    std::cout << "  " << (i + 1) << ". Score: " << scored.relevance_score
-              << " - " << scored.record.number() << " " << scored.record.street()
-              << ", " << scored.record.city() << " " << scored.record.postcode()
-              << " (shard " << scored.shard_id << ")" << std::endl;
+  if (isLogEnabled(LogLevel::kDebug)) {
+    LogLine line(LogLevel::kDebug, nullptr);
+    line << "Top " << scored_records.size() << " results:";
+    for (size_t i = 0; i < scored_records.size(); ++i) {
+      const auto& scored = scored_records[i];
+      line << "\n  " << (i + 1) << ". Score: " << scored.relevance_score
+           << " - " << scored.record.number() << " "
+           << scored.record.street() << ", " << scored.record.city() << " "
+           << scored.record.postcode() << " (shard " << scored.shard_id
+           << ")";
+    }
   }
 
   return scored_records;
@@ -0,0 +1,253 @@
+#include "gateway/json_writer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Escape sequence of a byte in a JSON string, empty for bytes written as
+// they are; the escapes crow::json uses
+struct Escape {
+  char length;
+  char chars[7];
+};
+
+struct EscapeTable {
+  Escape escapes[256];
+
+  EscapeTable() : escapes() {
+    constexpr char kHex[] = "0123456789abcdef";
+    for (int c = 0; c < 0x20; ++c) {
+      escapes[c] = {6, {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xF]}};
+    }
+    escapes['"'] = {2, {'\\', '"'}};
+    escapes['\\'] = {2, {'\\', '\\'}};
+    escapes['\n'] = {2, {'\\', 'n'}};
+    escapes['\b'] = {2, {'\\', 'b'}};
+    escapes['\f'] = {2, {'\\', 'f'}};
+    escapes['\r'] = {2, {'\\', 'r'}};
+    escapes['\t'] = {2, {'\\', 't'}};
+  }
+};
+
+const EscapeTable kEscapeTable;
+
+bool isJsonSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+void skipSpace(std::string_view text, size_t& pos) {
+  while (pos < text.size() && isJsonSpace(text[pos])) {
+    pos++;
+  }
+}
+
+// Read a string without escape sequences or control characters, leaving
+// pos after its closing quote
+bool readPlainString(std::string_view text,
+                     size_t& pos,
+                     std::string_view& value) {
+  if (pos >= text.size() || text[pos] != '"') {
+    return false;
+  }
+  size_t start = ++pos;
+  while (pos < text.size() && text[pos] != '"') {
+    if (text[pos] == '\\' || static_cast<unsigned char>(text[pos]) < 0x20) {
+      return false;
+    }
+    pos++;
+  }
+  if (pos >= text.size()) {
+    return false;
+  }
+  value = text.substr(start, pos - start);
+  pos++;
+  return true;
+}
+
+// Read a number in the JSON grammar:
+// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+bool readNumberToken(std::string_view text,
+                     size_t& pos,
+                     std::string_view& value) {
+  size_t start = pos;
+  if (pos < text.size() && text[pos] == '-') {
+    pos++;
+  }
+  if (pos >= text.size() || !isDigit(text[pos])) {
+    return false;
+  }
+  if (text[pos++] != '0') {
+    while (pos < text.size() && isDigit(text[pos])) {
+      pos++;
+    }
+  }
+  if (pos < text.size() && text[pos] == '.') {
+    if (++pos >= text.size() || !isDigit(text[pos])) {
+      return false;
+    }
+    while (pos < text.size() && isDigit(text[pos])) {
+      pos++;
+    }
+  }
+  if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+    pos++;
+    if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+      pos++;
+    }
+    if (pos >= text.size() || !isDigit(text[pos])) {
+      return false;
+    }
+    while (pos < text.size() && isDigit(text[pos])) {
+      pos++;
+    }
+  }
+  value = text.substr(start, pos - start);
+  return true;
+}
+
+bool readLiteral(std::string_view text,
+                 size_t& pos,
+                 std::string_view& value) {
+  for (std::string_view literal : {"true", "false", "null"}) {
+    if (text.substr(pos, literal.size()) == literal) {
+      value = text.substr(pos, literal.size());
+      pos += literal.size();
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+void appendJsonString(std::string& out, std::string_view value) {
+  out += '"';
+  size_t run_start = 0;
+  for (size_t i = 0; i < value.size(); ++i) {
+    const Escape& escape =
+        kEscapeTable.escapes[static_cast<unsigned char>(value[i])];
+    if (escape.length != 0) {
+      out.append(value.data() + run_start, i - run_start);
+      out.append(escape.chars, escape.length);
+      run_start = i + 1;
+    }
+  }
+  out.append(value.data() + run_start, value.size() - run_start);
+  out += '"';
+}
+
+void appendJsonNumber(std::string& out, double value) {
+  if (!std::isfinite(value)) {
+    out += "null";
+    return;
+  }
+  // Large enough for any finite double in %f
+  char buffer[400];
+  int length = std::snprintf(buffer, sizeof(buffer), "%f", value);
+  const char* point = static_cast<const char*>(
+      std::memchr(buffer, '.', static_cast<size_t>(length)));
+  if (point != nullptr) {
+    const char* last_kept = point + 1;
+    while (length > last_kept - buffer + 1 && buffer[length - 1] == '0') {
+      length--;
+    }
+  }
+  out.append(buffer, static_cast<size_t>(length));
+}
+
+void appendJsonNumber(std::string& out, int64_t value) {
+  out += std::to_string(value);
+}
+
+void appendJsonNumber(std::string& out, uint64_t value) {
+  out += std::to_string(value);
+}
+
+bool FlatJsonObject::parse(std::string_view text) {
+  size_ = 0;
+  size_t pos = 0;
+  skipSpace(text, pos);
+  if (pos >= text.size() || text[pos++] != '{') {
+    return false;
+  }
+  skipSpace(text, pos);
+  if (pos < text.size() && text[pos] == '}') {
+    pos++;
+  } else {
+    while (true) {
+      if (size_ == kMaxMembers) {
+        return false;
+      }
+      Member& member = members_[size_];
+      if (!readPlainString(text, pos, member.key)) {
+        return false;
+      }
+      skipSpace(text, pos);
+      if (pos >= text.size() || text[pos++] != ':') {
+        return false;
+      }
+      skipSpace(text, pos);
+      if (pos >= text.size()) {
+        return false;
+      }
+      bool read;
+      if (text[pos] == '"') {
+        member.type = Type::kString;
+        read = readPlainString(text, pos, member.value);
+      } else if (text[pos] == '-' || isDigit(text[pos])) {
+        member.type = Type::kNumber;
+        read = readNumberToken(text, pos, member.value);
+      } else {
+        member.type = Type::kLiteral;
+        read = readLiteral(text, pos, member.value);
+      }
+      if (!read || find(member.key) != nullptr) {
+        return false;
+      }
+      size_++;
+
+      skipSpace(text, pos);
+      if (pos >= text.size()) {
+        return false;
+      }
+      char next = text[pos++];
+      if (next == '}') {
+        break;
+      }
+      if (next != ',') {
+        return false;
+      }
+      skipSpace(text, pos);
+    }
+  }
+  skipSpace(text, pos);
+  return pos == text.size();
+}
+
+const FlatJsonObject::Member* FlatJsonObject::find(
+    std::string_view key) const {
+  for (size_t i = 0; i < size_; ++i) {
+    if (members_[i].key == key) {
+      return &members_[i];
+    }
+  }
+  return nullptr;
+}
+
+double FlatJsonObject::toNumber(const Member& member) {
+  // Number tokens longer than any double needs are rare enough to copy
+  char buffer[64];
+  if (member.value.size() < sizeof(buffer)) {
+    std::memcpy(buffer, member.value.data(), member.value.size());
+    buffer[member.value.size()] = '\0';
+    return std::strtod(buffer, nullptr);
+  }
+  return std::strtod(std::string(member.value).c_str(), nullptr);
+}
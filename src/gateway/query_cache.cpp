@@ -0,0 +1,120 @@
+#include "gateway/query_cache.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+QueryCache::QueryCache(const QueryCacheConfig& config)
+    : config_(config) {
+  config_.shard_count = std::max<size_t>(1, config_.shard_count);
+  shard_capacity_ = config_.max_bytes / config_.shard_count;
+  shards_.reserve(config_.shard_count);
+  for (size_t i = 0; i < config_.shard_count; ++i) {
+    shards_.push_back(std::make_unique<Shard>());
+  }
+}
+
+bool QueryCache::isEnabled() const {
+  return shard_capacity_ > 0 && config_.ttl.count() > 0;
+}
+
+std::shared_ptr<const std::string> QueryCache::get(const std::string& key,
+                                                   Clock::time_point now) {
+  if (!isEnabled()) {
+    return nullptr;
+  }
+
+  Shard& shard = shardFor(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.index.find(key);
+  if (it == shard.index.end()) {
+    misses_++;
+    return nullptr;
+  }
+
+  auto entry = it->second;
+  if (entry->expires_at <= now) {
+    erase(shard, entry);
+    expirations_++;
+    misses_++;
+    return nullptr;
+  }
+
+  // Move to the front of the LRU list
+  shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+  hits_++;
+  return entry->payload;
+}
+
+void QueryCache::put(const std::string& key,
+                     std::string payload,
+                     Clock::time_point now) {
+  size_t charge = key.size() + payload.size() + kEntryOverhead;
+  if (!isEnabled() || charge > shard_capacity_) {
+    return;
+  }
+
+  auto shared_payload = std::make_shared<const std::string>(std::move(payload));
+
+  Shard& shard = shardFor(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto existing = shard.index.find(key);
+  if (existing != shard.index.end()) {
+    erase(shard, existing->second);
+  }
+
+  // Evict from the least recently used end until the entry fits
+  while (shard.bytes + charge > shard_capacity_) {
+    erase(shard, std::prev(shard.lru.end()));
+    evictions_++;
+  }
+
+  shard.lru.push_front(
+      Entry{key, std::move(shared_payload), now + config_.ttl, charge});
+  shard.index.emplace(shard.lru.front().key, shard.lru.begin());
+  shard.bytes += charge;
+  insertions_++;
+}
+
+QueryCache::Stats QueryCache::getStats() const {
+  Stats stats;
+  stats.hits = hits_.load();
+  stats.misses = misses_.load();
+  stats.insertions = insertions_.load();
+  stats.evictions = evictions_.load();
+  stats.expirations = expirations_.load();
+  stats.entries = 0;
+  stats.bytes = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    stats.entries += shard->index.size();
+    stats.bytes += shard->bytes;
+  }
+  return stats;
+}
+
+std::string QueryCache::makeKey(const std::vector<std::string>& query_terms,
+                                int fuzziness) {
+  // Length-prefix each term so no term content can mimic a boundary
+  std::string key;
+  for (const std::string& term : query_terms) {
+    key += std::to_string(term.size());
+    key += ':';
+    key += term;
+  }
+  if (fuzziness > 0) {
+    key += '~';
+    key += std::to_string(fuzziness);
+  }
+  return key;
+}
+
+QueryCache::Shard& QueryCache::shardFor(const std::string& key) {
+  return *shards_[std::hash<std::string>()(key) % shards_.size()];
+}
+
+void QueryCache::erase(Shard& shard, std::list<Entry>::iterator entry) {
+  shard.bytes -= entry->charge;
+  shard.index.erase(entry->key);
+  shard.lru.erase(entry);
+}
@@ -5,6 +5,10 @@
 
 #include <gtest/gtest.h>
 
+#include <cctype>
+#include <string>
+#include <utility>
+
 // Test case conversion with mixed-case inputs (Requirement 2.1)
 TEST(AddressNormalizerTest, CaseConversion) {
   AddressNormalizer normalizer;
@@ -152,3 +156,65 @@ TEST(AddressNormalizerTest, NumericPreservation) {
   EXPECT_EQ("98388", normalizer.normalize("98388"));
   EXPECT_EQ("12345-6789", normalizer.normalize("12345-6789"));
 }
+
+// Test every suffix abbreviation and words that are not abbreviations
+TEST(AddressNormalizerTest, ExpandSuffix) {
+  const std::pair<const char*, const char*> suffixes[] = {
+      {"ST", "STREET"},     {"AVE", "AVENUE"},    {"RD", "ROAD"},
+      {"BLVD", "BOULEVARD"}, {"DR", "DRIVE"},      {"LN", "LANE"},
+      {"CT", "COURT"},      {"PL", "PLACE"},      {"CIR", "CIRCLE"},
+      {"WAY", "WAY"},       {"PKWY", "PARKWAY"},  {"TER", "TERRACE"},
+      {"SQ", "SQUARE"},     {"HWY", "HIGHWAY"},   {"EXPY", "EXPRESSWAY"},
+  };
+  for (const auto& [abbreviation, expansion] : suffixes) {
+    EXPECT_EQ(AddressNormalizer::expandSuffix(abbreviation), expansion);
+  }
+
+  // Lookups are exact and expect normalized (uppercase) words
+  for (const char* word : {"", "S", "STT", "SST", "st", "STREET", "AV", "TR",
+                           "EXPYY", "HW"}) {
+    EXPECT_TRUE(AddressNormalizer::expandSuffix(word).empty()) << word;
+  }
+}
+
+// Test that the single-pass normalizer matches uppercase, trim and collapse
+// applied separately, for every byte value
+TEST(AddressNormalizerTest, MatchesStepwiseNormalization) {
+  AddressNormalizer normalizer;
+  for (int byte = 0; byte < 256; ++byte) {
+    char c = static_cast<char>(byte);
+    std::string text = std::string(" a") + c + c + "b " + c;
+
+    std::string expected;
+    bool pending_space = false;
+    for (char t : text) {
+      if (std::isspace(static_cast<unsigned char>(t))) {
+        pending_space = true;
+        continue;
+      }
+      if (pending_space && !expected.empty()) {
+        expected += ' ';
+      }
+      pending_space = false;
+      expected += static_cast<char>(std::toupper(static_cast<unsigned char>(t)));
+    }
+
+    EXPECT_EQ(normalizer.normalize(text), expected) << "byte " << byte;
+  }
+}
+
+// Test normalizing into a reused buffer
+TEST(AddressNormalizerTest, NormalizeIntoReplacesContents) {
+  AddressNormalizer normalizer;
+  std::string buffer = "LEFTOVER CONTENTS THAT ARE LONG";
+
+  normalizer.normalizeInto("  Main   St ", buffer);
+  EXPECT_EQ(buffer, "MAIN ST");
+
+  normalizer.normalizeInto("\t", buffer);
+  EXPECT_EQ(buffer, "");
+
+  char chars[12];
+  size_t length = normalizer.normalizeTo(" Main   St\t", chars);
+  EXPECT_EQ(std::string(chars, length), "MAIN ST");
+}
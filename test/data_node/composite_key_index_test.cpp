@@ -0,0 +1,160 @@
+// Composite Key Index Unit Tests
+
+#include "data_node/composite_key_index.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "data_node/address_keys.h"
+#include "data_node/address_normalizer.h"
+
+static std::vector<DocId> toVector(ArrayView<DocId> ids) {
+  return std::vector<DocId>(ids.begin(), ids.end());
+}
+
+static std::string keyOf(size_t i) {
+  return std::to_string(i) + kKeySeparator + "MAIN ST";
+}
+
+static CompositeKeyIndex::KeyPosting posting(size_t key, DocId id) {
+  return CompositeKeyIndex::KeyPosting{CompositeKeyIndex::hashKey(keyOf(key)),
+                                       id};
+}
+
+// Many keys, each held by the records i and i + 1000
+static std::vector<CompositeKeyIndex::KeyPosting> makePostings() {
+  std::vector<CompositeKeyIndex::KeyPosting> postings;
+  for (DocId i = 0; i < 1000; ++i) {
+    postings.push_back(posting(i, i + 1000));
+    postings.push_back(posting(i, i));
+    postings.push_back(posting(i, i));  // Repeated postings are kept once
+  }
+  return postings;
+}
+
+// Test exact lookups of built keys
+TEST(CompositeKeyIndexTest, LooksUpExactKeys) {
+  CompositeKeyIndex index;
+  EXPECT_TRUE(index.lookup(keyOf(1)).empty());
+
+  index.build(makePostings());
+  EXPECT_EQ(index.size(), 1000u);
+  for (DocId i = 0; i < 1000; ++i) {
+    EXPECT_EQ(toVector(index.lookup(keyOf(i))),
+              (std::vector<DocId>{i, i + 1000}));
+  }
+
+  // Only exact keys match, never prefixes or extensions
+  EXPECT_TRUE(index.lookup("1").empty());
+  EXPECT_TRUE(index.lookup(keyOf(1) + "E").empty());
+  EXPECT_TRUE(index.lookup(keyOf(1000)).empty());
+
+  index.build({});
+  EXPECT_EQ(index.size(), 0u);
+  EXPECT_TRUE(index.lookup(keyOf(1)).empty());
+}
+
+// Test that structured queries produce the keys indexed for a record
+TEST(CompositeKeyIndexTest, StructuredQueryKeysMatchIndexKeys) {
+  AddressNormalizer normalizer;
+  std::vector<std::string> index_keys;
+  appendIndexKeys(normalizer.normalize("123"),
+                  normalizer.normalize("Main Street"),
+                  normalizer.normalize("Seattle"),
+                  normalizer.normalize("98101"), index_keys);
+  ASSERT_EQ(index_keys.size(), 3u);
+
+  ASSERT_TRUE(isStructuredQuery({"123 Main Street, Seattle, 98101"}));
+  EXPECT_FALSE(isStructuredQuery({"123", "Main"}));
+  StructuredQueryKeys query =
+      structuredQueryKeys(" 123  Main Street ,Seattle, 98101", normalizer);
+  ASSERT_EQ(query.keys.size(), 3u);
+  EXPECT_TRUE(query.has_postcode_key);
+  EXPECT_EQ(query.postcode, "98101");
+  EXPECT_EQ(query.keys[0], index_keys[2]);  // With postcode
+  EXPECT_EQ(query.keys[1], index_keys[0]);  // With city
+  EXPECT_EQ(query.keys[2], index_keys[1]);  // Number and street
+
+  // Without a postcode, no key is routable by postcode
+  query = structuredQueryKeys("123 Main Street, Seattle", normalizer);
+  EXPECT_FALSE(query.has_postcode_key);
+  EXPECT_TRUE(query.postcode.empty());
+  ASSERT_EQ(query.keys.size(), 2u);
+  EXPECT_EQ(query.keys[0], index_keys[0]);
+  EXPECT_EQ(query.keys[1], index_keys[1]);
+
+  query = structuredQueryKeys("Seattle, 98101", normalizer);
+  EXPECT_TRUE(query.keys.empty());
+}
+
+// Test that a plan builds every key of a structured query as a prefix of
+// its most specific one
+TEST(CompositeKeyIndexTest, StructuredQueryPlanSharesPrefixes) {
+  AddressNormalizer normalizer;
+  const std::string number_street =
+      std::string("123") + kKeySeparator + "MAIN ST";
+  const std::string with_city = number_street + kKeySeparator + "SEATTLE";
+  const std::string with_postcode = with_city + kKeySeparator + "98101";
+
+  // Empty parts are skipped and parts after the postcode ignored
+  StructuredQueryPlan plan(" 123  main st ,,Seattle, 98101,USA", normalizer);
+  EXPECT_EQ(plan.key(), with_postcode);
+  ASSERT_EQ(plan.keyLengths().size(), 3u);
+  EXPECT_EQ(plan.keyLengths()[0], number_street.size());
+  EXPECT_EQ(plan.keyLengths()[1], with_city.size());
+  EXPECT_TRUE(plan.hasPostcodeKey());
+  EXPECT_EQ(plan.postcode(), "98101");
+
+  // The postcode is kept for routing even without a city to key it with
+  StructuredQueryPlan no_city("123 Main St, , 98101", normalizer);
+  EXPECT_EQ(no_city.key(), number_street);
+  EXPECT_FALSE(no_city.hasPostcodeKey());
+  EXPECT_EQ(no_city.postcode(), "98101");
+
+  StructuredQueryPlan no_street("123, Seattle, 98101", normalizer);
+  EXPECT_TRUE(no_street.key().empty());
+  EXPECT_TRUE(no_street.keyLengths().empty());
+
+  // Keys of long queries do not fit the inline buffer
+  std::string street(StructuredQueryPlan::kInlineQueryLength, 'X');
+  StructuredQueryPlan long_plan("123 " + street + ", Seattle", normalizer);
+  EXPECT_EQ(long_plan.key(), std::string("123") + kKeySeparator + street +
+                                 kKeySeparator + "SEATTLE");
+  EXPECT_EQ(long_plan.keyLengths().size(), 2u);
+}
+
+// Test serving the index from a snapshot
+TEST(CompositeKeyIndexTest, SnapshotRoundTrip) {
+  const SourceFingerprint source = {42, 0x5EED};
+  std::string path = testing::TempDir() + "composite_key_index_test.snapshot";
+  CompositeKeyIndex built;
+  built.build(makePostings());
+
+  SnapshotWriter writer;
+  built.addToSnapshot(writer);
+  ASSERT_TRUE(writer.write(path, source));
+  auto snapshot = IndexSnapshot::open(path, source);
+  ASSERT_NE(snapshot, nullptr);
+
+  CompositeKeyIndex loaded;
+  ASSERT_TRUE(loaded.loadFromSnapshot(snapshot));
+  EXPECT_EQ(loaded.size(), built.size());
+  EXPECT_EQ(loaded.getMemoryUsage(), built.getMemoryUsage());
+  for (size_t i : {0u, 1u, 500u, 999u}) {
+    EXPECT_EQ(toVector(loaded.lookup(keyOf(i))),
+              toVector(built.lookup(keyOf(i))));
+  }
+  EXPECT_TRUE(loaded.lookup(keyOf(1000)).empty());
+
+  // A snapshot without the key index sections is rejected
+  SnapshotWriter empty_writer;
+  ASSERT_TRUE(empty_writer.write(path, source));
+  auto empty_snapshot = IndexSnapshot::open(path, source);
+  ASSERT_NE(empty_snapshot, nullptr);
+  EXPECT_FALSE(loaded.loadFromSnapshot(empty_snapshot));
+
+  std::remove(path.c_str());
+}
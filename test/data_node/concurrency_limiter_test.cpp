@@ -0,0 +1,119 @@
+// Concurrency Limiter Unit Tests
+
+#include "data_node/concurrency_limiter.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
+
+static ConcurrencyLimiterConfig fixedConfig(size_t limit) {
+  ConcurrencyLimiterConfig config;
+  config.max_concurrency = limit;
+  config.max_queued = 1;
+  config.max_queue_wait = std::chrono::milliseconds(20);
+  return config;
+}
+
+// Test that a fixed limit admits that many requests and sheds the rest
+TEST(ConcurrencyLimiterTest, FixedLimitShedsExcess) {
+  ConcurrencyLimiter limiter(fixedConfig(2));
+  EXPECT_FALSE(limiter.isAdaptive());
+
+  ConcurrencyLimiter::Permit first = limiter.tryAcquire();
+  ConcurrencyLimiter::Permit second = limiter.acquire();
+  ASSERT_TRUE(first);
+  ASSERT_TRUE(second);
+  EXPECT_FALSE(limiter.tryAcquire());
+
+  // A queued request gives up after the queue wait
+  auto start = ConcurrencyLimiter::Clock::now();
+  EXPECT_FALSE(limiter.acquire());
+  EXPECT_GE(ConcurrencyLimiter::Clock::now() - start,
+            std::chrono::milliseconds(20));
+
+  ConcurrencyLimiter::Stats stats = limiter.getStats();
+  EXPECT_EQ(stats.limit, 2u);
+  EXPECT_EQ(stats.in_flight, 2u);
+  EXPECT_EQ(stats.queued, 0u);
+  EXPECT_EQ(stats.admitted, 2u);
+  EXPECT_EQ(stats.shed, 2u);
+
+  // Releasing a permit frees its slot
+  first = ConcurrencyLimiter::Permit();
+  EXPECT_EQ(limiter.getStats().in_flight, 1u);
+  ConcurrencyLimiter::Permit third = limiter.tryAcquire();
+  EXPECT_TRUE(third);
+}
+
+// Test that a waiting request is admitted once a slot frees up, and that
+// requests over max_queued are shed without waiting
+TEST(ConcurrencyLimiterTest, QueuedRequestGetsFreedSlot) {
+  ConcurrencyLimiterConfig config = fixedConfig(1);
+  config.max_queue_wait = std::chrono::seconds(10);
+  ConcurrencyLimiter limiter(config);
+  ConcurrencyLimiter::Permit held = limiter.acquire();
+  ASSERT_TRUE(held);
+
+  bool admitted = false;
+  std::thread waiter([&]() { admitted = static_cast<bool>(limiter.acquire()); });
+  while (limiter.getStats().queued == 0) {
+    std::this_thread::yield();
+  }
+  auto start = ConcurrencyLimiter::Clock::now();
+  EXPECT_FALSE(limiter.acquire());  // The queue is full
+  EXPECT_LT(ConcurrencyLimiter::Clock::now() - start, std::chrono::seconds(1));
+
+  // The caller's deadline also bounds the wait
+  EXPECT_FALSE(limiter.acquire(ConcurrencyLimiter::Clock::now()));
+
+  held = ConcurrencyLimiter::Permit();
+  waiter.join();
+  EXPECT_TRUE(admitted);
+  EXPECT_EQ(limiter.getStats().in_flight, 0u);
+}
+
+// Test that the adaptive limit grows while it is used and backs off when
+// requests are dropped
+TEST(ConcurrencyLimiterTest, AdaptiveLimitFollowsOutcomes) {
+  ConcurrencyLimiterConfig config;
+  config.initial_limit = 4;
+  config.min_limit = 2;
+  config.max_limit = 6;
+  ConcurrencyLimiter limiter(config);
+  ASSERT_TRUE(limiter.isAdaptive());
+  EXPECT_EQ(limiter.getStats().limit, 4u);
+
+  // Fast requests filling the limit raise it, up to max_limit
+  for (int round = 0; round < 50; ++round) {
+    std::vector<ConcurrencyLimiter::Permit> permits;
+    size_t limit = limiter.getStats().limit;
+    for (size_t i = 0; i < limit; ++i) {
+      permits.push_back(limiter.tryAcquire());
+      ASSERT_TRUE(permits.back());
+    }
+    // Hold them long enough that timing noise does not look like congestion
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(limiter.getStats().limit, 6u);
+
+  // A lone request does not use the limit, so it does not raise it
+  ConcurrencyLimiter idle(config);
+  for (int i = 0; i < 50; ++i) {
+    ConcurrencyLimiter::Permit permit = idle.tryAcquire();
+  }
+  EXPECT_EQ(idle.getStats().limit, 4u);
+
+  // Dropped requests back it off, down to min_limit
+  for (int i = 0; i < 50; ++i) {
+    ConcurrencyLimiter::Permit permit = limiter.tryAcquire();
+    ASSERT_TRUE(permit);
+    permit.setDropped();
+  }
+  ConcurrencyLimiter::Stats stats = limiter.getStats();
+  EXPECT_EQ(stats.limit, 2u);
+  EXPECT_EQ(stats.dropped, 50u);
+  EXPECT_EQ(stats.in_flight, 0u);
+}
@@ -136,3 +136,85 @@ TEST(CSVParserTest, ResetCountersOnNewParse) {
   EXPECT_EQ(parser.getSuccessCount(), 2);
   EXPECT_EQ(parser.getErrorCount(), 5);
 }
+
+// Test that parsing on several threads gives the same records in file order
+TEST(CSVParserTest, MultiThreadedParseMatchesSingleThreaded) {
+  for (const char* path : {"test/fixtures/valid_addresses.csv",
+                           "test/fixtures/malformed_addresses.csv"}) {
+    CSVParser single_parser;
+    std::vector<AddressRecord> expected = single_parser.parse(path);
+
+    for (size_t threads : {2, 3, 16}) {
+      CSVParser parser;
+      std::vector<AddressRecord> records = parser.parse(path, threads);
+      EXPECT_EQ(records, expected) << path << " threads=" << threads;
+      EXPECT_EQ(parser.getSuccessCount(), single_parser.getSuccessCount());
+      EXPECT_EQ(parser.getErrorCount(), single_parser.getErrorCount());
+    }
+  }
+}
+
+// Test that scanning visits every record with the line it was parsed from,
+// each range's records in file order
+TEST(CSVParserTest, ScanVisitsRecordsWithTheirLines) {
+  const char* path = "test/fixtures/valid_addresses.csv";
+  CSVParser single_parser;
+  std::vector<AddressRecord> expected = single_parser.parse(path);
+
+  CSVParser parser;
+  std::vector<std::vector<std::pair<std::string, AddressRecord>>> chunks(3);
+  ASSERT_TRUE(parser.scan(
+      path, 3,
+      [&chunks](size_t chunk, std::string_view line, AddressRecord& record) {
+        ASSERT_LT(chunk, chunks.size());
+        chunks[chunk].emplace_back(std::string(line), record);
+      }));
+
+  std::vector<AddressRecord> records;
+  for (const auto& chunk : chunks) {
+    for (const auto& [line, record] : chunk) {
+      EXPECT_EQ(std::stoull(line.substr(line.rfind(',') + 1), nullptr, 16),
+                record.hash)
+          << line;
+      records.push_back(record);
+    }
+  }
+  EXPECT_EQ(records, expected);
+  EXPECT_EQ(chunks[0].front().first,
+            "-122.608996,47.166377,611,3RD ST,,Steilacoom,,,98388,,"
+            "46a6ea62641c0d1c");
+  EXPECT_EQ(parser.getSuccessCount(), 5u);
+
+  EXPECT_FALSE(parser.scan("test/fixtures/nonexistent_file.csv", 1,
+                           [](size_t, std::string_view, AddressRecord&) {}));
+}
+
+// Test quoted fields, number formats and malformed numbers
+TEST(CSVParserTest, ParseQuotedFieldsAndNumberFormats) {
+  CSVParser parser;
+  std::vector<AddressRecord> records =
+      parser.parse("test/fixtures/quoted_fields.csv");
+
+  // Rejected: out-of-range latitude, non-hex hash, unterminated quote
+  ASSERT_EQ(records.size(), 3);
+  EXPECT_EQ(parser.getSuccessCount(), 3);
+  EXPECT_EQ(parser.getErrorCount(), 3);
+
+  // Commas inside quotes belong to the field
+  EXPECT_EQ(records[0].street, "3RD ST, REAR");
+  EXPECT_EQ(records[0].city, "Steilacoom");
+  EXPECT_EQ(records[0].hash, 0x46a6ea62641c0d1c);
+
+  // Quotes are dropped, padded and signed numbers and a 0x hash prefix are
+  // accepted, and fields beyond the eleventh are ignored
+  EXPECT_DOUBLE_EQ(records[1].longitude, -121.6461331);
+  EXPECT_DOUBLE_EQ(records[1].latitude, 36.7082169);
+  EXPECT_EQ(records[1].street, "MCKINNON A STREET");
+  EXPECT_EQ(records[1].original_street, "MCKINNON A STREET");
+  EXPECT_EQ(records[1].unit, "C");
+  EXPECT_EQ(records[1].hash, 0xa8ac1dc8c998ce76);
+
+  // An empty hash defaults to zero
+  EXPECT_EQ(records[2].street, "LEYTE ROAD");
+  EXPECT_EQ(records[2].hash, 0u);
+}
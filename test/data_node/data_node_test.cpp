@@ -2,10 +2,20 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
 #include <fstream>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <thread>
 
+#include "data_node/address_keys.h"
 #include "data_node/data_node.h"
+#include "data_node/relevance_scorer.h"
+#include "data_node/thread_pool.h"
 
 // Helper to get the correct path to test data
 static std::string getTestDataPath(const std::string& filename) {
@@ -87,6 +97,33 @@ TEST(DataNodeTest, SearchWithMultipleTerms) {
   EXPECT_EQ(record.city, "Salinas");
 }
 
+// Test that multi-term results are the records matching every term, in the
+// same order whatever order the terms are given in
+TEST(DataNodeTest, MultiTermResultsAreOrderedIntersection) {
+  DataNode node(0, getTestDataPath("valid_addresses.csv"));
+  ASSERT_TRUE(node.initialize());
+
+  std::vector<AddressRecord> all = node.search({"S"});
+  std::vector<AddressRecord> expected;
+  for (const AddressRecord& record : node.search({"1"})) {
+    if (std::find(all.begin(), all.end(), record) != all.end()) {
+      expected.push_back(record);
+    }
+  }
+  ASSERT_FALSE(expected.empty());
+
+  std::vector<AddressRecord> results = node.search({"1", "S"});
+  std::vector<AddressRecord> reversed = node.search({"S", "1"});
+  EXPECT_EQ(results, reversed);
+  ASSERT_EQ(results.size(), expected.size());
+  for (const AddressRecord& record : expected) {
+    EXPECT_NE(std::find(results.begin(), results.end(), record),
+              results.end());
+  }
+
+  EXPECT_TRUE(node.search({"1", "S", "NONEXISTENT"}).empty());
+}
+
 // Test empty query handling
 TEST(DataNodeTest, EmptyQueryHandling) {
   DataNode node(0, getTestDataPath("valid_addresses.csv"));
@@ -203,3 +240,672 @@ TEST(DataNodeTest, CaseInsensitiveSearch) {
   const AddressRecord& record = results[0];
   EXPECT_EQ(record.city, "Steilacoom");
 }
+
+// Test that both radix tree layouts return the same search results
+TEST(DataNodeTest, PointerAndFlatLayoutsAgree) {
+  DataNodeOptions pointer_options;
+  pointer_options.flat_radix_layout = false;
+  DataNode pointer_node(0, getTestDataPath("valid_addresses.csv"),
+                        pointer_options);
+  DataNode flat_node(0, getTestDataPath("valid_addresses.csv"));
+  ASSERT_TRUE(pointer_node.initialize());
+  ASSERT_TRUE(flat_node.initialize());
+
+  for (const auto& query : std::vector<std::vector<std::string>>{
+           {"SALINAS"}, {"MCKINNON", "SALINAS"}, {"3RD"}, {"1"},
+           {"1531 MCKINNON STREET, SALINAS, 93906"}}) {
+    std::vector<AddressRecord> pointer_results = pointer_node.search(query);
+    std::vector<AddressRecord> flat_results = flat_node.search(query);
+    ASSERT_EQ(flat_results.size(), pointer_results.size());
+    for (size_t i = 0; i < flat_results.size(); ++i) {
+      EXPECT_EQ(flat_results[i].hash, pointer_results[i].hash);
+    }
+  }
+}
+
+// Test that the visitor search sees the same records as search()
+TEST(DataNodeTest, SearchViewsMatchesSearch) {
+  DataNode node(0, getTestDataPath("valid_addresses.csv"));
+  ASSERT_TRUE(node.initialize());
+
+  std::vector<std::string> query_terms = {"SALINAS"};
+  std::vector<AddressRecord> expected = node.search(query_terms);
+  ASSERT_FALSE(expected.empty());
+
+  std::vector<AddressRecord> visited;
+  size_t count = node.searchViews(
+      query_terms, [&visited](const AddressRecordView& record) {
+        visited.push_back(record.toRecord());
+      });
+
+  EXPECT_EQ(count, expected.size());
+  EXPECT_EQ(visited, expected);
+}
+
+// Test that top-K search returns the best records of a full ranking
+TEST(DataNodeTest, SearchTopKReturnsBestRecords) {
+  DataNode node(0, getTestDataPath("valid_addresses.csv"));
+  ASSERT_TRUE(node.initialize());
+
+  std::vector<std::string> query_terms = {"SALINAS"};
+  std::vector<double> all_scores;
+  size_t total = node.searchTopK(
+      query_terms, DataNode::kNoLimit, 0.0,
+      [&all_scores](const AddressRecordView&, double score) {
+        all_scores.push_back(score);
+      });
+  ASSERT_GT(total, 2u);
+  EXPECT_TRUE(std::is_sorted(all_scores.rbegin(), all_scores.rend()));
+
+  std::vector<double> top_scores;
+  size_t count = node.searchTopK(
+      query_terms, 2, 0.0, [&top_scores](const AddressRecordView&, double score) {
+        top_scores.push_back(score);
+      });
+  EXPECT_EQ(count, 2u);
+  EXPECT_EQ(top_scores,
+            std::vector<double>(all_scores.begin(), all_scores.begin() + 2));
+
+  // No record reaches an unreachable minimum score
+  size_t none = node.searchTopK(query_terms, DataNode::kNoLimit, 1e9,
+                                [](const AddressRecordView&, double) {});
+  EXPECT_EQ(none, 0u);
+}
+
+// Test that a batch ranks every query exactly like searchTopK(), including
+// duplicate and empty queries
+TEST(DataNodeTest, SearchTopKBatchMatchesSearchTopK) {
+  DataNodeOptions options;
+  options.batch_threads = 4;
+  DataNode node(0, getTestDataPath("valid_addresses.csv"), options);
+  ASSERT_TRUE(node.initialize());
+
+  std::vector<DataNode::BatchQuery> queries;
+  const std::vector<std::vector<std::string>> term_lists = {
+      {"SALINAS"}, {"MCKINNON", "SALINAS"}, {"3RD"}, {"1"}, {"S", "1"},
+      {"1531 MCKINNON STREET, SALINAS, 93906"}, {"NOMATCH"}, {}};
+  for (size_t max_results : {size_t{1}, size_t{3}, DataNode::kNoLimit}) {
+    for (const auto& terms : term_lists) {
+      // Each query appears twice, with the same ranking both times
+      for (int copy = 0; copy < 2; ++copy) {
+        queries.push_back({terms, max_results, 0.0});
+      }
+    }
+  }
+  queries.push_back({{"SALINAS"}, DataNode::kNoLimit, 1e9});
+  queries.push_back({{"SALINAS"}, 0, 0.0});
+
+  // Each query's records are visited from one thread
+  using Ranked = std::vector<std::pair<size_t, double>>;
+  std::vector<Ranked> batch_results(queries.size());
+  size_t total = node.searchTopKBatch(
+      queries, [&batch_results](size_t query, const AddressRecordView& record,
+                                double score) {
+        batch_results[query].emplace_back(record.hash, score);
+      });
+
+  size_t expected_total = 0;
+  for (size_t i = 0; i < queries.size(); ++i) {
+    Ranked expected;
+    expected_total += node.searchTopK(
+        queries[i].query_terms, queries[i].max_results, queries[i].min_score,
+        [&expected](const AddressRecordView& record, double score) {
+          expected.emplace_back(record.hash, score);
+        });
+    EXPECT_EQ(batch_results[i], expected) << "query " << i;
+  }
+  EXPECT_EQ(total, expected_total);
+  EXPECT_FALSE(batch_results[0].empty());
+}
+
+// Test that a batch sharing a pool finishes on the calling thread while
+// every pool worker is busy, with the same rankings
+TEST(DataNodeTest, SearchTopKBatchRunsOnBusyPool) {
+  DataNodeOptions options;
+  options.batch_threads = 4;
+  options.batch_pool = std::make_shared<ThreadPool>(1);
+  DataNode node(0, getTestDataPath("valid_addresses.csv"), options);
+  ASSERT_TRUE(node.initialize());
+
+  std::mutex mutex;
+  std::condition_variable released;
+  bool release = false;
+  options.batch_pool->submit([&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [&release]() { return release; });
+  });
+
+  std::vector<DataNode::BatchQuery> queries;
+  const std::vector<std::vector<std::string>> term_lists = {
+      {"SALINAS"}, {"MCKINNON", "SALINAS"}, {"3RD"}, {"1"}, {"S", "1"},
+      {"1531 MCKINNON STREET, SALINAS, 93906"}, {"NOMATCH"}, {}};
+  for (size_t max_results = 1; max_results <= 5; ++max_results) {
+    for (const auto& terms : term_lists) {
+      queries.push_back({terms, max_results, 0.0});
+    }
+  }
+
+  using Ranked = std::vector<std::pair<size_t, double>>;
+  std::vector<Ranked> batch_results(queries.size());
+  node.searchTopKBatch(
+      queries, [&batch_results](size_t query, const AddressRecordView& record,
+                                double score) {
+        batch_results[query].emplace_back(record.hash, score);
+      });
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    release = true;
+  }
+  released.notify_all();
+
+  for (size_t i = 0; i < queries.size(); ++i) {
+    Ranked expected;
+    node.searchTopK(
+        queries[i].query_terms, queries[i].max_results, queries[i].min_score,
+        [&expected](const AddressRecordView& record, double score) {
+          expected.emplace_back(record.hash, score);
+        });
+    EXPECT_EQ(batch_results[i], expected) << "query " << i;
+  }
+}
+
+// Test that a ranked cursor visits the searchTopK() ranking chunk by chunk
+TEST(DataNodeTest, SearchRankedVisitsInChunks) {
+  DataNode node(0, getTestDataPath("valid_addresses.csv"));
+  ASSERT_TRUE(node.initialize());
+
+  using Ranked = std::vector<std::pair<size_t, double>>;
+  auto collect = [](Ranked& ranked) {
+    return [&ranked](const AddressRecordView& record, double score) {
+      ranked.emplace_back(record.hash, score);
+    };
+  };
+  std::vector<std::string> query_terms = {"SALINAS"};
+  Ranked expected;
+  node.searchTopK(query_terms, DataNode::kNoLimit, 0.0, collect(expected));
+  ASSERT_GT(expected.size(), 2u);
+
+  DataNode::RankedCursor cursor =
+      node.searchRanked(query_terms, DataNode::kNoLimit, 0.0);
+  EXPECT_EQ(cursor.remaining(), expected.size());
+  Ranked streamed;
+  while (cursor.next(2, collect(streamed)) > 0) {
+    EXPECT_EQ(cursor.remaining(), expected.size() - streamed.size());
+  }
+  EXPECT_EQ(streamed, expected);
+  EXPECT_EQ(cursor.next(2, collect(streamed)), 0u);
+
+  EXPECT_EQ(node.searchRanked(query_terms, 1, 0.0).remaining(), 1u);
+  EXPECT_EQ(node.searchRanked({}, DataNode::kNoLimit, 0.0).remaining(), 0u);
+}
+
+// Test that fuzzy search finds terms with typos, within the allowance of
+// each term's length, and that every typo lowers a record's score
+TEST(DataNodeTest, FuzzySearchToleratesTypos) {
+  DataNode node(0, getTestDataPath("valid_addresses.csv"));
+  ASSERT_TRUE(node.initialize());
+
+  auto hashes = [&node](const std::vector<std::string>& query_terms,
+                        int fuzziness) {
+    std::vector<size_t> found;
+    node.searchTopK(
+        query_terms, DataNode::kNoLimit, 0.0,
+        [&found](const AddressRecordView& record, double) {
+          found.push_back(record.hash);
+        },
+        fuzziness);
+    std::sort(found.begin(), found.end());
+    return found;
+  };
+
+  const size_t mckinnon = 0xa8ac1dc8c998ce76;
+  EXPECT_TRUE(hashes({"MCKINON", "SALNAS"}, 0).empty());
+  EXPECT_EQ(hashes({"MCKINON", "SALNAS"}, 1), std::vector<size_t>{mckinnon});
+  EXPECT_EQ(hashes({"mckinon", "salnas"}, 2), std::vector<size_t>{mckinnon});
+  EXPECT_EQ(hashes({"SALINAX"}, 1).size(), 3u);
+
+  // Terms under 3 characters are exact, and under 6 allow only one typo
+  EXPECT_TRUE(hashes({"SX"}, 2).empty());
+  EXPECT_EQ(hashes({"LEYTX"}, 1).size(), 1u);
+  EXPECT_TRUE(hashes({"LXYTX"}, 2).empty());
+  EXPECT_EQ(hashes({"SXASIDX"}, 2).size(), 1u);
+
+  // Structured queries are matched exactly
+  EXPECT_TRUE(hashes({"1531 MCKINON STREET, SALINAS, 93906"}, 2).empty());
+
+  // One typo scales the score against the raw query terms once
+  std::vector<std::string> query_terms = {"SALINAX"};
+  RelevanceScorer scorer(query_terms);
+  size_t count = node.searchTopK(
+      query_terms, DataNode::kNoLimit, 0.0,
+      [&scorer](const AddressRecordView& record, double score) {
+        EXPECT_GT(score, 0.0);
+        EXPECT_DOUBLE_EQ(score,
+                         scorer.score(record) * RelevanceScorer::kEditFactor);
+      },
+      1);
+  EXPECT_EQ(count, 3u);
+
+  // Batches and cursors rank fuzzy queries like searchTopK()
+  std::vector<DataNode::BatchQuery> queries = {
+      {{"MCKINON", "SALNAS"}, DataNode::kNoLimit, 0.0, 1},
+      {{"MCKINON", "SALNAS"}, DataNode::kNoLimit, 0.0, 0}};
+  std::vector<size_t> batch_counts(queries.size(), 0);
+  node.searchTopKBatch(queries, [&batch_counts](size_t query,
+                                                const AddressRecordView&,
+                                                double) {
+    batch_counts[query]++;
+  });
+  EXPECT_EQ(batch_counts, (std::vector<size_t>{1, 0}));
+  EXPECT_EQ(node.searchRanked({"SALINAX"}, DataNode::kNoLimit, 0.0, 1)
+                .remaining(),
+            3u);
+}
+
+// Test that exact key lookups find what structured searches find
+TEST(DataNodeTest, LookupFindsExactCompositeKeys) {
+  DataNode node(0, getTestDataPath("valid_addresses.csv"));
+  ASSERT_TRUE(node.initialize());
+  EXPECT_GT(node.getStatistics().key_index_memory, 0u);
+
+  auto lookupHashes = [&node](const std::vector<std::string>& keys) {
+    std::vector<size_t> found;
+    node.lookup(keys, {}, DataNode::kNoLimit,
+                [&found](const AddressRecordView& record, double) {
+                  found.push_back(record.hash);
+                });
+    return found;
+  };
+
+  AddressNormalizer normalizer;
+  const std::string query = "1531 MCKINNON STREET, SALINAS, 93906";
+  std::vector<size_t> searched;
+  node.searchTopK({query}, DataNode::kNoLimit, 0.0,
+                  [&searched](const AddressRecordView& record, double) {
+                    searched.push_back(record.hash);
+                  });
+  ASSERT_FALSE(searched.empty());
+  StructuredQueryKeys keys = structuredQueryKeys(query, normalizer);
+  ASSERT_TRUE(keys.has_postcode_key);
+  EXPECT_EQ(lookupHashes({keys.keys[0]}), searched);
+  EXPECT_EQ(lookupHashes(keys.keys), searched);
+
+  // Keys are matched whole; the first key with records wins
+  std::string prefix = keys.keys[0].substr(0, keys.keys[0].size() - 1);
+  EXPECT_TRUE(lookupHashes({prefix}).empty());
+  EXPECT_EQ(lookupHashes({prefix, keys.keys[1]}), searched);
+  EXPECT_TRUE(lookupHashes({}).empty());
+
+  // Scores are those of the query terms
+  RelevanceScorer scorer({query});
+  node.lookup({keys.keys[0]}, {query}, 1,
+              [&scorer](const AddressRecordView& record, double score) {
+                EXPECT_EQ(score, scorer.score(record));
+              });
+}
+
+// Test that a multi-threaded load builds the same indexes as one thread
+TEST(DataNodeTest, ParallelLoadMatchesSingleThreaded) {
+  DataNodeOptions single_options;
+  single_options.load_threads = 1;
+  DataNodeOptions parallel_options;
+  parallel_options.load_threads = 4;
+  DataNode single_node(0, getTestDataPath("valid_addresses.csv"),
+                       single_options);
+  DataNode parallel_node(0, getTestDataPath("valid_addresses.csv"),
+                         parallel_options);
+  ASSERT_TRUE(single_node.initialize());
+  ASSERT_TRUE(parallel_node.initialize());
+
+  EXPECT_EQ(parallel_node.getStatistics().total_records,
+            single_node.getStatistics().total_records);
+  EXPECT_EQ(parallel_node.getStatistics().radix_tree_memory,
+            single_node.getStatistics().radix_tree_memory);
+  for (const auto& query : std::vector<std::vector<std::string>>{
+           {"SALINAS"}, {"MCKINNON", "SALINAS"}, {"3RD"}, {"1"},
+           {"1531 MCKINNON STREET, SALINAS, 93906"}}) {
+    EXPECT_EQ(parallel_node.search(query), single_node.search(query));
+  }
+}
+
+// Test that rows sharing a HASH are stored once, as the last row, while
+// every row's terms still find it
+TEST(DataNodeTest, DuplicateHashKeepsLastRow) {
+  std::string csv_path = testing::TempDir() + "duplicate_hash_test.csv";
+  {
+    std::ofstream out(csv_path);
+    out << "LON,LAT,NUMBER,STREET,UNIT,CITY,DISTRICT,REGION,POSTCODE,ID,HASH\n"
+        << "-122.0,47.0,1,OAK AVENUE,,Tacoma,,,98401,,00000000000000aa\n"
+        << "-122.0,47.0,2,ELM STREET,,Tacoma,,,98402,,00000000000000bb\n"
+        << "-122.0,47.0,1,OAK STREET,,Tacoma,,,98401,,00000000000000aa\n";
+  }
+
+  DataNode node(0, csv_path);
+  ASSERT_TRUE(node.initialize());
+  EXPECT_EQ(node.getStatistics().total_records, 2u);
+
+  for (const char* term : {"OAK AVENUE", "OAK STREET", "OAK"}) {
+    std::vector<AddressRecord> results = node.search({term});
+    auto oak = std::find_if(
+        results.begin(), results.end(),
+        [](const AddressRecord& record) { return record.number == "1"; });
+    ASSERT_NE(oak, results.end()) << term;
+    EXPECT_EQ(oak->street, "OAK STREET") << term;
+  }
+  EXPECT_EQ(node.search({"OAK"}).size(), 1u);
+
+  std::remove(csv_path.c_str());
+}
+
+// Test that a node writes a snapshot after building and serves from it on
+// the next start
+TEST(DataNodeTest, SnapshotRoundTrip) {
+  DataNodeOptions options;
+  options.snapshot_path = testing::TempDir() + "data_node_test.snapshot";
+  std::remove(options.snapshot_path.c_str());
+
+  DataNode built_node(0, getTestDataPath("valid_addresses.csv"), options);
+  ASSERT_TRUE(built_node.initialize());
+  EXPECT_FALSE(built_node.getStatistics().loaded_from_snapshot);
+  ASSERT_TRUE(std::ifstream(options.snapshot_path).good());
+
+  DataNode loaded_node(0, getTestDataPath("valid_addresses.csv"), options);
+  ASSERT_TRUE(loaded_node.initialize());
+  DataNode::Statistics stats = loaded_node.getStatistics();
+  EXPECT_TRUE(stats.loaded_from_snapshot);
+  EXPECT_EQ(stats.total_records, built_node.getStatistics().total_records);
+  EXPECT_EQ(stats.key_index_memory,
+            built_node.getStatistics().key_index_memory);
+
+  for (const auto& query : std::vector<std::vector<std::string>>{
+           {"SALINAS"}, {"MCKINNON", "SALINAS"}, {"3RD"}, {"1"},
+           {"1531 MCKINNON STREET, SALINAS, 93906"}}) {
+    EXPECT_EQ(loaded_node.search(query), built_node.search(query));
+  }
+
+  std::remove(options.snapshot_path.c_str());
+}
+
+// Test that cached postings serve the same results as the index
+TEST(DataNodeTest, PostingsCacheServesHotPrefixes) {
+  std::string csv_path = testing::TempDir() + "postings_cache_test.csv";
+  {
+    std::ofstream csv(csv_path);
+    csv << "LON,LAT,NUMBER,STREET,UNIT,CITY,DISTRICT,REGION,POSTCODE,ID,HASH\n";
+    for (int i = 0; i < 200; ++i) {
+      csv << "-121.6,36.7," << i << ","
+          << (i % 2 == 0 ? "MAIN STREET" : "OAK AVENUE")
+          << ",,Salinas,,,93906,," << std::hex << (0x1000 + i) << std::dec
+          << "\n";
+    }
+  }
+
+  DataNodeOptions options;
+  options.postings_cache_bytes = 1 << 20;
+  DataNode cached_node(0, csv_path, options);
+  DataNode plain_node(0, csv_path);
+  ASSERT_TRUE(cached_node.initialize());
+  ASSERT_TRUE(plain_node.initialize());
+
+  for (int round = 0; round < 3; ++round) {
+    for (const auto& query : std::vector<std::vector<std::string>>{
+             {"SALINAS"}, {"SALIN"}, {"MAIN", "SALINAS"}, {"OAK"}}) {
+      EXPECT_EQ(cached_node.search(query), plain_node.search(query));
+    }
+  }
+
+  DataNode::Statistics stats = cached_node.getStatistics();
+  EXPECT_GT(stats.postings_cache.hits, 0u);
+  EXPECT_GT(stats.postings_cache.entries, 0u);
+  EXPECT_EQ(plain_node.getStatistics().postings_cache.entries, 0u);
+
+  std::remove(csv_path.c_str());
+}
+
+// Test reverse geocoding with and without query terms
+TEST(DataNodeTest, SearchNearest) {
+  DataNode node(0, getTestDataPath("valid_addresses.csv"));
+  ASSERT_TRUE(node.initialize());
+  EXPECT_GT(node.getStatistics().spatial_index_memory, 0u);
+
+  // Next to 1531 MCKINNON STREET, Salinas
+  GeoPoint point{-121.6461, 36.7082};
+  std::vector<std::string> numbers;
+  std::vector<double> distances;
+  auto collect = [&](const AddressRecordView& record, double distance) {
+    numbers.emplace_back(record.number);
+    distances.push_back(distance);
+  };
+
+  EXPECT_EQ(node.searchNearest(point, 3, 0.0, {}, collect), 3u);
+  EXPECT_EQ(numbers, (std::vector<std::string>{"1531", "2073", "68"}));
+  EXPECT_LT(distances[0], 100.0);
+  EXPECT_TRUE(std::is_sorted(distances.begin(), distances.end()));
+
+  // Within 5 km only the Salinas addresses remain
+  numbers.clear();
+  distances.clear();
+  EXPECT_EQ(node.searchNearest(point, 10, 5000.0, {}, collect), 3u);
+
+  // Restricted to a street
+  numbers.clear();
+  distances.clear();
+  EXPECT_EQ(node.searchNearest(point, 10, 0.0, {"SANTA"}, collect), 1u);
+  EXPECT_EQ(numbers, (std::vector<std::string>{"2073"}));
+
+  EXPECT_EQ(node.searchNearest({200.0, 0.0}, 10, 0.0, {}, collect), 0u);
+}
+
+// Test bounding box search with and without query terms
+TEST(DataNodeTest, SearchBox) {
+  DataNode node(0, getTestDataPath("valid_addresses.csv"));
+  ASSERT_TRUE(node.initialize());
+
+  std::vector<std::string> numbers;
+  auto collect = [&numbers](const AddressRecordView& record) {
+    numbers.emplace_back(record.number);
+  };
+
+  // Around Salinas and Seaside, in DocId order
+  GeoBox monterey{-122.0, 36.5, -121.5, 36.8};
+  EXPECT_EQ(node.searchBox(monterey, DataNode::kNoLimit, {}, collect), 4u);
+  EXPECT_EQ(numbers, (std::vector<std::string>{"1531", "103", "2073", "68"}));
+
+  numbers.clear();
+  EXPECT_EQ(node.searchBox(monterey, 2, {}, collect), 2u);
+  EXPECT_EQ(numbers, (std::vector<std::string>{"1531", "103"}));
+
+  numbers.clear();
+  EXPECT_EQ(node.searchBox(monterey, DataNode::kNoLimit, {"SEASIDE"}, collect),
+            1u);
+  EXPECT_EQ(numbers, (std::vector<std::string>{"103"}));
+  EXPECT_EQ(node.searchBox(monterey, DataNode::kNoLimit, {"STEILACOOM"},
+                           collect),
+            0u);
+
+  GeoBox inverted{-121.5, 36.5, -122.0, 36.8};
+  EXPECT_EQ(node.searchBox(inverted, DataNode::kNoLimit, {}, collect), 0u);
+}
+
+// Write a shard CSV with one address per street name
+static void writeStreetsCsv(const std::string& path,
+                            const std::vector<std::string>& streets) {
+  std::ofstream csv(path, std::ios::trunc);
+  csv << "LON,LAT,NUMBER,STREET,UNIT,CITY,DISTRICT,REGION,POSTCODE,ID,HASH\n";
+  for (size_t i = 0; i < streets.size(); ++i) {
+    csv << "-121.6,36.7," << i + 1 << "," << streets[i]
+        << ",,Salinas,,,93906,," << std::hex << (0x2000 + i) << std::dec
+        << "\n";
+  }
+}
+
+// Test that a reload publishes a new generation built from the current
+// data file, and that a failed reload keeps serving the old one
+TEST(DataNodeTest, ReloadPublishesNewGeneration) {
+  std::string csv_path = testing::TempDir() + "reload_test.csv";
+  writeStreetsCsv(csv_path, {"MAIN STREET", "OAK AVENUE"});
+
+  DataNode node(0, csv_path);
+  EXPECT_EQ(node.getStatistics().generation, 0u);
+  ASSERT_TRUE(node.initialize());
+  DataNode::Statistics first = node.getStatistics();
+  EXPECT_EQ(first.generation, 1u);
+  EXPECT_EQ(first.total_records, 2u);
+  EXPECT_EQ(node.search({"OAK"}).size(), 1u);
+  EXPECT_EQ(node.search({"ELM"}).size(), 0u);
+
+  writeStreetsCsv(csv_path, {"MAIN STREET", "ELM STREET", "PINE STREET"});
+  std::optional<DataNode::Statistics> reloaded = node.reload();
+  ASSERT_TRUE(reloaded);
+  EXPECT_EQ(reloaded->generation, 2u);
+  EXPECT_EQ(reloaded->total_records, 3u);
+  DataNode::Statistics second = node.getStatistics();
+  EXPECT_EQ(second.generation, 2u);
+  EXPECT_EQ(second.total_records, 3u);
+  EXPECT_GE(second.loaded_at, first.loaded_at);
+  EXPECT_EQ(node.search({"OAK"}).size(), 0u);
+  EXPECT_EQ(node.search({"ELM"}).size(), 1u);
+
+  std::remove(csv_path.c_str());
+  EXPECT_FALSE(node.reload());
+  EXPECT_EQ(node.getStatistics().generation, 2u);
+  EXPECT_EQ(node.search({"ELM"}).size(), 1u);
+}
+
+// Test that a ranked cursor keeps reading the generation it ranked on after
+// a reload replaces it
+TEST(DataNodeTest, RankedCursorOutlivesReload) {
+  std::string csv_path = testing::TempDir() + "reload_cursor_test.csv";
+  writeStreetsCsv(csv_path, {"MAIN STREET", "MAIN AVENUE", "OAK AVENUE"});
+
+  DataNode node(0, csv_path);
+  ASSERT_TRUE(node.initialize());
+  DataNode::RankedCursor cursor =
+      node.searchRanked({"MAIN"}, DataNode::kNoLimit, 0.0);
+  ASSERT_EQ(cursor.remaining(), 2u);
+
+  writeStreetsCsv(csv_path, {"OAK AVENUE"});
+  ASSERT_TRUE(node.reload());
+  EXPECT_EQ(node.search({"MAIN"}).size(), 0u);
+
+  std::vector<std::string> streets;
+  cursor.next(DataNode::kNoLimit,
+              [&streets](const AddressRecordView& record, double /*score*/) {
+                streets.emplace_back(record.street);
+              });
+  std::sort(streets.begin(), streets.end());
+  EXPECT_EQ(streets,
+            (std::vector<std::string>{"MAIN AVENUE", "MAIN STREET"}));
+
+  std::remove(csv_path.c_str());
+}
+
+// Test that searches running during reloads always see one complete
+// generation
+TEST(DataNodeTest, SearchesDuringReloadSeeOneGeneration) {
+  std::string csv_path = testing::TempDir() + "reload_concurrent_test.csv";
+  writeStreetsCsv(csv_path, {"MAIN STREET", "MAIN AVENUE", "OAK AVENUE"});
+
+  DataNode node(0, csv_path);
+  ASSERT_TRUE(node.initialize());
+
+  std::atomic<bool> done{false};
+  std::atomic<size_t> bad_results{0};
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&]() {
+      while (!done) {
+        // Every generation has exactly two MAIN records
+        size_t count = node.searchTopK(
+            {"MAIN"}, DataNode::kNoLimit, 0.0,
+            [](const AddressRecordView&, double) {});
+        if (count != 2) {
+          bad_results++;
+        }
+      }
+    });
+  }
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_TRUE(node.reload());
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(bad_results, 0u);
+  EXPECT_EQ(node.getStatistics().generation, 6u);
+  std::remove(csv_path.c_str());
+}
+
+// Test that searches of every kind running on many threads at once return
+// what they return one at a time (run under ThreadSanitizer with
+// -DENABLE_TSAN=ON to check for data races)
+TEST(DataNodeTest, ConcurrentSearchesMatchSequential) {
+  DataNodeOptions options;
+  options.postings_cache_bytes = 1 << 20;
+  DataNode node(0, getTestDataPath("valid_addresses.csv"), options);
+  ASSERT_TRUE(node.initialize());
+
+  const std::vector<std::vector<std::string>> queries = {
+      {"SALINAS"}, {"MCKINNON", "SALINAS"}, {"3RD"}, {"1"}, {"S"},
+      {"1531 MCKINNON STREET, SALINAS, 93906"}};
+  const GeoPoint point{-121.65, 36.71};
+  const GeoBox box{-122.0, 36.5, -121.5, 36.8};
+
+  // Everything a worker observes, in one comparable value
+  auto runAll = [&]() {
+    std::vector<std::string> seen;
+    for (const auto& query : queries) {
+      for (const AddressRecord& record : node.search(query)) {
+        seen.push_back(record.number);
+      }
+      node.searchTopK(query, 2, 0.0,
+                      [&seen](const AddressRecordView& record, double) {
+                        seen.emplace_back(record.number);
+                      });
+      node.searchNearest(point, 3, 0.0, query,
+                         [&seen](const AddressRecordView& record, double) {
+                           seen.emplace_back(record.number);
+                         });
+      node.searchBox(box, DataNode::kNoLimit, query,
+                     [&seen](const AddressRecordView& record) {
+                       seen.emplace_back(record.number);
+                     });
+    }
+    std::vector<DataNode::BatchQuery> batch(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+      batch[i].query_terms = queries[i];
+    }
+    std::vector<std::vector<std::string>> batch_seen(queries.size());
+    std::mutex batch_mutex;
+    node.searchTopKBatch(batch, [&](size_t query,
+                                    const AddressRecordView& record, double) {
+      std::lock_guard<std::mutex> lock(batch_mutex);
+      batch_seen[query].emplace_back(record.number);
+    });
+    for (const auto& numbers : batch_seen) {
+      seen.insert(seen.end(), numbers.begin(), numbers.end());
+    }
+    return seen;
+  };
+
+  std::vector<std::string> expected = runAll();
+  ASSERT_FALSE(expected.empty());
+
+  std::vector<std::thread> workers;
+  std::atomic<size_t> mismatches{0};
+  for (int t = 0; t < 8; ++t) {
+    workers.emplace_back([&]() {
+      for (int round = 0; round < 10; ++round) {
+        if (runAll() != expected) {
+          mismatches++;
+        }
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  EXPECT_EQ(mismatches, 0u);
+}
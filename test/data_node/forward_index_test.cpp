@@ -20,9 +20,9 @@ TEST(ForwardIndexTest, InsertAndGet) {
   record.original_unit = "";
   record.original_city = "Steilacoom";
 
-  index.insert(record.hash, record);
+  DocId id = index.insert(record);
 
-  auto retrieved = index.get(record.hash);
+  auto retrieved = index.get(id);
   ASSERT_TRUE(retrieved.has_value());
   EXPECT_EQ(retrieved->longitude, record.longitude);
   EXPECT_EQ(retrieved->latitude, record.latitude);
@@ -30,12 +30,13 @@ TEST(ForwardIndexTest, InsertAndGet) {
   EXPECT_EQ(retrieved->number, record.number);
   EXPECT_EQ(retrieved->street, record.street);
   EXPECT_EQ(retrieved->city, record.city);
+  EXPECT_EQ(*retrieved, record);
 }
 
 TEST(ForwardIndexTest, GetNonExistent) {
   ForwardIndex index;
 
-  auto result = index.get(0x9999999999999999);
+  auto result = index.get(12345);
   EXPECT_FALSE(result.has_value());
 }
 
@@ -46,10 +47,10 @@ TEST(ForwardIndexTest, Contains) {
   record.hash = 0xABCDEF1234567890;
   record.city = "SEATTLE";
 
-  index.insert(record.hash, record);
+  DocId id = index.insert(record);
 
-  EXPECT_TRUE(index.contains(record.hash));
-  EXPECT_FALSE(index.contains(0x9999999999999999));
+  EXPECT_TRUE(index.contains(id));
+  EXPECT_FALSE(index.contains(id + 1));
 }
 
 TEST(ForwardIndexTest, RecordCount) {
@@ -59,13 +60,13 @@ TEST(ForwardIndexTest, RecordCount) {
 
   AddressRecord record1;
   record1.hash = 0x1111111111111111;
-  index.insert(record1.hash, record1);
+  index.insert(record1);
 
   EXPECT_EQ(index.getRecordCount(), 1);
 
   AddressRecord record2;
   record2.hash = 0x2222222222222222;
-  index.insert(record2.hash, record2);
+  index.insert(record2);
 
   EXPECT_EQ(index.getRecordCount(), 2);
 }
@@ -80,9 +81,65 @@ TEST(ForwardIndexTest, StorageSize) {
   AddressRecord record;
   record.hash = 0xABCDEF1234567890;
   record.city = "SEATTLE";
-  index.insert(record.hash, record);
+  index.insert(record);
 
   // Size should increase after insertion
   size_t size_with_record = index.getStorageSize();
   EXPECT_GT(size_with_record, empty_size);
 }
+
+// Test that DocIds are dense and assigned in insertion order
+TEST(ForwardIndexTest, AssignsDenseDocIds) {
+  ForwardIndex index;
+
+  for (DocId expected = 0; expected < 10; ++expected) {
+    AddressRecord record;
+    record.hash = 0x1000 + expected;
+    EXPECT_EQ(index.insert(record), expected);
+  }
+
+  for (DocId id = 0; id < 10; ++id) {
+    auto retrieved = index.get(id);
+    ASSERT_TRUE(retrieved.has_value());
+    EXPECT_EQ(retrieved->hash, 0x1000 + id);
+  }
+}
+
+// Test that records sharing city and street names keep their own values
+TEST(ForwardIndexTest, SharedStringsRoundTrip) {
+  ForwardIndex index;
+
+  AddressRecord first(-121.6, 36.7, 1, "1531", "MCKINNON STREET", "C",
+                      "Salinas", "93906", "MCKINNON STREET", "C", "Salinas");
+  AddressRecord second(-121.7, 36.8, 2, "68", "MCKINNON STREET", "",
+                       "Salinas", "93906", "MCKINNON STREET", "", "Salinas");
+  AddressRecord third(-121.8, 36.6, 3, "103", "LEYTE ROAD", "", "Seaside",
+                      "93955", "LEYTE ROAD", "", "Seaside");
+
+  DocId first_id = index.insert(first);
+  DocId second_id = index.insert(second);
+  DocId third_id = index.insert(third);
+
+  EXPECT_EQ(*index.get(first_id), first);
+  EXPECT_EQ(*index.get(second_id), second);
+  EXPECT_EQ(*index.get(third_id), third);
+}
+
+// Test that views expose the same fields as the owning record
+TEST(ForwardIndexTest, GetViewMatchesGet) {
+  ForwardIndex index;
+
+  AddressRecord record(-122.608996, 47.166377, 42, "611", "3RD STREET", "2",
+                       "STEILACOOM", "98388", "3rd St", "2", "Steilacoom");
+  DocId id = index.insert(record);
+
+  std::optional<AddressRecordView> view = index.getView(id);
+  ASSERT_TRUE(view.has_value());
+  EXPECT_EQ(view->hash, record.hash);
+  EXPECT_EQ(view->number, "611");
+  EXPECT_EQ(view->street, "3RD STREET");
+  EXPECT_EQ(view->original_city, "Steilacoom");
+  EXPECT_EQ(view->toRecord(), record);
+
+  EXPECT_FALSE(index.getView(id + 1).has_value());
+}
@@ -0,0 +1,168 @@
+// Index Snapshot Unit Tests
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "data_node/forward_index.h"
+#include "data_node/index_snapshot.h"
+#include "data_node/radix_tree_index.h"
+
+static std::string snapshotTestPath(const std::string& name) {
+  return testing::TempDir() + "index_snapshot_test_" + name;
+}
+
+static const SourceFingerprint kSource = {1234, 0xFEEDFACECAFEBEEF};
+
+// Test writing sections and reading them back from the mapped file
+TEST(IndexSnapshotTest, SectionsRoundTrip) {
+  std::string path = snapshotTestPath("sections");
+  std::vector<uint64_t> numbers = {1, 2, 3, 0xFFFFFFFFFFFFFFFF};
+  std::string text = "hello snapshot";
+
+  SnapshotWriter writer;
+  writer.addArray(SnapshotSection::kForwardHashes,
+                  ArrayView<uint64_t>(numbers));
+  writer.addSection(SnapshotSection::kStringData, text.data(), text.size());
+  ASSERT_TRUE(writer.write(path, kSource));
+
+  auto snapshot = IndexSnapshot::open(path, kSource);
+  ASSERT_NE(snapshot, nullptr);
+
+  auto read_numbers =
+      snapshot->getArray<uint64_t>(SnapshotSection::kForwardHashes);
+  ASSERT_TRUE(read_numbers.has_value());
+  EXPECT_EQ(std::vector<uint64_t>(read_numbers->begin(), read_numbers->end()),
+            numbers);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(read_numbers->data()) % 64, 0u);
+
+  auto read_text = snapshot->getArray<char>(SnapshotSection::kStringData);
+  ASSERT_TRUE(read_text.has_value());
+  EXPECT_EQ(std::string(read_text->begin(), read_text->end()), text);
+
+  EXPECT_FALSE(snapshot->getArray<char>(SnapshotSection::kRadixNodes));
+  EXPECT_FALSE(snapshot->getArray<uint64_t>(SnapshotSection::kStringData));
+
+  std::remove(path.c_str());
+}
+
+// Test that missing, stale or corrupted snapshots are rejected
+TEST(IndexSnapshotTest, RejectsInvalidSnapshots) {
+  std::string path = snapshotTestPath("invalid");
+  std::remove(path.c_str());
+  EXPECT_EQ(IndexSnapshot::open(path, kSource), nullptr);
+
+  std::vector<uint32_t> values(1000, 7);
+  SnapshotWriter writer;
+  writer.addArray(SnapshotSection::kStringOffsets,
+                  ArrayView<uint32_t>(values));
+  ASSERT_TRUE(writer.write(path, kSource));
+  ASSERT_NE(IndexSnapshot::open(path, kSource), nullptr);
+
+  // Built from different data
+  SourceFingerprint other_source = kSource;
+  other_source.content_hash++;
+  EXPECT_EQ(IndexSnapshot::open(path, other_source), nullptr);
+
+  // Flip one byte near the end of the section payload
+  {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(-10, std::ios::end);
+    file.put('\x55');
+  }
+  EXPECT_EQ(IndexSnapshot::open(path, kSource), nullptr);
+
+  std::remove(path.c_str());
+}
+
+// Test fingerprinting the contents of a file
+TEST(IndexSnapshotTest, SourceFingerprint) {
+  std::string path = snapshotTestPath("source.csv");
+  {
+    std::ofstream file(path);
+    file << "LON,LAT\n1,2\n";
+  }
+  auto first = SourceFingerprint::ofFile(path);
+  ASSERT_TRUE(first.has_value());
+  EXPECT_EQ(first->file_size, 12u);
+  EXPECT_EQ(SourceFingerprint::ofFile(path), first);
+
+  {
+    std::ofstream file(path);
+    file << "LON,LAT\n1,3\n";
+  }
+  auto second = SourceFingerprint::ofFile(path);
+  ASSERT_TRUE(second.has_value());
+  EXPECT_FALSE(*second == *first);
+
+  EXPECT_FALSE(SourceFingerprint::ofFile(snapshotTestPath("missing.csv")));
+  std::remove(path.c_str());
+}
+
+// Test that indexes served from a snapshot answer like the originals
+TEST(IndexSnapshotTest, IndexesServeFromSnapshot) {
+  std::string path = snapshotTestPath("indexes");
+
+  ForwardIndex forward_index;
+  forward_index.insert(AddressRecord(-121.6, 36.7, 11, "1531",
+                                     "MCKINNON STREET", "C", "Salinas",
+                                     "93906", "MCKINNON STREET", "C",
+                                     "Salinas"));
+  forward_index.insert(AddressRecord(-121.7, 36.8, 22, "68",
+                                     "MCKINNON STREET", "", "Salinas", "93906",
+                                     "MCKINNON STREET", "", "Salinas"));
+  RadixTreeIndex radix_index;
+  radix_index.insert("MCKINNON STREET", 0);
+  radix_index.insert("MCKINNON STREET", 1);
+  radix_index.insert("MAIN STREET", 1);
+  radix_index.insert("SALINAS", 0);
+  // Enough IDs for several compressed postings blocks
+  for (DocId id = 2; id < 1000; id += 2) {
+    radix_index.insert("SALINAS", id);
+  }
+  radix_index.freeze();
+
+  SnapshotWriter writer;
+  forward_index.addToSnapshot(writer);
+  radix_index.addToSnapshot(writer);
+  ASSERT_TRUE(writer.write(path, kSource));
+
+  ForwardIndex loaded_forward;
+  RadixTreeIndex loaded_radix;
+  {
+    auto snapshot = IndexSnapshot::open(path, kSource);
+    ASSERT_NE(snapshot, nullptr);
+    ASSERT_TRUE(loaded_forward.loadFromSnapshot(snapshot));
+    ASSERT_TRUE(loaded_radix.loadFromSnapshot(snapshot));
+  }
+
+  // The indexes keep the mapping alive on their own
+  EXPECT_EQ(loaded_forward.getRecordCount(), 2u);
+  EXPECT_EQ(*loaded_forward.get(0), *forward_index.get(0));
+  EXPECT_EQ(*loaded_forward.get(1), *forward_index.get(1));
+  EXPECT_FALSE(loaded_forward.contains(2));
+  EXPECT_THROW(loaded_forward.insert(AddressRecord()), std::logic_error);
+
+  EXPECT_TRUE(loaded_radix.isFrozen());
+  EXPECT_EQ(loaded_radix.getTermCount(), radix_index.getTermCount());
+  for (const char* prefix : {"M", "MC", "MAIN", "S", "SALINAS", "X"}) {
+    EXPECT_EQ(loaded_radix.search(prefix), radix_index.search(prefix))
+        << "prefix: " << prefix;
+  }
+  std::vector<DocId> candidates = {0, 1, 500, 501, 998, 1000};
+  EXPECT_EQ(loaded_radix.filterSorted("SALINAS", candidates),
+            (std::vector<DocId>{0, 500, 998}));
+
+  std::remove(path.c_str());
+}
+
+// Test that an unfrozen index cannot be snapshotted
+TEST(IndexSnapshotTest, UnfrozenRadixIndexThrows) {
+  RadixTreeIndex radix_index;
+  radix_index.insert("MAIN", 1);
+  SnapshotWriter writer;
+  EXPECT_THROW(radix_index.addToSnapshot(writer), std::logic_error);
+}
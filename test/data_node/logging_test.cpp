@@ -0,0 +1,125 @@
+// Logging Unit Tests
+
+#include "data_node/logging.h"
+
+#include <gtest/gtest.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Capture std::cout for the lifetime of the object
+class CoutCapture {
+ public:
+  CoutCapture() : old_buffer_(std::cout.rdbuf(buffer_.rdbuf())) {}
+  ~CoutCapture() { std::cout.rdbuf(old_buffer_); }
+  std::string str() const { return buffer_.str(); }
+
+ private:
+  std::stringstream buffer_;
+  std::streambuf* old_buffer_;
+};
+
+// Test level name parsing
+TEST(LoggingTest, ParseLogLevel) {
+  EXPECT_EQ(parseLogLevel("DEBUG"), LogLevel::kDebug);
+  EXPECT_EQ(parseLogLevel("info"), LogLevel::kInfo);
+  EXPECT_EQ(parseLogLevel("Warn"), LogLevel::kWarning);
+  EXPECT_EQ(parseLogLevel("WARNING"), LogLevel::kWarning);
+  EXPECT_EQ(parseLogLevel("ERROR"), LogLevel::kError);
+  EXPECT_EQ(parseLogLevel("VERBOSE"), std::nullopt);
+  EXPECT_EQ(parseLogLevel(""), std::nullopt);
+}
+
+// Test that lines are prefixed with their level and component and that
+// lines below the log level are dropped
+TEST(LoggingTest, FormatsAndFiltersLines) {
+  std::string output;
+  {
+    CoutCapture capture;
+    LogLine(LogLevel::kInfo, "DataNode") << "Found " << 3 << " IDs";
+    LogLine(LogLevel::kInfo, nullptr) << "No component";
+    LogLine(LogLevel::kDebug, "DataNode") << "Hidden";
+
+    setLogLevel(LogLevel::kDebug);
+    LogLine(LogLevel::kDebug, "DataNode") << "Shown";
+    setLogLevel(LogLevel::kWarning);
+    LogLine(LogLevel::kInfo, "DataNode") << "Hidden too";
+    setLogLevel(LogLevel::kInfo);
+    output = capture.str();
+  }
+
+  EXPECT_EQ(output,
+            "[INFO] [DataNode] Found 3 IDs\n"
+            "[INFO] No component\n"
+            "[DEBUG] [DataNode] Shown\n");
+  EXPECT_TRUE(isLogEnabled(LogLevel::kError));
+  EXPECT_FALSE(isLogEnabled(LogLevel::kDebug));
+}
+
+// Test that lines logged from many threads at once are never interleaved.
+// Captured at the file descriptor, since std::cout may be shared between
+// threads but a redirected stream buffer may not
+TEST(LoggingTest, ConcurrentLinesStayWhole) {
+  testing::internal::CaptureStdout();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([t]() {
+      for (int i = 0; i < 100; ++i) {
+        LogLine(LogLevel::kInfo, "Test") << "thread " << t << " line " << i;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::cout.flush();
+  std::string output = testing::internal::GetCapturedStdout();
+
+  std::istringstream lines(output);
+  std::string line;
+  size_t count = 0;
+  while (std::getline(lines, line)) {
+    EXPECT_EQ(line.rfind("[INFO] [Test] thread ", 0), 0u) << line;
+    count++;
+  }
+  EXPECT_EQ(count, 400u);
+}
+
+// Test that per-query lines are written for one query in every n, and for
+// every query while debug lines are enabled
+TEST(LoggingTest, SamplesQueryLines) {
+  std::string output;
+  {
+    CoutCapture capture;
+    setQueryLogSampling(3);
+    for (int i = 0; i < 9; ++i) {
+      beginQueryLog();
+      LogLine(LogLevel::kInfo, nullptr, isQueryLogged()) << "query";
+      LogLine(LogLevel::kInfo, nullptr) << "always";
+    }
+    setLogLevel(LogLevel::kDebug);
+    EXPECT_TRUE(beginQueryLog());
+    EXPECT_TRUE(beginQueryLog());
+    setLogLevel(LogLevel::kInfo);
+    setQueryLogSampling(1);
+    output = capture.str();
+  }
+
+  size_t queries = 0;
+  size_t always = 0;
+  std::istringstream lines(output);
+  std::string line;
+  while (std::getline(lines, line)) {
+    queries += line == "[INFO] query" ? 1 : 0;
+    always += line == "[INFO] always" ? 1 : 0;
+  }
+  EXPECT_EQ(queries, 3u);
+  EXPECT_EQ(always, 9u);
+
+  // Sampling off: every query is logged again
+  EXPECT_TRUE(beginQueryLog());
+  EXPECT_TRUE(isQueryLogged());
+}
@@ -0,0 +1,109 @@
+// Metrics Unit Tests
+
+#include "data_node/metrics.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Test that every value falls in a bucket whose bounds hold it, within the
+// promised relative error
+TEST(MetricsTest, BucketsBoundValues) {
+  std::vector<uint64_t> values = {0, 1, 15, 16, 17, 31, 32, 1000, 123456789,
+                                  (uint64_t{1} << 40) - 1};
+  for (uint64_t v = 1; v < (uint64_t{1} << 40); v = v * 3 + 1) {
+    values.push_back(v);
+  }
+  for (uint64_t value : values) {
+    size_t bucket = LatencyHistogram::bucketOf(value);
+    ASSERT_LT(bucket, LatencyHistogram::kBucketCount);
+    uint64_t lower = LatencyHistogram::bucketLowerBound(bucket);
+    uint64_t upper = LatencyHistogram::bucketLowerBound(bucket + 1);
+    EXPECT_LE(lower, value) << value;
+    EXPECT_LT(value, upper) << value;
+    EXPECT_LE(static_cast<double>(upper - lower),
+              static_cast<double>(std::max<uint64_t>(lower, 16)) / 16.0)
+        << value;
+  }
+
+  // Values beyond the range land in the last bucket
+  EXPECT_EQ(LatencyHistogram::bucketOf(uint64_t{1} << 50),
+            LatencyHistogram::kBucketCount - 1);
+}
+
+// Test percentiles, mean and max of a known distribution
+TEST(MetricsTest, Percentiles) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.snapshot().percentile(0.5), 0u);
+
+  // 1..1000 microseconds
+  for (uint64_t i = 1; i <= 1000; ++i) {
+    histogram.record(std::chrono::microseconds(i));
+  }
+  LatencyHistogram::Snapshot snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count, 1000u);
+  EXPECT_EQ(snapshot.max, 1000000u);
+  EXPECT_DOUBLE_EQ(snapshot.mean(), 500500.0);
+
+  auto near = [](uint64_t actual, double expected) {
+    return static_cast<double>(actual) >= expected &&
+           static_cast<double>(actual) <= expected * 1.07;
+  };
+  EXPECT_TRUE(near(snapshot.percentile(0.5), 500000.0))
+      << snapshot.percentile(0.5);
+  EXPECT_TRUE(near(snapshot.percentile(0.99), 990000.0))
+      << snapshot.percentile(0.99);
+  EXPECT_EQ(snapshot.percentile(1.0), 1000000u);
+}
+
+// Test that concurrent recording loses nothing
+TEST(MetricsTest, ConcurrentRecording) {
+  LatencyHistogram histogram;
+  Counter counter;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&histogram, &counter]() {
+      for (int i = 0; i < 10000; ++i) {
+        histogram.recordNanos(100);
+        counter.add();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  LatencyHistogram::Snapshot snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count, 80000u);
+  EXPECT_EQ(snapshot.sum, 8000000u);
+  EXPECT_EQ(counter.value(), 80000u);
+}
+
+// Test the Prometheus text format of a summary and a counter
+TEST(MetricsTest, PrometheusFormat) {
+  LatencyHistogram histogram;
+  histogram.record(std::chrono::milliseconds(2));
+
+  std::string out;
+  appendPrometheusHeader(out, "stage_latency_seconds", "summary",
+                         "Latency of each stage");
+  appendPrometheusSummary(out, "stage_latency_seconds", "stage=\"parse\"",
+                          histogram.snapshot());
+  appendPrometheusHeader(out, "requests_total", "counter", "Requests");
+  appendPrometheusSample(out, "requests_total", "", 42);
+
+  EXPECT_EQ(out,
+            "# HELP stage_latency_seconds Latency of each stage\n"
+            "# TYPE stage_latency_seconds summary\n"
+            "stage_latency_seconds{stage=\"parse\",quantile=\"0.5\"} 0.002\n"
+            "stage_latency_seconds{stage=\"parse\",quantile=\"0.9\"} 0.002\n"
+            "stage_latency_seconds{stage=\"parse\",quantile=\"0.99\"} 0.002\n"
+            "stage_latency_seconds{stage=\"parse\",quantile=\"0.999\"} 0.002\n"
+            "stage_latency_seconds_sum{stage=\"parse\"} 0.002\n"
+            "stage_latency_seconds_count{stage=\"parse\"} 1\n"
+            "# HELP requests_total Requests\n"
+            "# TYPE requests_total counter\n"
+            "requests_total 42\n");
+}
@@ -0,0 +1,85 @@
+// Posting Intersection Unit Tests
+
+#include "data_node/posting_intersection.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <vector>
+
+static std::vector<DocId> referenceIntersection(const std::vector<DocId>& a,
+                                                const std::vector<DocId>& b) {
+  std::vector<DocId> result;
+  std::set_intersection(a.begin(), a.end(), b.begin(), b.end(),
+                        std::back_inserter(result));
+  return result;
+}
+
+// Test galloping to the first ID at or above a target
+TEST(PostingIntersectionTest, GallopTo) {
+  std::vector<DocId> ids = {2, 4, 6, 8, 10, 12, 14, 16, 18, 20};
+  ArrayView<DocId> view(ids);
+
+  EXPECT_EQ(gallopTo(view, 0, 1), 0u);
+  EXPECT_EQ(gallopTo(view, 0, 2), 0u);
+  EXPECT_EQ(gallopTo(view, 0, 3), 1u);
+  EXPECT_EQ(gallopTo(view, 0, 15), 7u);
+  EXPECT_EQ(gallopTo(view, 0, 20), 9u);
+  EXPECT_EQ(gallopTo(view, 0, 21), ids.size());
+  EXPECT_EQ(gallopTo(view, 5, 3), 5u);  // Never moves backwards
+  EXPECT_EQ(gallopTo(view, ids.size(), 3), ids.size());
+}
+
+// Test both the merge and galloping paths on small inputs
+TEST(PostingIntersectionTest, IntersectSorted) {
+  std::vector<DocId> out = {99};
+
+  intersectSorted(ArrayView<DocId>(), ArrayView<DocId>(), out);
+  EXPECT_TRUE(out.empty());
+
+  std::vector<DocId> a = {1, 3, 5, 7};
+  std::vector<DocId> b = {3, 4, 5, 6, 7, 8};
+  intersectSorted(ArrayView<DocId>(a), ArrayView<DocId>(b), out);
+  EXPECT_EQ(out, (std::vector<DocId>{3, 5, 7}));
+
+  std::vector<DocId> wide;
+  for (DocId id = 0; id < 1000; ++id) {
+    wide.push_back(id * 3);
+  }
+  std::vector<DocId> narrow = {0, 4, 9, 2997, 3000};
+  intersectSorted(ArrayView<DocId>(narrow), ArrayView<DocId>(wide), out);
+  EXPECT_EQ(out, (std::vector<DocId>{0, 9, 2997}));
+
+  // Argument order does not matter
+  intersectSorted(ArrayView<DocId>(wide), ArrayView<DocId>(narrow), out);
+  EXPECT_EQ(out, (std::vector<DocId>{0, 9, 2997}));
+}
+
+// Test random lists of similar and skewed sizes against std::set_intersection
+TEST(PostingIntersectionTest, MatchesSetIntersection) {
+  std::mt19937 rng(42);
+  for (int round = 0; round < 200; ++round) {
+    std::uniform_int_distribution<DocId> id_dist(0, 500 + round * 10);
+    size_t a_size = rng() % 40;
+    size_t b_size = round % 2 == 0 ? rng() % 40 : rng() % 2000;
+
+    std::vector<DocId> a;
+    std::vector<DocId> b;
+    for (size_t i = 0; i < a_size; ++i) {
+      a.push_back(id_dist(rng));
+    }
+    for (size_t i = 0; i < b_size; ++i) {
+      b.push_back(id_dist(rng));
+    }
+    for (auto* ids : {&a, &b}) {
+      std::sort(ids->begin(), ids->end());
+      ids->erase(std::unique(ids->begin(), ids->end()), ids->end());
+    }
+
+    std::vector<DocId> out;
+    intersectSorted(ArrayView<DocId>(a), ArrayView<DocId>(b), out);
+    EXPECT_EQ(out, referenceIntersection(a, b)) << "round " << round;
+  }
+}
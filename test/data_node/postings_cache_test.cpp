@@ -0,0 +1,105 @@
+// Postings Cache Unit Tests
+
+#include "data_node/postings_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+// Build an ascending list of count IDs spaced step apart
+static std::vector<DocId> makeIds(size_t count, DocId step) {
+  std::vector<DocId> ids;
+  for (size_t i = 0; i < count; ++i) {
+    ids.push_back(static_cast<DocId>(i * step));
+  }
+  return ids;
+}
+
+// Test that compression round-trips small and large gaps
+TEST(PostingsCacheTest, EncodeDecodeRoundTrip) {
+  std::vector<DocId> ids = {0, 1, 127, 128, 16383, 16384, 2097152,
+                            UINT32_MAX - 1, UINT32_MAX};
+  std::vector<uint8_t> encoded = PostingsCache::encode(ids);
+
+  std::vector<DocId> decoded = {42};
+  PostingsCache::decode(encoded, ids.size(), decoded);
+  EXPECT_EQ(decoded, ids);
+
+  // Dense lists take about one byte per ID
+  std::vector<DocId> dense = makeIds(1000, 3);
+  EXPECT_LE(PostingsCache::encode(dense).size(), dense.size());
+
+  PostingsCache::decode(PostingsCache::encode({}), 0, decoded);
+  EXPECT_TRUE(decoded.empty());
+}
+
+// Test that only repeatedly requested, long lists are admitted
+TEST(PostingsCacheTest, AdmitsHotLongLists) {
+  PostingsCache cache(1 << 20);
+  std::vector<DocId> ids = makeIds(PostingsCache::kMinIds, 7);
+  std::vector<DocId> short_ids = makeIds(PostingsCache::kMinIds - 1, 7);
+  std::vector<DocId> result;
+
+  // First request: not hot yet
+  EXPECT_FALSE(cache.lookup(1, result));
+  cache.offer(1, ids);
+  EXPECT_FALSE(cache.lookup(1, result));
+  cache.offer(1, ids);
+  EXPECT_TRUE(cache.lookup(1, result));
+  EXPECT_EQ(result, ids);
+
+  // Hot but too short to be worth caching
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_FALSE(cache.lookup(2, result));
+    cache.offer(2, short_ids);
+  }
+
+  PostingsCache::Stats stats = cache.getStats();
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.misses, 5u);
+  EXPECT_EQ(stats.admissions, 1u);
+  EXPECT_EQ(stats.entries, 1u);
+  EXPECT_GT(stats.bytes, 0u);
+  EXPECT_EQ(stats.max_bytes, 1u << 20);
+}
+
+// Test that the least recently used lists are evicted to stay in budget
+TEST(PostingsCacheTest, EvictsLeastRecentlyUsed) {
+  std::vector<DocId> ids = makeIds(1000, 1);
+  std::vector<DocId> result;
+
+  // Find the charge of one entry, then size a cache for two
+  PostingsCache probe(1 << 20);
+  probe.lookup(0, result);
+  probe.lookup(0, result);
+  probe.offer(0, ids);
+  size_t charge = probe.getStats().bytes;
+  ASSERT_GT(charge, 0u);
+
+  PostingsCache cache(2 * charge);
+  auto admit = [&](uint32_t node) {
+    cache.lookup(node, result);
+    cache.lookup(node, result);
+    cache.offer(node, ids);
+  };
+  admit(1);
+  admit(2);
+  EXPECT_TRUE(cache.lookup(1, result));  // 2 is now least recently used
+  admit(3);
+
+  EXPECT_TRUE(cache.lookup(1, result));
+  EXPECT_FALSE(cache.lookup(2, result));
+  EXPECT_TRUE(cache.lookup(3, result));
+
+  PostingsCache::Stats stats = cache.getStats();
+  EXPECT_EQ(stats.evictions, 1u);
+  EXPECT_EQ(stats.entries, 2u);
+  EXPECT_LE(stats.bytes, stats.max_bytes);
+
+  // A list larger than the whole budget is never admitted
+  PostingsCache tiny(charge / 2);
+  tiny.lookup(1, result);
+  tiny.lookup(1, result);
+  tiny.offer(1, ids);
+  EXPECT_EQ(tiny.getStats().entries, 0u);
+}
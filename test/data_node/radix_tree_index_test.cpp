@@ -4,6 +4,12 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
 // Basic functionality test to verify the implementation works
 TEST(RadixTreeIndexTest, BasicInsertAndSearch) {
   RadixTreeIndex index;
@@ -73,22 +79,22 @@ TEST(RadixTreeIndexTest, InsertAndSearchSingleTerm) {
   RadixTreeIndex index;
 
   // Insert a single term with one ID
-  index.insert("MAIN", 0x1234567890ABCDEF);
+  index.insert("MAIN", 42);
 
   // Search for the exact term
   auto results = index.search("MAIN");
   ASSERT_EQ(results.size(), 1);
-  EXPECT_EQ(results[0], 0x1234567890ABCDEF);
+  EXPECT_EQ(results[0], 42);
 
   // Search for a prefix of the term
   results = index.search("MA");
   ASSERT_EQ(results.size(), 1);
-  EXPECT_EQ(results[0], 0x1234567890ABCDEF);
+  EXPECT_EQ(results[0], 42);
 
   // Search for the full term as prefix
   results = index.search("MAIN");
   ASSERT_EQ(results.size(), 1);
-  EXPECT_EQ(results[0], 0x1234567890ABCDEF);
+  EXPECT_EQ(results[0], 42);
 
   // Search for non-matching prefix
   results = index.search("SIDE");
@@ -101,32 +107,32 @@ TEST(RadixTreeIndexTest, PrefixSearchMultipleMatches) {
   RadixTreeIndex index;
 
   // Insert multiple terms that share a common prefix
-  index.insert("MAIN", 0x1111111111111111);
-  index.insert("MAPLE", 0x2222222222222222);
-  index.insert("MARKET", 0x3333333333333333);
-  index.insert("MADISON", 0x4444444444444444);
-  index.insert("BROAD", 0x5555555555555555);  // Different prefix
+  index.insert("MAIN", 11);
+  index.insert("MAPLE", 22);
+  index.insert("MARKET", 33);
+  index.insert("MADISON", 44);
+  index.insert("BROAD", 55);  // Different prefix
 
   // Search for common prefix "MA" - should match MAIN, MAPLE, MARKET, MADISON
   auto results = index.search("MA");
   EXPECT_EQ(results.size(), 4);
   // Results should contain all four IDs
-  EXPECT_NE(std::find(results.begin(), results.end(), 0x1111111111111111), results.end());
-  EXPECT_NE(std::find(results.begin(), results.end(), 0x2222222222222222), results.end());
-  EXPECT_NE(std::find(results.begin(), results.end(), 0x3333333333333333), results.end());
-  EXPECT_NE(std::find(results.begin(), results.end(), 0x4444444444444444), results.end());
+  EXPECT_NE(std::find(results.begin(), results.end(), 11), results.end());
+  EXPECT_NE(std::find(results.begin(), results.end(), 22), results.end());
+  EXPECT_NE(std::find(results.begin(), results.end(), 33), results.end());
+  EXPECT_NE(std::find(results.begin(), results.end(), 44), results.end());
   // Should not contain BROAD
-  EXPECT_EQ(std::find(results.begin(), results.end(), 0x5555555555555555), results.end());
+  EXPECT_EQ(std::find(results.begin(), results.end(), 55), results.end());
 
   // Search for more specific prefix "MAR" - should match MARKET only
   results = index.search("MAR");
   EXPECT_EQ(results.size(), 1);
-  EXPECT_EQ(results[0], 0x3333333333333333);
+  EXPECT_EQ(results[0], 33);
 
   // Search for prefix "B" - should match BROAD only
   results = index.search("B");
   EXPECT_EQ(results.size(), 1);
-  EXPECT_EQ(results[0], 0x5555555555555555);
+  EXPECT_EQ(results[0], 55);
 
   // Search for prefix "M" - should match all MA* terms
   results = index.search("M");
@@ -139,30 +145,30 @@ TEST(RadixTreeIndexTest, DuplicateTermHandling) {
   RadixTreeIndex index;
 
   // Insert the same term with multiple different IDs
-  index.insert("STREET", 0xAAAAAAAAAAAAAAAA);
-  index.insert("STREET", 0xBBBBBBBBBBBBBBBB);
-  index.insert("STREET", 0xCCCCCCCCCCCCCCCC);
+  index.insert("STREET", 10);
+  index.insert("STREET", 20);
+  index.insert("STREET", 30);
 
   // Search should return all IDs associated with the term
   auto results = index.search("STREET");
   EXPECT_EQ(results.size(), 3);
-  EXPECT_NE(std::find(results.begin(), results.end(), 0xAAAAAAAAAAAAAAAA), results.end());
-  EXPECT_NE(std::find(results.begin(), results.end(), 0xBBBBBBBBBBBBBBBB), results.end());
-  EXPECT_NE(std::find(results.begin(), results.end(), 0xCCCCCCCCCCCCCCCC), results.end());
+  EXPECT_NE(std::find(results.begin(), results.end(), 10), results.end());
+  EXPECT_NE(std::find(results.begin(), results.end(), 20), results.end());
+  EXPECT_NE(std::find(results.begin(), results.end(), 30), results.end());
 
   // Prefix search should also return all IDs
   results = index.search("STR");
   EXPECT_EQ(results.size(), 3);
 
   // Insert the same term-ID pair again (duplicate)
-  index.insert("STREET", 0xAAAAAAAAAAAAAAAA);
+  index.insert("STREET", 10);
 
   // Should still have 3 unique IDs (no duplicate IDs)
   results = index.search("STREET");
   EXPECT_EQ(results.size(), 3);
 
   // Add another unique ID
-  index.insert("STREET", 0xDDDDDDDDDDDDDDDD);
+  index.insert("STREET", 40);
   results = index.search("STREET");
   EXPECT_EQ(results.size(), 4);
 }
@@ -173,11 +179,11 @@ TEST(RadixTreeIndexTest, DuplicateTermsWithPrefixSearch) {
   RadixTreeIndex index;
 
   // Insert multiple terms, some duplicates
-  index.insert("PARK", 0x0000000000000001);
-  index.insert("PARK", 0x0000000000000002);
-  index.insert("PARKER", 0x0000000000000003);
-  index.insert("PARKING", 0x0000000000000004);
-  index.insert("PARK", 0x0000000000000005);
+  index.insert("PARK", 1);
+  index.insert("PARK", 2);
+  index.insert("PARKER", 3);
+  index.insert("PARKING", 4);
+  index.insert("PARK", 5);
 
   // Search for exact term "PARK" - should return 3 IDs
   auto results = index.search("PARK");
@@ -186,14 +192,528 @@ TEST(RadixTreeIndexTest, DuplicateTermsWithPrefixSearch) {
   // Search for "PARKER" - should return 1 ID
   results = index.search("PARKER");
   EXPECT_EQ(results.size(), 1);
-  EXPECT_EQ(results[0], 0x0000000000000003);
+  EXPECT_EQ(results[0], 3);
 
   // Search for "PARKING" - should return 1 ID
   results = index.search("PARKING");
   EXPECT_EQ(results.size(), 1);
-  EXPECT_EQ(results[0], 0x0000000000000004);
+  EXPECT_EQ(results[0], 4);
 
   // Search for prefix "PAR" - should return all 5 IDs
   results = index.search("PAR");
   EXPECT_EQ(results.size(), 5);
 }
+
+// Helper to build an index with overlapping terms for layout comparisons
+static void populateLayoutTestIndex(RadixTreeIndex& index) {
+  index.insert("PARK", 5);
+  index.insert("PARK", 2);
+  index.insert("PARKER", 3);
+  index.insert("PARKING", 4);
+  index.insert("PARIS", 1);
+  index.insert("MAIN", 7);
+  index.insert("MAPLE", 6);
+  index.insert("MAIN", 3);
+}
+
+// Test that the flattened layout returns exactly the same results, in the
+// same order, as the pointer-based layout
+TEST(RadixTreeIndexTest, FrozenLayoutMatchesPointerLayout) {
+  RadixTreeIndex pointer_index;
+  RadixTreeIndex flat_index;
+  populateLayoutTestIndex(pointer_index);
+  populateLayoutTestIndex(flat_index);
+
+  flat_index.freeze();
+  EXPECT_FALSE(pointer_index.isFrozen());
+  EXPECT_TRUE(flat_index.isFrozen());
+
+  for (const char* prefix :
+       {"P", "PA", "PAR", "PARK", "PARKE", "PARKER", "PARKING", "PARKINGS",
+        "PARI", "M", "MA", "MAI", "MAIN", "MAP", "X", "PX", "MAINS"}) {
+    EXPECT_EQ(flat_index.search(prefix), pointer_index.search(prefix))
+        << "prefix: " << prefix;
+  }
+  EXPECT_EQ(flat_index.getTermCount(), pointer_index.getTermCount());
+}
+
+// Test that a frozen index rejects further inserts
+TEST(RadixTreeIndexTest, InsertAfterFreezeThrows) {
+  RadixTreeIndex index;
+  index.insert("STREET", 1);
+  index.freeze();
+
+  EXPECT_THROW(index.insert("STREET", 2), std::logic_error);
+  EXPECT_EQ(index.search("STREET").size(), 1);
+}
+
+// Test freezing an empty index and freezing twice
+TEST(RadixTreeIndexTest, FreezeEmptyAndIdempotent) {
+  RadixTreeIndex index;
+  index.freeze();
+  EXPECT_TRUE(index.isFrozen());
+  EXPECT_EQ(index.search("A").size(), 0);
+
+  index.freeze();
+  EXPECT_TRUE(index.isFrozen());
+  EXPECT_GT(index.getMemoryUsage(), 0);
+}
+
+// Test that the flattened layout uses less memory than the pointer layout
+TEST(RadixTreeIndexTest, FrozenLayoutUsesLessMemory) {
+  RadixTreeIndex index;
+  populateLayoutTestIndex(index);
+  size_t pointer_usage = index.getMemoryUsage();
+
+  index.freeze();
+  EXPECT_LT(index.getMemoryUsage(), pointer_usage);
+}
+
+// Test that search stops once max_results IDs have been collected, and
+// returns the same leading IDs as an unlimited search
+TEST(RadixTreeIndexTest, SearchWithMaxResultsStopsEarly) {
+  for (bool freeze : {false, true}) {
+    RadixTreeIndex index;
+    populateLayoutTestIndex(index);
+    if (freeze) {
+      index.freeze();
+    }
+
+    std::vector<DocId> all = index.search("PA");
+    ASSERT_EQ(all.size(), 5);
+
+    std::vector<DocId> limited = index.search("PA", 3);
+    ASSERT_EQ(limited.size(), 3);
+    EXPECT_TRUE(std::equal(limited.begin(), limited.end(), all.begin()));
+
+    EXPECT_EQ(index.search("PA", 0).size(), 0);
+    EXPECT_EQ(index.search("PA", 100), all);
+  }
+}
+
+// Test that IDs shared by many terms in a broad subtree come back once each
+TEST(RadixTreeIndexTest, BroadPrefixDeduplicatesSharedIds) {
+  for (bool freeze : {false, true}) {
+    RadixTreeIndex index;
+    const size_t kRecords = 2000;
+    for (DocId id = 0; id < kRecords; ++id) {
+      // Each ID appears under several keys sharing the "S" prefix
+      index.insert("SALINAS", id);
+      index.insert("SALINAS\x01" + std::to_string(id % 97), id);
+      index.insert("SEASIDE", id);
+    }
+    if (freeze) {
+      index.freeze();
+    }
+
+    std::vector<DocId> results = index.search("S");
+    ASSERT_EQ(results.size(), kRecords);
+    std::vector<DocId> sorted = results;
+    std::sort(sorted.begin(), sorted.end());
+    EXPECT_EQ(std::adjacent_find(sorted.begin(), sorted.end()), sorted.end());
+
+    // Early exit returns exactly the requested number of unique IDs
+    EXPECT_EQ(index.search("S", 5).size(), 5);
+  }
+}
+
+// Test that merging indexes with disjoint first characters gives the same
+// results as inserting everything into one index
+TEST(RadixTreeIndexTest, MergeDisjointMatchesSingleIndex) {
+  RadixTreeIndex single_index;
+  populateLayoutTestIndex(single_index);
+  single_index.insert("ZEBRA", 8);
+
+  RadixTreeIndex p_index;
+  p_index.insert("PARK", 5);
+  p_index.insert("PARK", 2);
+  p_index.insert("PARKER", 3);
+  p_index.insert("PARKING", 4);
+  p_index.insert("PARIS", 1);
+  RadixTreeIndex mz_index;
+  mz_index.insert("MAIN", 7);
+  mz_index.insert("MAPLE", 6);
+  mz_index.insert("MAIN", 3);
+  mz_index.insert("ZEBRA", 8);
+
+  RadixTreeIndex merged_index;
+  merged_index.mergeDisjoint(std::move(mz_index));
+  merged_index.mergeDisjoint(std::move(p_index));
+  EXPECT_EQ(merged_index.getTermCount(), single_index.getTermCount());
+  EXPECT_EQ(mz_index.getTermCount(), 0);
+
+  merged_index.freeze();
+  single_index.freeze();
+  for (const char* prefix : {"P", "PARK", "M", "MAIN", "Z", "X"}) {
+    EXPECT_EQ(merged_index.search(prefix), single_index.search(prefix))
+        << "prefix: " << prefix;
+  }
+}
+
+// Test that merging indexes sharing a first character is rejected
+TEST(RadixTreeIndexTest, MergeOverlappingThrows) {
+  RadixTreeIndex index;
+  index.insert("PARK", 1);
+  RadixTreeIndex other;
+  other.insert("MAIN", 2);
+  other.insert("PARIS", 3);
+
+  EXPECT_THROW(index.mergeDisjoint(std::move(other)), std::logic_error);
+  EXPECT_EQ(index.search("MAIN").size(), 0);
+}
+
+// Test sorted search results and cardinality estimates in both layouts
+TEST(RadixTreeIndexTest, SearchSortedAndEstimateCount) {
+  RadixTreeIndex index;
+  index.insert("STREET", 9);
+  index.insert("STREET", 2);
+  index.insert("STREAM", 5);
+  index.insert("STRONG", 2);
+  index.insert("AVENUE", 7);
+
+  for (bool frozen : {false, true}) {
+    if (frozen) {
+      index.freeze();
+    }
+    EXPECT_EQ(index.searchSorted("STR"), (std::vector<DocId>{2, 5, 9}));
+    EXPECT_EQ(index.searchSorted("STREE"), (std::vector<DocId>{2, 9}));
+    EXPECT_TRUE(index.searchSorted("STRX").empty());
+
+    // Estimates count postings, so ID 2 counts once per matching term
+    EXPECT_EQ(index.estimateCount("S"), 4u);
+    EXPECT_EQ(index.estimateCount("STRE"), 3u);
+    EXPECT_EQ(index.estimateCount("STREAM"), 1u);
+    EXPECT_EQ(index.estimateCount("AVENUE"), 1u);
+    EXPECT_EQ(index.estimateCount("STREAMS"), 0u);
+    EXPECT_EQ(index.estimateCount("B"), 0u);
+    EXPECT_EQ(index.estimateCount(""), 0u);
+  }
+}
+
+// Test node-level lookup: prefixes that end on the same edge share a node
+TEST(RadixTreeIndexTest, FindPrefixNodeAndCollectSorted) {
+  RadixTreeIndex index;
+  index.insert("STREET", 9);
+  index.insert("STREET", 2);
+  index.insert("STREAM", 5);
+  index.insert("STRONG", 2);
+  EXPECT_EQ(index.findPrefixNode("STR"), RadixTreeIndex::kNoNode);
+
+  index.freeze();
+  size_t node = index.findPrefixNode("STREE");
+  ASSERT_NE(node, RadixTreeIndex::kNoNode);
+  EXPECT_EQ(index.findPrefixNode("STREET"), node);
+  EXPECT_NE(index.findPrefixNode("STRE"), node);
+  EXPECT_EQ(index.collectSorted(node), (std::vector<DocId>{2, 9}));
+  EXPECT_EQ(index.collectSorted(index.findPrefixNode("S")),
+            index.searchSorted("S"));
+
+  EXPECT_EQ(index.findPrefixNode("STRX"), RadixTreeIndex::kNoNode);
+  EXPECT_EQ(index.findPrefixNode(""), RadixTreeIndex::kNoNode);
+}
+
+// Test that one walk finds the longest matching prefix of a key, as
+// searching each prefix in turn would
+TEST(RadixTreeIndexTest, SearchLongestPrefix) {
+  RadixTreeIndex pointer_index;
+  RadixTreeIndex flat_index;
+  for (RadixTreeIndex* index : {&pointer_index, &flat_index}) {
+    index->insert("1|MAIN ST|SEATTLE|98101", 1);
+    index->insert("1|MAIN ST|SEATTLE", 1);
+    index->insert("1|MAIN ST|SEATTLE", 2);
+    index->insert("1|MAIN ST", 2);
+    index->insert("1|MAIN ST", 3);
+    index->insert("1|MAIN SQ", 4);
+  }
+  flat_index.freeze();
+
+  const std::vector<size_t> lengths = {9, 17, 23};
+  for (RadixTreeIndex* index : {&pointer_index, &flat_index}) {
+    for (std::string key :
+         {"1|MAIN ST|SEATTLE|98101", "1|MAIN ST|SEATTLE|98102",
+          "1|MAIN ST|SEATTLX|98101", "1|MAIN SX|SEATTLE|98101",
+          "2|MAIN ST|SEATTLE|98101"}) {
+      size_t matched_length;
+      std::vector<DocId> expected;
+      size_t expected_length = 0;
+      for (size_t i = lengths.size(); i > 0 && expected.empty(); --i) {
+        expected = index->search(key.substr(0, lengths[i - 1]));
+        expected_length = expected.empty() ? 0 : lengths[i - 1];
+      }
+      EXPECT_EQ(index->searchLongestPrefix(key, ArrayView<size_t>(lengths),
+                                           &matched_length),
+                expected)
+          << key;
+      EXPECT_EQ(matched_length, expected_length) << key;
+    }
+  }
+
+  size_t matched_length;
+  EXPECT_EQ(flat_index.searchLongestPrefix("1|MAIN ST|SEATTLE|98102",
+                                           ArrayView<size_t>(lengths),
+                                           &matched_length),
+            (std::vector<DocId>{1, 2}));
+  EXPECT_EQ(matched_length, 17u);
+  EXPECT_TRUE(flat_index.searchLongestPrefix("1|MAIN ST", {}).empty());
+}
+
+// Test that postings spanning several compressed blocks are collected and
+// filtered like the pointer layout's
+TEST(RadixTreeIndexTest, CompressedPostingsSpanBlocks) {
+  RadixTreeIndex pointer_index;
+  RadixTreeIndex flat_index;
+  size_t id_count = 0;
+  for (RadixTreeIndex* index : {&pointer_index, &flat_index}) {
+    id_count = 0;
+    for (DocId id = 0; id < 3000; id += 3) {
+      index->insert("SALINAS", id);
+      id_count++;
+    }
+    for (DocId id = 1; id < 3000; id += 7) {
+      index->insert("SALINAS CITY", id);
+      id_count++;
+    }
+    index->insert("SAN", 70000);
+    index->insert("SAN", 5);
+    id_count += 2;
+  }
+  flat_index.freeze();
+
+  for (const char* prefix : {"S", "SA", "SALINAS", "SALINAS C", "SAN", "X"}) {
+    EXPECT_EQ(flat_index.search(prefix), pointer_index.search(prefix))
+        << "prefix: " << prefix;
+    EXPECT_EQ(flat_index.searchSorted(prefix),
+              pointer_index.searchSorted(prefix))
+        << "prefix: " << prefix;
+  }
+
+  std::vector<std::vector<DocId>> candidate_sets = {
+      {0, 3, 383, 384, 385, 386, 2997, 2999, 70000},
+      {1, 2, 4},
+      {128 * 3, 129 * 3, 500000},
+      {}};
+  std::vector<DocId> every_id;
+  for (DocId id = 0; id < 3100; ++id) {
+    every_id.push_back(id);
+  }
+  candidate_sets.push_back(every_id);
+  for (const auto& candidates : candidate_sets) {
+    for (const char* prefix : {"S", "SALINAS", "SALINAS C", "SAN", "X"}) {
+      std::vector<DocId> matches = pointer_index.searchSorted(prefix);
+      std::vector<DocId> expected;
+      std::set_intersection(candidates.begin(), candidates.end(),
+                            matches.begin(), matches.end(),
+                            std::back_inserter(expected));
+      EXPECT_EQ(flat_index.filterSorted(prefix, candidates), expected)
+          << "prefix: " << prefix;
+      EXPECT_EQ(pointer_index.filterSorted(prefix, candidates), expected)
+          << "prefix: " << prefix;
+    }
+  }
+
+  // Dense gaps take a byte or two instead of a whole DocId
+  EXPECT_LT(flat_index.getMemoryUsage(), id_count * sizeof(DocId));
+}
+
+// Test that a bulk build from sorted postings gives the same tree as
+// inserting each posting, with duplicates and empty terms skipped
+TEST(RadixTreeIndexTest, BuildFromMatchesInsert) {
+  RadixTreeIndex inserted_index;
+  populateLayoutTestIndex(inserted_index);
+
+  std::vector<RadixTreeIndex::TermPosting> postings = {
+      {"PARK", 5},   {"PARK", 2}, {"PARKER", 3}, {"PARKING", 4},
+      {"PARIS", 1},  {"MAIN", 7}, {"MAPLE", 6},  {"MAIN", 3},
+      {"MAIN", 7},   {"", 9}};
+  std::sort(postings.begin(), postings.end(), RadixTreeIndex::postingLess);
+  RadixTreeIndex built_index;
+  built_index.buildFrom(postings);
+  EXPECT_EQ(built_index.getTermCount(), inserted_index.getTermCount());
+
+  const char* prefixes[] = {"P",      "PA",     "PAR",     "PARK",
+                            "PARKE",  "PARKER", "PARKING", "PARI",
+                            "M",      "MA",     "MAIN",    "MAP",
+                            "X",      "PX",     "MAINS"};
+  for (const char* prefix : prefixes) {
+    EXPECT_EQ(built_index.search(prefix), inserted_index.search(prefix))
+        << "prefix: " << prefix;
+  }
+
+  built_index.freeze();
+  inserted_index.freeze();
+  for (const char* prefix : prefixes) {
+    EXPECT_EQ(built_index.search(prefix), inserted_index.search(prefix))
+        << "prefix: " << prefix;
+  }
+}
+
+// Test that a bulk build splits edges at every divergence point, including
+// terms that are prefixes of later terms
+TEST(RadixTreeIndexTest, BuildFromSplitsEdges) {
+  std::vector<std::string> terms = {"A",    "AB",   "ABC", "ABD", "ABDE",
+                                    "ACAB", "ACAC", "B",   "BA",  "BB"};
+  RadixTreeIndex inserted_index;
+  std::vector<RadixTreeIndex::TermPosting> postings;
+  for (size_t i = 0; i < terms.size(); ++i) {
+    // Insert in reverse so the two builds see different orders
+    inserted_index.insert(terms[terms.size() - 1 - i],
+                          static_cast<DocId>(terms.size() - 1 - i));
+    postings.push_back({terms[i], static_cast<DocId>(i)});
+  }
+  RadixTreeIndex built_index;
+  built_index.buildFrom(postings);
+
+  for (const char* prefix : {"A", "AB", "ABD", "ABDE", "AC", "ACA", "ACAB",
+                             "B", "BA", "BC"}) {
+    EXPECT_EQ(built_index.search(prefix), inserted_index.search(prefix))
+        << "prefix: " << prefix;
+  }
+}
+
+// Test that buildFrom rejects unsorted postings and frozen indexes
+TEST(RadixTreeIndexTest, BuildFromRejectsInvalidInput) {
+  RadixTreeIndex index;
+  EXPECT_THROW(index.buildFrom({{"PARK", 2}, {"PARK", 1}}),
+               std::invalid_argument);
+  EXPECT_THROW(index.buildFrom({{"PARK", 1}, {"MAIN", 2}}),
+               std::invalid_argument);
+
+  index.buildFrom({{"MAIN", 1}});
+  index.freeze();
+  EXPECT_THROW(index.buildFrom({{"MAIN", 2}}), std::logic_error);
+}
+
+// Test that out-of-order inserts still keep each node's IDs sorted
+TEST(RadixTreeIndexTest, InsertKeepsIdsSortedAndUnique) {
+  RadixTreeIndex index;
+  for (DocId id : {9, 2, 7, 2, 11, 0, 9}) {
+    index.insert("STREET", id);
+  }
+  std::vector<DocId> expected = {0, 2, 7, 9, 11};
+  EXPECT_EQ(index.search("STREET"), expected);
+}
+
+// Test that fuzzy search finds terms within the allowed edits, each ID
+// once with its fewest edits, in both layouts
+TEST(RadixTreeIndexTest, SearchFuzzy) {
+  RadixTreeIndex index;
+  index.insert("MCKINNON", 1);
+  index.insert("MCKINON", 2);
+  index.insert("MACKINNON", 3);
+  index.insert("MCKINLEY", 4);
+  index.insert("MAIN", 5);
+  index.insert("MCKINNON", 6);
+  index.insert("MAIN", 6);
+
+  auto as_pairs = [](const std::vector<RadixTreeIndex::FuzzyMatch>& matches) {
+    std::vector<std::pair<DocId, int>> pairs;
+    for (const auto& match : matches) {
+      pairs.emplace_back(match.id, match.edits);
+    }
+    return pairs;
+  };
+  using Pairs = std::vector<std::pair<DocId, int>>;
+
+  for (bool frozen : {false, true}) {
+    if (frozen) {
+      index.freeze();
+    }
+    // Prefix semantics: MCKINON is one edit away from a prefix of MCKINNON
+    // and two away from prefixes of MACKINNON and MCKINLEY
+    EXPECT_EQ(as_pairs(index.searchFuzzy("MCKINON", 1)),
+              (Pairs{{1, 1}, {2, 0}, {6, 1}}))
+        << frozen;
+    EXPECT_EQ(as_pairs(index.searchFuzzy("MCKINON", 2)),
+              (Pairs{{1, 1}, {2, 0}, {3, 2}, {4, 2}, {6, 1}}))
+        << frozen;
+
+    // No edits is a plain prefix search
+    EXPECT_EQ(as_pairs(index.searchFuzzy("MCKIN", 0)),
+              (Pairs{{1, 0}, {2, 0}, {4, 0}, {6, 0}}))
+        << frozen;
+
+    // Edits are capped below the prefix length, so a short prefix does not
+    // match every term
+    EXPECT_EQ(as_pairs(index.searchFuzzy("MA", 2)),
+              as_pairs(index.searchFuzzy("MA", 1)))
+        << frozen;
+    EXPECT_EQ(as_pairs(index.searchFuzzy("XA", 2)),
+              (Pairs{{3, 1}, {5, 1}, {6, 1}}))
+        << frozen;
+    EXPECT_TRUE(index.searchFuzzy("", 2).empty());
+    EXPECT_TRUE(index.searchFuzzy("XYZZY", 2).empty());
+  }
+}
+
+// Test fuzzy search against a brute-force edit distance over every prefix
+// of every term
+TEST(RadixTreeIndexTest, SearchFuzzyMatchesBruteForce) {
+  auto distance = [](const std::string& a, const std::string& b) {
+    std::vector<size_t> row(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) {
+      row[j] = j;
+    }
+    for (size_t i = 1; i <= a.size(); ++i) {
+      size_t diagonal = row[0];
+      row[0] = i;
+      for (size_t j = 1; j <= b.size(); ++j) {
+        size_t above = row[j];
+        row[j] = std::min({row[j] + 1, row[j - 1] + 1,
+                           diagonal + (a[i - 1] != b[j - 1] ? 1 : 0)});
+        diagonal = above;
+      }
+    }
+    return row[b.size()];
+  };
+
+  // Terms over a small alphabet, so that many are a few edits apart
+  std::vector<std::string> terms;
+  uint32_t state = 12345;
+  for (int i = 0; i < 300; ++i) {
+    std::string term;
+    size_t length = 1 + i % 7;
+    for (size_t j = 0; j < length; ++j) {
+      state = state * 1103515245 + 12345;
+      term += static_cast<char>('A' + (state >> 16) % 4);
+    }
+    terms.push_back(term);
+  }
+  RadixTreeIndex pointer_index;
+  RadixTreeIndex flat_index;
+  for (size_t i = 0; i < terms.size(); ++i) {
+    pointer_index.insert(terms[i], static_cast<DocId>(i / 2));
+    flat_index.insert(terms[i], static_cast<DocId>(i / 2));
+  }
+  flat_index.freeze();
+
+  for (const std::string query : {"ABCD", "BBA", "DCBAD", "AAAAAA"}) {
+    for (int max_edits = 1; max_edits <= 2; ++max_edits) {
+      std::vector<std::pair<DocId, int>> expected;
+      for (size_t i = 0; i < terms.size(); ++i) {
+        size_t best = max_edits + 1;
+        for (size_t length = 1; length <= terms[i].size(); ++length) {
+          best = std::min(best, distance(query, terms[i].substr(0, length)));
+        }
+        if (best <= static_cast<size_t>(max_edits)) {
+          expected.emplace_back(static_cast<DocId>(i / 2),
+                                static_cast<int>(best));
+        }
+      }
+      std::sort(expected.begin(), expected.end());
+      std::vector<std::pair<DocId, int>> unique;
+      for (const auto& match : expected) {
+        if (unique.empty() || unique.back().first != match.first) {
+          unique.push_back(match);
+        }
+      }
+
+      for (const RadixTreeIndex* index : {&pointer_index, &flat_index}) {
+        std::vector<std::pair<DocId, int>> actual;
+        for (const auto& match : index->searchFuzzy(query, max_edits)) {
+          actual.emplace_back(match.id, match.edits);
+        }
+        EXPECT_EQ(actual, unique) << query << " " << max_edits;
+      }
+    }
+  }
+}
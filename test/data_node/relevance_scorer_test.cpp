@@ -0,0 +1,70 @@
+// Relevance Scorer Unit Tests
+
+#include <gtest/gtest.h>
+
+#include "data_node/relevance_scorer.h"
+
+static AddressRecordView makeView(std::string_view number,
+                                  std::string_view street,
+                                  std::string_view unit,
+                                  std::string_view city,
+                                  std::string_view postcode) {
+  AddressRecordView view;
+  view.number = number;
+  view.street = street;
+  view.unit = unit;
+  view.city = city;
+  view.postcode = postcode;
+  return view;
+}
+
+// Test the score of a record matching every term
+TEST(RelevanceScorerTest, ScoresAllComponents) {
+  RelevanceScorer scorer({"MAIN", "SEATTLE"});
+
+  // 100 (all terms) + 15 (street start) + 8 (city start) + 10 (5 fields)
+  EXPECT_DOUBLE_EQ(
+      scorer.score(makeView("123", "MAIN STREET", "APT 1", "SEATTLE", "98101")),
+      133.0);
+}
+
+// Test that partial matches score proportionally lower
+TEST(RelevanceScorerTest, PartialMatch) {
+  RelevanceScorer scorer({"MAIN", "SEATTLE"});
+
+  // 50 (one of two terms) + 8 (city start) + 8 (4 fields)
+  EXPECT_DOUBLE_EQ(
+      scorer.score(makeView("789", "OAK STREET", "", "SEATTLE", "98101")),
+      66.0);
+}
+
+// Test that matches at the start of the street score higher
+TEST(RelevanceScorerTest, PositionBasedScoring) {
+  RelevanceScorer scorer({"MAIN"});
+
+  double start = scorer.score(makeView("1", "MAIN STREET", "", "X", "1"));
+  double middle = scorer.score(makeView("1", "SOUTH MAIN STREET", "", "X", "1"));
+  EXPECT_DOUBLE_EQ(start - middle, 5.0);
+}
+
+// Test the completeness bonus
+TEST(RelevanceScorerTest, CompletenessScoring) {
+  RelevanceScorer scorer({"NOWHERE"});
+
+  EXPECT_DOUBLE_EQ(scorer.score(makeView("1", "A", "B", "C", "D")), 10.0);
+  EXPECT_DOUBLE_EQ(scorer.score(makeView("1", "A", "", "C", "D")), 8.0);
+  EXPECT_DOUBLE_EQ(scorer.score(makeView("", "", "", "", "")), 0.0);
+}
+
+// Test that typos scale a score down but keep it positive and ordered
+TEST(RelevanceScorerTest, TyposScaleScore) {
+  RelevanceScorer scorer({"MAIM", "SEATLE"});
+  AddressRecordView record =
+      makeView("123", "MAIN STREET", "", "SEATTLE", "98101");
+
+  // No term matches: only the completeness bonus of 8 is left
+  EXPECT_DOUBLE_EQ(scorer.score(record, 0), 8.0);
+  EXPECT_DOUBLE_EQ(scorer.score(record, 1), 4.0);
+  EXPECT_DOUBLE_EQ(scorer.score(record, 2), 2.0);
+  EXPECT_GT(scorer.score(record, 4), 0.0);
+}
@@ -0,0 +1,76 @@
+// Shard Partition Unit Tests
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "data_node/shard_partition.h"
+
+// Test that jump hashing spreads keys evenly and, when a bucket is added,
+// only moves keys into the new bucket
+TEST(ShardPartitionTest, JumpHashIsBalancedAndConsistent) {
+  std::mt19937_64 random(42);
+  std::vector<uint64_t> keys(20000);
+  for (auto& key : keys) {
+    key = random();
+  }
+
+  for (uint32_t buckets : {1u, 2u, 5u, 16u}) {
+    std::vector<size_t> counts(buckets, 0);
+    size_t moved = 0;
+    for (uint64_t key : keys) {
+      uint32_t bucket = ShardPartition::jumpConsistentHash(key, buckets);
+      ASSERT_LT(bucket, buckets);
+      counts[bucket]++;
+
+      uint32_t grown = ShardPartition::jumpConsistentHash(key, buckets + 1);
+      if (grown != bucket) {
+        EXPECT_EQ(grown, buckets);
+        moved++;
+      }
+    }
+    for (size_t count : counts) {
+      EXPECT_NEAR(static_cast<double>(count), keys.size() / buckets,
+                  keys.size() / buckets * 0.1)
+          << buckets << " buckets";
+    }
+    EXPECT_NEAR(static_cast<double>(moved), keys.size() / (buckets + 1),
+                keys.size() / (buckets + 1) * 0.1)
+        << buckets << " buckets";
+  }
+
+  // Known values keep shards stable across builds
+  EXPECT_EQ(ShardPartition::jumpConsistentHash(0, 7), 0u);
+  EXPECT_EQ(ShardPartition::jumpConsistentHash(1, 7), 6u);
+}
+
+// Test routing by each key
+TEST(ShardPartitionTest, RoutesByKey) {
+  EXPECT_EQ(ShardPartition::parseKey("hash"), ShardPartition::Key::kHash);
+  EXPECT_EQ(ShardPartition::parseKey("postcode"),
+            ShardPartition::Key::kPostcode);
+  EXPECT_EQ(ShardPartition::parseKey("city"), std::nullopt);
+
+  ShardPartition by_hash(4, ShardPartition::Key::kHash);
+  EXPECT_EQ(by_hash.shardForHash(12345), by_hash.shardFor(12345, "93906"));
+  EXPECT_EQ(by_hash.shardForHash(12345),
+            ShardPartition::jumpConsistentHash(12345, 4));
+  EXPECT_EQ(by_hash.shardForPostcode("93906"), std::nullopt);
+
+  // Every record with a postcode lands on the postcode's shard; records
+  // without one fall back to their hash
+  ShardPartition by_postcode(4, ShardPartition::Key::kPostcode);
+  EXPECT_EQ(by_postcode.shardForHash(12345), std::nullopt);
+  EXPECT_EQ(by_postcode.shardForPostcode(""), std::nullopt);
+  std::optional<size_t> shard = by_postcode.shardForPostcode("93906");
+  ASSERT_TRUE(shard.has_value());
+  for (size_t hash = 0; hash < 100; ++hash) {
+    EXPECT_EQ(by_postcode.shardFor(hash, "93906"), *shard);
+  }
+  EXPECT_EQ(by_postcode.shardFor(12345, ""), by_hash.shardFor(12345, ""));
+
+  // A single shard holds everything
+  ShardPartition single(1, ShardPartition::Key::kHash);
+  EXPECT_EQ(single.shardForHash(~size_t{0}), 0u);
+}
@@ -0,0 +1,210 @@
+// Spatial Index Unit Tests
+
+#include "data_node/spatial_index.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+// Random points clustered around a few cities, plus exact duplicates
+static std::vector<GeoPoint> makePoints(size_t count, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> offset(0.0, 0.05);
+  const std::vector<GeoPoint> centers = {
+      {-121.65, 36.70}, {-122.33, 47.61}, {-73.99, 40.73}, {151.21, -33.87}};
+  std::vector<GeoPoint> points;
+  for (size_t i = 0; i < count; ++i) {
+    if (i % 10 == 9) {
+      points.push_back(points[i / 2]);
+      continue;
+    }
+    const GeoPoint& center = centers[i % centers.size()];
+    points.push_back(GeoPoint{center.longitude + offset(rng),
+                              center.latitude + offset(rng)});
+  }
+  return points;
+}
+
+static std::vector<DocId> bruteForceBox(const std::vector<GeoPoint>& points,
+                                        const GeoBox& box) {
+  std::vector<DocId> ids;
+  for (DocId id = 0; id < points.size(); ++id) {
+    if (points[id].isValid() && box.contains(points[id])) {
+      ids.push_back(id);
+    }
+  }
+  return ids;
+}
+
+static std::vector<SpatialIndex::Neighbor> bruteForceNearest(
+    const std::vector<GeoPoint>& points,
+    const GeoPoint& point,
+    size_t max_results,
+    double max_distance_meters) {
+  std::vector<SpatialIndex::Neighbor> neighbors;
+  for (DocId id = 0; id < points.size(); ++id) {
+    double distance = distanceMeters(point, points[id]);
+    if (max_distance_meters == 0.0 || distance <= max_distance_meters) {
+      neighbors.push_back(SpatialIndex::Neighbor{id, distance});
+    }
+  }
+  std::sort(neighbors.begin(), neighbors.end(),
+            [](const auto& a, const auto& b) {
+              return a.distance_meters != b.distance_meters
+                         ? a.distance_meters < b.distance_meters
+                         : a.id < b.id;
+            });
+  neighbors.resize(std::min(neighbors.size(), max_results));
+  return neighbors;
+}
+
+static void expectSameNeighbors(
+    const std::vector<SpatialIndex::Neighbor>& actual,
+    const std::vector<SpatialIndex::Neighbor>& expected) {
+  ASSERT_EQ(actual.size(), expected.size());
+  for (size_t i = 0; i < actual.size(); ++i) {
+    EXPECT_EQ(actual[i].id, expected[i].id) << "at rank " << i;
+    EXPECT_DOUBLE_EQ(actual[i].distance_meters, expected[i].distance_meters);
+  }
+}
+
+// Test distances and box bounds against known values
+TEST(SpatialIndexTest, Distances) {
+  GeoPoint salinas{-121.6555, 36.6777};
+  GeoPoint seattle{-122.3321, 47.6062};
+  EXPECT_NEAR(distanceMeters(salinas, seattle), 1216000.0, 5000.0);
+  EXPECT_DOUBLE_EQ(distanceMeters(salinas, salinas), 0.0);
+
+  // One degree of latitude is about 111.2 km
+  EXPECT_NEAR(distanceMeters({0.0, 0.0}, {0.0, 1.0}), 111195.0, 10.0);
+
+  // Across the antimeridian
+  EXPECT_NEAR(distanceMeters({179.5, 0.0}, {-179.5, 0.0}), 111195.0, 10.0);
+
+  GeoBox box{-1.0, -1.0, 1.0, 1.0};
+  EXPECT_DOUBLE_EQ(minDistanceMeters({0.5, 0.5}, box), 0.0);
+  EXPECT_NEAR(minDistanceMeters({0.0, 2.0}, box), 111195.0, 10.0);
+
+  // The bound never exceeds the distance to any point of the box
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> longitude(-180.0, 180.0);
+  std::uniform_real_distribution<double> latitude(-90.0, 90.0);
+  for (int i = 0; i < 2000; ++i) {
+    GeoPoint a{longitude(rng), latitude(rng)};
+    GeoPoint b{longitude(rng), latitude(rng)};
+    GeoPoint c{longitude(rng), latitude(rng)};
+    GeoBox bounds{std::min(b.longitude, c.longitude),
+                  std::min(b.latitude, c.latitude),
+                  std::max(b.longitude, c.longitude),
+                  std::max(b.latitude, c.latitude)};
+    EXPECT_LE(minDistanceMeters(a, bounds), distanceMeters(a, b) + 1e-6);
+    EXPECT_LE(minDistanceMeters(a, bounds), distanceMeters(a, c) + 1e-6);
+  }
+}
+
+// Test validation of points and boxes
+TEST(SpatialIndexTest, Validation) {
+  EXPECT_TRUE((GeoPoint{-180.0, 90.0}.isValid()));
+  EXPECT_FALSE((GeoPoint{180.5, 0.0}.isValid()));
+  EXPECT_FALSE((GeoPoint{0.0, -91.0}.isValid()));
+  EXPECT_FALSE(
+      (GeoPoint{std::numeric_limits<double>::quiet_NaN(), 0.0}.isValid()));
+
+  EXPECT_TRUE((GeoBox{-1.0, -1.0, 1.0, 1.0}.isValid()));
+  EXPECT_TRUE((GeoBox{1.0, 1.0, 1.0, 1.0}.isValid()));
+  EXPECT_FALSE((GeoBox{1.0, -1.0, -1.0, 1.0}.isValid()));
+  EXPECT_FALSE((GeoBox{-1.0, 1.0, 1.0, -1.0}.isValid()));
+}
+
+// Test box search against a linear scan
+TEST(SpatialIndexTest, SearchBoxMatchesScan) {
+  std::vector<GeoPoint> points = makePoints(5000, 1);
+  points[17] = GeoPoint{std::numeric_limits<double>::quiet_NaN(), 0.0};
+  points[18] = GeoPoint{200.0, 0.0};
+  SpatialIndex index;
+  index.build(points);
+  EXPECT_EQ(index.size(), points.size() - 2);  // Invalid points left out
+  EXPECT_GT(index.getMemoryUsage(), 0u);
+
+  for (const GeoBox& box : std::vector<GeoBox>{
+           {-121.7, 36.65, -121.6, 36.75},
+           {-122.4, 47.5, -122.3, 47.7},
+           {-180.0, -90.0, 180.0, 90.0},
+           {0.0, 0.0, 1.0, 1.0},
+           {points[3].longitude, points[3].latitude, points[3].longitude,
+            points[3].latitude}}) {
+    EXPECT_EQ(index.searchBox(box), bruteForceBox(points, box));
+  }
+}
+
+// Test nearest neighbours against a linear scan, including ties
+TEST(SpatialIndexTest, NearestMatchesScan) {
+  std::vector<GeoPoint> points = makePoints(5000, 2);
+  SpatialIndex index;
+  index.build(points);
+
+  for (const GeoPoint& query :
+       std::vector<GeoPoint>{{-121.65, 36.70}, {-73.99, 40.73}, {0.0, 0.0},
+                             points[9], points[4001]}) {
+    for (size_t k : {1, 5, 50}) {
+      expectSameNeighbors(index.nearest(query, k),
+                          bruteForceNearest(points, query, k, 0.0));
+    }
+    expectSameNeighbors(index.nearest(query, 1000, 2000.0),
+                        bruteForceNearest(points, query, 1000, 2000.0));
+  }
+
+  EXPECT_TRUE(index.nearest({-121.65, 36.70}, 0).empty());
+  EXPECT_TRUE(index.nearest({0.0, 0.0}, 10, 1000.0).empty());
+}
+
+// Test that an empty index answers every query with nothing
+TEST(SpatialIndexTest, EmptyIndex) {
+  SpatialIndex unbuilt;
+  EXPECT_TRUE(unbuilt.searchBox({-180.0, -90.0, 180.0, 90.0}).empty());
+  EXPECT_TRUE(unbuilt.nearest({0.0, 0.0}, 10).empty());
+
+  SpatialIndex index;
+  index.build({});
+  EXPECT_EQ(index.size(), 0u);
+  EXPECT_TRUE(index.searchBox({-180.0, -90.0, 180.0, 90.0}).empty());
+  EXPECT_TRUE(index.nearest({0.0, 0.0}, 10).empty());
+}
+
+// Test serving the tree from a snapshot
+TEST(SpatialIndexTest, SnapshotRoundTrip) {
+  const SourceFingerprint source = {42, 0x5EED};
+  std::string path = testing::TempDir() + "spatial_index_test.snapshot";
+  std::vector<GeoPoint> points = makePoints(1000, 3);
+  SpatialIndex built;
+  built.build(points);
+
+  SnapshotWriter writer;
+  built.addToSnapshot(writer);
+  ASSERT_TRUE(writer.write(path, source));
+  auto snapshot = IndexSnapshot::open(path, source);
+  ASSERT_NE(snapshot, nullptr);
+
+  SpatialIndex loaded;
+  ASSERT_TRUE(loaded.loadFromSnapshot(snapshot));
+  EXPECT_EQ(loaded.size(), built.size());
+  GeoBox box{-121.7, 36.65, -121.6, 36.75};
+  EXPECT_EQ(loaded.searchBox(box), built.searchBox(box));
+  expectSameNeighbors(loaded.nearest({-121.65, 36.70}, 20),
+                      built.nearest({-121.65, 36.70}, 20));
+
+  // A snapshot without the spatial sections is rejected
+  SnapshotWriter empty_writer;
+  ASSERT_TRUE(empty_writer.write(path, source));
+  auto empty_snapshot = IndexSnapshot::open(path, source);
+  ASSERT_NE(empty_snapshot, nullptr);
+  EXPECT_FALSE(loaded.loadFromSnapshot(empty_snapshot));
+
+  std::remove(path.c_str());
+}
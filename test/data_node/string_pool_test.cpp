@@ -0,0 +1,62 @@
+// String Pool Unit Tests
+
+#include "data_node/string_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+TEST(StringPoolTest, EmptyStringIsPreInterned) {
+  StringPool pool;
+
+  EXPECT_EQ(pool.size(), 1);
+  EXPECT_EQ(pool.intern(""), StringPool::kEmptyStringId);
+  EXPECT_EQ(pool.get(StringPool::kEmptyStringId), "");
+  EXPECT_EQ(pool.size(), 1);
+}
+
+TEST(StringPoolTest, InternDeduplicates) {
+  StringPool pool;
+
+  StringPool::StringId salinas = pool.intern("SALINAS");
+  StringPool::StringId seaside = pool.intern("SEASIDE");
+  EXPECT_NE(salinas, seaside);
+
+  // Interning the same content again returns the existing ID
+  std::string copy = "SALINAS";
+  EXPECT_EQ(pool.intern(copy), salinas);
+  EXPECT_EQ(pool.size(), 3);
+
+  EXPECT_EQ(pool.get(salinas), "SALINAS");
+  EXPECT_EQ(pool.get(seaside), "SEASIDE");
+}
+
+TEST(StringPoolTest, ManyStringsStayAddressable) {
+  StringPool pool;
+
+  // Enough strings to force several buffer reallocations
+  for (int i = 0; i < 5000; ++i) {
+    pool.intern("STREET " + std::to_string(i));
+  }
+  EXPECT_EQ(pool.size(), 5001);
+
+  for (int i = 0; i < 5000; ++i) {
+    std::string expected = "STREET " + std::to_string(i);
+    StringPool::StringId id = pool.intern(expected);
+    EXPECT_EQ(pool.get(id), expected);
+  }
+  EXPECT_EQ(pool.size(), 5001);
+}
+
+TEST(StringPoolTest, GetInvalidIdReturnsEmpty) {
+  StringPool pool;
+  EXPECT_EQ(pool.get(12345), "");
+}
+
+TEST(StringPoolTest, MemoryUsageGrows) {
+  StringPool pool;
+  size_t initial_usage = pool.getMemoryUsage();
+
+  pool.intern("SOME LONG STREET NAME THAT NEEDS STORAGE");
+  EXPECT_GT(pool.getMemoryUsage(), initial_usage);
+}
@@ -0,0 +1,84 @@
+// Thread Pool Unit Tests
+
+#include "data_node/thread_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Test that every submitted task runs, on the pool's own threads
+TEST(ThreadPoolTest, RunsAllTasksOnWorkers) {
+  std::atomic<int> completed{0};
+  std::mutex ids_mutex;
+  std::set<std::thread::id> worker_ids;
+  {
+    ThreadPool pool(3);
+    EXPECT_EQ(pool.getThreadCount(), 3u);
+    for (int i = 0; i < 200; ++i) {
+      pool.submit([&]() {
+        {
+          std::lock_guard<std::mutex> lock(ids_mutex);
+          worker_ids.insert(std::this_thread::get_id());
+        }
+        completed++;
+      });
+    }
+  }  // The destructor drains the queue
+
+  EXPECT_EQ(completed, 200);
+  EXPECT_LE(worker_ids.size(), 3u);
+  EXPECT_EQ(worker_ids.count(std::this_thread::get_id()), 0u);
+}
+
+// Test that tasks may be submitted from other tasks and from many threads
+TEST(ThreadPoolTest, ConcurrentSubmitters) {
+  std::atomic<int> completed{0};
+  {
+    ThreadPool pool(2);
+    std::vector<std::thread> submitters;
+    for (int t = 0; t < 4; ++t) {
+      submitters.emplace_back([&]() {
+        for (int i = 0; i < 50; ++i) {
+          pool.submit([&]() {
+            pool.submit([&]() { completed++; });
+            completed++;
+          });
+        }
+      });
+    }
+    for (auto& submitter : submitters) {
+      submitter.join();
+    }
+  }
+
+  EXPECT_EQ(completed, 400);
+}
+
+// Test that a pool sized to the hardware has at least one worker
+TEST(ThreadPoolTest, DefaultSizeUsesHardwareThreads) {
+  ThreadPool pool(0);
+  EXPECT_GE(pool.getThreadCount(), 1u);
+}
+
+// Test that tasks waiting for a busy worker are counted as queued
+TEST(ThreadPoolTest, CountsQueuedTasks) {
+  std::mutex gate;
+  std::unique_lock<std::mutex> closed(gate);
+  std::atomic<bool> started{false};
+  ThreadPool pool(1);
+  pool.submit([&]() {
+    started = true;
+    std::lock_guard<std::mutex> lock(gate);
+  });
+  while (!started) {
+    std::this_thread::yield();
+  }
+  pool.submit([]() {});
+  pool.submit([]() {});
+  EXPECT_EQ(pool.getQueuedTaskCount(), 2u);
+  closed.unlock();
+}
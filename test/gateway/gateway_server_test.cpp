@@ -2,7 +2,10 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "gateway/gateway_server.h"
@@ -477,3 +480,252 @@ TEST_F(GatewayServerTest, SortingScoredRecords) {
   EXPECT_EQ(scored_records[3].relevance_score, 10.0);
   EXPECT_EQ(scored_records[4].relevance_score, 0.0);
 }
+
+// Test: Echoed query spliced into a cached payload
+TEST_F(GatewayServerTest, AddQueryToPayload) {
+  EXPECT_EQ(GatewayServer::addQueryToPayload("Main St",
+                                             "{\"result_count\":0}"),
+            "{\"query\":\"Main St\",\"result_count\":0}");
+  EXPECT_EQ(GatewayServer::addQueryToPayload("a \"b\"\\c\n", "{}"),
+            "{\"query\":\"a \\\"b\\\"\\\\c\\u000a\"}");
+}
+
+// Test splitting request text into data node query terms
+TEST_F(GatewayServerTest, SplitQueryTerms) {
+  EXPECT_EQ(GatewayServer::splitQueryTerms("  Main   St "),
+            (std::vector<std::string>{"Main", "St"}));
+  EXPECT_EQ(GatewayServer::splitQueryTerms("1 Main St, Salinas"),
+            (std::vector<std::string>{"1 Main St, Salinas"}));
+  EXPECT_TRUE(GatewayServer::splitQueryTerms("   ").empty());
+}
+
+// Test merging nearest records of several shards by distance
+TEST_F(GatewayServerTest, MergeByDistance) {
+  DataNodeResult shard0;
+  shard0.shard_id = 0;
+  shard0.success = true;
+  shard0.records = {createTestRecord("1", "MAIN ST", "A", "1"),
+                    createTestRecord("3", "MAIN ST", "A", "1")};
+  shard0.distances = {10.0, 30.0};
+
+  DataNodeResult shard1;
+  shard1.shard_id = 1;
+  shard1.success = true;
+  shard1.records = {createTestRecord("2", "MAIN ST", "A", "1"),
+                    createTestRecord("1", "MAIN ST", "A", "1")};
+  shard1.distances = {20.0, 25.0};
+
+  DataNodeResult failed;
+  failed.shard_id = 2;
+  failed.success = false;
+
+  auto nearest = GatewayServer::mergeByDistance({shard0, shard1, failed}, 10);
+  ASSERT_EQ(nearest.size(), 3u);  // The farther copy of "1" is dropped
+  EXPECT_EQ(nearest[0].record.number(), "1");
+  EXPECT_EQ(nearest[0].shard_id, 0);
+  EXPECT_DOUBLE_EQ(nearest[0].distance_meters, 10.0);
+  EXPECT_EQ(nearest[1].record.number(), "2");
+  EXPECT_EQ(nearest[1].shard_id, 1);
+  EXPECT_EQ(nearest[2].record.number(), "3");
+
+  auto limited = GatewayServer::mergeByDistance({shard0, shard1}, 2);
+  ASSERT_EQ(limited.size(), 2u);
+  EXPECT_EQ(limited[1].record.number(), "2");
+}
+
+// Test that /metrics renders every stage and the query cache counters
+TEST_F(GatewayServerTest, RenderMetrics) {
+  GatewayServer gateway(config_);
+  std::string metrics = gateway.renderMetrics();
+
+  EXPECT_NE(metrics.find("# TYPE gateway_stage_latency_seconds summary\n"),
+            std::string::npos);
+  for (const char* stage : {"parse", "fan_out", "merge_rank", "serialize"}) {
+    EXPECT_NE(metrics.find(std::string("gateway_stage_latency_seconds_count{"
+                                       "stage=\"") +
+                           stage + "\"} 0\n"),
+              std::string::npos)
+        << stage;
+  }
+  EXPECT_NE(metrics.find("gateway_query_cache_hits_total 0\n"),
+            std::string::npos);
+  EXPECT_NE(metrics.find("# TYPE gateway_query_cache_entries gauge\n"),
+            std::string::npos);
+  EXPECT_NE(metrics.find("gateway_admission_queue_depth 0\n"),
+            std::string::npos);
+  EXPECT_NE(metrics.find("gateway_shed_requests_total 0\n"),
+            std::string::npos);
+}
+
+// Test that admission control starts at the configured limit
+TEST_F(GatewayServerTest, AdmissionConfiguration) {
+  GatewayServer adaptive(config_);
+  EXPECT_EQ(adaptive.getAdmissionStats().limit,
+            config_.admission.initial_limit);
+
+  GatewayConfig fixed_config = config_;
+  fixed_config.admission.max_concurrency = 3;
+  GatewayServer fixed(fixed_config);
+  ConcurrencyLimiter::Stats stats = fixed.getAdmissionStats();
+  EXPECT_EQ(stats.limit, 3u);
+  EXPECT_EQ(stats.in_flight, 0u);
+  EXPECT_EQ(stats.shed, 0u);
+  EXPECT_NE(fixed.renderMetrics().find("gateway_admission_limit 3\n"),
+            std::string::npos);
+}
+
+// Test that data nodes sharing a shard ID are grouped as replicas of one
+// shard, each with its own metrics
+TEST_F(GatewayServerTest, GroupsReplicasByShard) {
+  DataNodeConfig replica;
+  replica.address = "localhost:50053";
+  replica.shard_id = 0;
+  config_.data_nodes.push_back(replica);
+  config_.channels_per_replica = 2;
+  config_.health_check_interval_ms = 0;
+
+  GatewayServer gateway(config_);
+  ASSERT_TRUE(gateway.initialize());
+  std::string metrics = gateway.renderMetrics();
+
+  for (const char* labels :
+       {"shard=\"0\",replica=\"localhost:50051\"",
+        "shard=\"0\",replica=\"localhost:50053\"",
+        "shard=\"1\",replica=\"localhost:50052\""}) {
+    EXPECT_NE(metrics.find(std::string("gateway_replica_healthy{") + labels +
+                           "} 1\n"),
+              std::string::npos)
+        << labels;
+    EXPECT_NE(metrics.find(std::string("gateway_replica_outstanding_calls{") +
+                           labels + "} 0\n"),
+              std::string::npos)
+        << labels;
+  }
+  EXPECT_NE(metrics.find("gateway_hedged_calls_total{shard=\"0\"} 0\n"),
+            std::string::npos);
+  EXPECT_NE(metrics.find("gateway_failover_calls_total{shard=\"1\"} 0\n"),
+            std::string::npos);
+  EXPECT_EQ(metrics.find("gateway_hedged_calls_total{shard=\"2\"}"),
+            std::string::npos);
+}
+
+// Test that hash lookups are routed to one shard only when the shards
+// were split by hash and their IDs cover the partition
+TEST_F(GatewayServerTest, RoutesHashLookupsByPartition) {
+  config_.health_check_interval_ms = 0;
+  {
+    GatewayServer gateway(config_);
+    ASSERT_TRUE(gateway.initialize());
+    EXPECT_EQ(gateway.shardForHash(0xa8ac1dc8c998ce76), std::nullopt);
+  }
+
+  config_.partition_key = ShardPartition::Key::kHash;
+  {
+    GatewayServer gateway(config_);
+    ASSERT_TRUE(gateway.initialize());
+    for (size_t hash : {size_t{0}, size_t{1}, size_t{0xa8ac1dc8c998ce76}}) {
+      EXPECT_EQ(gateway.shardForHash(hash),
+                static_cast<int>(ShardPartition::jumpConsistentHash(hash, 2)));
+    }
+  }
+
+  config_.partition_key = ShardPartition::Key::kPostcode;
+  {
+    GatewayServer gateway(config_);
+    ASSERT_TRUE(gateway.initialize());
+    EXPECT_EQ(gateway.shardForHash(1), std::nullopt);
+  }
+
+  // Shard IDs 0 and 2 do not match a two-shard partition
+  config_.partition_key = ShardPartition::Key::kHash;
+  config_.data_nodes[1].shard_id = 2;
+  {
+    GatewayServer gateway(config_);
+    ASSERT_TRUE(gateway.initialize());
+    EXPECT_EQ(gateway.shardForHash(1), std::nullopt);
+  }
+}
+
+// Test that merging drops duplicates across shards, keeping the better
+// scored copy, and returns the top results best first
+TEST_F(GatewayServerTest, AggregateAndRankResults) {
+  DataNodeResult shard0;
+  shard0.shard_id = 0;
+  shard0.success = true;
+  shard0.records = {
+      createTestRecord("1", "OAK ST", "SALINAS", "93901", "", 1),
+      createTestRecord("2", "MAIN ST", "SALINAS", "93901", "", 2),
+      createTestRecord("3", "MAIN ST", "", "", "", 3)};
+
+  DataNodeResult shard1;
+  shard1.shard_id = 1;
+  shard1.success = true;
+  shard1.records = {
+      // Record 2 with a unit, sharing its hash: more complete, scores higher
+      createTestRecord("2", "MAIN ST", "SALINAS", "93901", "APT 1", 2),
+      // The very record 1 again, from an overlapping shard
+      createTestRecord("1", "OAK ST", "SALINAS", "93901", "", 1),
+      createTestRecord("4", "MAIN ST", "SALINAS", "93901", "", 5)};
+
+  DataNodeResult failed;
+  failed.shard_id = 2;
+  failed.success = false;
+  failed.records = {createTestRecord("9", "MAIN ST", "SALINAS", "93901")};
+
+  auto ranked = GatewayServer::aggregateAndRankResults(
+      {shard0, shard1, failed}, {"MAIN"}, 10);
+  ASSERT_EQ(ranked.size(), 4u);
+  EXPECT_EQ(ranked[0].record.number(), "2");
+  EXPECT_EQ(ranked[0].record.unit(), "APT 1");
+  EXPECT_EQ(ranked[0].shard_id, 1);
+  EXPECT_EQ(ranked[1].record.number(), "4");
+  EXPECT_EQ(ranked[2].record.number(), "3");
+  EXPECT_EQ(ranked[3].record.number(), "1");
+  for (size_t i = 1; i < ranked.size(); ++i) {
+    EXPECT_GE(ranked[i - 1].relevance_score, ranked[i].relevance_score);
+  }
+
+  // Records are keyed by their hash when they have one, whatever their
+  // fields, and by their fields otherwise
+  DataNodeResult keyed;
+  keyed.shard_id = 0;
+  keyed.success = true;
+  keyed.records = {
+      createTestRecord("7", "MAIN ST", "SALINAS", "93901", "", 7),
+      createTestRecord("7", "MAIN STREET", "SALINAS", "93901", "", 7),
+      createTestRecord("8", "MAIN ST", "SALINAS", "93901", "", 8),
+      createTestRecord("8", "MAIN ST", "SALINAS", "93901", "", 9),
+      createTestRecord("9", "MAIN ST", "SALINAS", "93901", "", 0),
+      createTestRecord("9", "MAIN ST", "SALINAS", "93901", "", 0)};
+  auto deduplicated =
+      GatewayServer::aggregateAndRankResults({keyed}, {"MAIN"}, 10);
+  ASSERT_EQ(deduplicated.size(), 4u);
+  std::vector<uint64_t> hashes;
+  for (const auto& scored : deduplicated) {
+    hashes.push_back(scored.record.hash());
+  }
+  std::sort(hashes.begin(), hashes.end());
+  EXPECT_EQ(hashes, (std::vector<uint64_t>{0, 7, 8, 9}));
+
+  auto top = GatewayServer::aggregateAndRankResults({shard0, shard1},
+                                                    {"MAIN"}, 2);
+  ASSERT_EQ(top.size(), 2u);
+  EXPECT_EQ(top[0].record.number(), "2");
+  EXPECT_EQ(top[1].record.number(), "4");
+
+  // Scores sent by the data nodes (e.g. with typo penalties) are merged on
+  // as they are
+  DataNodeResult fuzzy;
+  fuzzy.shard_id = 0;
+  fuzzy.success = true;
+  fuzzy.records = {createTestRecord("5", "MAIN ST", "SALINAS", "93901"),
+                   createTestRecord("6", "MAIM ST", "SALINAS", "93901")};
+  fuzzy.scores = {50.0, 40.0};
+  auto merged = GatewayServer::aggregateAndRankResults({fuzzy, shard1},
+                                                       {"MAIM"}, 10);
+  ASSERT_EQ(merged.size(), 5u);
+  EXPECT_EQ(merged[0].record.number(), "5");
+  EXPECT_DOUBLE_EQ(merged[0].relevance_score, 50.0);
+  EXPECT_EQ(merged[1].record.number(), "6");
+  EXPECT_DOUBLE_EQ(merged[1].relevance_score, 40.0);
+}
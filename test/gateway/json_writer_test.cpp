@@ -0,0 +1,90 @@
+// JSON Writer Unit Tests
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <string>
+
+#include "gateway/json_writer.h"
+
+static std::string jsonString(std::string_view value) {
+  std::string out;
+  appendJsonString(out, value);
+  return out;
+}
+
+static std::string jsonNumber(double value) {
+  std::string out;
+  appendJsonNumber(out, value);
+  return out;
+}
+
+// Test that strings are escaped like crow::json escapes them
+TEST(JsonWriterTest, EscapesStrings) {
+  EXPECT_EQ(jsonString(""), "\"\"");
+  EXPECT_EQ(jsonString("MAIN ST"), "\"MAIN ST\"");
+  EXPECT_EQ(jsonString("a \"b\"\\c"), "\"a \\\"b\\\"\\\\c\"");
+  EXPECT_EQ(jsonString("\n\t\r\b\f"), "\"\\n\\t\\r\\b\\f\"");
+  EXPECT_EQ(jsonString(std::string("\x01\x1f\x7f", 3)),
+            "\"\\u0001\\u001f\x7f\"");
+  EXPECT_EQ(jsonString("CAF\xC3\x89"), "\"CAF\xC3\x89\"");  // UTF-8 as is
+}
+
+// Test that numbers are formatted like crow::json formats them
+TEST(JsonWriterTest, FormatsNumbers) {
+  EXPECT_EQ(jsonNumber(125.5), "125.5");
+  EXPECT_EQ(jsonNumber(10.0), "10.0");
+  EXPECT_EQ(jsonNumber(0.0), "0.0");
+  EXPECT_EQ(jsonNumber(1.05), "1.05");
+  EXPECT_EQ(jsonNumber(-122.608996), "-122.608996");
+  EXPECT_EQ(jsonNumber(47.1663771), "47.166377");  // Six decimals
+  EXPECT_EQ(jsonNumber(NAN), "null");
+  EXPECT_EQ(jsonNumber(INFINITY), "null");
+
+  std::string out;
+  appendJsonNumber(out, int64_t{-3});
+  out += ',';
+  appendJsonNumber(out, uint64_t{18446744073709551615ull});
+  EXPECT_EQ(out, "-3,18446744073709551615");
+}
+
+// Test reading the members of flat request bodies in place
+TEST(JsonWriterTest, ParsesFlatObjects) {
+  std::string body = " {\"address\" : \"Main St\",\"fuzziness\":1,\n"
+                     "\"score\":-2.5e1, \"on\":true, \"none\":null} ";
+  FlatJsonObject object;
+  ASSERT_TRUE(object.parse(body));
+
+  const FlatJsonObject::Member* address = object.find("address");
+  ASSERT_NE(address, nullptr);
+  EXPECT_EQ(address->type, FlatJsonObject::Type::kString);
+  EXPECT_EQ(address->value, "Main St");
+  EXPECT_EQ(address->value.data(), body.data() + 15);  // Not copied
+
+  const FlatJsonObject::Member* fuzziness = object.find("fuzziness");
+  ASSERT_NE(fuzziness, nullptr);
+  EXPECT_EQ(fuzziness->type, FlatJsonObject::Type::kNumber);
+  EXPECT_EQ(FlatJsonObject::toNumber(*fuzziness), 1.0);
+  EXPECT_EQ(FlatJsonObject::toNumber(*object.find("score")), -25.0);
+  EXPECT_EQ(object.find("on")->type, FlatJsonObject::Type::kLiteral);
+  EXPECT_EQ(object.find("none")->value, "null");
+  EXPECT_EQ(object.find("missing"), nullptr);
+
+  ASSERT_TRUE(object.parse("{}"));
+  EXPECT_EQ(object.find("address"), nullptr);
+}
+
+// Test that bodies of any other shape are left to a full JSON parser
+TEST(JsonWriterTest, RejectsOtherShapes) {
+  FlatJsonObject object;
+  for (const char* body :
+       {"", "[]", "{", "{\"a\":1", "{\"a\":1,}", "{\"a\" 1}", "{a:1}",
+        "{\"a\":\"x\\\"y\"}",  // Escape sequences
+        "{\"a\":\"x\ny\"}",    // Control characters
+        "{\"a\":[1]}", "{\"a\":{}}", "{\"a\":01}", "{\"a\":1.}",
+        "{\"a\":-}", "{\"a\":1e}", "{\"a\":tru}", "{\"a\":1,\"a\":2}",
+        "{\"a\":1} x", "{\"1\":1,\"2\":2,\"3\":3,\"4\":4,\"5\":5,\"6\":6,"
+                       "\"7\":7,\"8\":8,\"9\":9}"}) {
+    EXPECT_FALSE(object.parse(body)) << body;
+  }
+}
@@ -0,0 +1,140 @@
+// Query Cache Unit Tests
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gateway/query_cache.h"
+
+static QueryCacheConfig makeConfig(size_t max_bytes, size_t shard_count = 1) {
+  QueryCacheConfig config;
+  config.max_bytes = max_bytes;
+  config.ttl = std::chrono::milliseconds(1000);
+  config.shard_count = shard_count;
+  return config;
+}
+
+// Test hits, misses and replacing an entry
+TEST(QueryCacheTest, GetAndPut) {
+  QueryCache cache(makeConfig(1 << 20));
+  ASSERT_TRUE(cache.isEnabled());
+
+  EXPECT_EQ(cache.get("a"), nullptr);
+  cache.put("a", "payload a");
+  auto payload = cache.get("a");
+  ASSERT_NE(payload, nullptr);
+  EXPECT_EQ(*payload, "payload a");
+
+  cache.put("a", "replaced");
+  EXPECT_EQ(*cache.get("a"), "replaced");
+  EXPECT_EQ(*payload, "payload a");  // Earlier readers keep their copy
+
+  QueryCache::Stats stats = cache.getStats();
+  EXPECT_EQ(stats.hits, 2u);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.insertions, 2u);
+  EXPECT_EQ(stats.entries, 1u);
+  EXPECT_EQ(stats.bytes, 1 + 8 + QueryCache::kEntryOverhead);
+}
+
+// Test that entries expire after the TTL
+TEST(QueryCacheTest, EntriesExpire) {
+  QueryCache cache(makeConfig(1 << 20));
+  auto start = QueryCache::Clock::now();
+
+  cache.put("a", "payload", start);
+  EXPECT_NE(cache.get("a", start + std::chrono::milliseconds(999)), nullptr);
+  EXPECT_EQ(cache.get("a", start + std::chrono::milliseconds(1000)), nullptr);
+
+  QueryCache::Stats stats = cache.getStats();
+  EXPECT_EQ(stats.expirations, 1u);
+  EXPECT_EQ(stats.entries, 0u);
+  EXPECT_EQ(stats.bytes, 0u);
+}
+
+// Test that the least recently used entries are evicted to stay in budget
+TEST(QueryCacheTest, EvictsLeastRecentlyUsed) {
+  std::string payload(100, 'x');
+  size_t charge = 1 + payload.size() + QueryCache::kEntryOverhead;
+  QueryCache cache(makeConfig(3 * charge));
+
+  cache.put("a", payload);
+  cache.put("b", payload);
+  cache.put("c", payload);
+  ASSERT_NE(cache.get("a"), nullptr);  // "b" is now the oldest
+
+  cache.put("d", payload);
+  EXPECT_EQ(cache.get("b"), nullptr);
+  EXPECT_NE(cache.get("a"), nullptr);
+  EXPECT_NE(cache.get("c"), nullptr);
+  EXPECT_NE(cache.get("d"), nullptr);
+
+  QueryCache::Stats stats = cache.getStats();
+  EXPECT_EQ(stats.evictions, 1u);
+  EXPECT_EQ(stats.entries, 3u);
+  EXPECT_LE(stats.bytes, 3 * charge);
+
+  // A payload larger than the whole budget is not cached
+  cache.put("huge", std::string(4 * charge, 'y'));
+  EXPECT_EQ(cache.get("huge"), nullptr);
+  EXPECT_EQ(cache.getStats().entries, 3u);
+}
+
+// Test that a zero size or TTL disables the cache
+TEST(QueryCacheTest, Disabled) {
+  QueryCache no_bytes(makeConfig(0));
+  EXPECT_FALSE(no_bytes.isEnabled());
+  no_bytes.put("a", "payload");
+  EXPECT_EQ(no_bytes.get("a"), nullptr);
+
+  QueryCacheConfig config = makeConfig(1 << 20);
+  config.ttl = std::chrono::milliseconds(0);
+  QueryCache no_ttl(config);
+  EXPECT_FALSE(no_ttl.isEnabled());
+}
+
+// Test that keys distinguish term boundaries and case
+TEST(QueryCacheTest, MakeKey) {
+  EXPECT_EQ(QueryCache::makeKey({"MAIN", "ST"}),
+            QueryCache::makeKey({"MAIN", "ST"}));
+  EXPECT_NE(QueryCache::makeKey({"MAIN", "ST"}),
+            QueryCache::makeKey({"MAINST"}));
+  EXPECT_NE(QueryCache::makeKey({"MAIN ST"}),
+            QueryCache::makeKey({"MAIN", "ST"}));
+  EXPECT_NE(QueryCache::makeKey({"1:A"}), QueryCache::makeKey({"A", "A"}));
+  EXPECT_NE(QueryCache::makeKey({"Main"}), QueryCache::makeKey({"MAIN"}));
+  EXPECT_EQ(QueryCache::makeKey({"MAIN"}, 0), QueryCache::makeKey({"MAIN"}));
+  EXPECT_NE(QueryCache::makeKey({"MAIN"}, 1), QueryCache::makeKey({"MAIN"}));
+  EXPECT_NE(QueryCache::makeKey({"MAIN"}, 1), QueryCache::makeKey({"MAIN"}, 2));
+}
+
+// Test concurrent use across shards
+TEST(QueryCacheTest, ConcurrentAccess) {
+  QueryCache cache(makeConfig(1 << 20, 8));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&cache, t]() {
+      for (int i = 0; i < 500; ++i) {
+        std::string key = "key" + std::to_string((i * 7 + t) % 50);
+        if (!cache.get(key)) {
+          cache.put(key, "payload for " + key);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  QueryCache::Stats stats = cache.getStats();
+  EXPECT_EQ(stats.hits + stats.misses, 2000u);
+  EXPECT_EQ(stats.entries, 50u);
+  for (int i = 0; i < 50; ++i) {
+    std::string key = "key" + std::to_string(i);
+    auto payload = cache.get(key);
+    ASSERT_NE(payload, nullptr);
+    EXPECT_EQ(*payload, "payload for " + key);
+  }
+}